@@ -27,6 +27,7 @@ private:
 	ci::gl::TextureRef			mTextureDepth;
 	ci::gl::TextureRef			mTextureBodyIndex;
 	Kinect2::DeviceRef			mDevice;
+	ci::Vec2f					mJointPositions[ BODY_COUNT * JointType_Count ];
 
 	ci::Font					mFont;
 
@@ -74,13 +75,13 @@ void BodyApp::draw()
 	gl::enableWireframe();
 
 	if ( mDevice ) {
-		const vector<Kinect2::User>& users = mDevice->getFrame().getUsers();
-		for ( const Kinect2::User& user : users ) {
-			gl::color( getUserColor( user.getBodyIndex() ) );
-			for ( auto jointPair : user.getJointMap() ) {
+		const vector<Kinect2::Body>& bodies = mDevice->getFrame().getBodies();
+		for ( const Kinect2::Body& body : bodies ) {
+			gl::color( getUserColor( body.getIndex() ) );
+			for ( auto jointPair : body.getJointMap() ) {
 				gl::pushModelView();
-				gl::translate( jointPair.second.mPosition );
-				gl::rotate( jointPair.second.mOrientation );
+				gl::translate( jointPair.second.getPosition() );
+				gl::rotate( jointPair.second.getOrientation() );
 				gl::scale( 0.05f, 0.05f, 0.05f );
 				gl::drawCube( Vec3f::zero(), Vec3f::one() );
 				gl::popModelView();
@@ -107,17 +108,16 @@ void BodyApp::draw()
 		if ( mDevice ) {
 			Vec2f s = Vec2f( viewport.getSize() ) / Vec2f( mTextureColor->getSize() );
 
-			const vector<Kinect2::User>& users = mDevice->getFrame().getUsers();
-			for ( const Kinect2::User& user : users ) {
-				gl::color( getUserColor( user.getBodyIndex() ) );
-				for ( auto jointPair : user.getJointMap() ) {
-					Vec2f colorPos = mDevice->getJointPositionInColorFrame( jointPair.second.mPosition );
-					colorPos *= s;
-
-					//console( ) << "scale: " << s << "\n" << "position: " << colorPos << endl;
-
-					if ( jointPair.first == JointType_SpineMid ) {
-						gl::drawString( "User Id: " + toString( (int32_t)user.getBodyIndex() ), colorPos + Vec2f( 8.0f, 0.0f ), ColorAf( 0.0f, 1.0f, 1.0f ), mFont );
+			// Project every joint of every body in one call. Nothing is 
+			// drawn if mapping fails, rather than last frame's positions.
+			const vector<Kinect2::Body>& bodies = mDevice->getFrame().getBodies();
+			size_t count = Kinect2::mapBodiesToColor( bodies, mJointPositions, mDevice->getCoordinateMapper() );
+			for ( size_t i = 0; i < count / JointType_Count; ++i ) {
+				gl::color( getUserColor( bodies[ i ].getIndex() ) );
+				for ( int32_t j = 0; j < JointType_Count; ++j ) {
+					Vec2f colorPos = mJointPositions[ i * JointType_Count + j ] * s;
+					if ( j == JointType_SpineMid ) {
+						gl::drawString( "User Id: " + toString( (int32_t)bodies[ i ].getIndex() ), colorPos + Vec2f( 8.0f, 0.0f ), ColorAf( 0.0f, 1.0f, 1.0f ), mFont );
 					}
 
 					gl::drawSolidCircle( colorPos, 5.0f );
@@ -0,0 +1,261 @@
+#include "Kinect2Gesture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+// Benchmarks GestureRecognizer against synthetic trajectories. Templates
+// are recorded from parametric arm motions at several speeds. Six bodies
+// then perform random gestures at random speeds, sizes and positions with
+// sensor noise and idle gaps in between. Reports update timing, the pair
+// pruning counters and how many performed gestures were recognized.
+
+using namespace ci;
+using namespace Kinect2;
+using namespace std;
+
+static const float kPi = 3.14159265f;
+
+enum
+{
+	Gesture_WaveRight, Gesture_WaveLeft, Gesture_CircleRight, Gesture_SwipeLeft,
+	Gesture_SwipeRight, Gesture_PunchRight, Gesture_RaiseBoth, Gesture_Clap, Gesture_Count
+};
+
+static const char* kGestureNames[ Gesture_Count ] = {
+	"wave right", "wave left", "circle right", "swipe left",
+	"swipe right", "punch right", "raise both", "clap"
+};
+
+// Hand positions relative to the mid spine, in meters for a body with
+// 0.36m shoulders, at "phase" 0..1 through the gesture.
+static void poseHands( int32_t gesture, float phase, float amplitude, Vec3f& left, Vec3f& right )
+{
+	left	= Vec3f( -0.25f, -0.35f, -0.05f );
+	right	= Vec3f( 0.25f, -0.35f, -0.05f );
+	float s	= sin( phase * kPi );
+	switch ( gesture ) {
+	case Gesture_WaveRight:
+		right = Vec3f( 0.35f + 0.12f * amplitude * sin( phase * 4.0f * kPi ), 0.45f, -0.05f );
+		break;
+	case Gesture_WaveLeft:
+		left = Vec3f( -0.35f - 0.12f * amplitude * sin( phase * 4.0f * kPi ), 0.45f, -0.05f );
+		break;
+	case Gesture_CircleRight:
+		right = Vec3f( 0.3f + 0.15f * amplitude * cos( phase * 2.0f * kPi ), 0.25f + 0.15f * amplitude * sin( phase * 2.0f * kPi ), -0.25f );
+		break;
+	case Gesture_SwipeLeft:
+		right = Vec3f( 0.4f - 0.7f * amplitude * phase, 0.2f, -0.3f );
+		break;
+	case Gesture_SwipeRight:
+		left = Vec3f( -0.4f + 0.7f * amplitude * phase, 0.2f, -0.3f );
+		break;
+	case Gesture_PunchRight:
+		right = Vec3f( 0.18f, 0.15f, -0.05f - 0.5f * amplitude * s );
+		break;
+	case Gesture_RaiseBoth:
+		left	= Vec3f( -0.3f, -0.35f + 1.05f * amplitude * s, -0.05f );
+		right	= Vec3f( 0.3f, -0.35f + 1.05f * amplitude * s, -0.05f );
+		break;
+	case Gesture_Clap:
+		{
+			float x	= 0.05f + 0.45f * amplitude * fabs( cos( phase * 2.0f * kPi ) );
+			left	= Vec3f( -x, 0.05f, -0.3f );
+			right	= Vec3f( x, 0.05f, -0.3f );
+		}
+		break;
+	}
+}
+
+static Vec3f noise( mt19937& random, float sigma )
+{
+	normal_distribution<float> n( 0.0f, sigma );
+	return Vec3f( n( random ), n( random ), n( random ) );
+}
+
+// Builds a tracked body at "origin", scaled by "size", with its hands at
+// "left" and "right". Elbows and wrists follow from the hands.
+static Body makeBody( uint64_t id, const Vec3f& origin, float size, const Vec3f& left, const Vec3f& right,
+					 mt19937& random, float sigma )
+{
+	map<JointType, Body::Joint> jointMap;
+	Vec3f rest[ JointType_Count ];
+	for ( int32_t i = 0; i < JointType_Count; ++i ) {
+		rest[ i ] = Vec3f::zero();
+	}
+	rest[ JointType_SpineShoulder ]	= Vec3f( 0.0f, 0.3f, 0.0f );
+	rest[ JointType_Neck ]			= Vec3f( 0.0f, 0.38f, 0.0f );
+	rest[ JointType_Head ]			= Vec3f( 0.0f, 0.5f, 0.0f );
+	rest[ JointType_SpineBase ]		= Vec3f( 0.0f, -0.3f, 0.0f );
+	rest[ JointType_ShoulderLeft ]	= Vec3f( -0.18f, 0.3f, 0.0f );
+	rest[ JointType_ShoulderRight ]	= Vec3f( 0.18f, 0.3f, 0.0f );
+	rest[ JointType_HipLeft ]		= Vec3f( -0.1f, -0.3f, 0.0f );
+	rest[ JointType_HipRight ]		= Vec3f( 0.1f, -0.3f, 0.0f );
+
+	Vec3f hands[ 2 ]					= { left, right };
+	JointType shoulders[ 2 ]			= { JointType_ShoulderLeft, JointType_ShoulderRight };
+	JointType elbows[ 2 ]				= { JointType_ElbowLeft, JointType_ElbowRight };
+	JointType wrists[ 2 ]				= { JointType_WristLeft, JointType_WristRight };
+	JointType handJoints[ 2 ]			= { JointType_HandLeft, JointType_HandRight };
+	for ( size_t i = 0; i < 2; ++i ) {
+		Vec3f elbow						= ( rest[ shoulders[ i ] ] + hands[ i ] ) * 0.5f + Vec3f( 0.0f, -0.08f, 0.05f );
+		rest[ elbows[ i ] ]				= elbow;
+		rest[ wrists[ i ] ]				= elbow.lerp( 0.85f, hands[ i ] );
+		rest[ handJoints[ i ] ]			= hands[ i ];
+	}
+
+	for ( int32_t i = 0; i < JointType_Count; ++i ) {
+		Vec3f position = origin + rest[ i ] * size + noise( random, sigma );
+		jointMap[ (JointType)i ] = Body::Joint( position, Quatf(), TrackingState_Tracked );
+	}
+	return Body( id, (uint8_t)( id % BODY_COUNT ), jointMap );
+}
+
+struct Performer
+{
+	uint64_t	mId;
+	Vec3f		mOrigin;
+	float		mSize;
+
+	int32_t		mGesture;
+	float		mAmplitude;
+	size_t		mDuration;
+	size_t		mFrame;
+	size_t		mIdle;
+	bool		mRecognized;
+};
+
+int main( int argc, char* argv[] )
+{
+	size_t frameCount	= argc > 1 ? (size_t)atoi( argv[ 1 ] ) : 9000;
+	float sigma			= argc > 2 ? (float)atof( argv[ 2 ] ) : 0.008f;
+	float threshold		= 0.25f;
+	mt19937 random( 1234 );
+
+	// Templates at three speeds per gesture so any live speed is within
+	// the warping band of one of them
+	GestureRecognizerRef recognizer = GestureRecognizer::create();
+	const size_t durations[] = { 24, 36, 52 };
+	for ( int32_t g = 0; g < Gesture_Count; ++g ) {
+		for ( size_t d = 0; d < 3; ++d ) {
+			vector<Body> frames;
+			for ( size_t f = 0; f < durations[ d ]; ++f ) {
+				Vec3f left;
+				Vec3f right;
+				poseHands( g, (float)f / (float)( durations[ d ] - 1 ), 1.0f, left, right );
+				frames.push_back( makeBody( 0, Vec3f( 0.0f, 0.0f, 2.5f ), 1.0f, left, right, random, 0.0f ) );
+			}
+			recognizer->addTemplate( kGestureNames[ g ], frames, threshold );
+		}
+	}
+
+	uniform_real_distribution<float> unit( 0.0f, 1.0f );
+	vector<Performer> performers( BODY_COUNT );
+	for ( size_t i = 0; i < performers.size(); ++i ) {
+		Performer& p	= performers[ i ];
+		p.mId			= 1000 + i;
+		p.mOrigin		= Vec3f( -1.5f + 0.6f * (float)i, -0.1f + 0.2f * unit( random ), 2.0f + 2.0f * unit( random ) );
+		p.mSize			= 0.85f + 0.3f * unit( random );
+		p.mGesture		= -1;
+		p.mIdle			= 10 + i * 7;
+		p.mRecognized	= false;
+	}
+
+	size_t performed	= 0;
+	size_t recognized	= 0;
+	size_t confused		= 0;
+	size_t falseIdle	= 0;
+	size_t abandoned	= 0;
+	size_t compared		= 0;
+	size_t pruned		= 0;
+	vector<double> times;
+	times.reserve( frameCount );
+	vector<Body> bodies;
+	for ( size_t frame = 0; frame < frameCount; ++frame ) {
+		bodies.clear();
+		for ( vector<Performer>::iterator p = performers.begin(); p != performers.end(); ++p ) {
+			if ( p->mGesture < 0 && p->mIdle == 0 ) {
+				p->mGesture		= (int32_t)( random() % Gesture_Count );
+				p->mAmplitude	= 0.85f + 0.3f * unit( random );
+				p->mDuration	= 20 + random() % 40;
+				p->mFrame		= 0;
+				p->mRecognized	= false;
+			}
+
+			Vec3f left;
+			Vec3f right;
+			if ( p->mGesture >= 0 ) {
+				poseHands( p->mGesture, (float)p->mFrame / (float)( p->mDuration - 1 ), p->mAmplitude, left, right );
+			} else {
+				float sway = 0.02f * sin( (float)frame * 0.05f + (float)p->mId );
+				poseHands( -1, 0.0f, 0.0f, left, right );
+				left.x	+= sway;
+				right.x	+= sway;
+			}
+			bodies.push_back( makeBody( p->mId, p->mOrigin, p->mSize, left, right, random, sigma ) );
+		}
+
+		double start = getHostTime();
+		recognizer->update( bodies, (long long)( frame + 1 ) * 333333L );
+		times.push_back( getHostTime() - start );
+		abandoned	+= recognizer->getAbandonedCount();
+		compared	+= recognizer->getComparedCount();
+		pruned		+= recognizer->getPrunedCount();
+
+		// A gesture counts once it is matched late in the motion or just
+		// after it. Matches while idle are false positives.
+		const vector<GestureRecognizer::Match>& matches = recognizer->getMatches();
+		for ( vector<Performer>::iterator p = performers.begin(); p != performers.end(); ++p ) {
+			for ( vector<GestureRecognizer::Match>::const_iterator m = matches.begin(); m != matches.end(); ++m ) {
+				if ( m->mBodyId != p->mId ) {
+					continue;
+				}
+				int32_t gesture = (int32_t)( m->mTemplate / 3 );
+				if ( p->mGesture < 0 ) {
+					if ( p->mIdle < 25 ) {
+						++falseIdle;
+					}
+				} else if ( gesture == p->mGesture ) {
+					if ( !p->mRecognized && p->mFrame * 4 >= p->mDuration * 3 ) {
+						p->mRecognized = true;
+						++recognized;
+					}
+				} else if ( p->mFrame * 4 >= p->mDuration * 3 ) {
+					++confused;
+				}
+			}
+
+			if ( p->mGesture >= 0 ) {
+				if ( ++p->mFrame == p->mDuration ) {
+					++performed;
+					p->mGesture	= -1;
+					p->mIdle	= 30 + random() % 30;
+				}
+			} else if ( p->mIdle > 0 ) {
+				--p->mIdle;
+			}
+		}
+	}
+
+	sort( times.begin(), times.end() );
+	double total = 0.0;
+	for ( vector<double>::const_iterator iter = times.begin(); iter != times.end(); ++iter ) {
+		total += *iter;
+	}
+	size_t pairs = abandoned + compared + pruned;
+	printf( "%u templates, %u bodies, %u frames, joint noise %.3fm\n",
+		(uint32_t)recognizer->getTemplateCount(), (uint32_t)performers.size(), (uint32_t)frameCount, sigma );
+	printf( "update ms: mean %.3f, median %.3f, p99 %.3f, max %.3f\n",
+		total * 1000.0 / (double)times.size(), times[ times.size() / 2 ] * 1000.0,
+		times[ times.size() * 99 / 100 ] * 1000.0, times.back() * 1000.0 );
+	printf( "pairs: %u pruned (%.1f%%), %u abandoned (%.1f%%), %u compared in full (%.1f%%)\n",
+		(uint32_t)pruned, 100.0 * pruned / max<size_t>( pairs, 1 ),
+		(uint32_t)abandoned, 100.0 * abandoned / max<size_t>( pairs, 1 ),
+		(uint32_t)compared, 100.0 * compared / max<size_t>( pairs, 1 ) );
+	printf( "recognized %u of %u gestures (%.1f%%), %u confused frames, %u idle false positive frames\n",
+		(uint32_t)recognized, (uint32_t)performed, 100.0 * recognized / max<size_t>( performed, 1 ),
+		(uint32_t)confused, (uint32_t)falseIdle );
+	return 0;
+}
@@ -0,0 +1,287 @@
+#include "Kinect2Stream.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+
+// Streams synthetic frames from a StreamServer to a StreamClient over
+// loopback and checks that every stream arrives intact: depth, infrared
+// and body index bit for bit, bodies exactly and color at the server's
+// reduced size. Also checks that the codecs round trip on their own and
+// that packet headers with impossible sizes are rejected. Returns 0 when
+// every check passes.
+
+using namespace ci;
+using namespace Kinect2;
+using namespace std;
+
+static const int32_t kColorScale	= 4;
+static const int32_t kDepthWidth	= 512;
+static const int32_t kDepthHeight	= 424;
+
+static size_t sFailures = 0;
+
+static void check( bool passed, const char* name )
+{
+	printf( "%s: %s\n", passed ? "pass" : "FAIL", name );
+	if ( !passed ) {
+		++sFailures;
+	}
+}
+
+// Smooth surface with sensor noise, holes along the left edge and
+// speckle, moving a little every frame
+static Channel16u makeDepth( uint32_t frame, mt19937& random )
+{
+	Channel16u channel( kDepthWidth, kDepthHeight );
+	for ( int32_t y = 0; y < kDepthHeight; ++y ) {
+		uint16_t* row = channel.getData( Vec2i( 0, y ) );
+		for ( int32_t x = 0; x < kDepthWidth; ++x ) {
+			int32_t v = 0;
+			if ( x >= 40 ) {
+				v = 1500 + (int32_t)( 300.0f * sin( (float)( x + frame ) * 0.02f ) + 200.0f * cos( (float)y * 0.03f ) ) + (int32_t)( random() % 5 );
+				if ( random() % 500 == 0 ) {
+					v = (int32_t)( random() % 8000 );
+				}
+			}
+			row[ x ] = (uint16_t)v;
+		}
+	}
+	return channel;
+}
+
+static Channel8u makeBodyIndex( uint32_t frame )
+{
+	Channel8u channel( kDepthWidth, kDepthHeight );
+	for ( int32_t y = 0; y < kDepthHeight; ++y ) {
+		uint8_t* row = channel.getData( Vec2i( 0, y ) );
+		for ( int32_t x = 0; x < kDepthWidth; ++x ) {
+			int32_t cx	= 200 + (int32_t)( frame % 50 );
+			row[ x ]	= x > cx && x < cx + 80 && y > 100 ? 0 : ( x > 350 && y > 150 ? 1 : 0xff );
+		}
+	}
+	return channel;
+}
+
+// Constant over every "kColorScale" block, so the server's box filter
+// is exact.
+static Surface8u makeColor( uint32_t frame )
+{
+	Surface8u surface( 1920, 1080, false, SurfaceChannelOrder::RGB );
+	for ( int32_t y = 0; y < 1080; ++y ) {
+		uint8_t* p = surface.getData( Vec2i( 0, y ) );
+		for ( int32_t x = 0; x < 1920; ++x, p += surface.getPixelInc() ) {
+			p[ surface.getRedOffset() ]		= (uint8_t)( x / kColorScale + frame );
+			p[ surface.getGreenOffset() ]	= (uint8_t)( y / kColorScale );
+			p[ surface.getBlueOffset() ]	= (uint8_t)( ( x / kColorScale ) ^ ( y / kColorScale ) );
+		}
+	}
+	return surface;
+}
+
+static vector<Body> makeBodies( uint32_t frame )
+{
+	vector<Body> bodies;
+	for ( uint8_t i = 0; i < 2; ++i ) {
+		map<JointType, Body::Joint> jointMap;
+		for ( int32_t j = 0; j < JointType_Count; ++j ) {
+			Vec3f position( -0.5f + (float)i + 0.01f * (float)j, 0.02f * (float)j + 0.001f * (float)frame, 2.5f );
+			Quatf orientation( cos( 0.05f * (float)j ), 0.0f, sin( 0.05f * (float)j ), 0.0f );
+			jointMap[ (JointType)j ] = Body::Joint( position, orientation, j % 7 == 0 ? TrackingState_Inferred : TrackingState_Tracked );
+		}
+		bodies.push_back( Body( 72057594037927936ULL + i, i, jointMap, HandState_Open, HandState_Closed ) );
+	}
+	return bodies;
+}
+
+static bool equal( const Channel16u& a, const Channel16u& b )
+{
+	if ( !a || !b || a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight() ) {
+		return false;
+	}
+	for ( int32_t y = 0; y < a.getHeight(); ++y ) {
+		if ( memcmp( a.getData( Vec2i( 0, y ) ), b.getData( Vec2i( 0, y ) ), a.getWidth() * sizeof( uint16_t ) ) != 0 ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool equal( const Channel8u& a, const Channel8u& b )
+{
+	if ( !a || !b || a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight() ) {
+		return false;
+	}
+	for ( int32_t y = 0; y < a.getHeight(); ++y ) {
+		if ( memcmp( a.getData( Vec2i( 0, y ) ), b.getData( Vec2i( 0, y ) ), a.getWidth() ) != 0 ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// "received" is the server's reduced color.
+static bool equalColor( const Surface8u& sent, const Surface8u& received )
+{
+	if ( !received || received.getWidth() != sent.getWidth() / kColorScale || received.getHeight() != sent.getHeight() / kColorScale ) {
+		return false;
+	}
+	for ( int32_t y = 0; y < received.getHeight(); ++y ) {
+		for ( int32_t x = 0; x < received.getWidth(); ++x ) {
+			const uint8_t* a = sent.getData( Vec2i( x * kColorScale, y * kColorScale ) );
+			const uint8_t* b = received.getData( Vec2i( x, y ) );
+			if ( a[ sent.getRedOffset() ] != b[ received.getRedOffset() ] ||
+				a[ sent.getGreenOffset() ] != b[ received.getGreenOffset() ] ||
+				a[ sent.getBlueOffset() ] != b[ received.getBlueOffset() ] ) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool equal( const vector<Body>& a, const vector<Body>& b )
+{
+	if ( a.size() != b.size() ) {
+		return false;
+	}
+	for ( size_t i = 0; i < a.size(); ++i ) {
+		if ( a[ i ].getId() != b[ i ].getId() || a[ i ].getIndex() != b[ i ].getIndex() ||
+			a[ i ].getLeftHandState() != b[ i ].getLeftHandState() ||
+			a[ i ].getRightHandState() != b[ i ].getRightHandState() ||
+			a[ i ].getJointMap().size() != b[ i ].getJointMap().size() ) {
+			return false;
+		}
+		for ( map<JointType, Body::Joint>::const_iterator iter = a[ i ].getJointMap().begin(); iter != a[ i ].getJointMap().end(); ++iter ) {
+			map<JointType, Body::Joint>::const_iterator match = b[ i ].getJointMap().find( iter->first );
+			if ( match == b[ i ].getJointMap().end() ||
+				match->second.getPosition() != iter->second.getPosition() ||
+				match->second.getOrientation().v != iter->second.getOrientation().v ||
+				match->second.getOrientation().w != iter->second.getOrientation().w ||
+				match->second.getTrackingState() != iter->second.getTrackingState() ) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void checkCodecs( mt19937& random )
+{
+	Channel16u depth = makeDepth( 0, random );
+	vector<uint8_t> buffer;
+	StreamCodec::encodeChannel16u( depth, buffer );
+	Channel16u decodedDepth( kDepthWidth, kDepthHeight );
+	check( StreamCodec::decodeChannel16u( &buffer[ 0 ], buffer.size(), decodedDepth ) && equal( depth, decodedDepth ), "depth codec round trip" );
+	check( buffer.size() <= StreamCodec::getMaxPayloadSize( StreamCodec::Packet_Depth, kDepthWidth, kDepthHeight ), "depth payload within bound" );
+	printf( "      depth %u bytes, %.2f:1\n", (uint32_t)buffer.size(), (double)( kDepthWidth * kDepthHeight * 2 ) / (double)buffer.size() );
+
+	// White noise is the worst case for the predictor.
+	Channel16u noise( kDepthWidth, kDepthHeight );
+	for ( int32_t i = 0; i < kDepthWidth * kDepthHeight; ++i ) {
+		noise.getData()[ i ] = (uint16_t)random();
+	}
+	buffer.clear();
+	StreamCodec::encodeChannel16u( noise, buffer );
+	check( buffer.size() <= StreamCodec::getMaxPayloadSize( StreamCodec::Packet_Infrared, kDepthWidth, kDepthHeight ), "noise payload within bound" );
+
+	Channel8u bodyIndex = makeBodyIndex( 0 );
+	buffer.clear();
+	StreamCodec::encodeRunLength( bodyIndex, buffer );
+	Channel8u decodedBodyIndex( kDepthWidth, kDepthHeight );
+	check( StreamCodec::decodeRunLength( &buffer[ 0 ], buffer.size(), decodedBodyIndex ) && equal( bodyIndex, decodedBodyIndex ), "body index codec round trip" );
+
+	buffer.clear();
+	StreamCodec::encodeBodies( vector<Body>( 9, makeBodies( 0 ).front() ), buffer );
+	check( buffer.size() <= StreamCodec::getMaxPayloadSize( StreamCodec::Packet_Bodies, 0, 0 ), "body payload within bound" );
+
+	StreamCodec::PacketHeader header;
+	memset( &header, 0, sizeof( header ) );
+	header.mMagic	= StreamCodec::kStreamMagic;
+	header.mType	= StreamCodec::Packet_Depth;
+	header.mWidth	= kDepthWidth;
+	header.mHeight	= kDepthHeight;
+	header.mSize	= (uint32_t)StreamCodec::getMaxPayloadSize( header.mType, header.mWidth, header.mHeight );
+	check( StreamCodec::checkHeader( header ), "header at the size bound accepted" );
+	header.mSize	= 0xffffffff;
+	check( !StreamCodec::checkHeader( header ), "oversized header rejected" );
+	header.mSize	= 0;
+	header.mWidth	= 100000;
+	check( !StreamCodec::checkHeader( header ), "oversized dimensions rejected" );
+}
+
+int main( int argc, char* argv[] )
+{
+	uint16_t port		= argc > 1 ? (uint16_t)atoi( argv[ 1 ] ) : 45123;
+	uint32_t frameCount	= argc > 2 ? (uint32_t)atoi( argv[ 2 ] ) : 90;
+	mt19937 random( 1234 );
+
+	checkCodecs( random );
+
+	StreamServerRef server = StreamServer::create( port, kColorScale );
+	StreamClientRef client = StreamClient::create( "127.0.0.1", port );
+	for ( size_t i = 0; i < 200 && server->getClientCount() == 0; ++i ) {
+		this_thread::sleep_for( chrono::milliseconds( 10 ) );
+	}
+	check( server->getClientCount() == 1, "client connected" );
+
+	// Roughly 30fps, so intermediate frames are sent, not just the last.
+	Frame sent;
+	Frame received;
+	uint32_t receivedCount = 0;
+	for ( uint32_t i = 1; i <= frameCount; ++i ) {
+		sent = Frame( i, "synthetic", makeColor( i ), makeDepth( i, random ), makeDepth( i + 1000, random ),
+			Channel16u(), makeBodies( i ), i, makeBodyIndex( i ) );
+		server->send( sent );
+		this_thread::sleep_for( chrono::milliseconds( 33 ) );
+		if ( client->getFrame( received ) ) {
+			++receivedCount;
+		}
+	}
+
+	// Every stream keeps its latest frame, so the last one must arrive
+	// in full.
+	bool complete = false;
+	for ( size_t i = 0; i < 300 && !complete; ++i ) {
+		client->getFrame( received );
+		complete = received.getBodyTimeStamp() == sent.getBodyTimeStamp() &&
+			equal( sent.getDepth(), received.getDepth() ) &&
+			equal( sent.getInfrared(), received.getInfrared() ) &&
+			equal( sent.getBodyIndex(), received.getBodyIndex() ) &&
+			equalColor( sent.getColor(), received.getColor() );
+		if ( !complete ) {
+			this_thread::sleep_for( chrono::milliseconds( 10 ) );
+		}
+	}
+	check( receivedCount > 0, "frames received while streaming" );
+	check( received.getTimeStamp() == sent.getTimeStamp(), "latest time stamp" );
+	check( equal( sent.getDepth(), received.getDepth() ), "depth lossless" );
+	check( equal( sent.getInfrared(), received.getInfrared() ), "infrared lossless" );
+	check( !received.getInfraredLongExposure(), "absent stream stays absent" );
+	check( equal( sent.getBodyIndex(), received.getBodyIndex() ), "body index lossless" );
+	check( equalColor( sent.getColor(), received.getColor() ), "color reduced and intact" );
+	check( equal( sent.getBodies(), received.getBodies() ), "bodies exact" );
+
+	StreamStats serverStats = server->getStats();
+	StreamStats clientStats = client->getStats();
+	uint64_t dropped = 0;
+	for ( size_t i = 0; i < StreamCodec::Packet_Count; ++i ) {
+		dropped += serverStats.mDropped[ i ];
+	}
+	printf( "%u frames sent, %u received; server %.1f MB, encode %.2f ms, %u dropped; client latency %.2f ms\n",
+		frameCount, receivedCount, (double)serverStats.mBytes / 1048576.0, serverStats.mEncodeTime * 1000.0,
+		(uint32_t)dropped, clientStats.mLatency * 1000.0 );
+
+	client.reset();
+	server.reset();
+	if ( sFailures > 0 ) {
+		printf( "%u checks failed\n", (uint32_t)sFailures );
+		return 1;
+	}
+	printf( "all checks passed\n" );
+	return 0;
+}
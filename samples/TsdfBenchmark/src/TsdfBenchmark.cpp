@@ -0,0 +1,236 @@
+#include "Kinect2Tsdf.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <ppl.h>
+
+// Benchmarks TsdfVolume on synthetic depth. A mapper is built from 
+// typical Kinect v2 intrinsics, so no sensor or calibration file is 
+// needed. Depth frames are raycast against a sphere in front of a wall 
+// while the camera sways, and integrate() and updateMesh() are timed at 
+// each PPL concurrency level from one thread up to the processor count. 
+// A sphere is then fused from views all around it and its mesh checked 
+// for open and non-manifold edges and inward facing triangles.
+
+using namespace ci;
+using namespace Kinect2;
+using namespace std;
+
+static const float kPi = 3.14159265f;
+
+struct Camera
+{
+	Vec3f	mEye;
+	Vec3f	mAxes[ 3 ];
+};
+
+// Camera at "eye" looking at "target", camera space Y towards "up"
+static Camera lookAt( const Vec3f& eye, const Vec3f& target, const Vec3f& up )
+{
+	Camera camera;
+	camera.mEye			= eye;
+	camera.mAxes[ 2 ]	= ( target - eye ).normalized();
+	camera.mAxes[ 0 ]	= up.cross( camera.mAxes[ 2 ] ).normalized();
+	camera.mAxes[ 1 ]	= camera.mAxes[ 2 ].cross( camera.mAxes[ 0 ] );
+	return camera;
+}
+
+// Camera space to volume space
+static Matrix44f toPose( const Camera& camera )
+{
+	Matrix44f pose;
+	for ( int32_t c = 0; c < 3; ++c ) {
+		pose.at( 0, c ) = camera.mAxes[ c ].x;
+		pose.at( 1, c ) = camera.mAxes[ c ].y;
+		pose.at( 2, c ) = camera.mAxes[ c ].z;
+	}
+	pose.at( 0, 3 ) = camera.mEye.x;
+	pose.at( 1, 3 ) = camera.mEye.y;
+	pose.at( 2, 3 ) = camera.mEye.z;
+	return pose;
+}
+
+// Nearest ray parameter where "origin" + s * "dir" meets the sphere, or 
+// zero if it misses
+static float intersectSphere( const Vec3f& origin, const Vec3f& dir, const Vec3f& center, float radius )
+{
+	Vec3f o		= origin - center;
+	float a		= dir.dot( dir );
+	float b		= 2.0f * dir.dot( o );
+	float c		= o.dot( o ) - radius * radius;
+	float disc	= b * b - 4.0f * a * c;
+	if ( disc < 0.0f ) {
+		return 0.0f;
+	}
+	float s = ( -b - sqrt( disc ) ) / ( 2.0f * a );
+	return s > 0.0f ? s : 0.0f;
+}
+
+// Depth frame of a sphere, optionally in front of a wall at volume 
+// space Z "wall". Rays have unit camera space Z, so the ray parameter is 
+// the depth.
+static void raycast( const CoordinateMapperRef& mapper, const Camera& camera, const Vec3f& center, float radius, 
+					float wall, Channel16u& depth )
+{
+	const float* tableX	= mapper->getDepthToCameraTableX();
+	const float* tableY	= mapper->getDepthToCameraTableY();
+	int32_t count		= mapper->getDepthWidth() * mapper->getDepthHeight();
+	uint16_t* data		= depth.getData();
+	for ( int32_t i = 0; i < count; ++i ) {
+		Vec3f dir	= camera.mAxes[ 0 ] * tableX[ i ] + camera.mAxes[ 1 ] * tableY[ i ] + camera.mAxes[ 2 ];
+		float s		= intersectSphere( camera.mEye, dir, center, radius );
+		if ( s <= 0.0f && wall > 0.0f && dir.z > 0.0f ) {
+			s = ( wall - camera.mEye.z ) / dir.z;
+		}
+		data[ i ] = s > 0.5f && s < 4.5f ? (uint16_t)( s * 1000.0f + 0.5f ) : 0;
+	}
+}
+
+static double mean( const vector<double>& times )
+{
+	double total = 0.0;
+	for ( vector<double>::const_iterator iter = times.begin(); iter != times.end(); ++iter ) {
+		total += *iter;
+	}
+	return times.empty() ? 0.0 : total / (double)times.size();
+}
+
+// Mesh vertices are matched by position quantized to 10 microns
+struct Vertex
+{
+	Vertex( const Vec3f& v )
+	{
+		mX = (int64_t)floor( v.x * 1.0e5f + 0.5f );
+		mY = (int64_t)floor( v.y * 1.0e5f + 0.5f );
+		mZ = (int64_t)floor( v.z * 1.0e5f + 0.5f );
+	}
+
+	bool operator<( const Vertex& rhs ) const
+	{
+		if ( mX != rhs.mX ) {
+			return mX < rhs.mX;
+		}
+		if ( mY != rhs.mY ) {
+			return mY < rhs.mY;
+		}
+		return mZ < rhs.mZ;
+	}
+
+	int64_t mX;
+	int64_t mY;
+	int64_t mZ;
+};
+
+int main( int argc, char* argv[] )
+{
+	size_t frameCount	= argc > 1 ? (size_t)atoi( argv[ 1 ] ) : 90;
+	float voxelSize		= argc > 2 ? (float)atof( argv[ 2 ] ) : 0.01f;
+
+	CameraProjection depthProjection;
+	depthProjection.mFocalLength			= Vec2f( 365.5f, -365.5f );
+	depthProjection.mPrincipalPoint			= Vec2f( 257.6f, 207.5f );
+	depthProjection.mRadialDistortion[ 0 ]	= 0.092f;
+	depthProjection.mRadialDistortion[ 1 ]	= -0.271f;
+	depthProjection.mRadialDistortion[ 2 ]	= 0.094f;
+	CameraProjection colorProjection;
+	colorProjection.mFocalLength			= Vec2f( 1060.0f, -1060.0f );
+	colorProjection.mOffset					= Vec2f( 55.0f, 0.0f );
+	colorProjection.mPrincipalPoint			= Vec2f( 960.0f, 540.0f );
+	CoordinateMapperRef mapper = CoordinateMapper::create( depthProjection, colorProjection );
+
+	// The scene is the same at every level, so the volumes should match
+	unsigned processorCount = concurrency::GetProcessorCount();
+	printf( "%u processors, %u frames, %.3fm voxels\n", processorCount, (uint32_t)frameCount, voxelSize );
+	Channel16u depth( mapper->getDepthWidth(), mapper->getDepthHeight() );
+	for ( unsigned threads = 1; threads <= processorCount; threads = threads < processorCount ? min( threads * 2, processorCount ) : threads + 1 ) {
+		concurrency::CurrentScheduler::Create( concurrency::SchedulerPolicy( 2, concurrency::MinConcurrency, 1, concurrency::MaxConcurrency, threads ) );
+
+		TsdfVolumeRef volume = TsdfVolume::create( mapper, voxelSize );
+		vector<double> integrateTimes;
+		vector<double> meshTimes;
+		size_t remeshed = 0;
+		for ( size_t frame = 0; frame < frameCount; ++frame ) {
+			float t			= (float)frame / (float)frameCount;
+			Vec3f eye		= Vec3f( 0.3f * sin( t * 2.0f * kPi ), 0.1f * sin( t * 4.0f * kPi ), 0.0f );
+			Camera camera	= lookAt( eye, Vec3f( 0.0f, 0.0f, 1.5f ), Vec3f( 0.0f, 1.0f, 0.0f ) );
+			raycast( mapper, camera, Vec3f( 0.0f, 0.0f, 1.5f ), 0.3f, 2.5f, depth );
+
+			double start = getHostTime();
+			volume->integrate( depth, toPose( camera ) );
+			double integrated = getHostTime();
+			remeshed += volume->updateMesh();
+			double meshed = getHostTime();
+
+			// The first frame allocates and meshes everything; keep it 
+			// out of the steady state numbers
+			if ( frame > 0 ) {
+				integrateTimes.push_back( integrated - start );
+				meshTimes.push_back( meshed - integrated );
+			}
+		}
+		concurrency::CurrentScheduler::Detach();
+
+		double integrateMs	= mean( integrateTimes ) * 1000.0;
+		double meshMs		= mean( meshTimes ) * 1000.0;
+		sort( integrateTimes.begin(), integrateTimes.end() );
+		printf( "%2u threads: integrate %.2fms (p99 %.2fms), updateMesh %.2fms, %.1f fps, %u blocks, %u remeshed per frame\n", 
+			threads, integrateMs, integrateTimes.empty() ? 0.0 : integrateTimes[ integrateTimes.size() * 99 / 100 ] * 1000.0, 
+			meshMs, 1000.0 / max( integrateMs + meshMs, 0.001 ), (uint32_t)volume->getBlockCount(), 
+			(uint32_t)( remeshed / max<size_t>( frameCount, 1 ) ) );
+	}
+
+	// Fuse an isolated sphere from the six axis directions and the eight 
+	// diagonals. Every surface voxel is then observed, so the mesh should 
+	// be closed: each directed edge appears once and its reverse once.
+	Vec3f center( 0.013f, 0.021f, 0.037f );
+	float radius			= 0.25f;
+	TsdfVolumeRef volume	= TsdfVolume::create( mapper, voxelSize );
+	for ( int32_t v = 0; v < 14; ++v ) {
+		Vec3f dir;
+		if ( v < 6 ) {
+			dir[ v / 2 ] = v % 2 == 0 ? 1.0f : -1.0f;
+		} else {
+			dir = Vec3f( v & 1 ? 1.0f : -1.0f, v & 2 ? 1.0f : -1.0f, v & 4 ? 1.0f : -1.0f ).normalized();
+		}
+		Vec3f up		= fabs( dir.y ) > 0.9f ? Vec3f( 0.0f, 0.0f, 1.0f ) : Vec3f( 0.0f, 1.0f, 0.0f );
+		Camera camera	= lookAt( center + dir * 1.2f, center, up );
+		raycast( mapper, camera, center, radius, 0.0f, depth );
+		volume->integrate( depth, toPose( camera ) );
+	}
+	volume->updateMesh();
+
+	vector<Vec3f> positions;
+	volume->getMesh( positions );
+	map<pair<Vertex, Vertex>, size_t> edges;
+	size_t inward		= 0;
+	double error		= 0.0;
+	for ( size_t i = 0; i + 2 < positions.size(); i += 3 ) {
+		const Vec3f* p	= &positions[ i ];
+		Vec3f centroid	= ( p[ 0 ] + p[ 1 ] + p[ 2 ] ) / 3.0f;
+		if ( ( p[ 1 ] - p[ 0 ] ).cross( p[ 2 ] - p[ 0 ] ).dot( centroid - center ) <= 0.0f ) {
+			++inward;
+		}
+		error += fabs( ( centroid - center ).length() - radius );
+		for ( size_t e = 0; e < 3; ++e ) {
+			++edges[ make_pair( Vertex( p[ e ] ), Vertex( p[ ( e + 1 ) % 3 ] ) ) ];
+		}
+	}
+	size_t open			= 0;
+	size_t nonManifold	= 0;
+	for ( map<pair<Vertex, Vertex>, size_t>::const_iterator iter = edges.begin(); iter != edges.end(); ++iter ) {
+		if ( iter->second > 1 ) {
+			++nonManifold;
+		}
+		if ( edges.find( make_pair( iter->first.second, iter->first.first ) ) == edges.end() ) {
+			++open;
+		}
+	}
+	size_t triangleCount = positions.size() / 3;
+	printf( "closed sphere: %u triangles, %u open edges, %u non-manifold edges, %u inward triangles, mean radial error %.2fmm\n", 
+		(uint32_t)triangleCount, (uint32_t)open, (uint32_t)nonManifold, (uint32_t)inward, 
+		triangleCount > 0 ? error * 1000.0 / (double)triangleCount : 0.0 );
+	return open == 0 && nonManifold == 0 && inward == 0 && triangleCount > 0 ? 0 : 1;
+}
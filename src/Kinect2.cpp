@@ -36,6 +36,7 @@
 */
 
 #include "Kinect2.h"
+#include "Kinect2ChangeDetector.h"
 #include "cinder/app/App.h"
 
 #include <comutil.h>
@@ -46,6 +47,44 @@ using namespace ci;
 using namespace ci::app;
 using namespace std;
 
+CameraProjection calcColorProjection( ICoordinateMapper* mapper )
+{
+	CameraProjection projection;
+	if ( mapper == 0 ) {
+		return projection;
+	}
+
+	// Grid over the depth camera's frustum at several distances
+	static const size_t kGrid	= 9;
+	static const size_t kLayers	= 4;
+	CameraSpacePoint cameraPoints[ kGrid * kGrid * kLayers ];
+	ColorSpacePoint colorPoints[ kGrid * kGrid * kLayers ];
+	size_t count = 0;
+	for ( size_t l = 0; l < kLayers; ++l ) {
+		float z = 1.0f + (float)l;
+		for ( size_t j = 0; j < kGrid; ++j ) {
+			for ( size_t i = 0; i < kGrid; ++i ) {
+				cameraPoints[ count ].X = ( (float)i / (float)( kGrid - 1 ) - 0.5f ) * 1.2f * z;
+				cameraPoints[ count ].Y = ( (float)j / (float)( kGrid - 1 ) - 0.5f ) * 1.0f * z;
+				cameraPoints[ count ].Z = z;
+				++count;
+			}
+		}
+	}
+	long hr = mapper->MapCameraPointsToColorSpace( (UINT)count, cameraPoints, (UINT)count, colorPoints );
+	if ( FAILED( hr ) ) {
+		return projection;
+	}
+
+	Vec3f points[ kGrid * kGrid * kLayers ];
+	Vec2f positions[ kGrid * kGrid * kLayers ];
+	for ( size_t i = 0; i < count; ++i ) {
+		points[ i ]		= toVec3f( cameraPoints[ i ] );
+		positions[ i ]	= toVec2f( colorPoints[ i ] );
+	}
+	return fitProjection( points, positions, count );
+}
+
 Channel8u channel16To8( const Channel16u& channel )
 {
 	Channel8u channel8;
@@ -131,6 +170,19 @@ size_t getDeviceCount()
 	return count;
 }
 
+double getHostTime()
+{
+	static double frequency = 0.0;
+	if ( frequency == 0.0 ) {
+		LARGE_INTEGER f;
+		::QueryPerformanceFrequency( &f );
+		frequency = (double)f.QuadPart;
+	}
+	LARGE_INTEGER counter;
+	::QueryPerformanceCounter( &counter );
+	return (double)counter.QuadPart / frequency;
+}
+
 map<size_t, string> getDeviceMap()
 {
 	map<size_t, string> deviceMap;
@@ -190,6 +242,64 @@ Vec2i mapBodyCoordToDepth( const Vec3f& v, ICoordinateMapper* mapper )
 	return Vec2i();
 }
 
+// Gathers joint positions into "points", indexed body * JointType_Count + joint
+static size_t gatherJoints( const vector<Body>& bodies, CameraSpacePoint* points )
+{
+	size_t bodyCount = min<size_t>( bodies.size(), BODY_COUNT );
+	for ( size_t i = 0; i < bodyCount; ++i ) {
+		CameraSpacePoint* bodyPoints = points + i * JointType_Count;
+		memset( bodyPoints, 0, JointType_Count * sizeof( CameraSpacePoint ) );
+		const map<JointType, Body::Joint>& jointMap = bodies[ i ].getJointMap();
+		for ( map<JointType, Body::Joint>::const_iterator iter = jointMap.begin(); iter != jointMap.end(); ++iter ) {
+			const Vec3f& v = iter->second.getPosition();
+			bodyPoints[ iter->first ].X = v.x;
+			bodyPoints[ iter->first ].Y = v.y;
+			bodyPoints[ iter->first ].Z = v.z;
+		}
+	}
+	return bodyCount * JointType_Count;
+}
+
+size_t mapBodiesToColor( const vector<Body>& bodies, Vec2f* positions, ICoordinateMapper* mapper )
+{
+	CameraSpacePoint cameraPoints[ BODY_COUNT * JointType_Count ];
+	ColorSpacePoint colorPoints[ BODY_COUNT * JointType_Count ];
+	size_t count = gatherJoints( bodies, cameraPoints );
+	if ( count == 0 || FAILED( mapper->MapCameraPointsToColorSpace( (UINT)count, cameraPoints, (UINT)count, colorPoints ) ) ) {
+		return 0;
+	}
+	for ( size_t i = 0; i < count; ++i ) {
+		positions[ i ] = toVec2f( colorPoints[ i ] );
+	}
+	return count;
+}
+
+size_t mapBodiesToDepth( const vector<Body>& bodies, Vec2f* positions, ICoordinateMapper* mapper )
+{
+	CameraSpacePoint cameraPoints[ BODY_COUNT * JointType_Count ];
+	DepthSpacePoint depthPoints[ BODY_COUNT * JointType_Count ];
+	size_t count = gatherJoints( bodies, cameraPoints );
+	if ( count == 0 || FAILED( mapper->MapCameraPointsToDepthSpace( (UINT)count, cameraPoints, (UINT)count, depthPoints ) ) ) {
+		return 0;
+	}
+	for ( size_t i = 0; i < count; ++i ) {
+		positions[ i ] = toVec2f( depthPoints[ i ] );
+	}
+	return count;
+}
+
+size_t mapBodiesToImage( const vector<Body>& bodies, Vec2f* positions, const CameraProjection& projection )
+{
+	CameraSpacePoint cameraPoints[ BODY_COUNT * JointType_Count ];
+	Vec3f points[ BODY_COUNT * JointType_Count ];
+	size_t count = gatherJoints( bodies, cameraPoints );
+	for ( size_t i = 0; i < count; ++i ) {
+		points[ i ] = toVec3f( cameraPoints[ i ] );
+	}
+	projection.project( points, count, positions );
+	return count;
+}
+
 Vec2i mapDepthCoordToColor( const Vec2i& v, uint16_t depth, ICoordinateMapper* mapper )
 {
 	DepthSpacePoint depthSpacePoint;
@@ -251,6 +361,18 @@ Channel16u mapDepthFrameToColor( const Channel16u& depth, ICoordinateMapper* map
 	return channel;
 }
 
+CameraProjection toCameraProjection( const CameraIntrinsics& v )
+{
+	// Camera space Y points up, depth image rows go down
+	CameraProjection projection;
+	projection.mFocalLength				= Vec2f( v.FocalLengthX, -v.FocalLengthY );
+	projection.mPrincipalPoint			= Vec2f( v.PrincipalPointX, v.PrincipalPointY );
+	projection.mRadialDistortion[ 0 ]	= v.RadialDistortionSecondOrder;
+	projection.mRadialDistortion[ 1 ]	= v.RadialDistortionFourthOrder;
+	projection.mRadialDistortion[ 2 ]	= v.RadialDistortionSixthOrder;
+	return projection;
+}
+
 Quatf toQuatf( const Vector4& v )
 {
 	return Quatf( v.w, v.x, v.y, v.z );
@@ -298,7 +420,7 @@ string wcharToString( wchar_t* v )
 DeviceOptions::DeviceOptions()
 : mDeviceIndex( 0 ), mDeviceId( "" ), mEnabledAudio( false ), mEnabledBody( false ), 
 mEnabledBodyIndex( false ), mEnabledColor( true ), mEnabledDepth( true ), 
-mEnabledInfrared( false ), mEnabledInfraredLongExposure( false )
+mEnabledDepthChanges( false ), mEnabledInfrared( false ), mEnabledInfraredLongExposure( false )
 {
 }
 
@@ -332,6 +454,12 @@ DeviceOptions& DeviceOptions::enableDepth( bool enable )
 	return *this;
 }
 
+DeviceOptions& DeviceOptions::enableDepthChanges( bool enable )
+{
+	mEnabledDepthChanges = enable;
+	return *this;
+}
+
 DeviceOptions& DeviceOptions::enableInfrared( bool enable )
 {
 	mEnabledInfrared = enable;
@@ -366,6 +494,30 @@ int32_t	 DeviceOptions::getDeviceIndex() const
 	return mDeviceIndex;
 }
 
+uint32_t DeviceOptions::getStreams() const
+{
+	uint32_t streams = 0;
+	if ( mEnabledBody ) {
+		streams |= Streams::Body;
+	}
+	if ( mEnabledBodyIndex ) {
+		streams |= Streams::BodyIndex;
+	}
+	if ( mEnabledColor ) {
+		streams |= Streams::Color;
+	}
+	if ( mEnabledDepth ) {
+		streams |= Streams::Depth;
+	}
+	if ( mEnabledInfrared ) {
+		streams |= Streams::Infrared;
+	}
+	if ( mEnabledInfraredLongExposure ) {
+		streams |= Streams::InfraredLongExposure;
+	}
+	return streams;
+}
+
 bool DeviceOptions::isAudioEnabled() const
 {
 	return mEnabledAudio;
@@ -391,6 +543,11 @@ bool DeviceOptions::isDepthEnabled() const
 	return mEnabledDepth;
 }
 
+bool DeviceOptions::isDepthChangesEnabled() const
+{
+	return mEnabledDepthChanges;
+}
+
 bool DeviceOptions::isInfraredEnabled() const
 {
 	return mEnabledInfrared;
@@ -403,6 +560,223 @@ bool DeviceOptions::isInfraredLongExposureEnabled() const
 
 //////////////////////////////////////////////////////////////////////////////////////////////
 
+AudioBuffer::Span::Span()
+: mPosition( 0 )
+{
+	mData[ 0 ]	= 0;
+	mData[ 1 ]	= 0;
+	mSize[ 0 ]	= 0;
+	mSize[ 1 ]	= 0;
+}
+
+const float* AudioBuffer::Span::getData( size_t part ) const
+{
+	return mData[ part ];
+}
+
+size_t AudioBuffer::Span::getSize( size_t part ) const
+{
+	return mSize[ part ];
+}
+
+uint64_t AudioBuffer::Span::getPosition() const
+{
+	return mPosition;
+}
+
+size_t AudioBuffer::Span::size() const
+{
+	return mSize[ 0 ] + mSize[ 1 ];
+}
+
+bool AudioBuffer::Span::empty() const
+{
+	return size() == 0;
+}
+
+float AudioBuffer::Span::operator[]( size_t i ) const
+{
+	return i < mSize[ 0 ] ? mData[ 0 ][ i ] : mData[ 1 ][ i - mSize[ 0 ] ];
+}
+
+AudioBuffer::SubFrame::SubFrame()
+: mBeamAngle( 0.0f ), mBeamAngleConfidence( 0.0f ), mPosition( 0 ), mSize( 0 ), 
+mTimeStamp( 0L )
+{
+}
+
+AudioBuffer::Reader::Reader()
+: mPosition( 0 )
+{
+}
+
+AudioBuffer::Reader::Reader( const AudioBufferRef& buffer )
+: mBuffer( buffer ), mPosition( buffer ? buffer->getWritePosition() : 0 )
+{
+}
+
+AudioBuffer::Span AudioBuffer::Reader::acquire( size_t maxCount )
+{
+	if ( !mBuffer ) {
+		return Span();
+	}
+	return mBuffer->read( mPosition, maxCount );
+}
+
+bool AudioBuffer::Reader::release( const Span& span )
+{
+	if ( !mBuffer ) {
+		return false;
+	}
+	if ( mBuffer->isValid( span ) ) {
+		mPosition = span.getPosition() + span.size();
+		return true;
+	}
+	uint64_t written	= mBuffer->getWritePosition();
+	mPosition			= written > mBuffer->getCapacity() ? written - mBuffer->getCapacity() : 0;
+	return false;
+}
+
+uint64_t AudioBuffer::Reader::getPosition() const
+{
+	return mPosition;
+}
+
+size_t AudioBuffer::Reader::getAvailable() const
+{
+	return mBuffer ? (size_t)( mBuffer->getWritePosition() - mPosition ) : 0;
+}
+
+AudioBufferRef AudioBuffer::create( size_t capacity )
+{
+	return AudioBufferRef( new AudioBuffer( capacity ) );
+}
+
+AudioBuffer::AudioBuffer( size_t capacity )
+: mCapacity( 1024 ), mClaimed( 0 ), mCommitted( 0 ), mSubFrameCount( 0 )
+{
+	while ( mCapacity < capacity ) {
+		mCapacity <<= 1;
+	}
+	mMask = mCapacity - 1;
+	mSamples.resize( mCapacity, 0.0f );
+
+	// Sensor sub-frames are 256 samples; keep metadata for every one in the ring
+	size_t subFrameCount = max<size_t>( mCapacity / 256, 4 );
+	mSubFrames = vector<SubFrameSlot>( subFrameCount );
+	mSubFrameMask = subFrameCount - 1;
+	for ( vector<SubFrameSlot>::iterator iter = mSubFrames.begin(); iter != mSubFrames.end(); ++iter ) {
+		iter->mVersion.store( 0 );
+	}
+}
+
+size_t AudioBuffer::getCapacity() const
+{
+	return mCapacity;
+}
+
+uint32_t AudioBuffer::getSampleRate() const
+{
+	return 16000;
+}
+
+uint64_t AudioBuffer::getWritePosition() const
+{
+	return mCommitted.load( memory_order_acquire );
+}
+
+AudioBuffer::Span AudioBuffer::read( uint64_t position, size_t maxCount ) const
+{
+	Span span;
+	uint64_t committed	= mCommitted.load( memory_order_acquire );
+	uint64_t oldest		= committed > mCapacity ? committed - mCapacity : 0;
+	position			= max( position, oldest );
+	size_t count		= (size_t)min<uint64_t>( committed - position, maxCount );
+	size_t offset		= (size_t)( position & mMask );
+	size_t first		= min( count, mCapacity - offset );
+
+	span.mPosition	= position;
+	span.mData[ 0 ]	= &mSamples[ offset ];
+	span.mSize[ 0 ]	= first;
+	span.mData[ 1 ]	= &mSamples[ 0 ];
+	span.mSize[ 1 ]	= count - first;
+	return span;
+}
+
+bool AudioBuffer::isValid( const Span& span ) const
+{
+	// Everything the producer has claimed, committed or not, may have 
+	// overwritten the oldest "claimed - capacity" samples
+	atomic_thread_fence( memory_order_acquire );
+	uint64_t claimed = mClaimed.load( memory_order_relaxed );
+	return claimed <= span.mPosition + mCapacity;
+}
+
+bool AudioBuffer::getSubFrame( uint64_t position, SubFrame& subFrame ) const
+{
+	uint64_t count = mSubFrameCount.load( memory_order_acquire );
+	for ( uint64_t i = 0; i < count && i <= mSubFrameMask; ++i ) {
+		const SubFrameSlot& slot = mSubFrames[ (size_t)( ( count - 1 - i ) & mSubFrameMask ) ];
+		uint32_t version = slot.mVersion.load( memory_order_acquire );
+		if ( ( version & 1 ) != 0 ) {
+			continue;
+		}
+		SubFrame copy = slot.mSubFrame;
+		atomic_thread_fence( memory_order_acquire );
+		if ( slot.mVersion.load( memory_order_relaxed ) != version ) {
+			continue;
+		}
+		if ( position >= copy.mPosition && position < copy.mPosition + copy.mSize ) {
+			subFrame = copy;
+			return true;
+		}
+		if ( position > copy.mPosition ) {
+			break;
+		}
+	}
+	return false;
+}
+
+bool AudioBuffer::getLatestSubFrame( SubFrame& subFrame ) const
+{
+	uint64_t committed = mCommitted.load( memory_order_acquire );
+	return committed > 0 && getSubFrame( committed - 1, subFrame );
+}
+
+void AudioBuffer::write( const float* data, size_t count, long long timeStamp, float beamAngle, float beamAngleConfidence )
+{
+	count				= min( count, mCapacity );
+	uint64_t position	= mCommitted.load( memory_order_relaxed );
+
+	// Claim first so readers can tell their span is being overwritten
+	mClaimed.store( position + count, memory_order_relaxed );
+	atomic_thread_fence( memory_order_release );
+
+	size_t offset	= (size_t)( position & mMask );
+	size_t first	= min( count, mCapacity - offset );
+	memcpy( &mSamples[ offset ], data, first * sizeof( float ) );
+	if ( count > first ) {
+		memcpy( &mSamples[ 0 ], data + first, ( count - first ) * sizeof( float ) );
+	}
+
+	uint64_t index		= mSubFrameCount.load( memory_order_relaxed );
+	SubFrameSlot& slot	= mSubFrames[ (size_t)( index & mSubFrameMask ) ];
+	uint32_t version	= slot.mVersion.load( memory_order_relaxed );
+	slot.mVersion.store( version + 1, memory_order_relaxed );
+	atomic_thread_fence( memory_order_release );
+	slot.mSubFrame.mBeamAngle			= beamAngle;
+	slot.mSubFrame.mBeamAngleConfidence	= beamAngleConfidence;
+	slot.mSubFrame.mPosition			= position;
+	slot.mSubFrame.mSize				= count;
+	slot.mSubFrame.mTimeStamp			= timeStamp;
+	slot.mVersion.store( version + 2, memory_order_release );
+	mSubFrameCount.store( index + 1, memory_order_release );
+
+	mCommitted.store( position + count, memory_order_release );
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
 Body::Joint::Joint()
 : mOrientation( Quatf() ), mPosition( Vec3f::zero() ), mTrackingState( TrackingState::TrackingState_NotTracked )
 {
@@ -524,15 +898,17 @@ const HandState& Body::getRightHandState() const
 //////////////////////////////////////////////////////////////////////////////////////////////
 
 Frame::Frame()
-: mDeviceId( "" ), mTimeStamp( 0L )
+: mBodyTimeStamp( 0L ), mDeviceId( "" ), mTimeStamp( 0L )
 {
 }
 
 Frame::Frame( long long time, const string& deviceId, const Surface8u& color,
 			  const Channel16u& depth, const Channel16u& infrared, 
-			  const Channel16u& infraredLongExposure )
-: mSurfaceColor( color ), mChannelDepth( depth ), mChannelInfrared( infrared ), 
-mChannelInfraredLongExposure( infraredLongExposure ), mDeviceId( deviceId ), 
+			  const Channel16u& infraredLongExposure, const vector<Body>& bodies, 
+			  long long bodyTimeStamp, const Channel8u& bodyIndex )
+: mBodies( bodies ), mBodyTimeStamp( bodyTimeStamp ), mDeviceId( deviceId ), 
+mChannelBodyIndex( bodyIndex ), mChannelDepth( depth ), mChannelInfrared( infrared ), 
+mChannelInfraredLongExposure( infraredLongExposure ), mSurfaceColor( color ), 
 mTimeStamp( time )
 {
 }
@@ -542,6 +918,11 @@ const vector<Body>& Frame::getBodies() const
 	return mBodies;
 }
 
+long long Frame::getBodyTimeStamp() const
+{
+	return mBodyTimeStamp;
+}
+
 const Channel8u& Frame::getBodyIndex() const
 {
 	return mChannelBodyIndex;
@@ -557,6 +938,11 @@ const Channel16u& Frame::getDepth() const
 	return mChannelDepth;
 }
 
+const TileChangesRef& Frame::getDepthChanges() const
+{
+	return mDepthChanges;
+}
+
 const string& Frame::getDeviceId() const
 {
 	return mDeviceId;
@@ -581,13 +967,22 @@ int64_t Frame::getTimeStamp() const
 
 DeviceRef Device::create()
 {
-	return DeviceRef( new Device() );
+	return DeviceRef( new Device( false ) );
 }
 
-Device::Device()
-: mFrameReader( 0 ), mSensor( 0 ), mCoordinateMapper( 0 )
+DeviceRef Device::createHeadless()
 {
-	App::get()->getSignalUpdate().connect( bind( &Device::update, this ) );
+	return DeviceRef( new Device( true ) );
+}
+
+Device::Device( bool headless )
+: mFrameEvent( 0 ), mFrameReader( 0 ), mSensor( 0 ), mCoordinateMapper( 0 ), mBodyTimeStampPrevious( 0L ), 
+mHostTimeOffset( 0.0 ), mAudioFrameEvent( 0 ), mAudioFrameReader( 0 ), mAudioStopEvent( 0 )
+{
+	mAudioRunning = false;
+	if ( !headless ) {
+		App::get()->getSignalUpdate().connect( bind( &Device::update, this ) );
+	}
 }
 
 Device::~Device()
@@ -595,11 +990,31 @@ Device::~Device()
 	stop();
 }
 
+const AudioBufferRef& Device::getAudioBuffer() const
+{
+	return mAudioBuffer;
+}
+
+const CameraProjection& Device::getColorProjection() const
+{
+	return mColorProjection;
+}
+
+const CameraProjection& Device::getDepthProjection() const
+{
+	return mDepthProjection;
+}
+
 ICoordinateMapper* Device::getCoordinateMapper() const
 {
 	return mCoordinateMapper;
 }
 
+const ChangeDetectorRef& Device::getDepthChangeDetector() const
+{
+	return mDepthChangeDetector;
+}
+
 const DeviceOptions& Device::getDeviceOptions() const
 {
 	return mDeviceOptions;
@@ -613,10 +1028,75 @@ const Frame& Device::getFrame() const
 const ci::Vec4f&    Device::getFloorPlane() const{
     return mFloorPlane;
 }
+
+void Device::getBodies( double hostTime, vector<Body>& bodies, double horizon ) const
+{
+	const vector<Body>& latest = mFrame.mBodies;
+	if ( bodies.size() != latest.size() ) {
+		bodies.resize( latest.size() );
+	}
+	if ( latest.empty() ) {
+		return;
+	}
+
+	// "t" is 0 at the previous body frame and 1 at the latest one
+	double latestTime	= (double)mFrame.mBodyTimeStamp * 1.0e-7;
+	double prevTime		= (double)mBodyTimeStampPrevious * 1.0e-7;
+	double sensorTime	= hostTime - mHostTimeOffset;
+	double interval		= latestTime - prevTime;
+	float t				= 1.0f;
+	if ( mBodyTimeStampPrevious > 0L && interval > 0.0 ) {
+		double elapsed	= min( sensorTime - latestTime, max( horizon, 0.0 ) );
+		t				= (float)( 1.0 + max( elapsed, -interval ) / interval );
+	}
+
+	for ( size_t i = 0; i < latest.size(); ++i ) {
+		const Body& b	= latest[ i ];
+		Body& body		= bodies[ i ];
+		if ( body.mJointMap.size() != b.mJointMap.size() ) {
+			body = b;
+		}
+		body.mId				= b.mId;
+		body.mIndex				= b.mIndex;
+		body.mTracked			= b.mTracked;
+		body.mLeftHandState		= b.mLeftHandState;
+		body.mRightHandState	= b.mRightHandState;
+
+		const Body* a = 0;
+		for ( vector<Body>::const_iterator iter = mBodiesPrevious.begin(); iter != mBodiesPrevious.end(); ++iter ) {
+			if ( iter->mId == b.mId ) {
+				a = &( *iter );
+				break;
+			}
+		}
+
+		map<JointType, Body::Joint>::iterator out = body.mJointMap.begin();
+		for ( map<JointType, Body::Joint>::const_iterator iter = b.mJointMap.begin(); iter != b.mJointMap.end(); ++iter, ++out ) {
+			out->second = iter->second;
+			if ( a == 0 || t == 1.0f ) {
+				continue;
+			}
+			map<JointType, Body::Joint>::const_iterator prev = a->mJointMap.find( iter->first );
+			if ( prev == a->mJointMap.end() || 
+				prev->second.mTrackingState == TrackingState_NotTracked || 
+				iter->second.mTrackingState == TrackingState_NotTracked ) {
+				continue;
+			}
+
+			// t in [0, 1) interpolates, t > 1 extrapolates along the last velocity
+			out->second.mPosition = prev->second.mPosition + ( iter->second.mPosition - prev->second.mPosition ) * t;
+			if ( t < 1.0f ) {
+				out->second.mOrientation = prev->second.mOrientation.slerp( t, iter->second.mOrientation );
+			}
+		}
+	}
+}
+
 void Device::start( const DeviceOptions& deviceOptions )
 {
 	long hr = S_OK;
 	mDeviceOptions = deviceOptions;
+	mDepthChangeDetector = mDeviceOptions.isDepthChangesEnabled() ? ChangeDetector::create() : ChangeDetectorRef();
 	
 	IKinectSensorCollection* sensorCollection = 0;
 	hr = GetKinectSensorCollection( &sensorCollection );
@@ -665,9 +1145,6 @@ void Device::start( const DeviceOptions& deviceOptions )
 			hr = mSensor->get_CoordinateMapper( &mCoordinateMapper );
 			if ( SUCCEEDED( hr ) ) {
 				long flags = 0L;
-				if ( mDeviceOptions.isAudioEnabled() ) {
-					flags |= FrameSourceTypes::FrameSourceTypes_Audio;
-				}
 				if ( mDeviceOptions.isBodyEnabled() ) {
 					flags |= FrameSourceTypes::FrameSourceTypes_Body;
 				}
@@ -694,6 +1171,9 @@ void Device::start( const DeviceOptions& deviceOptions )
 					}
 					throw ExcOpenFrameReaderFailed( hr, mDeviceOptions.getDeviceId() );
 				}
+				if ( mDeviceOptions.isAudioEnabled() ) {
+					startAudio();
+				}
 			} else {
 				throw ExcDeviceOpenFailed( hr, mDeviceOptions.getDeviceId() );
 			}
@@ -705,11 +1185,18 @@ void Device::start( const DeviceOptions& deviceOptions )
 
 void Device::stop()
 {
+	stopAudio();
+	mColorProjection = CameraProjection();
+	mDepthProjection = CameraProjection();
 	if ( mCoordinateMapper != 0 ) {
 		mCoordinateMapper->Release();
 		mCoordinateMapper = 0;
 	}
 	if ( mFrameReader != 0 ) {
+		if ( mFrameEvent != 0 ) {
+			mFrameReader->UnsubscribeMultiSourceFrameArrived( mFrameEvent );
+			mFrameEvent = 0;
+		}
 		mFrameReader->Release();
 		mFrameReader = 0;
 	}
@@ -722,363 +1209,218 @@ void Device::stop()
 	}
 }
 
-void Device::update()
+template<uint32_t S>
+static inline bool isCaptured( uint32_t stream, const DeviceOptions& options )
 {
+	return ( S & stream ) != 0 && ( ( S & Streams::Dynamic ) == 0 || ( options.getStreams() & stream ) != 0 );
+}
+
+template<typename R, typename F>
+static HRESULT acquireFrame( IMultiSourceFrame* frame, HRESULT ( STDMETHODCALLTYPE IMultiSourceFrame::*getReference )( R** ), F** result )
+{
+	R* frameRef	= 0;
+	HRESULT hr	= ( frame->*getReference )( &frameRef );
+	if ( SUCCEEDED( hr ) ) {
+		hr = frameRef->AcquireFrame( result );
+	}
+	if ( frameRef != 0 ) {
+		frameRef->Release();
+		frameRef = 0;
+	}
+	return hr;
+}
 
+template<typename F, typename T>
+static HRESULT copyFrameBuffer( F* frame, ChannelT<T>& channel )
+{
+	IFrameDescription* frameDescription	= 0;
+	int32_t width						= 0;
+	int32_t height						= 0;
+	uint32_t bufferSize					= 0;
+	T* buffer							= 0;
+
+	HRESULT hr = frame->get_FrameDescription( &frameDescription );
+	if ( SUCCEEDED( hr ) ) {
+		hr = frameDescription->get_Width( &width );
+	}
+	if ( SUCCEEDED( hr ) ) {
+		hr = frameDescription->get_Height( &height );
+	}
+	if ( SUCCEEDED( hr ) ) {
+		hr = frame->AccessUnderlyingBuffer( &bufferSize, &buffer );
+	}
+	if ( SUCCEEDED( hr ) ) {
+		channel = ChannelT<T>( width, height );
+		memcpy( channel.getData(), buffer, width * height * sizeof( T ) );
+	}
+	if ( frameDescription != 0 ) {
+		frameDescription->Release();
+		frameDescription = 0;
+	}
+	return hr;
+}
+
+template<uint32_t S>
+bool Device::capture( FrameT<S>& frame )
+{
 	if ( mFrameReader == 0 ) {
-		return;
+		return false;
 	}
 
-	IAudioBeamFrame* audioFrame								= 0;
 	IBodyFrame* bodyFrame									= 0;
 	IBodyIndexFrame* bodyIndexFrame							= 0;
 	IColorFrame* colorFrame									= 0;
 	IDepthFrame* depthFrame									= 0;
-	IMultiSourceFrame* frame								= 0;
+	IMultiSourceFrame* multiSourceFrame						= 0;
 	IInfraredFrame* infraredFrame							= 0;
 	ILongExposureInfraredFrame* infraredLongExposureFrame	= 0;
 	
-	HRESULT hr = mFrameReader->AcquireLatestFrame( &frame );
-	
-	if ( SUCCEEDED( hr ) && mDeviceOptions.isAudioEnabled() ) {
-		// TODO audio	
+	HRESULT hr = mFrameReader->AcquireLatestFrame( &multiSourceFrame );
+	if ( SUCCEEDED( hr ) && isCaptured<S>( Streams::Body, mDeviceOptions ) ) {
+		hr = acquireFrame( multiSourceFrame, &IMultiSourceFrame::get_BodyFrameReference, &bodyFrame );
 	}
-
-	if ( SUCCEEDED( hr ) && mDeviceOptions.isBodyEnabled() ) {
-		IBodyFrameReference* frameRef = 0;
-		hr = frame->get_BodyFrameReference( &frameRef );
-		if ( SUCCEEDED( hr ) ) {
-			hr = frameRef->AcquireFrame( &bodyFrame );
-		}
-		if ( frameRef != 0 ) {
-			frameRef->Release();
-			frameRef = 0;
-		}
+	if ( SUCCEEDED( hr ) && isCaptured<S>( Streams::BodyIndex, mDeviceOptions ) ) {
+		hr = acquireFrame( multiSourceFrame, &IMultiSourceFrame::get_BodyIndexFrameReference, &bodyIndexFrame );
 	}
-
-	if ( SUCCEEDED( hr ) && mDeviceOptions.isBodyIndexEnabled() ) {
-		IBodyIndexFrameReference* frameRef = 0;
-		hr = frame->get_BodyIndexFrameReference( &frameRef );
-		if ( SUCCEEDED( hr ) ) {
-			hr = frameRef->AcquireFrame( &bodyIndexFrame );
-		}
-		if ( frameRef != 0 ) {
-			frameRef->Release();
-			frameRef = 0;
-		}
+	if ( SUCCEEDED( hr ) && isCaptured<S>( Streams::Color, mDeviceOptions ) ) {
+		hr = acquireFrame( multiSourceFrame, &IMultiSourceFrame::get_ColorFrameReference, &colorFrame );
 	}
-
-	if ( SUCCEEDED( hr ) && mDeviceOptions.isColorEnabled() ) {
-		IColorFrameReference* frameRef = 0;
-		hr = frame->get_ColorFrameReference( &frameRef );
-		if ( SUCCEEDED( hr ) ) {
-			hr = frameRef->AcquireFrame( &colorFrame );
-		}
-		if ( frameRef != 0 ) {
-			frameRef->Release();
-			frameRef = 0;
-		}
+	if ( SUCCEEDED( hr ) && isCaptured<S>( Streams::Depth, mDeviceOptions ) ) {
+		hr = acquireFrame( multiSourceFrame, &IMultiSourceFrame::get_DepthFrameReference, &depthFrame );
 	}
-
-	if ( SUCCEEDED( hr ) && mDeviceOptions.isDepthEnabled() ) {
-		IDepthFrameReference* frameRef = 0;
-		hr = frame->get_DepthFrameReference( &frameRef );
-		if ( SUCCEEDED( hr ) ) {
-			hr = frameRef->AcquireFrame( &depthFrame );
-		}
-		if ( frameRef != 0 ) {
-			frameRef->Release();
-			frameRef = 0;
-		}
+	if ( SUCCEEDED( hr ) && isCaptured<S>( Streams::Infrared, mDeviceOptions ) ) {
+		hr = acquireFrame( multiSourceFrame, &IMultiSourceFrame::get_InfraredFrameReference, &infraredFrame );
 	}
-
-	if ( SUCCEEDED( hr ) && mDeviceOptions.isInfraredEnabled() ) {
-		IInfraredFrameReference* frameRef = 0;
-		hr = frame->get_InfraredFrameReference( &frameRef );
-		if ( SUCCEEDED( hr ) ) {
-			hr = frameRef->AcquireFrame( &infraredFrame );
-		}
-		if ( frameRef != 0 ) {
-			frameRef->Release();
-			frameRef = 0;
-		}
+	if ( SUCCEEDED( hr ) && isCaptured<S>( Streams::InfraredLongExposure, mDeviceOptions ) ) {
+		hr = acquireFrame( multiSourceFrame, &IMultiSourceFrame::get_LongExposureInfraredFrameReference, &infraredLongExposureFrame );
 	}
 
-	if ( SUCCEEDED( hr ) && mDeviceOptions.isInfraredLongExposureEnabled() ) {
-		ILongExposureInfraredFrameReference* frameRef = 0;
-		hr = frame->get_LongExposureInfraredFrameReference( &frameRef );
-		if ( SUCCEEDED( hr ) ) {
-			hr = frameRef->AcquireFrame( &infraredLongExposureFrame );
-		}
-		if ( frameRef != 0 ) {
-			frameRef->Release();
-			frameRef = 0;
+	// The frame time comes from the first stream present, in the order 
+	// the sensor delivers them.
+	FrameT<S> captured;
+	if ( SUCCEEDED( hr ) ) {
+		if ( depthFrame != 0 ) {
+			hr = depthFrame->get_RelativeTime( &captured.mTimeStamp );
+		} else if ( infraredFrame != 0 ) {
+			hr = infraredFrame->get_RelativeTime( &captured.mTimeStamp );
+		} else if ( infraredLongExposureFrame != 0 ) {
+			hr = infraredLongExposureFrame->get_RelativeTime( &captured.mTimeStamp );
+		} else if ( bodyIndexFrame != 0 ) {
+			hr = bodyIndexFrame->get_RelativeTime( &captured.mTimeStamp );
+		} else if ( colorFrame != 0 ) {
+			hr = colorFrame->get_RelativeTime( &captured.mTimeStamp );
+		} else if ( bodyFrame != 0 ) {
+			hr = bodyFrame->get_RelativeTime( &captured.mTimeStamp );
 		}
 	}
 
-	if ( SUCCEEDED( hr ) ) {
-		long long timeStamp										= 0L;
-
-		// TODO audio
-
-		std::vector<Body> bodies;
-		int64_t bodyTime										= 0L;
-		IBody* kinectBodies[ BODY_COUNT ]						= { 0 };
-		
-		Channel8u bodyIndexChannel;
-		IFrameDescription* bodyIndexFrameDescription			= 0;
-		int32_t bodyIndexWidth									= 0;
-		int32_t bodyIndexHeight									= 0;
-		uint32_t bodyIndexBufferSize							= 0;
-		uint8_t* bodyIndexBuffer								= 0;
-		int64_t bodyIndexTime									= 0L;
-		
-		Surface8u colorSurface;
-		IFrameDescription* colorFrameDescription				= 0;
-		int32_t colorWidth										= 0;
-		int32_t colorHeight										= 0;
-		ColorImageFormat colorImageFormat						= ColorImageFormat_None;
-		uint32_t colorBufferSize								= 0;
-		uint8_t* colorBuffer									= 0;
-
-		Channel16u depthChannel;
-		IFrameDescription* depthFrameDescription				= 0;
-		int32_t depthWidth										= 0;
-		int32_t depthHeight										= 0;
-		uint16_t depthMinReliableDistance						= 0;
-		uint16_t depthMaxReliableDistance						= 0;
-		uint32_t depthBufferSize								= 0;
-		uint16_t* depthBuffer									= 0;
-
-		Channel16u infraredChannel;
-		IFrameDescription* infraredFrameDescription				= 0;
-		int32_t infraredWidth									= 0;
-		int32_t infraredHeight									= 0;
-		uint32_t infraredBufferSize								= 0;
-		uint16_t* infraredBuffer								= 0;
-
-		Channel16u infraredLongExposureChannel;
-		IFrameDescription* infraredLongExposureFrameDescription	= 0;
-		int32_t infraredLongExposureWidth						= 0;
-		int32_t infraredLongExposureHeight						= 0;
-		uint32_t infraredLongExposureBufferSize					= 0;
-		uint16_t* infraredLongExposureBuffer					= 0;
-
-		hr = depthFrame->get_RelativeTime( &timeStamp );
-
-		// TODO audio
-		if ( mDeviceOptions.isAudioEnabled() ) {
-
+	if ( SUCCEEDED( hr ) && bodyFrame != 0 ) {
+		IBody* kinectBodies[ BODY_COUNT ] = { 0 };
+		long long bodyTimeStamp = 0L;
+		hr = bodyFrame->get_RelativeTime( &bodyTimeStamp );
+		captured.mBodyTimeStamp.swap( bodyTimeStamp );
+		if ( SUCCEEDED( hr ) ) {
+			hr = bodyFrame->GetAndRefreshBodyData( BODY_COUNT, kinectBodies );
 		}
-
-		if ( mDeviceOptions.isBodyEnabled() ) {
-			if ( SUCCEEDED( hr ) ) {
-				hr = bodyFrame->get_RelativeTime( &bodyTime );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = bodyFrame->GetAndRefreshBodyData( BODY_COUNT, kinectBodies );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				for ( uint8_t i = 0; i < 6; ++i ) {
-					IBody* kinectBody = kinectBodies[ i ];
-					if ( kinectBody != 0 ) {
-						uint8_t isTracked	= false;
-						hr					= kinectBody->get_IsTracked( &isTracked );
-						if ( SUCCEEDED( hr ) && isTracked ) {
-							Joint joints[ JointType_Count ];
-							kinectBody->GetJoints( JointType_Count, joints );
-
-							JointOrientation jointOrientations[ JointType_Count ];
-							kinectBody->GetJointOrientations( JointType_Count, jointOrientations );
-
-							uint64_t id = 0;
-							kinectBody->get_TrackingId( &id );
-
-							HandState leftHandState = HandState_Unknown;
-                            HandState rightHandState = HandState_Unknown;
-                            kinectBody->get_HandLeftState(&leftHandState);
-                            kinectBody->get_HandRightState(&rightHandState);
-
-							std::map<JointType, Body::Joint> jointMap;
-							for ( int32_t j = 0; j < JointType_Count; ++j ) {
-								Body::Joint joint( 
-									toVec3f( joints[ j ].Position ), 
-									toQuatf( jointOrientations[ j ].Orientation ), 
-									joints[ j ].TrackingState
-									);
-								jointMap.insert( pair<JointType, Body::Joint>( static_cast<JointType>( j ), joint ) );
-							}
-							Body body(id, i, jointMap,leftHandState,rightHandState);
-							bodies.push_back( body );
+		if ( SUCCEEDED( hr ) ) {
+			vector<Body> bodies;
+			for ( uint8_t i = 0; i < BODY_COUNT; ++i ) {
+				IBody* kinectBody = kinectBodies[ i ];
+				if ( kinectBody != 0 ) {
+					uint8_t isTracked	= false;
+					hr					= kinectBody->get_IsTracked( &isTracked );
+					if ( SUCCEEDED( hr ) && isTracked ) {
+						Joint joints[ JointType_Count ];
+						kinectBody->GetJoints( JointType_Count, joints );
+
+						JointOrientation jointOrientations[ JointType_Count ];
+						kinectBody->GetJointOrientations( JointType_Count, jointOrientations );
+
+						uint64_t id = 0;
+						kinectBody->get_TrackingId( &id );
+
+						HandState leftHandState		= HandState_Unknown;
+						HandState rightHandState	= HandState_Unknown;
+						kinectBody->get_HandLeftState( &leftHandState );
+						kinectBody->get_HandRightState( &rightHandState );
+
+						std::map<JointType, Body::Joint> jointMap;
+						for ( int32_t j = 0; j < JointType_Count; ++j ) {
+							Body::Joint joint( 
+								toVec3f( joints[ j ].Position ), 
+								toQuatf( jointOrientations[ j ].Orientation ), 
+								joints[ j ].TrackingState
+								);
+							jointMap.insert( pair<JointType, Body::Joint>( static_cast<JointType>( j ), joint ) );
 						}
+						bodies.push_back( Body( id, i, jointMap, leftHandState, rightHandState ) );
 					}
 				}
 			}
+			for ( uint8_t i = 0; i < BODY_COUNT; ++i ) {
+				if ( kinectBodies[ i ] != 0 ) {
+					kinectBodies[ i ]->Release();
+					kinectBodies[ i ] = 0;
+				}
+			}
+			captured.mBodies.swap( bodies );
 		}
 		if ( SUCCEEDED( hr ) ) {
 			Vector4 floorPlane;
 			hr = bodyFrame->get_FloorClipPlane( &floorPlane );
-			mFloorPlane = toVec4f(floorPlane);
-		}
-
-		if ( mDeviceOptions.isBodyIndexEnabled() ) {
-			if ( SUCCEEDED( hr ) ) {
-				hr = bodyIndexFrame->get_RelativeTime( &bodyIndexTime );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = bodyIndexFrame->get_FrameDescription( &bodyIndexFrameDescription );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = bodyIndexFrameDescription->get_Width( &bodyIndexWidth );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = bodyIndexFrameDescription->get_Height( &bodyIndexHeight );
-			}
-			if ( SUCCEEDED( hr ) ) {
- 				hr = bodyIndexFrame->AccessUnderlyingBuffer( &bodyIndexBufferSize, &bodyIndexBuffer );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				bodyIndexChannel = Channel8u( bodyIndexWidth, bodyIndexHeight );
-				memcpy( bodyIndexChannel.getData(), bodyIndexBuffer, bodyIndexWidth * bodyIndexHeight * sizeof( uint8_t ) );
-			}
-		}
-
-		if ( mDeviceOptions.isColorEnabled() ) {
-			if ( SUCCEEDED( hr ) ) {
-				hr = colorFrame->get_FrameDescription( &colorFrameDescription );
-				if ( SUCCEEDED( hr ) ) {
-					float vFov = 0.0f;
-					float hFov = 0.0f;
-					float dFov = 0.0f;
-					colorFrameDescription->get_VerticalFieldOfView( &vFov );
-					colorFrameDescription->get_HorizontalFieldOfView( &hFov );
-					colorFrameDescription->get_DiagonalFieldOfView( &dFov );
-				}
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = colorFrameDescription->get_Width( &colorWidth );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = colorFrameDescription->get_Height( &colorHeight );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = colorFrame->get_RawColorImageFormat( &colorImageFormat );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				colorBufferSize = colorWidth * colorHeight * sizeof( uint8_t ) * 4;
-				colorBuffer		= new uint8_t[ colorBufferSize ];
-				hr = colorFrame->CopyConvertedFrameDataToArray( colorBufferSize, reinterpret_cast<uint8_t*>( colorBuffer ), ColorImageFormat_Rgba );
-			
-				if ( SUCCEEDED( hr ) ) {
-					colorSurface = Surface8u( colorWidth, colorHeight, false, SurfaceChannelOrder::RGBA );
-					memcpy( colorSurface.getData(), colorBuffer, colorWidth * colorHeight * sizeof( uint8_t ) * 4 );
-				}
-
-				delete [] colorBuffer;
-				colorBuffer = 0;
-			}
-		}
-
-		if ( mDeviceOptions.isDepthEnabled() ) {
-			if ( SUCCEEDED( hr ) ) {
-				hr = depthFrame->get_FrameDescription( &depthFrameDescription );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = depthFrameDescription->get_Width( &depthWidth );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = depthFrameDescription->get_Height( &depthHeight );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = depthFrame->get_DepthMinReliableDistance( &depthMinReliableDistance );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = depthFrame->get_DepthMaxReliableDistance( &depthMaxReliableDistance );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = depthFrame->AccessUnderlyingBuffer( &depthBufferSize, &depthBuffer );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				depthChannel = Channel16u( depthWidth, depthHeight );
-				memcpy( depthChannel.getData(), depthBuffer, depthWidth * depthHeight * sizeof( uint16_t ) );
-			}
+			Vec4f plane = toVec4f( floorPlane );
+			captured.mFloorPlane.swap( plane );
 		}
+	}
 
-		if ( mDeviceOptions.isInfraredEnabled() ) {
-			if ( SUCCEEDED( hr ) ) {
-				hr = infraredFrame->get_FrameDescription( &infraredFrameDescription );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = infraredFrameDescription->get_Width( &infraredWidth );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = infraredFrameDescription->get_Height( &infraredHeight );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = infraredFrame->AccessUnderlyingBuffer( &infraredBufferSize, &infraredBuffer );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				infraredChannel = Channel16u( infraredWidth, infraredHeight );
-				memcpy( infraredChannel.getData(), infraredBuffer,  infraredWidth * infraredHeight * sizeof( uint16_t ) );
-			}
-		}
+	if ( SUCCEEDED( hr ) && bodyIndexFrame != 0 ) {
+		Channel8u bodyIndex;
+		hr = copyFrameBuffer( bodyIndexFrame, bodyIndex );
+		captured.mChannelBodyIndex.swap( bodyIndex );
+	}
 
-		if ( mDeviceOptions.isInfraredLongExposureEnabled() ) {
-			if ( SUCCEEDED( hr ) ) {
-				hr = infraredLongExposureFrame->get_FrameDescription( &infraredLongExposureFrameDescription );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = infraredLongExposureFrameDescription->get_Width( &infraredLongExposureWidth );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = infraredLongExposureFrameDescription->get_Height( &infraredLongExposureHeight );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				hr = infraredLongExposureFrame->AccessUnderlyingBuffer( &infraredLongExposureBufferSize, &infraredLongExposureBuffer );
-			}
-			if ( SUCCEEDED( hr ) ) {
-				infraredLongExposureChannel = Channel16u( infraredLongExposureWidth, infraredLongExposureHeight );
-				memcpy( infraredLongExposureChannel.getData(), infraredLongExposureBuffer, infraredLongExposureWidth * infraredLongExposureHeight * sizeof( uint16_t ) );
-			}
+	if ( SUCCEEDED( hr ) && colorFrame != 0 ) {
+		IFrameDescription* colorFrameDescription	= 0;
+		int32_t colorWidth							= 0;
+		int32_t colorHeight							= 0;
+		hr = colorFrame->get_FrameDescription( &colorFrameDescription );
+		if ( SUCCEEDED( hr ) ) {
+			hr = colorFrameDescription->get_Width( &colorWidth );
 		}
-
 		if ( SUCCEEDED( hr ) ) {
-			mFrame.mBodies						= bodies;
-			mFrame.mChannelBodyIndex			= bodyIndexChannel;
-			mFrame.mChannelDepth				= depthChannel;
-			mFrame.mChannelInfrared				= infraredChannel;
-			mFrame.mChannelInfraredLongExposure	= infraredLongExposureChannel;
-			mFrame.mDeviceId					= mDeviceOptions.getDeviceId();
-			mFrame.mSurfaceColor				= colorSurface;
-			mFrame.mTimeStamp					= timeStamp;
+			hr = colorFrameDescription->get_Height( &colorHeight );
 		}
-
-		if ( bodyIndexFrameDescription != 0 ) {
-			bodyIndexFrameDescription->Release();
-			bodyIndexFrameDescription = 0;
+		if ( SUCCEEDED( hr ) ) {
+			Surface8u colorSurface( colorWidth, colorHeight, false, SurfaceChannelOrder::RGBA );
+			hr = colorFrame->CopyConvertedFrameDataToArray( colorWidth * colorHeight * sizeof( uint8_t ) * 4, colorSurface.getData(), ColorImageFormat_Rgba );
+			captured.mSurfaceColor.swap( colorSurface );
 		}
 		if ( colorFrameDescription != 0 ) {
 			colorFrameDescription->Release();
 			colorFrameDescription = 0;
 		}
-		if ( depthFrameDescription != 0 ) {
-			depthFrameDescription->Release();
-			depthFrameDescription = 0;
-		}
-		if ( infraredFrameDescription != 0 ) {
-			infraredFrameDescription->Release();
-			infraredFrameDescription = 0;
-		}
-		if ( infraredLongExposureFrameDescription != 0 ) {
-			infraredLongExposureFrameDescription->Release();
-			infraredLongExposureFrameDescription = 0;
-		}
 	}
 
-	if ( audioFrame != 0 ) {
-		audioFrame->Release();
-		audioFrame = 0;
+	if ( SUCCEEDED( hr ) && depthFrame != 0 ) {
+		Channel16u depth;
+		hr = copyFrameBuffer( depthFrame, depth );
+		captured.mChannelDepth.swap( depth );
+	}
+	if ( SUCCEEDED( hr ) && infraredFrame != 0 ) {
+		Channel16u infrared;
+		hr = copyFrameBuffer( infraredFrame, infrared );
+		captured.mChannelInfrared.swap( infrared );
+	}
+	if ( SUCCEEDED( hr ) && infraredLongExposureFrame != 0 ) {
+		Channel16u infraredLongExposure;
+		hr = copyFrameBuffer( infraredLongExposureFrame, infraredLongExposure );
+		captured.mChannelInfraredLongExposure.swap( infraredLongExposure );
+	}
+
+	if ( SUCCEEDED( hr ) ) {
+		frame = captured;
 	}
+
 	if ( bodyFrame != 0 ) {
 		bodyFrame->Release();
 		bodyFrame = 0;
@@ -1095,9 +1437,9 @@ void Device::update()
 		depthFrame->Release();
 		depthFrame = 0;
 	}
-	if ( frame != 0 ) {
-		frame->Release();
-		frame = 0;
+	if ( multiSourceFrame != 0 ) {
+		multiSourceFrame->Release();
+		multiSourceFrame = 0;
 	}
 	if ( infraredFrame != 0 ) {
 		infraredFrame->Release();
@@ -1107,6 +1449,256 @@ void Device::update()
 		infraredLongExposureFrame->Release();
 		infraredLongExposureFrame = 0;
 	}
+	return SUCCEEDED( hr );
+}
+
+template<uint32_t S>
+bool Device::updateFrame()
+{
+	FrameT<S> frame;
+	if ( !capture( frame ) ) {
+		return false;
+	}
+
+	if ( isCaptured<S>( Streams::Body, mDeviceOptions ) ) {
+		long long bodyTime = frame.mBodyTimeStamp.get();
+		if ( bodyTime != mFrame.mBodyTimeStamp ) {
+			mBodiesPrevious.swap( mFrame.mBodies );
+			mBodyTimeStampPrevious = mFrame.mBodyTimeStamp;
+
+			// Arrival latency only adds to the offset, so track its minimum
+			// while slowly following drift between the two clocks
+			double offset = getHostTime() - (double)bodyTime * 1.0e-7;
+			if ( mBodyTimeStampPrevious == 0L || offset < mHostTimeOffset ) {
+				mHostTimeOffset = offset;
+			} else {
+				mHostTimeOffset += ( offset - mHostTimeOffset ) * 0.01;
+			}
+		}
+		frame.mBodies.swap( mFrame.mBodies );
+		mFrame.mBodyTimeStamp	= bodyTime;
+		mFloorPlane				= frame.mFloorPlane.get();
+	} else {
+		mFrame.mBodies.clear();
+		mFrame.mBodyTimeStamp	= 0L;
+	}
+	mFrame.mChannelBodyIndex			= isCaptured<S>( Streams::BodyIndex, mDeviceOptions ) ? frame.mChannelBodyIndex.get() : Channel8u();
+	mFrame.mChannelDepth				= isCaptured<S>( Streams::Depth, mDeviceOptions ) ? frame.mChannelDepth.get() : Channel16u();
+	mFrame.mDepthChanges				= mDepthChangeDetector && mFrame.mChannelDepth ? mDepthChangeDetector->update( mFrame.mChannelDepth ) : TileChangesRef();
+	mFrame.mChannelInfrared				= isCaptured<S>( Streams::Infrared, mDeviceOptions ) ? frame.mChannelInfrared.get() : Channel16u();
+	mFrame.mChannelInfraredLongExposure	= isCaptured<S>( Streams::InfraredLongExposure, mDeviceOptions ) ? frame.mChannelInfraredLongExposure.get() : Channel16u();
+	mFrame.mDeviceId					= mDeviceOptions.getDeviceId();
+	mFrame.mSurfaceColor				= isCaptured<S>( Streams::Color, mDeviceOptions ) ? frame.mSurfaceColor.get() : Surface8u();
+	mFrame.mTimeStamp					= frame.mTimeStamp;
+	return true;
+}
+
+bool Device::poll()
+{
+	if ( mFrameReader == 0 ) {
+		return false;
+	}
+
+	// Intrinsics read as zero until the sensor has delivered its calibration
+	if ( !mDepthProjection.isValid() && mCoordinateMapper != 0 ) {
+		CameraIntrinsics intrinsics;
+		if ( SUCCEEDED( mCoordinateMapper->GetDepthCameraIntrinsics( &intrinsics ) ) && intrinsics.FocalLengthX > 0.0f ) {
+			mDepthProjection = toCameraProjection( intrinsics );
+			mColorProjection = calcColorProjection( mCoordinateMapper );
+		}
+	}
+
+	// Common stream sets get a capture path of their own. Anything else 
+	// checks the options per stream.
+	switch ( mDeviceOptions.getStreams() ) {
+	case Streams::Color:
+		return updateFrame<Streams::Color>();
+	case Streams::Depth:
+		return updateFrame<Streams::Depth>();
+	case Streams::Infrared:
+		return updateFrame<Streams::Infrared>();
+	case Streams::Color | Streams::Depth:
+		return updateFrame<Streams::Color | Streams::Depth>();
+	case Streams::Depth | Streams::Infrared:
+		return updateFrame<Streams::Depth | Streams::Infrared>();
+	case Streams::Body | Streams::Depth:
+		return updateFrame<Streams::Body | Streams::Depth>();
+	case Streams::Body | Streams::BodyIndex | Streams::Depth:
+		return updateFrame<Streams::Body | Streams::BodyIndex | Streams::Depth>();
+	case Streams::Body | Streams::BodyIndex | Streams::Color | Streams::Depth:
+		return updateFrame<Streams::Body | Streams::BodyIndex | Streams::Color | Streams::Depth>();
+	default:
+		return updateFrame<Streams::All | Streams::Dynamic>();
+	}
+}
+
+bool Device::waitForFrame( uint32_t timeoutMs )
+{
+	if ( mFrameReader == 0 ) {
+		return false;
+	}
+	if ( mFrameEvent == 0 && FAILED( mFrameReader->SubscribeMultiSourceFrameArrived( &mFrameEvent ) ) ) {
+		mFrameEvent = 0;
+		return poll();
+	}
+	if ( ::WaitForSingleObject( reinterpret_cast<HANDLE>( mFrameEvent ), timeoutMs ) != WAIT_OBJECT_0 ) {
+		return false;
+	}
+
+	// The event data only holds a reference to this frame; poll() reads 
+	// the latest one anyway.
+	IMultiSourceFrameArrivedEventArgs* args = 0;
+	if ( SUCCEEDED( mFrameReader->GetMultiSourceFrameArrivedEventData( mFrameEvent, &args ) ) && args != 0 ) {
+		args->Release();
+		args = 0;
+	}
+	return poll();
+}
+
+void Device::update()
+{
+	poll();
+}
+
+template bool Device::capture( FrameT<Streams::Color>& frame );
+template bool Device::capture( FrameT<Streams::Depth>& frame );
+template bool Device::capture( FrameT<Streams::Infrared>& frame );
+template bool Device::capture( FrameT<Streams::Color | Streams::Depth>& frame );
+template bool Device::capture( FrameT<Streams::Depth | Streams::Infrared>& frame );
+template bool Device::capture( FrameT<Streams::Body | Streams::Depth>& frame );
+template bool Device::capture( FrameT<Streams::Body | Streams::BodyIndex | Streams::Depth>& frame );
+template bool Device::capture( FrameT<Streams::Body | Streams::BodyIndex | Streams::Color | Streams::Depth>& frame );
+template bool Device::capture( FrameT<Streams::All | Streams::Dynamic>& frame );
+
+void Device::startAudio()
+{
+	IAudioSource* audioSource = 0;
+	long hr = mSensor->get_AudioSource( &audioSource );
+	if ( SUCCEEDED( hr ) ) {
+		hr = audioSource->OpenReader( &mAudioFrameReader );
+	}
+	if ( SUCCEEDED( hr ) ) {
+		hr = mAudioFrameReader->SubscribeFrameArrived( &mAudioFrameEvent );
+	}
+	if ( audioSource != 0 ) {
+		audioSource->Release();
+		audioSource = 0;
+	}
+	if ( FAILED( hr ) ) {
+		stopAudio();
+		throw ExcOpenAudioReaderFailed( hr, mDeviceOptions.getDeviceId() );
+	}
+
+	if ( !mAudioBuffer ) {
+		mAudioBuffer = AudioBuffer::create();
+	}
+	mAudioStopEvent	= ::CreateEvent( 0, TRUE, FALSE, 0 );
+	mAudioRunning	= true;
+	mAudioThread	= shared_ptr<thread>( new thread( bind( &Device::updateAudio, this ) ) );
+}
+
+void Device::stopAudio()
+{
+	mAudioRunning = false;
+	if ( mAudioStopEvent != 0 ) {
+		::SetEvent( mAudioStopEvent );
+	}
+	if ( mAudioThread ) {
+		mAudioThread->join();
+		mAudioThread.reset();
+	}
+	if ( mAudioStopEvent != 0 ) {
+		::CloseHandle( mAudioStopEvent );
+		mAudioStopEvent = 0;
+	}
+	if ( mAudioFrameReader != 0 ) {
+		if ( mAudioFrameEvent != 0 ) {
+			mAudioFrameReader->UnsubscribeFrameArrived( mAudioFrameEvent );
+			mAudioFrameEvent = 0;
+		}
+		mAudioFrameReader->Release();
+		mAudioFrameReader = 0;
+	}
+}
+
+void Device::updateAudio()
+{
+	HANDLE events[ 2 ] = { reinterpret_cast<HANDLE>( mAudioFrameEvent ), mAudioStopEvent };
+	while ( mAudioRunning ) {
+		DWORD result = ::WaitForMultipleObjects( 2, events, FALSE, INFINITE );
+		if ( result != WAIT_OBJECT_0 || !mAudioRunning ) {
+			break;
+		}
+
+		IAudioBeamFrameArrivedEventArgs* args		= 0;
+		IAudioBeamFrameReference* frameRef			= 0;
+		IAudioBeamFrameList* frameList				= 0;
+		IAudioBeamFrame* frame						= 0;
+		UINT subFrameCount							= 0;
+
+		long hr = mAudioFrameReader->GetFrameArrivedEventData( mAudioFrameEvent, &args );
+		if ( SUCCEEDED( hr ) ) {
+			hr = args->get_FrameReference( &frameRef );
+		}
+		if ( SUCCEEDED( hr ) ) {
+			hr = frameRef->AcquireBeamFrames( &frameList );
+		}
+		if ( SUCCEEDED( hr ) ) {
+
+			// Only one beam is supported by the sensor
+			hr = frameList->OpenAudioBeamFrame( 0, &frame );
+		}
+		if ( SUCCEEDED( hr ) ) {
+			hr = frame->get_SubFrameCount( &subFrameCount );
+		}
+		for ( UINT i = 0; SUCCEEDED( hr ) && i < subFrameCount; ++i ) {
+			IAudioBeamSubFrame* subFrame	= 0;
+			float beamAngle					= 0.0f;
+			float beamAngleConfidence		= 0.0f;
+			TIMESPAN timeStamp				= 0L;
+			UINT bufferSize					= 0;
+			BYTE* buffer					= 0;
+
+			hr = frame->GetSubFrame( i, &subFrame );
+			if ( SUCCEEDED( hr ) ) {
+				hr = subFrame->get_BeamAngle( &beamAngle );
+			}
+			if ( SUCCEEDED( hr ) ) {
+				hr = subFrame->get_BeamAngleConfidence( &beamAngleConfidence );
+			}
+			if ( SUCCEEDED( hr ) ) {
+				hr = subFrame->get_RelativeTime( &timeStamp );
+			}
+			if ( SUCCEEDED( hr ) ) {
+				hr = subFrame->AccessUnderlyingBuffer( &bufferSize, &buffer );
+			}
+			if ( SUCCEEDED( hr ) ) {
+				mAudioBuffer->write( reinterpret_cast<const float*>( buffer ), bufferSize / sizeof( float ), 
+					timeStamp, beamAngle, beamAngleConfidence );
+			}
+			if ( subFrame != 0 ) {
+				subFrame->Release();
+				subFrame = 0;
+			}
+		}
+
+		if ( frame != 0 ) {
+			frame->Release();
+			frame = 0;
+		}
+		if ( frameList != 0 ) {
+			frameList->Release();
+			frameList = 0;
+		}
+		if ( frameRef != 0 ) {
+			frameRef->Release();
+			frameRef = 0;
+		}
+		if ( args != 0 ) {
+			args->Release();
+			args = 0;
+		}
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////
@@ -1146,4 +1738,9 @@ Device::ExcOpenFrameReaderFailed::ExcOpenFrameReaderFailed( long hr, const strin
 	sprintf( mMessage, "Unable to open frame reader. Device ID: %s. Error: %i", id, hr );
 }
 
+Device::ExcOpenAudioReaderFailed::ExcOpenAudioReaderFailed( long hr, const string& id ) throw()
+{
+	sprintf( mMessage, "Unable to open audio reader. Device ID: %s. Error: %i", id.c_str(), hr );
+}
+
 }
@@ -41,8 +41,12 @@
 #include "cinder/Matrix.h"
 #include "cinder/Quaternion.h"
 #include "cinder/Surface.h"
+#include <atomic>
 #include <functional>
 #include <map>
+#include <thread>
+#include <utility>
+#include <vector>
 #include "ole2.h"
 
 #if defined( _DEBUG )
@@ -53,23 +57,40 @@
 #pragma comment( lib, "wbemuuid.lib" )
 
 #include "Kinect.h"
+#include "Kinect2Projection.h"
 
 namespace Kinect2 {
 
+class Body;
+
 ci::Channel8u									channel16To8( const ci::Channel16u& channel );
 ci::Surface8u									colorizeBodyIndex( const ci::Channel8u& bodyIndexChannel );
 
 ci::Color8u										getBodyColor( uint64_t index );
 size_t											getDeviceCount();
 std::map<size_t, std::string>					getDeviceMap();
+// Monotonic host clock in seconds, used to query bodies between sensor frames
+double											getHostTime();
 
 ci::Vec2i										mapBodyCoordToColor( const ci::Vec3f& v, ICoordinateMapper* mapper );
 ci::Vec2i										mapBodyCoordToDepth( const ci::Vec3f& v, ICoordinateMapper* mapper );
+// Projects every joint of every body with one mapper call. "positions" must 
+// hold bodies.size() * JointType_Count points and is indexed by 
+// body * JointType_Count + joint. Returns the number of points written.
+size_t											mapBodiesToColor( const std::vector<Body>& bodies, ci::Vec2f* positions, ICoordinateMapper* mapper );
+size_t											mapBodiesToDepth( const std::vector<Body>& bodies, ci::Vec2f* positions, ICoordinateMapper* mapper );
+// CPU equivalent using a cached projection (see Device::getColorProjection() 
+// and Device::getDepthProjection()).
+size_t											mapBodiesToImage( const std::vector<Body>& bodies, ci::Vec2f* positions, const CameraProjection& projection );
 //ci::Surface8u									mapColorFrameToDepth( const ci::Surface8u& color, ICoordinateMapper* mapper );
 ci::Vec2i										mapDepthCoordToColor( const ci::Vec2i& v, uint16_t depth, ICoordinateMapper* mapper );
 ci::Channel16u									mapDepthFrameToColor( const ci::Channel16u& depth, ICoordinateMapper* mapper );
 ci::Surface32f                                  mapDepthFrameToCamera( const ci::Channel16u& depth, ICoordinateMapper* mapper );
 
+// Fits a color camera projection to the mapper by sampling points in the 
+// depth camera's field of view.
+CameraProjection								calcColorProjection( ICoordinateMapper* mapper );
+CameraProjection								toCameraProjection( const CameraIntrinsics& v );
 ci::Quatf										toQuatf( const Vector4& v );
 ci::Vec2f										toVec2f( const PointF& v );
 ci::Vec2f										toVec2f( const ColorSpacePoint& v );
@@ -81,6 +102,26 @@ std::string										wcharToString( wchar_t* v );
 
 //////////////////////////////////////////////////////////////////////////////////////////////
 
+// Stream sets for the compile-time capture path (see FrameT and 
+// Device::capture()).
+namespace Streams
+{
+	enum : uint32_t
+	{
+		Body					= 1 << 0, 
+		BodyIndex				= 1 << 1, 
+		Color					= 1 << 2, 
+		Depth					= 1 << 3, 
+		Infrared				= 1 << 4, 
+		InfraredLongExposure	= 1 << 5, 
+		All						= 0x3f, 
+		// Checks DeviceOptions for every stream at run time
+		Dynamic					= 0x80000000
+	};
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
 class DeviceOptions
 {
 public:
@@ -91,6 +132,9 @@ public:
 	DeviceOptions&								enableBodyIndex( bool enable = true );
 	DeviceOptions&								enableColor( bool enable = true );
 	DeviceOptions&								enableDepth( bool enable = true );
+	// Compares each depth frame against the last one in tiles and 
+	// publishes the result with the Frame.
+	DeviceOptions&								enableDepthChanges( bool enable = true );
 	DeviceOptions&								enableInfrared( bool enable = true );
 	DeviceOptions&								enableInfraredLongExposure( bool enable = true );
 	DeviceOptions&								setDeviceId( const std::string& id = "" ); 
@@ -98,11 +142,14 @@ public:
 
 	const std::string&							getDeviceId() const;
 	int32_t										getDeviceIndex() const;
+	// Enabled video and body streams as a Streams mask
+	uint32_t									getStreams() const;
 	bool										isAudioEnabled() const;
 	bool										isBodyEnabled() const;
 	bool										isBodyIndexEnabled() const;
 	bool										isColorEnabled() const;
 	bool										isDepthEnabled() const;
+	bool										isDepthChangesEnabled() const;
 	bool										isInfraredEnabled() const;
 	bool										isInfraredLongExposureEnabled() const;
 protected:
@@ -114,13 +161,115 @@ protected:
 	bool										mEnabledBodyIndex;
 	bool										mEnabledColor;
 	bool										mEnabledDepth;
+	bool										mEnabledDepthChanges;
 	bool										mEnabledInfrared;
 	bool										mEnabledInfraredLongExposure;
 };
 
 //////////////////////////////////////////////////////////////////////////////////////////////
 
+class AudioBuffer;
+typedef std::shared_ptr<AudioBuffer> AudioBufferRef;
+
+// Lock-free, single-producer/multi-consumer ring of beam-formed audio 
+// samples (32-bit float, 16kHz mono). Positions are absolute sample 
+// counts since capture started. Consumers read in place through Spans and 
+// check afterwards that the producer has not lapped them.
+class AudioBuffer
+{
+public:
+	static AudioBufferRef						create( size_t capacity = 65536 );
+
+	// Samples are contiguous except where the ring wraps, so a span 
+	// has up to two parts.
+	class Span
+	{
+	public:
+		Span();
+
+		const float*							getData( size_t part ) const;
+		size_t									getSize( size_t part ) const;
+		uint64_t								getPosition() const;
+		size_t									size() const;
+		bool									empty() const;
+		float									operator[]( size_t i ) const;
+	protected:
+		const float*							mData[ 2 ];
+		uint64_t								mPosition;
+		size_t									mSize[ 2 ];
+
+		friend class							AudioBuffer;
+	};
+
+	// Sensor metadata for each sub-frame written to the buffer.
+	struct SubFrame
+	{
+		SubFrame();
+
+		float									mBeamAngle;
+		float									mBeamAngleConfidence;
+		uint64_t								mPosition;
+		size_t									mSize;
+		long long								mTimeStamp;
+	};
+
+	// Per-consumer cursor. Readers are independent of each other.
+	class Reader
+	{
+	public:
+		Reader();
+		Reader( const AudioBufferRef& buffer );
+
+		// Up to "maxCount" unread samples, without copying.
+		Span									acquire( size_t maxCount = ~(size_t)0 );
+		// Consumes "span". Returns false if it was overwritten while in 
+		// use, in which case the cursor skips ahead to the oldest valid sample.
+		bool									release( const Span& span );
+
+		uint64_t								getPosition() const;
+		size_t									getAvailable() const;
+	protected:
+		AudioBufferRef							mBuffer;
+		uint64_t								mPosition;
+	};
+
+	size_t										getCapacity() const;
+	uint32_t									getSampleRate() const;
+	uint64_t									getWritePosition() const;
+
+	Span										read( uint64_t position, size_t maxCount ) const;
+	bool										isValid( const Span& span ) const;
+	bool										getSubFrame( uint64_t position, SubFrame& subFrame ) const;
+	bool										getLatestSubFrame( SubFrame& subFrame ) const;
+
+	// Producer side. Only one thread may write.
+	void										write( const float* data, size_t count, long long timeStamp, float beamAngle, float beamAngleConfidence );
+protected:
+	AudioBuffer( size_t capacity );
+
+	struct SubFrameSlot
+	{
+		SubFrame								mSubFrame;
+		std::atomic<uint32_t>					mVersion;
+	};
+
+	size_t										mCapacity;
+	size_t										mMask;
+	std::vector<float>							mSamples;
+	std::vector<SubFrameSlot>					mSubFrames;
+	size_t										mSubFrameMask;
+	std::atomic<uint64_t>						mClaimed;
+	std::atomic<uint64_t>						mCommitted;
+	std::atomic<uint64_t>						mSubFrameCount;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+class ChangeDetector;
 class Device;
+class TileChanges;
+typedef std::shared_ptr<ChangeDetector>		ChangeDetectorRef;
+typedef std::shared_ptr<const TileChanges>	TileChangesRef;
 
 class Body
 {
@@ -133,18 +282,19 @@ public:
 	{
 	public:
 		Joint();
+		Joint( const ci::Vec3f& position, const ci::Quatf& orientation, TrackingState trackingState );
 		
 		const ci::Quatf&						getOrientation() const;
 		const ci::Vec3f&						getPosition() const;
 		TrackingState							getTrackingState() const;
 	protected:
-		Joint( const ci::Vec3f& position, const ci::Quatf& orientation, TrackingState trackingState );
-		
 		ci::Quatf								mOrientation;
 		ci::Vec3f								mPosition;
 		TrackingState							mTrackingState;
 
+		friend class							BodyDecoder;
 		friend class							Device;
+		friend class							FrameBusReader;
 	};
 
 	//////////////////////////////////////////////////////////////////////////////////////////////
@@ -158,10 +308,11 @@ public:
 	const HandState&                            getLeftHandState() const;
     const HandState&                            getRightHandState() const;
 
-private:
+	// Tracked body built from outside the sensor, e.g. for playback or 
+	// synthetic input.
 	Body( uint64_t id, uint8_t index, const std::map<JointType, Body::Joint>& jointMap );
 	Body( uint64_t id, uint8_t index, const std::map<JointType, Body::Joint>& jointMap, HandState leftHandState, HandState rightHandState );
-
+private:
 	uint64_t									mId;
 	uint8_t										mIndex;
 	std::map<JointType, Body::Joint>			mJointMap;
@@ -169,7 +320,9 @@ private:
 	HandState									mLeftHandState;
     HandState                                   mRightHandState;
 
+	friend class								BodyDecoder;
 	friend class								Device;
+	friend class								FrameBusReader;
 };
 
 class Frame
@@ -178,30 +331,206 @@ public:
 	Frame();
 
 	const std::vector<Body>&					getBodies() const;
+	long long									getBodyTimeStamp() const;
 	const ci::Channel8u&						getBodyIndex() const;
 	const ci::Surface8u&						getColor() const;
 	const ci::Channel16u&						getDepth() const;
+	// Depth tiles that changed beyond sensor noise, if enabled in 
+	// DeviceOptions. See Kinect2ChangeDetector.h.
+	const TileChangesRef&						getDepthChanges() const;
 	const std::string&							getDeviceId() const;
 	const ci::Channel16u&						getInfrared() const;
 	const ci::Channel16u&						getInfraredLongExposure() const;
 	long long									getTimeStamp() const;
-protected:
-	Frame( long long frameId, const std::string& deviceId, const ci::Surface8u& color, 
-		const ci::Channel16u& depth, const ci::Channel16u& infrared, 
-		const ci::Channel16u& infraredLongExposure );
 
+	// Frame built from outside the sensor, e.g. for playback, tests or 
+	// synthetic input to StreamServer. Empty channels mark streams that 
+	// are not present; "bodyTimeStamp" of 0 marks missing bodies.
+	Frame( long long timeStamp, const std::string& deviceId, const ci::Surface8u& color, 
+		const ci::Channel16u& depth, const ci::Channel16u& infrared, 
+		const ci::Channel16u& infraredLongExposure, 
+		const std::vector<Body>& bodies = std::vector<Body>(), long long bodyTimeStamp = 0L, 
+		const ci::Channel8u& bodyIndex = ci::Channel8u() );
+protected:
 	std::vector<Body>							mBodies;
+	long long									mBodyTimeStamp;
 	std::string									mDeviceId;
 	ci::Channel8u								mChannelBodyIndex;
 	ci::Channel16u								mChannelDepth;
 	ci::Channel16u								mChannelInfrared;
 	ci::Channel16u								mChannelInfraredLongExposure;
+	TileChangesRef								mDepthChanges;
 	ci::Surface8u								mSurfaceColor;
 	long long									mTimeStamp;
 
+	friend class								Device;
+	friend class								StreamClient;
+};
+
+// Storage for one stream of a FrameT. Values start out empty or zero.
+template<bool enabled, typename T>
+class StreamStorage
+{
+public:
+	StreamStorage();
+
+	T&											get();
+	const T&									get() const;
+	void										swap( T& value );
+protected:
+	T											mValue;
+};
+
+// Streams that are not captured store nothing. Reads return a shared 
+// empty value that cannot be written, and swap() leaves "value" empty.
+template<typename T>
+class StreamStorage<false, T>
+{
+public:
+	const T&									get() const;
+	void										swap( T& value );
+protected:
+	static const T								sEmpty;
+};
+
+// Frame holding only the streams in "S". Accessors for other streams 
+// fail to compile.
+template<uint32_t S>
+class FrameT
+{
+public:
+	FrameT();
+
+	const std::vector<Body>&					getBodies() const;
+	long long									getBodyTimeStamp() const;
+	const ci::Channel8u&						getBodyIndex() const;
+	const ci::Surface8u&						getColor() const;
+	const ci::Channel16u&						getDepth() const;
+	const ci::Vec4f&							getFloorPlane() const;
+	const ci::Channel16u&						getInfrared() const;
+	const ci::Channel16u&						getInfraredLongExposure() const;
+	long long									getTimeStamp() const;
+protected:
+	StreamStorage<( S & Streams::Body ) != 0, std::vector<Body> >						mBodies;
+	StreamStorage<( S & Streams::Body ) != 0, long long>								mBodyTimeStamp;
+	StreamStorage<( S & Streams::BodyIndex ) != 0, ci::Channel8u>						mChannelBodyIndex;
+	StreamStorage<( S & Streams::Depth ) != 0, ci::Channel16u>							mChannelDepth;
+	StreamStorage<( S & Streams::Infrared ) != 0, ci::Channel16u>						mChannelInfrared;
+	StreamStorage<( S & Streams::InfraredLongExposure ) != 0, ci::Channel16u>			mChannelInfraredLongExposure;
+	StreamStorage<( S & Streams::Body ) != 0, ci::Vec4f>								mFloorPlane;
+	StreamStorage<( S & Streams::Color ) != 0, ci::Surface8u>							mSurfaceColor;
+	long long									mTimeStamp;
+
 	friend class								Device;
 };
 
+template<bool enabled, typename T>
+StreamStorage<enabled, T>::StreamStorage()
+: mValue()
+{
+}
+
+template<bool enabled, typename T>
+T& StreamStorage<enabled, T>::get()
+{
+	return mValue;
+}
+
+template<bool enabled, typename T>
+const T& StreamStorage<enabled, T>::get() const
+{
+	return mValue;
+}
+
+template<bool enabled, typename T>
+void StreamStorage<enabled, T>::swap( T& value )
+{
+	std::swap( mValue, value );
+}
+
+template<typename T>
+const T StreamStorage<false, T>::sEmpty = T();
+
+template<typename T>
+const T& StreamStorage<false, T>::get() const
+{
+	return sEmpty;
+}
+
+template<typename T>
+void StreamStorage<false, T>::swap( T& value )
+{
+	value = T();
+}
+
+template<uint32_t S>
+FrameT<S>::FrameT()
+: mTimeStamp( 0L )
+{
+}
+
+template<uint32_t S>
+const std::vector<Body>& FrameT<S>::getBodies() const
+{
+	static_assert( ( S & Streams::Body ) != 0, "Body stream is not captured" );
+	return mBodies.get();
+}
+
+template<uint32_t S>
+long long FrameT<S>::getBodyTimeStamp() const
+{
+	static_assert( ( S & Streams::Body ) != 0, "Body stream is not captured" );
+	return mBodyTimeStamp.get();
+}
+
+template<uint32_t S>
+const ci::Channel8u& FrameT<S>::getBodyIndex() const
+{
+	static_assert( ( S & Streams::BodyIndex ) != 0, "Body index stream is not captured" );
+	return mChannelBodyIndex.get();
+}
+
+template<uint32_t S>
+const ci::Surface8u& FrameT<S>::getColor() const
+{
+	static_assert( ( S & Streams::Color ) != 0, "Color stream is not captured" );
+	return mSurfaceColor.get();
+}
+
+template<uint32_t S>
+const ci::Channel16u& FrameT<S>::getDepth() const
+{
+	static_assert( ( S & Streams::Depth ) != 0, "Depth stream is not captured" );
+	return mChannelDepth.get();
+}
+
+template<uint32_t S>
+const ci::Vec4f& FrameT<S>::getFloorPlane() const
+{
+	static_assert( ( S & Streams::Body ) != 0, "Body stream is not captured" );
+	return mFloorPlane.get();
+}
+
+template<uint32_t S>
+const ci::Channel16u& FrameT<S>::getInfrared() const
+{
+	static_assert( ( S & Streams::Infrared ) != 0, "Infrared stream is not captured" );
+	return mChannelInfrared.get();
+}
+
+template<uint32_t S>
+const ci::Channel16u& FrameT<S>::getInfraredLongExposure() const
+{
+	static_assert( ( S & Streams::InfraredLongExposure ) != 0, "Long exposure infrared stream is not captured" );
+	return mChannelInfraredLongExposure.get();
+}
+
+template<uint32_t S>
+long long FrameT<S>::getTimeStamp() const
+{
+	return mTimeStamp;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////
 
 typedef std::shared_ptr<Device>	DeviceRef;
@@ -210,24 +539,70 @@ class Device
 {
 public:
 	static DeviceRef							create();
+	// Needs no Cinder app. Drive the device with poll() or waitForFrame() 
+	// from your own loop or thread.
+	static DeviceRef							createHeadless();
 	~Device();
 	
 	void										start( const DeviceOptions& deviceOptions = DeviceOptions() );
 	void										stop();
 
+	// Audio is captured on its own thread when enabled in DeviceOptions.
+	const AudioBufferRef&						getAudioBuffer() const;
+	// Valid once the sensor has reported its calibration.
+	const CameraProjection&						getColorProjection() const;
+	const CameraProjection&						getDepthProjection() const;
 	ICoordinateMapper*							getCoordinateMapper() const;
+	// Tunes the change detection behind Frame::getDepthChanges(). Null 
+	// unless enabled in DeviceOptions.
+	const ChangeDetectorRef&					getDepthChangeDetector() const;
 	const DeviceOptions&						getDeviceOptions() const;
 	const Frame&								getFrame() const;
 	const ci::Vec4f&                            getFloorPlane() const;
 
+	// Writes the body set at "hostTime" (see getHostTime()) into "bodies". 
+	// Joints are interpolated between the last two body frames and 
+	// extrapolated along their velocity for at most "horizon" seconds past 
+	// the latest one. Bodies already in "bodies" are reused, so steady 
+	// state does not allocate.
+	void										getBodies( double hostTime, std::vector<Body>& bodies, double horizon = 0.05 ) const;
+
+	// Reads the latest frame through a capture path specialized on "S", 
+	// which must be a subset of the enabled streams. Other streams are 
+	// neither acquired nor stored. Returns false if no new frame was 
+	// ready. Instantiated in Kinect2.cpp for the sets update() dispatches to.
+	template<uint32_t S> bool					capture( FrameT<S>& frame );
+
+	// Reads the latest frame if the sensor has one ready. Returns true if 
+	// getFrame() changed. Runs on every app update unless headless.
+	bool										poll();
+	// Blocks until the sensor signals a frame or "timeoutMs" passes, then 
+	// polls.
+	bool										waitForFrame( uint32_t timeoutMs = INFINITE );
 protected:
-	Device();
+	Device( bool headless );
 
 	virtual void								update();
+	template<uint32_t S> bool					updateFrame();
+
+	void										startAudio();
+	void										stopAudio();
+	void										updateAudio();
 
 	std::function<void ( Frame frame )>			mEventHandler;
 	
+	AudioBufferRef								mAudioBuffer;
+	IAudioBeamFrameReader*						mAudioFrameReader;
+	WAITABLE_HANDLE								mAudioFrameEvent;
+	std::atomic<bool>							mAudioRunning;
+	HANDLE										mAudioStopEvent;
+	std::shared_ptr<std::thread>				mAudioThread;
+
+	CameraProjection							mColorProjection;
 	ICoordinateMapper*							mCoordinateMapper;
+	ChangeDetectorRef							mDepthChangeDetector;
+	CameraProjection							mDepthProjection;
+	WAITABLE_HANDLE								mFrameEvent;
 	IMultiSourceFrameReader*					mFrameReader;
 	IKinectSensor*								mSensor;
 	//WAITABLE_HANDLE							onSensorCollectionChanged();
@@ -236,6 +611,10 @@ protected:
 	Frame										mFrame;
 	ci::Vec4f                                   mFloorPlane;
 
+	std::vector<Body>							mBodiesPrevious;
+	long long									mBodyTimeStampPrevious;
+	double										mHostTimeOffset;
+
 public:
 
 	//////////////////////////////////////////////////////////////////////////////////////////////
@@ -284,6 +663,12 @@ public:
 	public:
 		ExcOpenFrameReaderFailed( long hr, const std::string& id ) throw();
 	};
+
+	class ExcOpenAudioReaderFailed : public Exception 
+	{
+	public:
+		ExcOpenAudioReaderFailed( long hr, const std::string& id ) throw();
+	};
 };
 
 }
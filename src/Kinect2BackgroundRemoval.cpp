@@ -0,0 +1,329 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2BackgroundRemoval.h"
+
+#include <cmath>
+#include <emmintrin.h>
+#include <ppl.h>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+static const size_t kCompositeBands = 8;
+
+// True if "surface" has its red, green and blue at these byte offsets
+static bool hasOffsets( const Surface8u& surface, int32_t red, int32_t green, int32_t blue )
+{
+	return surface.getRedOffset() == red && surface.getGreenOffset() == green && surface.getBlueOffset() == blue;
+}
+
+// Output keeps the color frame's byte order where it can, so the vector 
+// path applies.
+static Surface8u createOutput( const Surface8u& color, const Vec2i& size )
+{
+	return Surface8u( size.x, size.y, true, color.getBlueOffset() == 0 ? SurfaceChannelOrder::BGRA : SurfaceChannelOrder::RGBA );
+}
+
+BackgroundRemovalRef BackgroundRemoval::create( const CoordinateMapperRef& mapper, int32_t scale, const Vec2i& colorSize )
+{
+	return BackgroundRemovalRef( new BackgroundRemoval( mapper, scale, colorSize ) );
+}
+
+BackgroundRemoval::BackgroundRemoval( const CoordinateMapperRef& mapper, int32_t scale, const Vec2i& colorSize )
+: mColorSize( colorSize ), mFeather( 2.0f ), mHoleRadius( 1 ), mInset( 1.0f ), mMapper( mapper ), 
+mMaskFilter( MaskFilter::create() ), mScale( max( scale, 1 ) ), mUser( MaskFilter::Mask_Users )
+{
+	int32_t width	= ( mColorSize.x + mScale - 1 ) / mScale;
+	int32_t height	= ( mColorSize.y + mScale - 1 ) / mScale;
+	mColorPoints.resize( mMapper->getDepthWidth() * mMapper->getDepthHeight() );
+	mDepthGrid.resize( width * height );
+	mLabels	= Channel8u( width, height );
+	mMatte	= Channel8u( width, height );
+	memset( mMatte.getData(), 0, mMatte.getRowBytes() * height );
+
+	// Color column to the matte samples on either side, with the weight 
+	// of the right one in 1/256ths. Rows are computed the same way.
+	mColumnIndices.resize( mColorSize.x );
+	mColumnWeights.resize( mColorSize.x );
+	for ( int32_t x = 0; x < mColorSize.x; ++x ) {
+		float u				= min( max( ( (float)x + 0.5f ) / (float)mScale - 0.5f, 0.0f ), (float)( width - 1 ) );
+		int32_t i			= min( (int32_t)u, max( width - 2, 0 ) );
+		mColumnIndices[ x ]	= i;
+		mColumnWeights[ x ]	= (uint16_t)min( ( u - (float)i ) * 256.0f + 0.5f, 256.0f );
+	}
+}
+
+void BackgroundRemoval::update( const Channel16u& depth, const Channel8u& bodyIndex )
+{
+	int32_t depthWidth	= mMapper->getDepthWidth();
+	int32_t depthHeight	= mMapper->getDepthHeight();
+	int32_t width		= mLabels.getWidth();
+	int32_t height		= mLabels.getHeight();
+	if ( !depth || !bodyIndex || depth.getWidth() != depthWidth || depth.getHeight() != depthHeight || 
+		bodyIndex.getSize() != depth.getSize() ) {
+		memset( mMatte.getData(), 0, mMatte.getRowBytes() * height );
+		return;
+	}
+
+	// Each depth pixel covers the cells between its color position and 
+	// those of its right and lower neighbors, unless they are across a 
+	// depth edge. The nearest depth wins each cell.
+	mMapper->mapDepthFrameToColor( depth.getData(), &mColorPoints[ 0 ] );
+	for ( int32_t y = 0; y < height; ++y ) {
+		memset( mLabels.getData( Vec2i( 0, y ) ), 0xff, width );
+	}
+	fill( mDepthGrid.begin(), mDepthGrid.end(), (uint16_t)0xffff );
+
+	const float invScale	= 1.0f / (float)mScale;
+	const uint16_t edge		= 50;
+	const int32_t maxExtent	= 3;
+	for ( int32_t y = 0; y < depthHeight; ++y ) {
+		const uint16_t* d	= depth.getData( Vec2i( 0, y ) );
+		const uint8_t* b	= bodyIndex.getData( Vec2i( 0, y ) );
+		const Vec2f* p		= &mColorPoints[ y * depthWidth ];
+		for ( int32_t x = 0; x < depthWidth; ++x ) {
+			if ( d[ x ] == 0 ) {
+				continue;
+			}
+			float u1 = p[ x ].x * invScale;
+			float v1 = p[ x ].y * invScale;
+			float u2 = u1;
+			float v2 = v1;
+			if ( x + 1 < depthWidth && d[ x + 1 ] != 0 && abs( (int32_t)d[ x + 1 ] - (int32_t)d[ x ] ) < edge ) {
+				u2 = p[ x + 1 ].x * invScale;
+			}
+			if ( y + 1 < depthHeight && d[ x + depthWidth ] != 0 && abs( (int32_t)d[ x + depthWidth ] - (int32_t)d[ x ] ) < edge ) {
+				v2 = p[ x + depthWidth ].y * invScale;
+			}
+
+			int32_t x1 = (int32_t)floor( min( u1, u2 ) );
+			int32_t y1 = (int32_t)floor( min( v1, v2 ) );
+			int32_t x2 = min( (int32_t)floor( max( u1, u2 ) ), x1 + maxExtent );
+			int32_t y2 = min( (int32_t)floor( max( v1, v2 ) ), y1 + maxExtent );
+			x1 = max( x1, 0 );
+			y1 = max( y1, 0 );
+			x2 = min( x2, width - 1 );
+			y2 = min( y2, height - 1 );
+			for ( int32_t cy = y1; cy <= y2; ++cy ) {
+				uint16_t* z		= &mDepthGrid[ cy * width ];
+				uint8_t* label	= mLabels.getData( Vec2i( 0, cy ) );
+				for ( int32_t cx = x1; cx <= x2; ++cx ) {
+					if ( d[ x ] < z[ cx ] ) {
+						z[ cx ]		= d[ x ];
+						label[ cx ]	= b[ x ];
+					}
+				}
+			}
+		}
+	}
+
+	// Distances are to the centers of the nearest cells across the edge, 
+	// which lies half a cell closer.
+	mMaskFilter->close( mLabels, mMask, mHoleRadius, mUser );
+	mMaskFilter->calcDistance( mMask, mDistanceInside, true, MaskFilter::Mask_NonZero );
+	mMaskFilter->calcDistance( mMask, mDistanceOutside, false, MaskFilter::Mask_NonZero );
+	float scale		= (float)mScale;
+	float feather	= max( mFeather, 0.001f ) * 2.0f;
+	concurrency::parallel_for( 0, height, [ & ]( int32_t y )
+	{
+		const float* inside		= mDistanceInside.getData( Vec2i( 0, y ) );
+		const float* outside	= mDistanceOutside.getData( Vec2i( 0, y ) );
+		uint8_t* matte			= mMatte.getData( Vec2i( 0, y ) );
+		for ( int32_t x = 0; x < width; ++x ) {
+			float distance	= inside[ x ] > 0.0f ? inside[ x ] - 0.5f : 0.5f - outside[ x ];
+			float alpha		= ( distance * scale - mInset ) / feather + 0.5f;
+			matte[ x ]		= (uint8_t)( min( max( alpha, 0.0f ), 1.0f ) * 255.0f + 0.5f );
+		}
+	} );
+}
+
+// Per row, the two matte rows are blended vertically eight samples at a 
+// time, the result is sampled horizontally into a row of alpha, and four 
+// pixels at a time take that alpha or are blended with it. The vector path 
+// moves whole pixels, so it needs four byte pixels with the same color 
+// order everywhere and the output's alpha in the last byte. Anything else 
+// is swizzled one pixel at a time.
+template<bool blend>
+void BackgroundRemoval::compositeRows( const Surface8u& color, const Surface8u* background, Surface8u& output ) const
+{
+	int32_t width		= mColorSize.x;
+	int32_t height		= mColorSize.y;
+	int32_t matteWidth	= mMatte.getWidth();
+	int32_t matteHeight	= mMatte.getHeight();
+
+	int32_t srcInc				= color.getPixelInc();
+	int32_t bgInc				= blend ? background->getPixelInc() : 0;
+	int32_t dstInc				= output.getPixelInc();
+	const int32_t srcOffsets[]	= { color.getRedOffset(), color.getGreenOffset(), color.getBlueOffset() };
+	const int32_t bgOffsets[]	= { blend ? background->getRedOffset() : 0, blend ? background->getGreenOffset() : 0, blend ? background->getBlueOffset() : 0 };
+	const int32_t dstOffsets[]	= { output.getRedOffset(), output.getGreenOffset(), output.getBlueOffset() };
+	int32_t dstAlpha			= output.getAlphaOffset();
+	bool direct					= srcInc == 4 && dstInc == 4 && dstAlpha == 3 && 
+		hasOffsets( color, dstOffsets[ 0 ], dstOffsets[ 1 ], dstOffsets[ 2 ] ) && 
+		( !blend || ( bgInc == 4 && hasOffsets( *background, dstOffsets[ 0 ], dstOffsets[ 1 ], dstOffsets[ 2 ] ) ) );
+	concurrency::parallel_for( (size_t)0, kCompositeBands, [ & ]( size_t band )
+	{
+		vector<uint16_t> samples( matteWidth + 8 );
+		vector<uint8_t> alphas( width + 16 );
+		const __m128i zero		= _mm_setzero_si128();
+		const __m128i opaque	= _mm_set1_epi32( (int32_t)0xff000000 );
+		const __m128i rgb		= _mm_set1_epi32( 0x00ffffff );
+		const __m128i half		= _mm_set1_epi16( 128 );
+		const __m128i full		= _mm_set1_epi16( 255 );
+
+		int32_t y0 = (int32_t)( band * height / kCompositeBands );
+		int32_t y1 = (int32_t)( ( band + 1 ) * height / kCompositeBands );
+		for ( int32_t y = y0; y < y1; ++y ) {
+			float v				= min( max( ( (float)y + 0.5f ) / (float)mScale - 0.5f, 0.0f ), (float)( matteHeight - 1 ) );
+			int32_t row			= min( (int32_t)v, max( matteHeight - 2, 0 ) );
+			int32_t weight		= (int32_t)min( ( v - (float)row ) * 256.0f + 0.5f, 256.0f );
+			const uint8_t* m0	= mMatte.getData( Vec2i( 0, row ) );
+			const uint8_t* m1	= mMatte.getData( Vec2i( 0, min( row + 1, matteHeight - 1 ) ) );
+
+			__m128i w0 = _mm_set1_epi16( (int16_t)( 256 - weight ) );
+			__m128i w1 = _mm_set1_epi16( (int16_t)weight );
+			int32_t i = 0;
+			for ( ; i + 8 <= matteWidth; i += 8 ) {
+				__m128i a = _mm_unpacklo_epi8( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( m0 + i ) ), zero );
+				__m128i b = _mm_unpacklo_epi8( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( m1 + i ) ), zero );
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( &samples[ i ] ), 
+					_mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( a, w0 ), _mm_mullo_epi16( b, w1 ) ), 8 ) );
+			}
+			for ( ; i < matteWidth; ++i ) {
+				samples[ i ] = (uint16_t)( ( m0[ i ] * ( 256 - weight ) + m1[ i ] * weight ) >> 8 );
+			}
+			samples[ matteWidth ] = samples[ matteWidth - 1 ];
+
+			for ( int32_t x = 0; x < width; ++x ) {
+				int32_t j	= mColumnIndices[ x ];
+				int32_t k	= mColumnWeights[ x ];
+				alphas[ x ]	= (uint8_t)( ( samples[ j ] * ( 256 - k ) + samples[ j + 1 ] * k ) >> 8 );
+			}
+
+			const uint8_t* src	= color.getData( Vec2i( 0, y ) );
+			const uint8_t* bg	= blend ? background->getData( Vec2i( 0, y ) ) : 0;
+			uint8_t* dst		= output.getData( Vec2i( 0, y ) );
+			int32_t x = 0;
+			for ( ; direct && x + 4 <= width; x += 4 ) {
+				__m128i c		= _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + x * 4 ) );
+				__m128i a8		= _mm_cvtsi32_si128( *reinterpret_cast<const int32_t*>( &alphas[ x ] ) );
+				__m128i a32		= _mm_unpacklo_epi16( zero, _mm_unpacklo_epi8( zero, a8 ) );
+				__m128i result;
+				if ( blend ) {
+					// Alpha per channel as 16 bit words, two pixels per vector
+					__m128i aw		= _mm_srli_epi32( a32, 24 );
+					aw				= _mm_or_si128( aw, _mm_slli_epi32( aw, 16 ) );
+					__m128i aLo		= _mm_unpacklo_epi32( aw, aw );
+					__m128i aHi		= _mm_unpackhi_epi32( aw, aw );
+					__m128i b		= _mm_loadu_si128( reinterpret_cast<const __m128i*>( bg + x * 4 ) );
+					__m128i lo		= _mm_add_epi16( _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( c, zero ), aLo ), 
+						_mm_mullo_epi16( _mm_unpacklo_epi8( b, zero ), _mm_sub_epi16( full, aLo ) ) ), half );
+					__m128i hi		= _mm_add_epi16( _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( c, zero ), aHi ), 
+						_mm_mullo_epi16( _mm_unpackhi_epi8( b, zero ), _mm_sub_epi16( full, aHi ) ) ), half );
+
+					// x / 255 as ( x + ( x >> 8 ) ) >> 8
+					lo				= _mm_srli_epi16( _mm_add_epi16( lo, _mm_srli_epi16( lo, 8 ) ), 8 );
+					hi				= _mm_srli_epi16( _mm_add_epi16( hi, _mm_srli_epi16( hi, 8 ) ), 8 );
+					result			= _mm_or_si128( _mm_packus_epi16( lo, hi ), opaque );
+				} else {
+					result			= _mm_or_si128( _mm_and_si128( c, rgb ), a32 );
+				}
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( dst + x * 4 ), result );
+			}
+			for ( ; x < width; ++x ) {
+				uint32_t a			= alphas[ x ];
+				const uint8_t* s	= src + x * srcInc;
+				uint8_t* d			= dst + x * dstInc;
+				for ( int32_t ch = 0; ch < 3; ++ch ) {
+					uint32_t value			= blend ? s[ srcOffsets[ ch ] ] * a + bg[ x * bgInc + bgOffsets[ ch ] ] * ( 255 - a ) + 128 : s[ srcOffsets[ ch ] ];
+					d[ dstOffsets[ ch ] ]	= (uint8_t)( blend ? ( value + ( value >> 8 ) ) >> 8 : value );
+				}
+				if ( dstAlpha >= 0 ) {
+					d[ dstAlpha ] = blend ? 255 : (uint8_t)a;
+				}
+			}
+		}
+	} );
+}
+
+void BackgroundRemoval::composite( const Surface8u& color, Surface8u& output ) const
+{
+	if ( !color || color.getSize() != mColorSize ) {
+		return;
+	}
+	if ( !output || output.getSize() != mColorSize || output.getAlphaOffset() < 0 ) {
+		output = createOutput( color, mColorSize );
+	}
+	compositeRows<false>( color, 0, output );
+}
+
+void BackgroundRemoval::composite( const Surface8u& color, const Surface8u& background, Surface8u& output ) const
+{
+	if ( !color || color.getSize() != mColorSize || !background || background.getSize() != mColorSize ) {
+		return;
+	}
+	if ( !output || output.getSize() != mColorSize ) {
+		output = createOutput( color, mColorSize );
+	}
+	compositeRows<true>( color, &background, output );
+}
+
+const Channel8u& BackgroundRemoval::getMatte() const
+{
+	return mMatte;
+}
+
+void BackgroundRemoval::setFeather( float radius, float inset )
+{
+	mFeather	= radius;
+	mInset		= inset;
+}
+
+void BackgroundRemoval::setHoleRadius( int32_t radius )
+{
+	mHoleRadius = radius;
+}
+
+void BackgroundRemoval::setUser( int32_t user )
+{
+	mUser = user;
+}
+
+}
@@ -0,0 +1,109 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2CoordinateMapper.h"
+#include "Kinect2MaskFilter.h"
+
+namespace Kinect2 {
+
+class BackgroundRemoval;
+typedef std::shared_ptr<BackgroundRemoval>	BackgroundRemovalRef;
+
+// Cuts users out of the full resolution color frame. update() splats the 
+// body index into a color space matte at a fraction of the color 
+// resolution. It uses the mapper's cached depth to color tables and a 
+// depth test, so nearer objects still occlude users. It then closes small 
+// holes and feathers the edge by signed distance. composite() upsamples 
+// the matte row by row and writes it as the alpha of the output surface, 
+// or blends over a background.
+class BackgroundRemoval
+{
+public:
+	// The matte is the color frame's size divided by "scale".
+	static BackgroundRemovalRef					create( const CoordinateMapperRef& mapper, int32_t scale = 4, 
+												const ci::Vec2i& colorSize = ci::Vec2i( 1920, 1080 ) );
+
+	void										update( const ci::Channel16u& depth, const ci::Channel8u& bodyIndex );
+
+	// Copies "color" into "output" with the matte as alpha. Surfaces may 
+	// use any channel order; RGBA or BGRA throughout is fastest. "output" 
+	// is replaced by one in the color frame's order if it lacks alpha or 
+	// has the wrong size.
+	void										composite( const ci::Surface8u& color, ci::Surface8u& output ) const;
+	// Blends "color" over "background", which must have the color 
+	// frame's size. "output" may be "background".
+	void										composite( const ci::Surface8u& color, const ci::Surface8u& background, ci::Surface8u& output ) const;
+
+	// Alpha at matte resolution
+	const ci::Channel8u&						getMatte() const;
+
+	// The alpha ramp is twice "radius" wide, in color pixels, centered 
+	// "inset" pixels inside the body index edge. A small inset hides the 
+	// background fringe left by depth to color misalignment.
+	void										setFeather( float radius, float inset = 0.0f );
+	// Holes and gaps up to twice "radius" matte pixels wide are closed.
+	void										setHoleRadius( int32_t radius );
+	// A body index value, or MaskFilter::Mask_Users for all users
+	void										setUser( int32_t user );
+protected:
+	BackgroundRemoval( const CoordinateMapperRef& mapper, int32_t scale, const ci::Vec2i& colorSize );
+
+	template<bool blend>
+	void										compositeRows( const ci::Surface8u& color, const ci::Surface8u* background, ci::Surface8u& output ) const;
+
+	ci::Vec2i									mColorSize;
+	std::vector<ci::Vec2f>						mColorPoints;
+	std::vector<int32_t>						mColumnIndices;
+	std::vector<uint16_t>						mColumnWeights;
+	std::vector<uint16_t>						mDepthGrid;
+	ci::Channel32f								mDistanceInside;
+	ci::Channel32f								mDistanceOutside;
+	float										mFeather;
+	int32_t										mHoleRadius;
+	float										mInset;
+	ci::Channel8u								mLabels;
+	CoordinateMapperRef							mMapper;
+	ci::Channel8u								mMask;
+	MaskFilterRef								mMaskFilter;
+	ci::Channel8u								mMatte;
+	int32_t										mScale;
+	int32_t										mUser;
+};
+
+}
@@ -0,0 +1,670 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2BodyBroadcast.h"
+
+#include <ws2tcpip.h>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+static const uint32_t kBodyMagic			= 0xb7;
+static const uint32_t kBodyQuatOffset		= 3 + ( JointType_Count - 1 ) * 3;
+static const uint32_t kBodyRelativeBits		= 11;
+static const float kBodyRelativeScale		= 500.0f;
+static const float kBodyRootScale			= 1000.0f;
+static const float kBodySqrtHalf			= 0.70710678f;
+// Packets this far behind the last one are late or duplicated. Anything 
+// further back means the broadcaster restarted.
+static const int16_t kBodyReorderWindow		= 64;
+
+// Leaf joints carry no orientation.
+static bool hasOrientation( uint32_t joint )
+{
+	return joint != JointType_Head && joint != JointType_FootLeft && joint != JointType_FootRight && 
+		joint != JointType_HandTipLeft && joint != JointType_ThumbLeft && 
+		joint != JointType_HandTipRight && joint != JointType_ThumbRight;
+}
+
+static int32_t quantize( float v, float scale, int32_t bits )
+{
+	int32_t limit = ( 1 << ( bits - 1 ) ) - 1;
+	return max( -limit, min( limit, (int32_t)floor( v * scale + 0.5f ) ) );
+}
+
+static void quantizeBody( const Body& body, BodyCodec::QuantizedBody& q )
+{
+	q.mId				= body.getId();
+	q.mIndex			= body.getIndex();
+	q.mLeftHandState	= (uint8_t)body.getLeftHandState();
+	q.mRightHandState	= (uint8_t)body.getRightHandState();
+	memset( q.mLargest, 0, sizeof( q.mLargest ) );
+	memset( q.mTrackingStates, 0, sizeof( q.mTrackingStates ) );
+	memset( q.mValues, 0, sizeof( q.mValues ) );
+
+	const map<JointType, Body::Joint>& jointMap = body.getJointMap();
+	map<JointType, Body::Joint>::const_iterator root = jointMap.find( JointType_SpineBase );
+	Vec3f origin = Vec3f::zero();
+	if ( root != jointMap.end() ) {
+		const Vec3f& p = root->second.getPosition();
+		q.mValues[ 0 ] = quantize( p.x, kBodyRootScale, 16 );
+		q.mValues[ 1 ] = quantize( p.y, kBodyRootScale, 16 );
+		q.mValues[ 2 ] = quantize( p.z, kBodyRootScale, 16 );
+		origin = Vec3f( (float)q.mValues[ 0 ], (float)q.mValues[ 1 ], (float)q.mValues[ 2 ] ) / kBodyRootScale;
+	}
+
+	for ( map<JointType, Body::Joint>::const_iterator iter = jointMap.begin(); iter != jointMap.end(); ++iter ) {
+		uint32_t j = (uint32_t)iter->first;
+		if ( j >= JointType_Count ) {
+			continue;
+		}
+		q.mTrackingStates[ j ] = (uint8_t)iter->second.getTrackingState();
+		if ( j > 0 ) {
+			Vec3f p		= iter->second.getPosition() - origin;
+			int32_t* v	= q.mValues + 3 + ( j - 1 ) * 3;
+			v[ 0 ]		= quantize( p.x, kBodyRelativeScale, kBodyRelativeBits );
+			v[ 1 ]		= quantize( p.y, kBodyRelativeScale, kBodyRelativeBits );
+			v[ 2 ]		= quantize( p.z, kBodyRelativeScale, kBodyRelativeBits );
+		}
+		if ( hasOrientation( j ) ) {
+
+			// Smallest three: drop the largest component, made positive, 
+			// and rebuild it from the unit length.
+			const Quatf& o	= iter->second.getOrientation();
+			float c[]		= { o.w, o.v.x, o.v.y, o.v.z };
+			float length	= sqrt( c[ 0 ] * c[ 0 ] + c[ 1 ] * c[ 1 ] + c[ 2 ] * c[ 2 ] + c[ 3 ] * c[ 3 ] );
+			if ( length < 1.0e-6f ) {
+				c[ 0 ] = 1.0f;
+				c[ 1 ] = c[ 2 ] = c[ 3 ] = 0.0f;
+				length = 1.0f;
+			}
+			uint8_t largest = 0;
+			for ( uint8_t i = 1; i < 4; ++i ) {
+				if ( fabs( c[ i ] ) > fabs( c[ largest ] ) ) {
+					largest = i;
+				}
+			}
+			float sign		= c[ largest ] < 0.0f ? -1.0f : 1.0f;
+			int32_t* v		= q.mValues + kBodyQuatOffset + j * 3;
+			q.mLargest[ j ]	= largest;
+			for ( uint8_t i = 0, k = 0; i < 4; ++i ) {
+				if ( i != largest ) {
+					float n		= ( sign * c[ i ] / length / kBodySqrtHalf + 1.0f ) * 127.5f;
+					v[ k++ ]	= max( 0, min( 255, (int32_t)floor( n + 0.5f ) ) );
+				}
+			}
+		}
+	}
+}
+
+// Small differences dominate between keyframes: 5 bits up to +-8, 10 bits 
+// up to +-128, 19 bits beyond.
+static void writeDelta( StreamCodec::BitWriter& writer, int32_t d )
+{
+	uint32_t u = (uint32_t)( ( d << 1 ) ^ ( d >> 31 ) );
+	if ( u < 16 ) {
+		writer.write( u, 5 );
+	} else if ( u < 256 ) {
+		writer.write( 2, 2 );
+		writer.write( u, 8 );
+	} else {
+		writer.write( 3, 2 );
+		writer.write( u, 17 );
+	}
+}
+
+static int32_t readDelta( StreamCodec::BitReader& reader )
+{
+	uint32_t u = 0;
+	if ( reader.read( 1 ) == 0 ) {
+		u = reader.read( 4 );
+	} else if ( reader.read( 1 ) == 0 ) {
+		u = reader.read( 8 );
+	} else {
+		u = reader.read( 17 );
+	}
+	return (int32_t)( u >> 1 ) ^ -(int32_t)( u & 1 );
+}
+
+static const BodyCodec::QuantizedBody* findBody( const vector<BodyCodec::QuantizedBody>& bodies, uint64_t id )
+{
+	for ( vector<BodyCodec::QuantizedBody>::const_iterator iter = bodies.begin(); iter != bodies.end(); ++iter ) {
+		if ( iter->mId == id ) {
+			return &( *iter );
+		}
+	}
+	return 0;
+}
+
+static int32_t toSigned( uint32_t v, uint32_t bits )
+{
+	return (int32_t)( v << ( 32 - bits ) ) >> ( 32 - bits );
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+BodyEncoder::BodyEncoder( uint32_t keyframeInterval )
+: mFramesSinceKeyframe( 0 ), mKeyframeInterval( max<uint32_t>( keyframeInterval, 1 ) ), mKeyframeRequested( true ), 
+mKeySequence( 0 ), mSequence( 0 )
+{
+}
+
+void BodyEncoder::encode( const vector<Body>& bodies, long long timeStamp, vector<uint8_t>& buffer )
+{
+	mQuantized.clear();
+	for ( vector<Body>::const_iterator iter = bodies.begin(); iter != bodies.end() && mQuantized.size() < BODY_COUNT; ++iter ) {
+		if ( iter->isTracked() ) {
+			mQuantized.push_back( BodyCodec::QuantizedBody() );
+			quantizeBody( *iter, mQuantized.back() );
+		}
+	}
+
+	// Deltas need every body in the keyframe.
+	bool keyframe = mKeyframeRequested || ++mFramesSinceKeyframe >= mKeyframeInterval;
+	for ( vector<BodyCodec::QuantizedBody>::const_iterator iter = mQuantized.begin(); iter != mQuantized.end() && !keyframe; ++iter ) {
+		keyframe = findBody( mKeyframe, iter->mId ) == 0;
+	}
+
+	buffer.clear();
+	StreamCodec::BitWriter writer( buffer );
+	writer.write( kBodyMagic, 8 );
+	writer.write( keyframe ? 1 : 0, 1 );
+	writer.write( (uint32_t)mQuantized.size(), 3 );
+	writer.write( mSequence, 16 );
+	if ( !keyframe ) {
+		writer.write( mKeySequence, 16 );
+	}
+	writer.write( (uint32_t)( (uint64_t)timeStamp >> 32 ), 32 );
+	writer.write( (uint32_t)timeStamp, 32 );
+
+	for ( vector<BodyCodec::QuantizedBody>::const_iterator iter = mQuantized.begin(); iter != mQuantized.end(); ++iter ) {
+		const BodyCodec::QuantizedBody& q = *iter;
+		writer.write( (uint32_t)( q.mId >> 32 ), 32 );
+		writer.write( (uint32_t)q.mId, 32 );
+		writer.write( q.mIndex, 3 );
+		writer.write( q.mLeftHandState, 3 );
+		writer.write( q.mRightHandState, 3 );
+		for ( uint32_t j = 0; j < JointType_Count; ++j ) {
+			writer.write( q.mTrackingStates[ j ], 2 );
+		}
+
+		if ( keyframe ) {
+			for ( uint32_t i = 0; i < 3; ++i ) {
+				writer.write( (uint32_t)q.mValues[ i ], 16 );
+			}
+			for ( uint32_t i = 3; i < kBodyQuatOffset; ++i ) {
+				writer.write( (uint32_t)q.mValues[ i ], kBodyRelativeBits );
+			}
+			for ( uint32_t j = 0; j < JointType_Count; ++j ) {
+				if ( hasOrientation( j ) ) {
+					const int32_t* v = q.mValues + kBodyQuatOffset + j * 3;
+					writer.write( q.mLargest[ j ], 2 );
+					writer.write( ( v[ 0 ] << 16 ) | ( v[ 1 ] << 8 ) | v[ 2 ], 24 );
+				}
+			}
+		} else {
+			const BodyCodec::QuantizedBody& key = *findBody( mKeyframe, q.mId );
+			for ( uint32_t i = 0; i < kBodyQuatOffset; ++i ) {
+				writeDelta( writer, q.mValues[ i ] - key.mValues[ i ] );
+			}
+			for ( uint32_t j = 0; j < JointType_Count; ++j ) {
+				if ( hasOrientation( j ) ) {
+					const int32_t* v	= q.mValues + kBodyQuatOffset + j * 3;
+					const int32_t* k	= key.mValues + kBodyQuatOffset + j * 3;
+					if ( q.mLargest[ j ] == key.mLargest[ j ] ) {
+						writer.write( 0, 1 );
+						writeDelta( writer, v[ 0 ] - k[ 0 ] );
+						writeDelta( writer, v[ 1 ] - k[ 1 ] );
+						writeDelta( writer, v[ 2 ] - k[ 2 ] );
+					} else {
+						writer.write( 1, 1 );
+						writer.write( q.mLargest[ j ], 2 );
+						writer.write( ( v[ 0 ] << 16 ) | ( v[ 1 ] << 8 ) | v[ 2 ], 24 );
+					}
+				}
+			}
+		}
+	}
+	writer.flush();
+
+	if ( keyframe ) {
+		mKeyframe				= mQuantized;
+		mKeySequence			= mSequence;
+		mKeyframeRequested		= false;
+		mFramesSinceKeyframe	= 0;
+	}
+	++mSequence;
+}
+
+void BodyEncoder::requestKeyframe()
+{
+	mKeyframeRequested = true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+BodyDecoder::BodyDecoder()
+: mKeyframeValid( false ), mKeySequence( 0 ), mLastSequence( 0 ), mLostCount( 0 ), mSequenceValid( false ), 
+mUndecodableCount( 0 )
+{
+}
+
+void BodyDecoder::dequantize( const BodyCodec::QuantizedBody& q, Body& body )
+{
+	body.mId				= q.mId;
+	body.mIndex				= q.mIndex;
+	body.mLeftHandState		= (HandState)q.mLeftHandState;
+	body.mRightHandState	= (HandState)q.mRightHandState;
+	body.mTracked			= true;
+
+	Vec3f origin = Vec3f( (float)q.mValues[ 0 ], (float)q.mValues[ 1 ], (float)q.mValues[ 2 ] ) / kBodyRootScale;
+	for ( uint32_t j = 0; j < JointType_Count; ++j ) {
+		Vec3f position = origin;
+		if ( j > 0 ) {
+			const int32_t* v	= q.mValues + 3 + ( j - 1 ) * 3;
+			position			+= Vec3f( (float)v[ 0 ], (float)v[ 1 ], (float)v[ 2 ] ) / kBodyRelativeScale;
+		}
+
+		Quatf orientation( 0.0f, 0.0f, 0.0f, 0.0f );
+		if ( hasOrientation( j ) ) {
+			const int32_t* v	= q.mValues + kBodyQuatOffset + j * 3;
+			float c[ 4 ];
+			float sum			= 0.0f;
+			for ( uint8_t i = 0, k = 0; i < 4; ++i ) {
+				if ( i != q.mLargest[ j ] ) {
+					c[ i ]	= ( (float)v[ k++ ] / 127.5f - 1.0f ) * kBodySqrtHalf;
+					sum		+= c[ i ] * c[ i ];
+				}
+			}
+			c[ q.mLargest[ j ] ]	= sqrt( max( 0.0f, 1.0f - sum ) );
+			orientation				= Quatf( c[ 0 ], c[ 1 ], c[ 2 ], c[ 3 ] );
+		}
+
+		Body::Joint& joint		= body.mJointMap[ (JointType)j ];
+		joint.mOrientation		= orientation;
+		joint.mPosition			= position;
+		joint.mTrackingState	= (TrackingState)q.mTrackingStates[ j ];
+	}
+}
+
+bool BodyDecoder::decode( const uint8_t* data, size_t size, vector<Body>& bodies, long long& timeStamp )
+{
+	StreamCodec::BitReader reader( data, size );
+	if ( reader.read( 8 ) != kBodyMagic ) {
+		return false;
+	}
+	bool keyframe		= reader.read( 1 ) != 0;
+	uint32_t count		= reader.read( 3 );
+	uint16_t sequence	= (uint16_t)reader.read( 16 );
+	uint16_t keySequence = keyframe ? sequence : (uint16_t)reader.read( 16 );
+	uint64_t time		= (uint64_t)reader.read( 32 ) << 32;
+	time				|= reader.read( 32 );
+	if ( count > BODY_COUNT || reader.isOverrun() ) {
+		return false;
+	}
+
+	// A keyframe always resyncs, so a restarted broadcaster is picked up 
+	// at its first keyframe even if its sequence is behind the old one.
+	if ( mSequenceValid ) {
+		int16_t gap = (int16_t)( sequence - mLastSequence );
+		if ( gap > 0 ) {
+			mLostCount += gap - 1;
+		} else if ( keyframe || gap <= -kBodyReorderWindow ) {
+			mKeyframeValid	= false;
+			mSequenceValid	= false;
+		} else {
+			return false;
+		}
+	}
+	mLastSequence	= sequence;
+	mSequenceValid	= true;
+	if ( !keyframe && ( !mKeyframeValid || keySequence != mKeySequence ) ) {
+		++mUndecodableCount;
+		return false;
+	}
+
+	mQuantized.resize( count );
+	for ( uint32_t b = 0; b < count; ++b ) {
+		BodyCodec::QuantizedBody& q = mQuantized[ b ];
+		q.mId				= (uint64_t)reader.read( 32 ) << 32;
+		q.mId				|= reader.read( 32 );
+		q.mIndex			= (uint8_t)reader.read( 3 );
+		q.mLeftHandState	= (uint8_t)reader.read( 3 );
+		q.mRightHandState	= (uint8_t)reader.read( 3 );
+		for ( uint32_t j = 0; j < JointType_Count; ++j ) {
+			q.mTrackingStates[ j ]	= (uint8_t)reader.read( 2 );
+			q.mLargest[ j ]			= 0;
+		}
+		memset( q.mValues, 0, sizeof( q.mValues ) );
+
+		if ( keyframe ) {
+			for ( uint32_t i = 0; i < 3; ++i ) {
+				q.mValues[ i ] = toSigned( reader.read( 16 ), 16 );
+			}
+			for ( uint32_t i = 3; i < kBodyQuatOffset; ++i ) {
+				q.mValues[ i ] = toSigned( reader.read( kBodyRelativeBits ), kBodyRelativeBits );
+			}
+			for ( uint32_t j = 0; j < JointType_Count; ++j ) {
+				if ( hasOrientation( j ) ) {
+					int32_t* v		= q.mValues + kBodyQuatOffset + j * 3;
+					q.mLargest[ j ]	= (uint8_t)reader.read( 2 );
+					uint32_t packed	= reader.read( 24 );
+					v[ 0 ]			= ( packed >> 16 ) & 0xff;
+					v[ 1 ]			= ( packed >> 8 ) & 0xff;
+					v[ 2 ]			= packed & 0xff;
+				}
+			}
+		} else {
+			const BodyCodec::QuantizedBody* key = findBody( mKeyframe, q.mId );
+			if ( key == 0 ) {
+				++mUndecodableCount;
+				return false;
+			}
+			for ( uint32_t i = 0; i < kBodyQuatOffset; ++i ) {
+				q.mValues[ i ] = key->mValues[ i ] + readDelta( reader );
+			}
+			for ( uint32_t j = 0; j < JointType_Count; ++j ) {
+				if ( hasOrientation( j ) ) {
+					int32_t* v			= q.mValues + kBodyQuatOffset + j * 3;
+					const int32_t* k	= key->mValues + kBodyQuatOffset + j * 3;
+					if ( reader.read( 1 ) == 0 ) {
+						q.mLargest[ j ]	= key->mLargest[ j ];
+						v[ 0 ]			= k[ 0 ] + readDelta( reader );
+						v[ 1 ]			= k[ 1 ] + readDelta( reader );
+						v[ 2 ]			= k[ 2 ] + readDelta( reader );
+					} else {
+						q.mLargest[ j ]	= (uint8_t)reader.read( 2 );
+						uint32_t packed	= reader.read( 24 );
+						v[ 0 ]			= ( packed >> 16 ) & 0xff;
+						v[ 1 ]			= ( packed >> 8 ) & 0xff;
+						v[ 2 ]			= packed & 0xff;
+					}
+				}
+			}
+		}
+	}
+	if ( reader.isOverrun() ) {
+		return false;
+	}
+
+	if ( keyframe ) {
+		mKeyframe		= mQuantized;
+		mKeySequence	= sequence;
+		mKeyframeValid	= true;
+	}
+
+	bodies.resize( count );
+	for ( uint32_t b = 0; b < count; ++b ) {
+		dequantize( mQuantized[ b ], bodies[ b ] );
+	}
+	timeStamp = (long long)time;
+	return true;
+}
+
+uint64_t BodyDecoder::getLostCount() const
+{
+	return mLostCount;
+}
+
+uint64_t BodyDecoder::getUndecodableCount() const
+{
+	return mUndecodableCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+BodyBroadcaster::Stats::Stats()
+: mBytes( 0 ), mDropped( 0 ), mEncodeTime( 0.0 ), mPackets( 0 )
+{
+}
+
+BodyBroadcasterRef BodyBroadcaster::create( const string& address, uint16_t port, uint32_t keyframeInterval )
+{
+	return BodyBroadcasterRef( new BodyBroadcaster( address, port, keyframeInterval ) );
+}
+
+BodyBroadcaster::BodyBroadcaster( const string& address, uint16_t port, uint32_t keyframeInterval )
+: mEncoder( keyframeInterval ), mPending( false ), mRunning( true ), mSocket( INVALID_SOCKET ), mTimeStamp( 0L )
+{
+	WSADATA data;
+	int32_t error = WSAStartup( MAKEWORD( 2, 2 ), &data );
+	if ( error != 0 ) {
+		throw StreamServer::ExcSocketFailed( "WSAStartup", error );
+	}
+
+	memset( &mAddress, 0, sizeof( mAddress ) );
+	mAddress.sin_family	= AF_INET;
+	mAddress.sin_port	= htons( port );
+	if ( inet_pton( AF_INET, address.c_str(), &mAddress.sin_addr ) != 1 ) {
+		WSACleanup();
+		throw StreamServer::ExcSocketFailed( "inet_pton", 0 );
+	}
+
+	mSocket = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	if ( mSocket == INVALID_SOCKET ) {
+		error = WSAGetLastError();
+		WSACleanup();
+		throw StreamServer::ExcSocketFailed( "socket", error );
+	}
+	if ( ( ntohl( mAddress.sin_addr.s_addr ) >> 28 ) == 0xe ) {
+		int32_t ttl = 1;
+		setsockopt( mSocket, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&ttl, sizeof( ttl ) );
+	} else {
+		int32_t broadcast = 1;
+		setsockopt( mSocket, SOL_SOCKET, SO_BROADCAST, (const char*)&broadcast, sizeof( broadcast ) );
+	}
+
+	mThread = shared_ptr<thread>( new thread( bind( &BodyBroadcaster::run, this ) ) );
+}
+
+BodyBroadcaster::~BodyBroadcaster()
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		mRunning = false;
+	}
+	mCondition.notify_all();
+	mThread->join();
+	closesocket( mSocket );
+	WSACleanup();
+}
+
+void BodyBroadcaster::send( const vector<Body>& bodies, long long timeStamp )
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		if ( mPending ) {
+			++mStats.mDropped;
+		}
+		mBodies		= bodies;
+		mPending	= true;
+		mTimeStamp	= timeStamp;
+	}
+	mCondition.notify_one();
+}
+
+BodyBroadcaster::Stats BodyBroadcaster::getStats() const
+{
+	lock_guard<mutex> lock( mMutex );
+	return mStats;
+}
+
+void BodyBroadcaster::run()
+{
+	vector<Body> bodies;
+	vector<uint8_t> buffer;
+	while ( true ) {
+		long long timeStamp = 0L;
+		{
+			unique_lock<mutex> lock( mMutex );
+			while ( mRunning && !mPending ) {
+				mCondition.wait( lock );
+			}
+			if ( !mRunning ) {
+				break;
+			}
+			bodies.swap( mBodies );
+			mPending	= false;
+			timeStamp	= mTimeStamp;
+		}
+
+		double start = getHostTime();
+		mEncoder.encode( bodies, timeStamp, buffer );
+		double elapsed = getHostTime() - start;
+
+		int32_t count = sendto( mSocket, (const char*)&buffer[ 0 ], (int32_t)buffer.size(), 0, 
+			(const sockaddr*)&mAddress, sizeof( mAddress ) );
+		
+		lock_guard<mutex> lock( mMutex );
+		if ( count > 0 ) {
+			mStats.mBytes += count;
+			++mStats.mPackets;
+		} else {
+			++mStats.mDropped;
+		}
+		mStats.mEncodeTime = mStats.mEncodeTime == 0.0 ? elapsed : mStats.mEncodeTime * 0.95 + elapsed * 0.05;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+BodyReceiverRef BodyReceiver::create( uint16_t port, const string& multicastGroup )
+{
+	return BodyReceiverRef( new BodyReceiver( port, multicastGroup ) );
+}
+
+BodyReceiver::BodyReceiver( uint16_t port, const string& multicastGroup )
+: mNew( false ), mRunning( true ), mSocket( INVALID_SOCKET ), mTimeStamp( 0L )
+{
+	WSADATA data;
+	int32_t error = WSAStartup( MAKEWORD( 2, 2 ), &data );
+	if ( error != 0 ) {
+		throw StreamServer::ExcSocketFailed( "WSAStartup", error );
+	}
+
+	mSocket = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	if ( mSocket == INVALID_SOCKET ) {
+		error = WSAGetLastError();
+		WSACleanup();
+		throw StreamServer::ExcSocketFailed( "socket", error );
+	}
+	int32_t reuse = 1;
+	setsockopt( mSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof( reuse ) );
+
+	sockaddr_in address;
+	memset( &address, 0, sizeof( address ) );
+	address.sin_family		= AF_INET;
+	address.sin_addr.s_addr	= htonl( INADDR_ANY );
+	address.sin_port		= htons( port );
+	if ( ::bind( mSocket, (const sockaddr*)&address, sizeof( address ) ) == SOCKET_ERROR ) {
+		error = WSAGetLastError();
+		closesocket( mSocket );
+		WSACleanup();
+		throw StreamServer::ExcSocketFailed( "bind", error );
+	}
+
+	if ( !multicastGroup.empty() ) {
+		ip_mreq request;
+		memset( &request, 0, sizeof( request ) );
+		request.imr_interface.s_addr = htonl( INADDR_ANY );
+		if ( inet_pton( AF_INET, multicastGroup.c_str(), &request.imr_multiaddr ) != 1 || 
+			setsockopt( mSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&request, sizeof( request ) ) == SOCKET_ERROR ) {
+			error = WSAGetLastError();
+			closesocket( mSocket );
+			WSACleanup();
+			throw StreamServer::ExcSocketFailed( "IP_ADD_MEMBERSHIP", error );
+		}
+	}
+
+	mThread = shared_ptr<thread>( new thread( bind( &BodyReceiver::run, this ) ) );
+}
+
+BodyReceiver::~BodyReceiver()
+{
+	mRunning = false;
+	shutdown( mSocket, SD_BOTH );
+	closesocket( mSocket );
+	mThread->join();
+	WSACleanup();
+}
+
+bool BodyReceiver::getBodies( vector<Body>& bodies )
+{
+	lock_guard<mutex> lock( mMutex );
+	if ( !mNew ) {
+		return false;
+	}
+	bodies	= mBodies;
+	mNew	= false;
+	return true;
+}
+
+long long BodyReceiver::getTimeStamp() const
+{
+	lock_guard<mutex> lock( mMutex );
+	return mTimeStamp;
+}
+
+uint64_t BodyReceiver::getLostCount() const
+{
+	lock_guard<mutex> lock( mMutex );
+	return mDecoder.getLostCount() + mDecoder.getUndecodableCount();
+}
+
+void BodyReceiver::run()
+{
+	vector<uint8_t> buffer( 2048 );
+	vector<Body> bodies;
+	while ( mRunning ) {
+		int32_t count = recvfrom( mSocket, (char*)&buffer[ 0 ], (int32_t)buffer.size(), 0, 0, 0 );
+		if ( count <= 0 ) {
+			continue;
+		}
+
+		lock_guard<mutex> lock( mMutex );
+		long long timeStamp = 0L;
+		if ( mDecoder.decode( &buffer[ 0 ], count, bodies, timeStamp ) ) {
+			mBodies.swap( bodies );
+			mNew		= true;
+			mTimeStamp	= timeStamp;
+		}
+	}
+}
+
+}
@@ -0,0 +1,189 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2Stream.h"
+
+namespace Kinect2 {
+
+class BodyBroadcaster;
+class BodyReceiver;
+typedef std::shared_ptr<BodyBroadcaster>	BodyBroadcasterRef;
+typedef std::shared_ptr<BodyReceiver>		BodyReceiverRef;
+
+// Compact binary body protocol. The root joint is quantized to 1mm and 
+// the others to 2mm relative to it, orientations use the smallest-three 
+// encoding and joint and hand states are bit-packed. Packets between 
+// keyframes only carry differences against the last keyframe. A keyframe 
+// body is about 180 bytes; deltas shrink with the motion since then.
+namespace BodyCodec
+{
+	static const uint32_t kValueCount = 3 + ( JointType_Count - 1 ) * 3 + JointType_Count * 3;
+
+	struct QuantizedBody
+	{
+		uint64_t								mId;
+		uint8_t									mIndex;
+		uint8_t									mLargest[ JointType_Count ];
+		uint8_t									mLeftHandState;
+		uint8_t									mRightHandState;
+		uint8_t									mTrackingStates[ JointType_Count ];
+		int32_t									mValues[ kValueCount ];
+	};
+}
+
+class BodyEncoder
+{
+public:
+	BodyEncoder( uint32_t keyframeInterval = 15 );
+
+	// Replaces the contents of "buffer" with one packet. Untracked bodies 
+	// are skipped.
+	void										encode( const std::vector<Body>& bodies, long long timeStamp, std::vector<uint8_t>& buffer );
+	// Forces the next packet to be a keyframe.
+	void										requestKeyframe();
+protected:
+	uint32_t									mFramesSinceKeyframe;
+	std::vector<BodyCodec::QuantizedBody>		mKeyframe;
+	uint32_t									mKeyframeInterval;
+	bool										mKeyframeRequested;
+	uint16_t									mKeySequence;
+	std::vector<BodyCodec::QuantizedBody>		mQuantized;
+	uint16_t									mSequence;
+};
+
+class BodyDecoder
+{
+public:
+	BodyDecoder();
+
+	// Rebuilds "bodies" from a packet, reusing existing entries. Returns 
+	// false if the packet is malformed, late or duplicated, or refers to a 
+	// keyframe that was lost. A keyframe or a jump far back in the 
+	// sequence, e.g. after the broadcaster restarts, starts over.
+	bool										decode( const uint8_t* data, size_t size, std::vector<Body>& bodies, long long& timeStamp );
+
+	// Packets missing from the sequence, and packets dropped for lack of a keyframe
+	uint64_t									getLostCount() const;
+	uint64_t									getUndecodableCount() const;
+protected:
+	static void									dequantize( const BodyCodec::QuantizedBody& q, Body& body );
+
+	std::vector<BodyCodec::QuantizedBody>		mKeyframe;
+	bool										mKeyframeValid;
+	uint16_t									mKeySequence;
+	uint16_t									mLastSequence;
+	uint64_t									mLostCount;
+	std::vector<BodyCodec::QuantizedBody>		mQuantized;
+	bool										mSequenceValid;
+	uint64_t									mUndecodableCount;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+// Encodes and sends bodies on its own thread. Use a multicast group 
+// (224.0.0.0/4) or a broadcast address. send() keeps only the latest bodies 
+// if the thread falls behind.
+class BodyBroadcaster
+{
+public:
+	static BodyBroadcasterRef					create( const std::string& address = "255.255.255.255", uint16_t port = 7020, 
+												uint32_t keyframeInterval = 15 );
+	~BodyBroadcaster();
+
+	void										send( const std::vector<Body>& bodies, long long timeStamp );
+
+	struct Stats
+	{
+		Stats();
+
+		uint64_t								mBytes;
+		uint64_t								mDropped;
+		// Smoothed seconds spent encoding one packet
+		double									mEncodeTime;
+		uint64_t								mPackets;
+	};
+
+	Stats										getStats() const;
+protected:
+	BodyBroadcaster( const std::string& address, uint16_t port, uint32_t keyframeInterval );
+
+	void										run();
+
+	sockaddr_in									mAddress;
+	std::vector<Body>							mBodies;
+	std::condition_variable						mCondition;
+	BodyEncoder									mEncoder;
+	mutable std::mutex							mMutex;
+	bool										mPending;
+	bool										mRunning;
+	SOCKET										mSocket;
+	Stats										mStats;
+	std::shared_ptr<std::thread>				mThread;
+	long long									mTimeStamp;
+};
+
+// Receives body packets on its own thread. Leave "multicastGroup" empty 
+// for broadcast.
+class BodyReceiver
+{
+public:
+	static BodyReceiverRef						create( uint16_t port = 7020, const std::string& multicastGroup = "" );
+	~BodyReceiver();
+
+	// Copies the latest bodies. Returns false if nothing arrived since the 
+	// last call.
+	bool										getBodies( std::vector<Body>& bodies );
+	long long									getTimeStamp() const;
+	uint64_t									getLostCount() const;
+protected:
+	BodyReceiver( uint16_t port, const std::string& multicastGroup );
+
+	void										run();
+
+	std::vector<Body>							mBodies;
+	BodyDecoder									mDecoder;
+	mutable std::mutex							mMutex;
+	bool										mNew;
+	std::atomic<bool>							mRunning;
+	SOCKET										mSocket;
+	std::shared_ptr<std::thread>				mThread;
+	long long									mTimeStamp;
+};
+
+}
@@ -0,0 +1,403 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2BodyHistory.h"
+
+#include <cfloat>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+static const float kTicksToSeconds = 1.0e-7f;
+
+BodyHistoryRef BodyHistory::create( size_t capacity )
+{
+	return BodyHistoryRef( new BodyHistory( capacity ) );
+}
+
+BodyHistory::BodyHistory( size_t capacity )
+: mCapacity( max<size_t>( capacity, 2 ) ), mTimeStamp( 0L )
+{
+	mTracks.resize( BODY_COUNT );
+}
+
+void BodyHistory::clear()
+{
+	for ( vector<Track>::iterator iter = mTracks.begin(); iter != mTracks.end(); ++iter ) {
+		iter->deactivate();
+	}
+	mTimeStamp = 0L;
+}
+
+size_t BodyHistory::getCapacity() const
+{
+	return mCapacity;
+}
+
+const BodyHistory::Track* BodyHistory::getTrack( uint64_t id ) const
+{
+	for ( vector<Track>::const_iterator iter = mTracks.begin(); iter != mTracks.end(); ++iter ) {
+		if ( iter->mActive && iter->mId == id ) {
+			return &( *iter );
+		}
+	}
+	return 0;
+}
+
+const vector<BodyHistory::Track>& BodyHistory::getTracks() const
+{
+	return mTracks;
+}
+
+void BodyHistory::update( const Frame& frame )
+{
+	update( frame.getBodies(), frame.getTimeStamp() );
+}
+
+void BodyHistory::update( const vector<Body>& bodies, long long timeStamp )
+{
+	if ( timeStamp <= mTimeStamp ) {
+		return;
+	}
+	mTimeStamp = timeStamp;
+
+	bool seen[ BODY_COUNT ] = { false };
+	for ( vector<Body>::const_iterator body = bodies.begin(); body != bodies.end(); ++body ) {
+		if ( !body->isTracked() ) {
+			continue;
+		}
+		
+		int32_t index		= -1;
+		int32_t available	= -1;
+		for ( int32_t i = 0; i < BODY_COUNT; ++i ) {
+			if ( mTracks[ i ].mActive ) {
+				if ( mTracks[ i ].mId == body->getId() ) {
+					index = i;
+					break;
+				}
+			} else if ( available < 0 ) {
+				available = i;
+			}
+		}
+		if ( index < 0 ) {
+			if ( available < 0 ) {
+				continue;
+			}
+			index = available;
+			mTracks[ index ].activate( body->getId(), mCapacity );
+		}
+
+		mTracks[ index ].push( *body, timeStamp );
+		seen[ index ] = true;
+	}
+
+	for ( int32_t i = 0; i < BODY_COUNT; ++i ) {
+		if ( !seen[ i ] ) {
+			mTracks[ i ].deactivate();
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+BodyHistory::Track::Track()
+: mActive( false ), mCapacity( 0 ), mId( 0 ), mSequence( 0 ), mSize( 0 )
+{
+	memset( mPathLength, 0, sizeof( mPathLength ) );
+}
+
+void BodyHistory::Track::activate( uint64_t id, size_t capacity )
+{
+	mActive		= true;
+	mCapacity	= capacity;
+	mId			= id;
+	mSequence	= 0;
+	mSize		= 0;
+	memset( mPathLength, 0, sizeof( mPathLength ) );
+
+	// Storage is only allocated the first time a slot is used
+	size_t wedgeCount = JointType_Count * 3 * 2;
+	mFields.resize( JointType_Count * Field_Count * capacity );
+	mStates.resize( JointType_Count * capacity );
+	mTimeStamps.resize( capacity );
+	mWedges.resize( wedgeCount );
+	mWedgeSequences.resize( wedgeCount * capacity );
+	mWedgeValues.resize( wedgeCount * capacity );
+	for ( vector<Wedge>::iterator iter = mWedges.begin(); iter != mWedges.end(); ++iter ) {
+		iter->mHead = 0;
+		iter->mSize = 0;
+	}
+}
+
+void BodyHistory::Track::deactivate()
+{
+	mActive		= false;
+	mId			= 0;
+	mSequence	= 0;
+	mSize		= 0;
+}
+
+size_t BodyHistory::Track::slot( size_t age ) const
+{
+	return (size_t)( ( mSequence - 1 - age ) % mCapacity );
+}
+
+float* BodyHistory::Track::field( size_t joint, size_t f )
+{
+	return &mFields[ ( joint * Field_Count + f ) * mCapacity ];
+}
+
+const float* BodyHistory::Track::field( size_t joint, size_t f ) const
+{
+	return &mFields[ ( joint * Field_Count + f ) * mCapacity ];
+}
+
+size_t BodyHistory::Track::wedgeIndex( size_t joint, size_t axis, bool isMax ) const
+{
+	return ( joint * 3 + axis ) * 2 + ( isMax ? 1 : 0 );
+}
+
+void BodyHistory::Track::pushWedge( size_t joint, size_t axis, bool isMax, uint64_t seq, float v )
+{
+	size_t index		= wedgeIndex( joint, axis, isMax );
+	Wedge& wedge		= mWedges[ index ];
+	uint64_t* seqs		= &mWedgeSequences[ index * mCapacity ];
+	float* values		= &mWedgeValues[ index * mCapacity ];
+
+	// Drop everything at the back that can never be the extremum again
+	while ( wedge.mSize > 0 ) {
+		size_t back = ( wedge.mHead + wedge.mSize - 1 ) % mCapacity;
+		if ( isMax ? values[ back ] > v : values[ back ] < v ) {
+			break;
+		}
+		--wedge.mSize;
+	}
+	size_t back		= ( wedge.mHead + wedge.mSize ) % mCapacity;
+	seqs[ back ]	= seq;
+	values[ back ]	= v;
+	++wedge.mSize;
+}
+
+void BodyHistory::Track::expireWedge( size_t joint, size_t axis, bool isMax, uint64_t oldestSeq )
+{
+	size_t index	= wedgeIndex( joint, axis, isMax );
+	Wedge& wedge	= mWedges[ index ];
+	uint64_t* seqs	= &mWedgeSequences[ index * mCapacity ];
+	while ( wedge.mSize > 0 && seqs[ wedge.mHead ] < oldestSeq ) {
+		wedge.mHead = ( wedge.mHead + 1 ) % mCapacity;
+		--wedge.mSize;
+	}
+}
+
+void BodyHistory::Track::push( const Body& body, long long timeStamp )
+{
+	uint64_t seq		= mSequence;
+	size_t s			= (size_t)( seq % mCapacity );
+	size_t p0			= (size_t)( ( seq + mCapacity - 1 ) % mCapacity );
+	size_t p1			= (size_t)( ( seq + mCapacity - 2 ) % mCapacity );
+	bool hasPrev		= mSize >= 1;
+	bool hasPrevPrev	= mSize >= 2;
+	float dt			= hasPrev ? (float)( timeStamp - mTimeStamps[ p0 ] ) * kTicksToSeconds : 0.0f;
+	float invDt			= dt > 0.0f ? 1.0f / dt : 0.0f;
+
+	// The sample after the one being evicted loses its predecessor, so 
+	// its segment no longer belongs to the window's path length
+	bool evicting = mSize == mCapacity;
+	size_t firstKept = (size_t)( ( seq + 1 ) % mCapacity );
+	uint64_t oldestSeq = evicting ? seq + 1 - mCapacity : 0;
+
+	mTimeStamps[ s ] = timeStamp;
+
+	const map<JointType, Body::Joint>& jointMap = body.getJointMap();
+	for ( size_t j = 0; j < JointType_Count; ++j ) {
+		Vec3f position				= Vec3f::zero();
+		TrackingState state			= TrackingState_NotTracked;
+		map<JointType, Body::Joint>::const_iterator iter = jointMap.find( (JointType)j );
+		if ( iter != jointMap.end() ) {
+			position	= iter->second.getPosition();
+			state		= iter->second.getTrackingState();
+		}
+		uint8_t* states = &mStates[ j * mCapacity ];
+
+		if ( evicting ) {
+			mPathLength[ j ] = max( mPathLength[ j ] - field( j, Field_Segment )[ firstKept ], 0.0f );
+		}
+		
+		Vec3f velocity		= Vec3f::zero();
+		Vec3f acceleration	= Vec3f::zero();
+		float segment		= 0.0f;
+		bool valid			= state != TrackingState_NotTracked;
+		bool validPrev		= hasPrev && states[ p0 ] != TrackingState_NotTracked;
+		bool validPrevPrev	= hasPrevPrev && states[ p1 ] != TrackingState_NotTracked;
+		if ( valid && validPrev && invDt > 0.0f ) {
+			Vec3f prev(	field( j, Field_PositionX )[ p0 ], 
+						field( j, Field_PositionY )[ p0 ], 
+						field( j, Field_PositionZ )[ p0 ] );
+			Vec3f delta	= position - prev;
+			segment		= delta.length();
+			velocity	= delta * invDt;
+			if ( validPrevPrev ) {
+				Vec3f prevVelocity(	field( j, Field_VelocityX )[ p0 ], 
+									field( j, Field_VelocityY )[ p0 ], 
+									field( j, Field_VelocityZ )[ p0 ] );
+				acceleration = ( velocity - prevVelocity ) * invDt;
+			}
+		}
+
+		field( j, Field_PositionX )[ s ]		= position.x;
+		field( j, Field_PositionY )[ s ]		= position.y;
+		field( j, Field_PositionZ )[ s ]		= position.z;
+		field( j, Field_VelocityX )[ s ]		= velocity.x;
+		field( j, Field_VelocityY )[ s ]		= velocity.y;
+		field( j, Field_VelocityZ )[ s ]		= velocity.z;
+		field( j, Field_AccelerationX )[ s ]	= acceleration.x;
+		field( j, Field_AccelerationY )[ s ]	= acceleration.y;
+		field( j, Field_AccelerationZ )[ s ]	= acceleration.z;
+		field( j, Field_Segment )[ s ]			= segment;
+		states[ s ]								= (uint8_t)state;
+		mPathLength[ j ]						+= segment;
+
+		for ( size_t axis = 0; axis < 3; ++axis ) {
+			if ( evicting ) {
+				expireWedge( j, axis, false, oldestSeq );
+				expireWedge( j, axis, true, oldestSeq );
+			}
+			if ( valid ) {
+				pushWedge( j, axis, false, seq, position[ (int32_t)axis ] );
+				pushWedge( j, axis, true, seq, position[ (int32_t)axis ] );
+			}
+		}
+	}
+
+	++mSequence;
+	mSize = min( mSize + 1, mCapacity );
+}
+
+uint64_t BodyHistory::Track::getId() const
+{
+	return mId;
+}
+
+bool BodyHistory::Track::isActive() const
+{
+	return mActive;
+}
+
+size_t BodyHistory::Track::getCapacity() const
+{
+	return mCapacity;
+}
+
+size_t BodyHistory::Track::getSize() const
+{
+	return mSize;
+}
+
+long long BodyHistory::Track::getTimeStamp( size_t age ) const
+{
+	if ( age >= mSize ) {
+		return 0L;
+	}
+	return mTimeStamps[ slot( age ) ];
+}
+
+Vec3f BodyHistory::Track::getPosition( JointType joint, size_t age ) const
+{
+	if ( age >= mSize ) {
+		return Vec3f::zero();
+	}
+	size_t s = slot( age );
+	return Vec3f( field( joint, Field_PositionX )[ s ], field( joint, Field_PositionY )[ s ], field( joint, Field_PositionZ )[ s ] );
+}
+
+Vec3f BodyHistory::Track::getVelocity( JointType joint, size_t age ) const
+{
+	if ( age >= mSize ) {
+		return Vec3f::zero();
+	}
+	size_t s = slot( age );
+	return Vec3f( field( joint, Field_VelocityX )[ s ], field( joint, Field_VelocityY )[ s ], field( joint, Field_VelocityZ )[ s ] );
+}
+
+Vec3f BodyHistory::Track::getAcceleration( JointType joint, size_t age ) const
+{
+	if ( age >= mSize ) {
+		return Vec3f::zero();
+	}
+	size_t s = slot( age );
+	return Vec3f( field( joint, Field_AccelerationX )[ s ], field( joint, Field_AccelerationY )[ s ], field( joint, Field_AccelerationZ )[ s ] );
+}
+
+float BodyHistory::Track::getSpeed( JointType joint, size_t age ) const
+{
+	return getVelocity( joint, age ).length();
+}
+
+TrackingState BodyHistory::Track::getTrackingState( JointType joint, size_t age ) const
+{
+	if ( age >= mSize ) {
+		return TrackingState_NotTracked;
+	}
+	return (TrackingState)mStates[ joint * mCapacity + slot( age ) ];
+}
+
+AxisAlignedBox3f BodyHistory::Track::getBounds( JointType joint ) const
+{
+	Vec3f minimum = Vec3f::zero();
+	Vec3f maximum = Vec3f::zero();
+	if ( mSize > 0 ) {
+		for ( size_t axis = 0; axis < 3; ++axis ) {
+			const Wedge& wedgeMin = mWedges[ wedgeIndex( joint, axis, false ) ];
+			const Wedge& wedgeMax = mWedges[ wedgeIndex( joint, axis, true ) ];
+			if ( wedgeMin.mSize == 0 || wedgeMax.mSize == 0 ) {
+				return AxisAlignedBox3f( Vec3f::zero(), Vec3f::zero() );
+			}
+			minimum[ (int32_t)axis ] = mWedgeValues[ wedgeIndex( joint, axis, false ) * mCapacity + wedgeMin.mHead ];
+			maximum[ (int32_t)axis ] = mWedgeValues[ wedgeIndex( joint, axis, true ) * mCapacity + wedgeMax.mHead ];
+		}
+	}
+	return AxisAlignedBox3f( minimum, maximum );
+}
+
+float BodyHistory::Track::getPathLength( JointType joint ) const
+{
+	return mPathLength[ joint ];
+}
+
+}
@@ -0,0 +1,141 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2.h"
+#include "cinder/AxisAlignedBox.h"
+
+namespace Kinect2 {
+
+class BodyHistory;
+typedef std::shared_ptr<BodyHistory> BodyHistoryRef;
+
+// Fixed-capacity joint history per tracked body. Samples are stored 
+// structure-of-arrays in a ring so that "joint J, N frames ago" is a 
+// single index calculation. Velocity, acceleration, path length and 
+// bounds over the window are updated incrementally as frames arrive.
+class BodyHistory
+{
+public:
+	static BodyHistoryRef						create( size_t capacity = 30 );
+
+	class Track
+	{
+	public:
+		Track();
+
+		uint64_t								getId() const;
+		bool									isActive() const;
+
+		// Number of samples held, never more than getCapacity().
+		size_t									getCapacity() const;
+		size_t									getSize() const;
+
+		// "age" is the number of frames before the most recent sample.
+		long long								getTimeStamp( size_t age = 0 ) const;
+		ci::Vec3f								getPosition( JointType joint, size_t age = 0 ) const;
+		ci::Vec3f								getVelocity( JointType joint, size_t age = 0 ) const;
+		ci::Vec3f								getAcceleration( JointType joint, size_t age = 0 ) const;
+		TrackingState							getTrackingState( JointType joint, size_t age = 0 ) const;
+
+		// Aggregates over every sample currently held in the window.
+		ci::AxisAlignedBox3f					getBounds( JointType joint ) const;
+		float									getPathLength( JointType joint ) const;
+		float									getSpeed( JointType joint, size_t age = 0 ) const;
+	protected:
+		enum
+		{
+			Field_PositionX, Field_PositionY, Field_PositionZ, 
+			Field_VelocityX, Field_VelocityY, Field_VelocityZ, 
+			Field_AccelerationX, Field_AccelerationY, Field_AccelerationZ, 
+			Field_Segment, Field_Count
+		};
+
+		// Sliding window extremum of one joint axis (monotonic queue).
+		struct Wedge
+		{
+			size_t								mHead;
+			size_t								mSize;
+		};
+
+		void									activate( uint64_t id, size_t capacity );
+		void									deactivate();
+		void									push( const Body& body, long long timeStamp );
+
+		size_t									slot( size_t age ) const;
+		float*									field( size_t joint, size_t f );
+		const float*							field( size_t joint, size_t f ) const;
+
+		void									pushWedge( size_t joint, size_t axis, bool isMax, uint64_t seq, float v );
+		void									expireWedge( size_t joint, size_t axis, bool isMax, uint64_t oldestSeq );
+		size_t									wedgeIndex( size_t joint, size_t axis, bool isMax ) const;
+
+		bool									mActive;
+		size_t									mCapacity;
+		uint64_t								mId;
+		float									mPathLength[ JointType_Count ];
+		uint64_t								mSequence;
+		size_t									mSize;
+		std::vector<float>						mFields;
+		std::vector<uint8_t>					mStates;
+		std::vector<long long>					mTimeStamps;
+		std::vector<Wedge>						mWedges;
+		std::vector<uint64_t>					mWedgeSequences;
+		std::vector<float>						mWedgeValues;
+
+		friend class							BodyHistory;
+	};
+
+	// Appends the bodies in "frame" if its time stamp is newer than the 
+	// last one seen. Tracks whose id is missing from the frame are released.
+	void										update( const Frame& frame );
+	void										update( const std::vector<Body>& bodies, long long timeStamp );
+	void										clear();
+
+	size_t										getCapacity() const;
+	const Track*								getTrack( uint64_t id ) const;
+	const std::vector<Track>&					getTracks() const;
+protected:
+	BodyHistory( size_t capacity );
+
+	size_t										mCapacity;
+	long long									mTimeStamp;
+	std::vector<Track>							mTracks;
+};
+
+}
@@ -0,0 +1,290 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2ChangeDetector.h"
+
+#include <cstring>
+#include <emmintrin.h>
+#include <ppl.h>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+TileChanges::TileChanges()
+: mDirtyCount( 0 )
+{
+}
+
+const Channel8u& TileChanges::getTiles() const
+{
+	return mTiles;
+}
+
+const vector<Area>& TileChanges::getRects() const
+{
+	return mRects;
+}
+
+size_t TileChanges::getDirtyCount() const
+{
+	return mDirtyCount;
+}
+
+int32_t TileChanges::getTileSize() const
+{
+	return ChangeDetector::kTileSize;
+}
+
+bool TileChanges::isDirty( const Area& area ) const
+{
+	int32_t x1 = max( area.getX1() / ChangeDetector::kTileSize, 0 );
+	int32_t y1 = max( area.getY1() / ChangeDetector::kTileSize, 0 );
+	int32_t x2 = min( ( area.getX2() + ChangeDetector::kTileSize - 1 ) / ChangeDetector::kTileSize, mTiles.getWidth() );
+	int32_t y2 = min( ( area.getY2() + ChangeDetector::kTileSize - 1 ) / ChangeDetector::kTileSize, mTiles.getHeight() );
+	for ( int32_t y = y1; y < y2; ++y ) {
+		const uint8_t* row = mTiles.getData( Vec2i( 0, y ) );
+		for ( int32_t x = x1; x < x2; ++x ) {
+			if ( row[ x ] != 0 ) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+// Sums the lanes of four 32 bit integers.
+static inline uint32_t sumLanes( __m128i v )
+{
+	v = _mm_add_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	v = _mm_add_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	return (uint32_t)_mm_cvtsi128_si32( v );
+}
+
+ChangeDetectorRef ChangeDetector::create()
+{
+	return ChangeDetectorRef( new ChangeDetector() );
+}
+
+ChangeDetector::ChangeDetector()
+: mMaxFlips( 16 ), mNoiseOffset( 2.0f ), mNoiseScale( 1.5f )
+{
+}
+
+TileChangesRef ChangeDetector::update( const Channel16u& channel )
+{
+	if ( !channel ) {
+		return TileChangesRef();
+	}
+
+	int32_t width	= channel.getWidth();
+	int32_t height	= channel.getHeight();
+	int32_t tilesX	= ( width + kTileSize - 1 ) / kTileSize;
+	int32_t tilesY	= ( height + kTileSize - 1 ) / kTileSize;
+
+	shared_ptr<TileChanges> changes( new TileChanges() );
+	changes->mTiles = Channel8u( tilesX, tilesY );
+
+	// Without a reference, everything has changed.
+	if ( !mReference || mReference.getSize() != channel.getSize() ) {
+		mReference = channel.clone();
+		for ( int32_t y = 0; y < tilesY; ++y ) {
+			memset( changes->mTiles.getData( Vec2i( 0, y ) ), 1, tilesX );
+		}
+		changes->mDirtyCount = tilesX * tilesY;
+		mergeRects( *changes );
+		return changes;
+	}
+
+	Channel8u& tiles		= changes->mTiles;
+	const __m128i zero		= _mm_setzero_si128();
+	const __m128i ones		= _mm_set1_epi16( -1 );
+	concurrency::parallel_for( 0, tilesY, [ & ]( int32_t ty )
+	{
+		int32_t y1		= ty * kTileSize;
+		int32_t y2		= min( y1 + kTileSize, height );
+		uint8_t* flags	= tiles.getData( Vec2i( 0, ty ) );
+		for ( int32_t tx = 0; tx < tilesX; ++tx ) {
+			int32_t x1			= tx * kTileSize;
+			int32_t x2			= min( x1 + kTileSize, width );
+			int32_t xSimd		= x1 + ( ( x2 - x1 ) & ~7 );
+			__m128i sad			= zero;
+			__m128i sum			= zero;
+			__m128i counts		= zero;
+			__m128i flips		= zero;
+			uint32_t sadTail	= 0;
+			uint32_t sumTail	= 0;
+			uint32_t countTail	= 0;
+			uint32_t flipTail	= 0;
+			for ( int32_t y = y1; y < y2; ++y ) {
+				const uint16_t* input		= channel.getData( Vec2i( 0, y ) );
+				const uint16_t* reference	= mReference.getData( Vec2i( 0, y ) );
+				for ( int32_t x = x1; x < xSimd; x += 8 ) {
+					__m128i a		= _mm_loadu_si128( reinterpret_cast<const __m128i*>( input + x ) );
+					__m128i b		= _mm_loadu_si128( reinterpret_cast<const __m128i*>( reference + x ) );
+					__m128i za		= _mm_cmpeq_epi16( a, zero );
+					__m128i zb		= _mm_cmpeq_epi16( b, zero );
+					__m128i both	= _mm_andnot_si128( _mm_or_si128( za, zb ), ones );
+					__m128i diff	= _mm_and_si128( _mm_or_si128( _mm_subs_epu16( a, b ), _mm_subs_epu16( b, a ) ), both );
+					__m128i depth	= _mm_and_si128( a, both );
+					flips			= _mm_sub_epi16( flips, _mm_xor_si128( za, zb ) );
+					counts			= _mm_sub_epi16( counts, both );
+					sad				= _mm_add_epi32( sad, _mm_add_epi32( _mm_unpacklo_epi16( diff, zero ), _mm_unpackhi_epi16( diff, zero ) ) );
+					sum				= _mm_add_epi32( sum, _mm_add_epi32( _mm_unpacklo_epi16( depth, zero ), _mm_unpackhi_epi16( depth, zero ) ) );
+				}
+				for ( int32_t x = xSimd; x < x2; ++x ) {
+					uint16_t a = input[ x ];
+					uint16_t b = reference[ x ];
+					if ( a != 0 && b != 0 ) {
+						sadTail		+= a > b ? a - b : b - a;
+						sumTail		+= a;
+						++countTail;
+					} else if ( ( a == 0 ) != ( b == 0 ) ) {
+						++flipTail;
+					}
+				}
+			}
+
+			// Per lane counts are at most two per row, so they fit 16 bits.
+			uint32_t count		= sumLanes( _mm_madd_epi16( counts, _mm_set1_epi16( 1 ) ) ) + countTail;
+			uint32_t flipCount	= sumLanes( _mm_madd_epi16( flips, _mm_set1_epi16( 1 ) ) ) + flipTail;
+			bool changed		= flipCount > mMaxFlips;
+			if ( !changed && count > 0 ) {
+				float z			= (float)( sumLanes( sum ) + sumTail ) / (float)count * 0.001f;
+				float allowed	= (float)count * ( mNoiseOffset + mNoiseScale * z * z );
+				changed			= (float)( sumLanes( sad ) + sadTail ) > allowed;
+			}
+
+			flags[ tx ] = changed ? 1 : 0;
+			if ( changed ) {
+				for ( int32_t y = y1; y < y2; ++y ) {
+					memcpy( mReference.getData( Vec2i( x1, y ) ), channel.getData( Vec2i( x1, y ) ), ( x2 - x1 ) * sizeof( uint16_t ) );
+				}
+			}
+		}
+	} );
+
+	for ( int32_t y = 0; y < tilesY; ++y ) {
+		const uint8_t* row = tiles.getData( Vec2i( 0, y ) );
+		for ( int32_t x = 0; x < tilesX; ++x ) {
+			changes->mDirtyCount += row[ x ];
+		}
+	}
+	mergeRects( *changes );
+	return changes;
+}
+
+// Runs of dirty tiles in each row extend the rectangle above them when 
+// they span the same columns; otherwise they start a new one.
+void ChangeDetector::mergeRects( TileChanges& changes ) const
+{
+	const Channel8u& tiles = changes.mTiles;
+	vector<size_t> open;
+	vector<size_t> next;
+	for ( int32_t y = 0; y < tiles.getHeight(); ++y ) {
+		const uint8_t* row = tiles.getData( Vec2i( 0, y ) );
+		next.clear();
+		for ( int32_t x = 0; x < tiles.getWidth(); ) {
+			if ( row[ x ] == 0 ) {
+				++x;
+				continue;
+			}
+			int32_t x1 = x;
+			while ( x < tiles.getWidth() && row[ x ] != 0 ) {
+				++x;
+			}
+
+			bool extended = false;
+			for ( size_t i = 0; i < open.size() && !extended; ++i ) {
+				Area& rect = changes.mRects[ open[ i ] ];
+				if ( rect.getX1() == x1 && rect.getX2() == x ) {
+					rect.y2		= y + 1;
+					extended	= true;
+					next.push_back( open[ i ] );
+				}
+			}
+			if ( !extended ) {
+				next.push_back( changes.mRects.size() );
+				changes.mRects.push_back( Area( x1, y, x, y + 1 ) );
+			}
+		}
+		open.swap( next );
+	}
+
+	int32_t width	= mReference.getWidth();
+	int32_t height	= mReference.getHeight();
+	for ( vector<Area>::iterator iter = changes.mRects.begin(); iter != changes.mRects.end(); ++iter ) {
+		*iter = Area( iter->getX1() * kTileSize, iter->getY1() * kTileSize, 
+			min( iter->getX2() * kTileSize, width ), min( iter->getY2() * kTileSize, height ) );
+	}
+}
+
+void ChangeDetector::reset()
+{
+	mReference = Channel16u();
+}
+
+void ChangeDetector::setNoise( float offset, float scale )
+{
+	mNoiseOffset	= offset;
+	mNoiseScale		= scale;
+}
+
+float ChangeDetector::getNoiseOffset() const
+{
+	return mNoiseOffset;
+}
+
+float ChangeDetector::getNoiseScale() const
+{
+	return mNoiseScale;
+}
+
+void ChangeDetector::setMaxFlips( uint32_t count )
+{
+	mMaxFlips = count;
+}
+
+uint32_t ChangeDetector::getMaxFlips() const
+{
+	return mMaxFlips;
+}
+
+}
@@ -0,0 +1,117 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "cinder/Area.h"
+#include "cinder/Channel.h"
+#include <memory>
+#include <vector>
+
+// Depends on nothing but Cinder, so consumers such as DepthPyramid and 
+// DepthMesh can take TileChanges without the Kinect SDK.
+
+namespace Kinect2 {
+
+class ChangeDetector;
+class TileChanges;
+typedef std::shared_ptr<ChangeDetector>		ChangeDetectorRef;
+typedef std::shared_ptr<const TileChanges>	TileChangesRef;
+
+// Tiles of a channel that changed, published with each Frame when 
+// DeviceOptions::enableDepthChanges() is set. Consumers can limit work to 
+// the dirty tiles or rectangles and keep their previous results elsewhere; 
+// DepthPyramid::update() and DepthMesh::update() take them directly.
+class TileChanges
+{
+public:
+	// One pixel per tile, non-zero where the tile changed
+	const ci::Channel8u&						getTiles() const;
+	// Dirty tiles merged into rectangles, in pixels
+	const std::vector<ci::Area>&				getRects() const;
+	size_t										getDirtyCount() const;
+	int32_t										getTileSize() const;
+	// True if any tile overlapping "area" changed
+	bool										isDirty( const ci::Area& area ) const;
+protected:
+	TileChanges();
+
+	size_t										mDirtyCount;
+	std::vector<ci::Area>						mRects;
+	ci::Channel8u								mTiles;
+
+	friend class								ChangeDetector;
+};
+
+// Compares each depth channel against a reference in 16x16 tiles. Within 
+// a tile, pixels with depth in both channels add their absolute 
+// difference; a tile is dirty when that sum exceeds the sensor noise 
+// expected at the tile's mean depth, or when too many pixels gained or 
+// lost depth. Dirty tiles are copied into the reference and clean ones 
+// keep theirs, so slow drift still adds up to a change eventually.
+class ChangeDetector
+{
+public:
+	static const int32_t						kTileSize = 16;
+
+	static ChangeDetectorRef					create();
+
+	TileChangesRef								update( const ci::Channel16u& channel );
+	// The next update() marks every tile dirty.
+	void										reset();
+
+	// Pixels may differ by "offset" + "scale" * z * z millimeters on 
+	// average, with z in meters.
+	void										setNoise( float offset, float scale );
+	float										getNoiseOffset() const;
+	float										getNoiseScale() const;
+	// Pixels per tile that may gain or lose depth, as they flicker along 
+	// edges, before the tile counts as changed
+	void										setMaxFlips( uint32_t count );
+	uint32_t									getMaxFlips() const;
+protected:
+	ChangeDetector();
+
+	void										mergeRects( TileChanges& changes ) const;
+
+	uint32_t									mMaxFlips;
+	float										mNoiseOffset;
+	float										mNoiseScale;
+	ci::Channel16u								mReference;
+};
+
+}
@@ -0,0 +1,383 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2Contour.h"
+
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+#include <functional>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+// Cell corners are top left, top right, bottom right and bottom left, 
+// from bit 3 down to bit 0. Edges are top, right, bottom and left. For 
+// each corner configuration, the exit edge per entry edge, keeping the 
+// label on the left on screen. Diagonal corners are separate.
+static const int8_t kExitEdges[ 16 ][ 4 ] = {
+	{ -1, -1, -1, -1 }, { -1, -1,  3, -1 }, { -1,  2, -1, -1 }, { -1,  3, -1, -1 }, 
+	{  1, -1, -1, -1 }, {  1, -1,  3, -1 }, {  2, -1, -1, -1 }, {  3, -1, -1, -1 }, 
+	{ -1, -1, -1,  0 }, { -1, -1,  0, -1 }, { -1,  2, -1,  0 }, { -1,  0, -1, -1 }, 
+	{ -1, -1, -1,  1 }, { -1, -1,  1, -1 }, { -1, -1, -1,  2 }, { -1, -1, -1, -1 }
+};
+
+// Edge midpoints relative to the cell's top left pixel, and the step to 
+// the cell across each edge
+static const float		kEdgeMidpoints[ 4 ][ 2 ]	= { { 0.5f, 0.0f }, { 1.0f, 0.5f }, { 0.5f, 1.0f }, { 0.0f, 0.5f } };
+static const int32_t	kEdgeSteps[ 4 ][ 2 ]		= { { 0, -1 }, { 1, 0 }, { 0, 1 }, { -1, 0 } };
+
+// The two corner configurations with diagonal corners hold two segments.
+static inline int32_t getSegment( int32_t config, int32_t edge )
+{
+	return ( config == 5 && edge == 2 ) || ( config == 10 && edge == 1 ) ? 1 : 0;
+}
+
+ContourTracerRef ContourTracer::create( uint8_t labelCount )
+{
+	return ContourTracerRef( new ContourTracer( labelCount ) );
+}
+
+ContourTracer::ContourTracer( uint8_t labelCount )
+: mLabelCount( min<uint8_t>( labelCount, 8 ) ), mMinArea( 4.0f ), mSimplify( Simplify_None ), 
+mSimplifyTolerance( 1.0f ), mSmoothing( 0 ), mPaddedWidth( 0 )
+{
+}
+
+size_t ContourTracer::update( const Channel8u& labels )
+{
+	mContours.clear();
+	mPoints.clear();
+	if ( !labels ) {
+		return 0;
+	}
+
+	int32_t width	= labels.getWidth();
+	int32_t height	= labels.getHeight();
+	mPaddedWidth	= width + 2;
+	mPadded.resize( mPaddedWidth * ( height + 2 ) );
+	memset( &mPadded[ 0 ], 0xff, mPaddedWidth );
+	memset( &mPadded[ ( height + 1 ) * mPaddedWidth ], 0xff, mPaddedWidth );
+	for ( int32_t y = 0; y < height; ++y ) {
+		uint8_t* row				= &mPadded[ ( y + 1 ) * mPaddedWidth ];
+		row[ 0 ]					= 0xff;
+		row[ width + 1 ]			= 0xff;
+		memcpy( row + 1, labels.getData( Vec2i( 0, y ) ), width );
+	}
+	mVisited.assign( ( width + 1 ) * ( height + 1 ), 0 );
+
+	// Cell (x, y) has the padded pixels (x, y) to (x + 1, y + 1) as corners.
+	for ( int32_t y = 0; y <= height; ++y ) {
+		const uint8_t* row0 = &mPadded[ y * mPaddedWidth ];
+		const uint8_t* row1 = row0 + mPaddedWidth;
+		for ( int32_t x = 0; x <= width; ) {
+
+			// Skip 16 cells at a time where all their corners match.
+			if ( x + 17 <= mPaddedWidth ) {
+				__m128i a	= _mm_loadu_si128( reinterpret_cast<const __m128i*>( row0 + x ) );
+				__m128i b	= _mm_loadu_si128( reinterpret_cast<const __m128i*>( row0 + x + 1 ) );
+				__m128i c	= _mm_loadu_si128( reinterpret_cast<const __m128i*>( row1 + x ) );
+				__m128i d	= _mm_loadu_si128( reinterpret_cast<const __m128i*>( row1 + x + 1 ) );
+				__m128i eq	= _mm_and_si128( _mm_and_si128( _mm_cmpeq_epi8( a, b ), _mm_cmpeq_epi8( a, c ) ), _mm_cmpeq_epi8( a, d ) );
+				if ( _mm_movemask_epi8( eq ) == 0xffff ) {
+					x += 16;
+					continue;
+				}
+			}
+
+			uint8_t corners[ 4 ] = { row0[ x ], row0[ x + 1 ], row1[ x + 1 ], row1[ x ] };
+			if ( corners[ 0 ] != corners[ 1 ] || corners[ 0 ] != corners[ 2 ] || corners[ 0 ] != corners[ 3 ] ) {
+				for ( int32_t i = 0; i < 4; ++i ) {
+					uint8_t label = corners[ i ];
+					if ( label >= mLabelCount || ( i > 0 && label == corners[ 0 ] ) || ( i > 1 && label == corners[ 1 ] ) || 
+						( i > 2 && label == corners[ 2 ] ) ) {
+						continue;
+					}
+					int32_t config = ( corners[ 0 ] == label ? 8 : 0 ) | ( corners[ 1 ] == label ? 4 : 0 ) | 
+						( corners[ 2 ] == label ? 2 : 0 ) | ( corners[ 3 ] == label ? 1 : 0 );
+					for ( int32_t edge = 0; edge < 4; ++edge ) {
+						if ( kExitEdges[ config ][ edge ] >= 0 && 
+							( mVisited[ y * ( width + 1 ) + x ] & ( 1 << ( label * 2 + getSegment( config, edge ) ) ) ) == 0 ) {
+							trace( x, y, edge, label );
+						}
+					}
+				}
+			}
+			++x;
+		}
+	}
+	return mContours.size();
+}
+
+void ContourTracer::trace( int32_t x, int32_t y, int32_t edge, uint8_t label )
+{
+	int32_t cellsX	= mPaddedWidth - 1;
+	int32_t cx		= x;
+	int32_t cy		= y;
+	int32_t entry	= edge;
+	mRaw.clear();
+	do {
+		const uint8_t* row0	= &mPadded[ cy * mPaddedWidth + cx ];
+		const uint8_t* row1	= row0 + mPaddedWidth;
+		int32_t config		= ( row0[ 0 ] == label ? 8 : 0 ) | ( row0[ 1 ] == label ? 4 : 0 ) | 
+			( row1[ 1 ] == label ? 2 : 0 ) | ( row1[ 0 ] == label ? 1 : 0 );
+		int32_t exit		= kExitEdges[ config ][ entry ];
+		mVisited[ cy * cellsX + cx ] |= 1 << ( label * 2 + getSegment( config, entry ) );
+
+		// Padded coordinates are one more than pixel coordinates.
+		mRaw.push_back( Vec2f( (float)( cx - 1 ) + kEdgeMidpoints[ exit ][ 0 ], (float)( cy - 1 ) + kEdgeMidpoints[ exit ][ 1 ] ) );
+		cx		+= kEdgeSteps[ exit ][ 0 ];
+		cy		+= kEdgeSteps[ exit ][ 1 ];
+		entry	= ( exit + 2 ) & 3;
+	} while ( cx != x || cy != y || entry != edge );
+
+	// With the label on the left on screen, outer contours have a negative 
+	// signed area in pixel coordinates.
+	float area = 0.0f;
+	for ( size_t i = 0, j = mRaw.size() - 1; i < mRaw.size(); j = i++ ) {
+		area += mRaw[ j ].x * mRaw[ i ].y - mRaw[ i ].x * mRaw[ j ].y;
+	}
+	area *= 0.5f;
+	if ( fabs( area ) < mMinArea ) {
+		return;
+	}
+
+	for ( int32_t i = 0; i < mSmoothing; ++i ) {
+		smooth();
+	}
+
+	Contour contour;
+	contour.mArea	= fabs( area );
+	contour.mHole	= area > 0.0f;
+	contour.mLabel	= label;
+	contour.mOffset	= mPoints.size();
+	if ( mSimplify == Simplify_DouglasPeucker && mRaw.size() > 3 ) {
+		simplifyDouglasPeucker( mRaw );
+	} else if ( mSimplify == Simplify_Visvalingam && mRaw.size() > 3 ) {
+		simplifyVisvalingam( mRaw );
+	} else {
+		mPoints.insert( mPoints.end(), mRaw.begin(), mRaw.end() );
+	}
+	contour.mCount	= mPoints.size() - contour.mOffset;
+	mContours.push_back( contour );
+}
+
+void ContourTracer::smooth()
+{
+	size_t count = mRaw.size();
+	mSmoothed.resize( count );
+	for ( size_t i = 0; i < count; ++i ) {
+		const Vec2f& prev = mRaw[ i == 0 ? count - 1 : i - 1 ];
+		const Vec2f& next = mRaw[ i + 1 == count ? 0 : i + 1 ];
+		mSmoothed[ i ] = ( prev + mRaw[ i ] * 2.0f + next ) * 0.25f;
+	}
+	mRaw.swap( mSmoothed );
+}
+
+// Splits the closed contour at its first point and the point farthest 
+// from it, then simplifies both halves.
+void ContourTracer::simplifyDouglasPeucker( const vector<Vec2f>& points )
+{
+	size_t count	= points.size();
+	float tolerance	= mSimplifyTolerance * mSimplifyTolerance;
+	size_t farPoint	= 0;
+	float farthest	= -1.0f;
+	for ( size_t i = 1; i < count; ++i ) {
+		float d = points[ i ].distanceSquared( points[ 0 ] );
+		if ( d > farthest ) {
+			farPoint	= i;
+			farthest	= d;
+		}
+	}
+
+	mKeep.assign( count, 0 );
+	mKeep[ 0 ]			= 1;
+	mKeep[ farPoint ]	= 1;
+	mSpans.clear();
+	mSpans.push_back( make_pair( (size_t)0, farPoint ) );
+	mSpans.push_back( make_pair( farPoint, count ) );
+	while ( !mSpans.empty() ) {
+		size_t first	= mSpans.back().first;
+		size_t last		= mSpans.back().second;
+		mSpans.pop_back();
+		if ( last - first < 2 ) {
+			continue;
+		}
+
+		const Vec2f& a		= points[ first ];
+		const Vec2f& b		= points[ last % count ];
+		Vec2f ab			= b - a;
+		float length		= ab.lengthSquared();
+		size_t split		= first;
+		float splitDistance	= tolerance;
+		for ( size_t i = first + 1; i < last; ++i ) {
+			Vec2f ap	= points[ i ] - a;
+			float d		= 0.0f;
+			if ( length > 0.0f ) {
+				float cross = ab.x * ap.y - ab.y * ap.x;
+				d = cross * cross / length;
+			} else {
+				d = ap.lengthSquared();
+			}
+			if ( d > splitDistance ) {
+				split			= i;
+				splitDistance	= d;
+			}
+		}
+		if ( split != first ) {
+			mKeep[ split ] = 1;
+			mSpans.push_back( make_pair( first, split ) );
+			mSpans.push_back( make_pair( split, last ) );
+		}
+	}
+
+	// A contour within tolerance of its diameter still keeps a triangle.
+	if ( count - std::count( mKeep.begin(), mKeep.end(), 0 ) < 3 ) {
+		Vec2f ab		= points[ farPoint ] - points[ 0 ];
+		size_t third	= 0;
+		float distance	= -1.0f;
+		for ( size_t i = 1; i < count; ++i ) {
+			Vec2f ap	= points[ i ] - points[ 0 ];
+			float d		= fabs( ab.x * ap.y - ab.y * ap.x );
+			if ( i != farPoint && d > distance ) {
+				third		= i;
+				distance	= d;
+			}
+		}
+		mKeep[ third ] = 1;
+	}
+
+	for ( size_t i = 0; i < count; ++i ) {
+		if ( mKeep[ i ] != 0 ) {
+			mPoints.push_back( points[ i ] );
+		}
+	}
+}
+
+// Repeatedly removes the point spanning the smallest triangle with its 
+// neighbors. A point's weight never drops below that of a point removed 
+// before it, so removal order stays monotonic.
+void ContourTracer::simplifyVisvalingam( const vector<Vec2f>& points )
+{
+	uint32_t count = (uint32_t)points.size();
+	mKeep.assign( count, 1 );
+	mNext.resize( count );
+	mPrevious.resize( count );
+	mWeights.resize( count );
+	mHeap.clear();
+	for ( uint32_t i = 0; i < count; ++i ) {
+		mNext[ i ]		= i + 1 == count ? 0 : i + 1;
+		mPrevious[ i ]	= i == 0 ? count - 1 : i - 1;
+	}
+
+	for ( uint32_t i = 0; i < count; ++i ) {
+		const Vec2f& a	= points[ mPrevious[ i ] ];
+		const Vec2f& b	= points[ i ];
+		const Vec2f& c	= points[ mNext[ i ] ];
+		mWeights[ i ]	= fabs( ( b.x - a.x ) * ( c.y - a.y ) - ( c.x - a.x ) * ( b.y - a.y ) ) * 0.5f;
+		mHeap.push_back( make_pair( mWeights[ i ], i ) );
+	}
+	make_heap( mHeap.begin(), mHeap.end(), greater<pair<float, uint32_t> >() );
+
+	uint32_t remaining = count;
+	while ( remaining > 3 && !mHeap.empty() ) {
+		pair<float, uint32_t> top = mHeap.front();
+		pop_heap( mHeap.begin(), mHeap.end(), greater<pair<float, uint32_t> >() );
+		mHeap.pop_back();
+		uint32_t i = top.second;
+		if ( mKeep[ i ] == 0 || top.first != mWeights[ i ] ) {
+			continue;
+		}
+		if ( top.first >= mSimplifyTolerance ) {
+			break;
+		}
+
+		mKeep[ i ]				= 0;
+		uint32_t prev			= mPrevious[ i ];
+		uint32_t next			= mNext[ i ];
+		mNext[ prev ]			= next;
+		mPrevious[ next ]		= prev;
+		--remaining;
+
+		uint32_t neighbors[ 2 ]	= { prev, next };
+		for ( int32_t n = 0; n < 2; ++n ) {
+			uint32_t j		= neighbors[ n ];
+			const Vec2f& a	= points[ mPrevious[ j ] ];
+			const Vec2f& b	= points[ j ];
+			const Vec2f& c	= points[ mNext[ j ] ];
+			mWeights[ j ]	= max( fabs( ( b.x - a.x ) * ( c.y - a.y ) - ( c.x - a.x ) * ( b.y - a.y ) ) * 0.5f, top.first );
+			mHeap.push_back( make_pair( mWeights[ j ], j ) );
+			push_heap( mHeap.begin(), mHeap.end(), greater<pair<float, uint32_t> >() );
+		}
+	}
+
+	for ( uint32_t i = 0; i < count; ++i ) {
+		if ( mKeep[ i ] != 0 ) {
+			mPoints.push_back( points[ i ] );
+		}
+	}
+}
+
+const vector<ContourTracer::Contour>& ContourTracer::getContours() const
+{
+	return mContours;
+}
+
+const vector<Vec2f>& ContourTracer::getPoints() const
+{
+	return mPoints;
+}
+
+void ContourTracer::setMinArea( float area )
+{
+	mMinArea = area;
+}
+
+void ContourTracer::setSmoothing( int32_t iterations )
+{
+	mSmoothing = max( iterations, 0 );
+}
+
+void ContourTracer::setSimplify( int32_t method, float tolerance )
+{
+	mSimplify			= method;
+	mSimplifyTolerance	= tolerance;
+}
+
+}
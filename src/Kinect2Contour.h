@@ -0,0 +1,125 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2.h"
+
+namespace Kinect2 {
+
+class ContourTracer;
+typedef std::shared_ptr<ContourTracer>	ContourTracerRef;
+
+// Traces the outlines of every label in a label mask, such as 
+// Frame::getBodyIndex(), with marching squares in a single pass. Each 
+// label gets its outer contours and the contours of its holes. Points of 
+// all contours are packed into one array whose storage, like all scratch 
+// space, is kept across frames.
+// 
+// Points are in pixel coordinates with pixel centers on integers. Outer 
+// contours run counter-clockwise on screen, holes clockwise.
+class ContourTracer
+{
+public:
+	enum : int32_t
+	{
+		Simplify_None, Simplify_DouglasPeucker, Simplify_Visvalingam
+	};
+
+	struct Contour
+	{
+		// Enclosed area in pixels before smoothing and simplification
+		float									mArea;
+		size_t									mCount;
+		bool									mHole;
+		uint8_t									mLabel;
+		// First point in getPoints()
+		size_t									mOffset;
+	};
+
+	// Labels 0 to "labelCount" - 1 are traced, at most eight. Other values 
+	// are background.
+	static ContourTracerRef						create( uint8_t labelCount = BODY_COUNT );
+
+	// Returns the number of contours.
+	size_t										update( const ci::Channel8u& labels );
+
+	const std::vector<Contour>&					getContours() const;
+	const std::vector<ci::Vec2f>&				getPoints() const;
+
+	// Contours enclosing less than "area" pixels are dropped.
+	void										setMinArea( float area );
+	// Passes of a 1-2-1 filter along each contour, which rounds off the 
+	// staircase of the pixel grid
+	void										setSmoothing( int32_t iterations );
+	// "tolerance" is the largest distance in pixels a removed point may 
+	// have from the simplified contour (Douglas-Peucker), or the smallest 
+	// triangle area in pixels a kept point spans with its neighbors 
+	// (Visvalingam).
+	void										setSimplify( int32_t method, float tolerance );
+protected:
+	ContourTracer( uint8_t labelCount );
+
+	void										simplifyDouglasPeucker( const std::vector<ci::Vec2f>& points );
+	void										simplifyVisvalingam( const std::vector<ci::Vec2f>& points );
+	void										smooth();
+	void										trace( int32_t x, int32_t y, int32_t edge, uint8_t label );
+
+	std::vector<Contour>						mContours;
+	uint8_t										mLabelCount;
+	float										mMinArea;
+	std::vector<ci::Vec2f>						mPoints;
+	int32_t										mSimplify;
+	float										mSimplifyTolerance;
+	int32_t										mSmoothing;
+
+	// Scratch space. "mPadded" is the label mask with a background border, 
+	// "mVisited" holds two bits per label and cell for the segments traced.
+	std::vector<std::pair<float, uint32_t> >	mHeap;
+	std::vector<uint8_t>						mKeep;
+	std::vector<uint32_t>						mNext;
+	std::vector<uint8_t>						mPadded;
+	int32_t										mPaddedWidth;
+	std::vector<uint32_t>						mPrevious;
+	std::vector<ci::Vec2f>						mRaw;
+	std::vector<ci::Vec2f>						mSmoothed;
+	std::vector<std::pair<size_t, size_t> >		mSpans;
+	std::vector<uint16_t>						mVisited;
+	std::vector<float>							mWeights;
+};
+
+}
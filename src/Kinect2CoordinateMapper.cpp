@@ -0,0 +1,461 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2CoordinateMapper.h"
+#if defined( CINDER_MSW )
+#include "Kinect2.h"
+#endif
+
+#include <cfloat>
+#include <cstdio>
+#include <emmintrin.h>
+#include <fstream>
+#include <limits>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+static const uint32_t kCalibrationMagic		= 0x4d43324b; // "K2CM"
+static const uint32_t kCalibrationVersion	= 1;
+
+// Camera space for "count" depth pixels, written as interleaved XYZ
+static void mapDepthRowToCamera( const uint16_t* depth, const float* tableX, const float* tableY, size_t count, float* output )
+{
+	const float negInf	= -numeric_limits<float>::infinity();
+	const __m128 scale	= _mm_set1_ps( 0.001f );
+	const __m128 inf	= _mm_set1_ps( negInf );
+	const __m128 zero	= _mm_setzero_ps();
+	const __m128i zeroi	= _mm_setzero_si128();
+
+	size_t i = 0;
+	for ( ; i + 4 <= count; i += 4, output += 12 ) {
+		__m128i d		= _mm_unpacklo_epi16( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( depth + i ) ), zeroi );
+		__m128 z		= _mm_mul_ps( _mm_cvtepi32_ps( d ), scale );
+		__m128 invalid	= _mm_cmpeq_ps( z, zero );
+		__m128 x		= _mm_mul_ps( _mm_loadu_ps( tableX + i ), z );
+		__m128 y		= _mm_mul_ps( _mm_loadu_ps( tableY + i ), z );
+		x				= _mm_or_ps( _mm_andnot_ps( invalid, x ), _mm_and_ps( invalid, inf ) );
+		y				= _mm_or_ps( _mm_andnot_ps( invalid, y ), _mm_and_ps( invalid, inf ) );
+		z				= _mm_or_ps( _mm_andnot_ps( invalid, z ), _mm_and_ps( invalid, inf ) );
+
+		// SoA to interleaved XYZ
+		__m128 t0 = _mm_unpacklo_ps( x, y );
+		__m128 t1 = _mm_unpackhi_ps( x, y );
+		__m128 a0 = _mm_shuffle_ps( z, t0, _MM_SHUFFLE( 2, 2, 0, 0 ) );
+		__m128 a1 = _mm_shuffle_ps( t0, z, _MM_SHUFFLE( 1, 1, 3, 3 ) );
+		__m128 a2 = _mm_shuffle_ps( z, t1, _MM_SHUFFLE( 2, 2, 2, 2 ) );
+		__m128 a3 = _mm_shuffle_ps( t1, z, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+		_mm_storeu_ps( output + 0, _mm_shuffle_ps( t0, a0, _MM_SHUFFLE( 2, 0, 1, 0 ) ) );
+		_mm_storeu_ps( output + 4, _mm_shuffle_ps( a1, t1, _MM_SHUFFLE( 1, 0, 2, 0 ) ) );
+		_mm_storeu_ps( output + 8, _mm_shuffle_ps( a2, a3, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+	}
+	for ( ; i < count; ++i, output += 3 ) {
+		if ( depth[ i ] == 0 ) {
+			output[ 0 ] = negInf;
+			output[ 1 ] = negInf;
+			output[ 2 ] = negInf;
+		} else {
+			float z		= (float)depth[ i ] * 0.001f;
+			output[ 0 ]	= tableX[ i ] * z;
+			output[ 1 ]	= tableY[ i ] * z;
+			output[ 2 ]	= z;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+#if defined( CINDER_MSW )
+CoordinateMapperRef CoordinateMapper::create( ICoordinateMapper* mapper )
+{
+	CoordinateMapperRef coordinateMapper( new CoordinateMapper() );
+
+	CameraIntrinsics intrinsics;
+	long hr = mapper->GetDepthCameraIntrinsics( &intrinsics );
+	if ( FAILED( hr ) || intrinsics.FocalLengthX <= 0.0f ) {
+		throw ExcMapperNotReady( hr );
+	}
+	coordinateMapper->mDepthProjection = toCameraProjection( intrinsics );
+	coordinateMapper->mColorProjection = calcColorProjection( mapper );
+
+	UINT32 tableSize	= 0;
+	PointF* table		= 0;
+	hr = mapper->GetDepthFrameToCameraSpaceTable( &tableSize, &table );
+	if ( FAILED( hr ) || tableSize != (UINT32)( coordinateMapper->mDepthWidth * coordinateMapper->mDepthHeight ) ) {
+		if ( table != 0 ) {
+			::CoTaskMemFree( table );
+		}
+		throw ExcMapperNotReady( hr );
+	}
+	for ( UINT32 i = 0; i < tableSize; ++i ) {
+		coordinateMapper->mCameraTable[ 0 ][ i ] = table[ i ].X;
+		coordinateMapper->mCameraTable[ 1 ][ i ] = table[ i ].Y;
+	}
+	::CoTaskMemFree( table );
+
+	// Sample every pixel at two distances and solve u = a + b / z
+	static const float kNear	= 1.0f;
+	static const float kFar		= 4.0f;
+	vector<DepthSpacePoint> depthPoints( tableSize );
+	vector<UINT16> depthNear( tableSize, (UINT16)( kNear * 1000.0f ) );
+	vector<UINT16> depthFar( tableSize, (UINT16)( kFar * 1000.0f ) );
+	vector<ColorSpacePoint> colorNear( tableSize );
+	vector<ColorSpacePoint> colorFar( tableSize );
+	for ( int32_t y = 0; y < coordinateMapper->mDepthHeight; ++y ) {
+		for ( int32_t x = 0; x < coordinateMapper->mDepthWidth; ++x ) {
+			DepthSpacePoint& p	= depthPoints[ y * coordinateMapper->mDepthWidth + x ];
+			p.X					= (float)x;
+			p.Y					= (float)y;
+		}
+	}
+	hr = mapper->MapDepthPointsToColorSpace( tableSize, &depthPoints[ 0 ], tableSize, &depthNear[ 0 ], tableSize, &colorNear[ 0 ] );
+	if ( SUCCEEDED( hr ) ) {
+		hr = mapper->MapDepthPointsToColorSpace( tableSize, &depthPoints[ 0 ], tableSize, &depthFar[ 0 ], tableSize, &colorFar[ 0 ] );
+	}
+	if ( FAILED( hr ) ) {
+		throw ExcMapperNotReady( hr );
+	}
+	
+	float invRange = 1.0f / ( 1.0f / kNear - 1.0f / kFar );
+	for ( UINT32 i = 0; i < tableSize; ++i ) {
+		float n[ 2 ] = { colorNear[ i ].X, colorNear[ i ].Y };
+		float f[ 2 ] = { colorFar[ i ].X, colorFar[ i ].Y };
+		for ( size_t c = 0; c < 2; ++c ) {
+			if ( n[ c ] > -FLT_MAX && n[ c ] < FLT_MAX && f[ c ] > -FLT_MAX && f[ c ] < FLT_MAX ) {
+				float b									= ( n[ c ] - f[ c ] ) * invRange;
+				coordinateMapper->mColorTableA[ c ][ i ]	= n[ c ] - b / kNear;
+				coordinateMapper->mColorTableB[ c ][ i ]	= b;
+			} else {
+				coordinateMapper->mColorTableA[ c ][ i ]	= -numeric_limits<float>::infinity();
+				coordinateMapper->mColorTableB[ c ][ i ]	= 0.0f;
+			}
+		}
+	}
+
+	return coordinateMapper;
+}
+#endif
+
+CoordinateMapperRef CoordinateMapper::create( const fs::path& path )
+{
+	CoordinateMapperRef coordinateMapper( new CoordinateMapper() );
+	coordinateMapper->read( path );
+	return coordinateMapper;
+}
+
+CoordinateMapperRef CoordinateMapper::create( const CameraProjection& depthProjection, const CameraProjection& colorProjection )
+{
+	CoordinateMapperRef coordinateMapper( new CoordinateMapper() );
+	coordinateMapper->mDepthProjection = depthProjection;
+	coordinateMapper->mColorProjection = colorProjection;
+
+	const float* k	= depthProjection.mRadialDistortion;
+	const float* kc	= colorProjection.mRadialDistortion;
+	for ( int32_t y = 0; y < coordinateMapper->mDepthHeight; ++y ) {
+		for ( int32_t x = 0; x < coordinateMapper->mDepthWidth; ++x ) {
+			size_t i = (size_t)( y * coordinateMapper->mDepthWidth + x );
+
+			// Undistort by fixed point iteration, which converges quickly 
+			// for the mild distortion of depth cameras
+			float u		= ( (float)x - depthProjection.mPrincipalPoint.x ) / depthProjection.mFocalLength.x;
+			float v		= ( (float)y - depthProjection.mPrincipalPoint.y ) / depthProjection.mFocalLength.y;
+			float nx	= u;
+			float ny	= v;
+			for ( size_t j = 0; j < 20; ++j ) {
+				float r2	= nx * nx + ny * ny;
+				float d		= 1.0f + r2 * ( k[ 0 ] + r2 * ( k[ 1 ] + r2 * k[ 2 ] ) );
+				nx			= u / d;
+				ny			= v / d;
+			}
+			coordinateMapper->mCameraTable[ 0 ][ i ] = nx;
+			coordinateMapper->mCameraTable[ 1 ][ i ] = ny;
+
+			// The color projection of a point at depth z along this ray is 
+			// exactly u = a + b / z
+			float r2	= nx * nx + ny * ny;
+			float d		= 1.0f + r2 * ( kc[ 0 ] + r2 * ( kc[ 1 ] + r2 * kc[ 2 ] ) );
+			coordinateMapper->mColorTableA[ 0 ][ i ]	= colorProjection.mPrincipalPoint.x + colorProjection.mFocalLength.x * nx * d;
+			coordinateMapper->mColorTableA[ 1 ][ i ]	= colorProjection.mPrincipalPoint.y + colorProjection.mFocalLength.y * ny * d;
+			coordinateMapper->mColorTableB[ 0 ][ i ]	= colorProjection.mOffset.x;
+			coordinateMapper->mColorTableB[ 1 ][ i ]	= colorProjection.mOffset.y;
+		}
+	}
+	return coordinateMapper;
+}
+
+CoordinateMapper::CoordinateMapper()
+: mDepthHeight( 424 ), mDepthWidth( 512 )
+{
+	size_t count = mDepthWidth * mDepthHeight;
+	for ( size_t c = 0; c < 2; ++c ) {
+		mCameraTable[ c ].resize( count, 0.0f );
+		mColorTableA[ c ].resize( count, 0.0f );
+		mColorTableB[ c ].resize( count, 0.0f );
+	}
+}
+
+static void writeProjection( ofstream& stream, const CameraProjection& projection )
+{
+	float v[ 9 ] = {
+		projection.mFocalLength.x, projection.mFocalLength.y, 
+		projection.mOffset.x, projection.mOffset.y, 
+		projection.mPrincipalPoint.x, projection.mPrincipalPoint.y, 
+		projection.mRadialDistortion[ 0 ], projection.mRadialDistortion[ 1 ], projection.mRadialDistortion[ 2 ]
+	};
+	stream.write( reinterpret_cast<const char*>( v ), sizeof( v ) );
+}
+
+static void readProjection( ifstream& stream, CameraProjection& projection )
+{
+	float v[ 9 ];
+	stream.read( reinterpret_cast<char*>( v ), sizeof( v ) );
+	projection.mFocalLength				= Vec2f( v[ 0 ], v[ 1 ] );
+	projection.mOffset					= Vec2f( v[ 2 ], v[ 3 ] );
+	projection.mPrincipalPoint			= Vec2f( v[ 4 ], v[ 5 ] );
+	projection.mRadialDistortion[ 0 ]	= v[ 6 ];
+	projection.mRadialDistortion[ 1 ]	= v[ 7 ];
+	projection.mRadialDistortion[ 2 ]	= v[ 8 ];
+}
+
+void CoordinateMapper::save( const fs::path& path ) const
+{
+	ofstream stream( path.string().c_str(), ios::binary );
+	if ( !stream ) {
+		throw ExcCalibrationWriteFailed( path.string() );
+	}
+
+	uint32_t header[ 2 ]	= { kCalibrationMagic, kCalibrationVersion };
+	int32_t size[ 2 ]		= { mDepthWidth, mDepthHeight };
+	stream.write( reinterpret_cast<const char*>( header ), sizeof( header ) );
+	stream.write( reinterpret_cast<const char*>( size ), sizeof( size ) );
+	writeProjection( stream, mDepthProjection );
+	writeProjection( stream, mColorProjection );
+
+	streamsize bytes = mDepthWidth * mDepthHeight * sizeof( float );
+	for ( size_t c = 0; c < 2; ++c ) {
+		stream.write( reinterpret_cast<const char*>( &mCameraTable[ c ][ 0 ] ), bytes );
+		stream.write( reinterpret_cast<const char*>( &mColorTableA[ c ][ 0 ] ), bytes );
+		stream.write( reinterpret_cast<const char*>( &mColorTableB[ c ][ 0 ] ), bytes );
+	}
+	if ( !stream ) {
+		throw ExcCalibrationWriteFailed( path.string() );
+	}
+}
+
+void CoordinateMapper::read( const fs::path& path )
+{
+	ifstream stream( path.string().c_str(), ios::binary );
+	uint32_t header[ 2 ]	= { 0, 0 };
+	int32_t size[ 2 ]		= { 0, 0 };
+	stream.read( reinterpret_cast<char*>( header ), sizeof( header ) );
+	stream.read( reinterpret_cast<char*>( size ), sizeof( size ) );
+	if ( !stream || header[ 0 ] != kCalibrationMagic || header[ 1 ] != kCalibrationVersion || 
+		size[ 0 ] != mDepthWidth || size[ 1 ] != mDepthHeight ) {
+		throw ExcCalibrationReadFailed( path.string() );
+	}
+	readProjection( stream, mDepthProjection );
+	readProjection( stream, mColorProjection );
+
+	streamsize bytes = mDepthWidth * mDepthHeight * sizeof( float );
+	for ( size_t c = 0; c < 2; ++c ) {
+		stream.read( reinterpret_cast<char*>( &mCameraTable[ c ][ 0 ] ), bytes );
+		stream.read( reinterpret_cast<char*>( &mColorTableA[ c ][ 0 ] ), bytes );
+		stream.read( reinterpret_cast<char*>( &mColorTableB[ c ][ 0 ] ), bytes );
+	}
+	if ( !stream ) {
+		throw ExcCalibrationReadFailed( path.string() );
+	}
+}
+
+int32_t CoordinateMapper::getDepthWidth() const
+{
+	return mDepthWidth;
+}
+
+int32_t CoordinateMapper::getDepthHeight() const
+{
+	return mDepthHeight;
+}
+
+const CameraProjection& CoordinateMapper::getColorProjection() const
+{
+	return mColorProjection;
+}
+
+const CameraProjection& CoordinateMapper::getDepthProjection() const
+{
+	return mDepthProjection;
+}
+
+const float* CoordinateMapper::getDepthToCameraTableX() const
+{
+	return &mCameraTable[ 0 ][ 0 ];
+}
+
+const float* CoordinateMapper::getDepthToCameraTableY() const
+{
+	return &mCameraTable[ 1 ][ 0 ];
+}
+
+void CoordinateMapper::mapDepthFrameToCamera( const uint16_t* depth, Vec3f* points ) const
+{
+	mapDepthRowToCamera( depth, &mCameraTable[ 0 ][ 0 ], &mCameraTable[ 1 ][ 0 ], 
+		mDepthWidth * mDepthHeight, reinterpret_cast<float*>( points ) );
+}
+
+Surface32f CoordinateMapper::mapDepthFrameToCamera( const Channel16u& depth ) const
+{
+	Surface32f surface;
+	if ( !depth || depth.getWidth() != mDepthWidth || depth.getHeight() != mDepthHeight ) {
+		return surface;
+	}
+	surface = Surface32f( mDepthWidth, mDepthHeight, false, SurfaceChannelOrder::RGB );
+	for ( int32_t y = 0; y < mDepthHeight; ++y ) {
+		const uint16_t* row	= depth.getData( Vec2i( 0, y ) );
+		float* output		= surface.getData( Vec2i( 0, y ) );
+		size_t offset		= y * mDepthWidth;
+		mapDepthRowToCamera( row, &mCameraTable[ 0 ][ offset ], &mCameraTable[ 1 ][ offset ], mDepthWidth, output );
+	}
+	return surface;
+}
+
+void CoordinateMapper::mapDepthFrameToColor( const uint16_t* depth, Vec2f* points ) const
+{
+	const float negInf		= -numeric_limits<float>::infinity();
+	const __m128 thousand	= _mm_set1_ps( 1000.0f );
+	const __m128 inf		= _mm_set1_ps( negInf );
+	const __m128 zero		= _mm_setzero_ps();
+	const __m128i zeroi		= _mm_setzero_si128();
+	const float* au			= &mColorTableA[ 0 ][ 0 ];
+	const float* av			= &mColorTableA[ 1 ][ 0 ];
+	const float* bu			= &mColorTableB[ 0 ][ 0 ];
+	const float* bv			= &mColorTableB[ 1 ][ 0 ];
+	float* output			= reinterpret_cast<float*>( points );
+	size_t count			= mDepthWidth * mDepthHeight;
+
+	size_t i = 0;
+	for ( ; i + 4 <= count; i += 4, output += 8 ) {
+		__m128i d16		= _mm_loadl_epi64( reinterpret_cast<const __m128i*>( depth + i ) );
+		__m128 d		= _mm_cvtepi32_ps( _mm_unpacklo_epi16( d16, zeroi ) );
+		__m128 invalid	= _mm_cmpeq_ps( d, zero );
+		__m128 invZ		= _mm_div_ps( thousand, _mm_or_ps( d, _mm_and_ps( invalid, thousand ) ) );
+		__m128 u		= _mm_add_ps( _mm_loadu_ps( au + i ), _mm_mul_ps( _mm_loadu_ps( bu + i ), invZ ) );
+		__m128 v		= _mm_add_ps( _mm_loadu_ps( av + i ), _mm_mul_ps( _mm_loadu_ps( bv + i ), invZ ) );
+		u				= _mm_or_ps( _mm_andnot_ps( invalid, u ), _mm_and_ps( invalid, inf ) );
+		v				= _mm_or_ps( _mm_andnot_ps( invalid, v ), _mm_and_ps( invalid, inf ) );
+		_mm_storeu_ps( output + 0, _mm_unpacklo_ps( u, v ) );
+		_mm_storeu_ps( output + 4, _mm_unpackhi_ps( u, v ) );
+	}
+	for ( ; i < count; ++i, output += 2 ) {
+		if ( depth[ i ] == 0 ) {
+			output[ 0 ] = negInf;
+			output[ 1 ] = negInf;
+		} else {
+			float invZ	= 1000.0f / (float)depth[ i ];
+			output[ 0 ]	= au[ i ] + bu[ i ] * invZ;
+			output[ 1 ]	= av[ i ] + bv[ i ] * invZ;
+		}
+	}
+}
+
+Vec2f CoordinateMapper::mapCameraPointToColor( const Vec3f& v ) const
+{
+	return mColorProjection.project( v );
+}
+
+Vec2f CoordinateMapper::mapCameraPointToDepth( const Vec3f& v ) const
+{
+	return mDepthProjection.project( v );
+}
+
+Vec3f CoordinateMapper::mapDepthPointToCamera( const Vec2i& v, uint16_t depth ) const
+{
+	if ( depth == 0 || v.x < 0 || v.y < 0 || v.x >= mDepthWidth || v.y >= mDepthHeight ) {
+		float negInf = -numeric_limits<float>::infinity();
+		return Vec3f( negInf, negInf, negInf );
+	}
+	size_t i	= v.y * mDepthWidth + v.x;
+	float z		= (float)depth * 0.001f;
+	return Vec3f( mCameraTable[ 0 ][ i ] * z, mCameraTable[ 1 ][ i ] * z, z );
+}
+
+Vec2f CoordinateMapper::mapDepthPointToColor( const Vec2i& v, uint16_t depth ) const
+{
+	if ( depth == 0 || v.x < 0 || v.y < 0 || v.x >= mDepthWidth || v.y >= mDepthHeight ) {
+		float negInf = -numeric_limits<float>::infinity();
+		return Vec2f( negInf, negInf );
+	}
+	size_t i	= v.y * mDepthWidth + v.x;
+	float invZ	= 1000.0f / (float)depth;
+	return Vec2f( mColorTableA[ 0 ][ i ] + mColorTableB[ 0 ][ i ] * invZ, mColorTableA[ 1 ][ i ] + mColorTableB[ 1 ][ i ] * invZ );
+}
+
+void CoordinateMapper::mapCameraPointsToColor( const Vec3f* points, size_t count, Vec2f* output ) const
+{
+	mColorProjection.project( points, count, output );
+}
+
+void CoordinateMapper::mapCameraPointsToDepth( const Vec3f* points, size_t count, Vec2f* output ) const
+{
+	mDepthProjection.project( points, count, output );
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+const char* CoordinateMapper::Exception::what() const throw()
+{
+	return mMessage;
+}
+
+CoordinateMapper::ExcCalibrationReadFailed::ExcCalibrationReadFailed( const string& path ) throw()
+{
+	sprintf( mMessage, "Unable to read calibration file: %s", path.c_str() );
+}
+
+CoordinateMapper::ExcCalibrationWriteFailed::ExcCalibrationWriteFailed( const string& path ) throw()
+{
+	sprintf( mMessage, "Unable to write calibration file: %s", path.c_str() );
+}
+
+CoordinateMapper::ExcMapperNotReady::ExcMapperNotReady( long hr ) throw()
+{
+	sprintf( mMessage, "Coordinate mapper has no calibration yet. Error: %i", hr );
+}
+
+}
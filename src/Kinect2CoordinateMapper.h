@@ -0,0 +1,145 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2Projection.h"
+#include "cinder/Cinder.h"
+#include "cinder/Exception.h"
+#include "cinder/Filesystem.h"
+#include "cinder/Surface.h"
+#include <memory>
+#include <vector>
+
+struct ICoordinateMapper;
+
+namespace Kinect2 {
+
+class CoordinateMapper;
+typedef std::shared_ptr<CoordinateMapper> CoordinateMapperRef;
+
+// CPU reproduction of the sensor's ICoordinateMapper. The calibration is 
+// captured once from a live mapper and can be written to disk, so mapping 
+// works on recorded data, before the sensor's mapper becomes valid, or 
+// without a sensor at all. Frame and point batch mappings have SSE2 
+// paths. Only capturing calibration needs the Kinect SDK; everything else 
+// builds on any platform Cinder does.
+class CoordinateMapper
+{
+public:
+#if defined( CINDER_MSW )
+	// Captures calibration from a live mapper. Throws ExcMapperNotReady if 
+	// the sensor has not reported its intrinsics yet.
+	static CoordinateMapperRef					create( ICoordinateMapper* mapper );
+#endif
+	static CoordinateMapperRef					create( const ci::fs::path& path );
+	// Builds the tables from camera models alone, for synthetic data and 
+	// benchmarks. The depth camera is taken to sit at the camera space 
+	// origin, so "depthProjection"'s offset is ignored.
+	static CoordinateMapperRef					create( const CameraProjection& depthProjection, const CameraProjection& colorProjection );
+
+	void										save( const ci::fs::path& path ) const;
+
+	int32_t										getDepthWidth() const;
+	int32_t										getDepthHeight() const;
+	const CameraProjection&						getColorProjection() const;
+	const CameraProjection&						getDepthProjection() const;
+
+	// Per-pixel camera space X and Y at a depth of one meter.
+	const float*								getDepthToCameraTableX() const;
+	const float*								getDepthToCameraTableY() const;
+
+	// Equivalents of MapDepthFrameToCameraSpace and MapDepthFrameToColorSpace. 
+	// "depth" holds getDepthWidth() * getDepthHeight() millimeter values. 
+	// Pixels without depth map to negative infinity, as with the SDK.
+	void										mapDepthFrameToCamera( const uint16_t* depth, ci::Vec3f* points ) const;
+	void										mapDepthFrameToColor( const uint16_t* depth, ci::Vec2f* points ) const;
+	ci::Surface32f								mapDepthFrameToCamera( const ci::Channel16u& depth ) const;
+
+	ci::Vec2f									mapCameraPointToColor( const ci::Vec3f& v ) const;
+	ci::Vec2f									mapCameraPointToDepth( const ci::Vec3f& v ) const;
+	ci::Vec3f									mapDepthPointToCamera( const ci::Vec2i& v, uint16_t depth ) const;
+	ci::Vec2f									mapDepthPointToColor( const ci::Vec2i& v, uint16_t depth ) const;
+	void										mapCameraPointsToColor( const ci::Vec3f* points, size_t count, ci::Vec2f* output ) const;
+	void										mapCameraPointsToDepth( const ci::Vec3f* points, size_t count, ci::Vec2f* output ) const;
+protected:
+	CoordinateMapper();
+
+	void										read( const ci::fs::path& path );
+
+	CameraProjection							mColorProjection;
+	CameraProjection							mDepthProjection;
+	int32_t										mDepthHeight;
+	int32_t										mDepthWidth;
+
+	// Depth pixel to color pixel is u = a + b / z per pixel, z in meters
+	std::vector<float>							mColorTableA[ 2 ];
+	std::vector<float>							mColorTableB[ 2 ];
+	std::vector<float>							mCameraTable[ 2 ];
+public:
+
+	//////////////////////////////////////////////////////////////////////////////////////////////
+
+	class Exception : public ci::Exception
+	{
+	public:
+		const char* what() const throw();
+	protected:
+		char									mMessage[ 2048 ];
+		friend class							CoordinateMapper;
+	};
+
+	class ExcCalibrationReadFailed : public Exception 
+	{
+	public:
+		ExcCalibrationReadFailed( const std::string& path ) throw();
+	};
+
+	class ExcCalibrationWriteFailed : public Exception 
+	{
+	public:
+		ExcCalibrationWriteFailed( const std::string& path ) throw();
+	};
+
+	class ExcMapperNotReady : public Exception 
+	{
+	public:
+		ExcMapperNotReady( long hr ) throw();
+	};
+};
+
+}
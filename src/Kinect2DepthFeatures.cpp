@@ -0,0 +1,298 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2DepthFeatures.h"
+
+#include <cmath>
+#include <emmintrin.h>
+#include <limits>
+#include <ppl.h>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+// Approximate focal length of the depth camera in pixels, used to turn the 
+// window size in meters into a radius in pixels
+static const float kDepthFocalLength	= 365.0f;
+static const int32_t kTileSize			= 32;
+
+DepthFeaturesRef DepthFeatures::create( float windowSize, int32_t minRadius, int32_t maxRadius )
+{
+	return DepthFeaturesRef( new DepthFeatures( windowSize, minRadius, maxRadius ) );
+}
+
+DepthFeatures::DepthFeatures( float windowSize, int32_t minRadius, int32_t maxRadius )
+: mHeight( 0 ), mMaxRadius( max( maxRadius, 1 ) ), mMinRadius( max( minRadius, 1 ) ), mWidth( 0 ), 
+mWindowSize( windowSize )
+{
+	mMinRadius = min( mMinRadius, mMaxRadius );
+}
+
+void DepthFeatures::update( const Surface32f& points )
+{
+	if ( !points ) {
+		return;
+	}
+	if ( points.getWidth() != mWidth || points.getHeight() != mHeight ) {
+		mWidth		= points.getWidth();
+		mHeight		= points.getHeight();
+		mCurvature	= Channel32f( mWidth, mHeight );
+		mNormals	= Surface32f( mWidth, mHeight, false, SurfaceChannelOrder::RGB );
+		mIntegral.assign( Plane_Total * ( mWidth + 1 ) * ( mHeight + 1 ), 0.0 );
+	}
+	buildIntegral( points );
+
+	int32_t tilesX		= ( mWidth + kTileSize - 1 ) / kTileSize;
+	int32_t tilesY		= ( mHeight + kTileSize - 1 ) / kTileSize;
+	float radiusScale	= mWindowSize * 0.5f * kDepthFocalLength;
+	concurrency::parallel_for( 0, tilesX * tilesY, [ & ]( int32_t tile )
+	{
+		int32_t x0 = ( tile % tilesX ) * kTileSize;
+		int32_t y0 = ( tile / tilesX ) * kTileSize;
+		int32_t x1 = min( x0 + kTileSize, mWidth );
+		int32_t y1 = min( y0 + kTileSize, mHeight );
+		double sums[ Plane_Total ];
+		for ( int32_t y = y0; y < y1; ++y ) {
+			const float* p	= points.getData( Vec2i( x0, y ) );
+			float* n		= mNormals.getData( Vec2i( x0, y ) );
+			float* c		= mCurvature.getData( Vec2i( x0, y ) );
+			for ( int32_t x = x0; x < x1; ++x, p += points.getPixelInc(), n += mNormals.getPixelInc(), ++c ) {
+				n[ 0 ]	= 0.0f;
+				n[ 1 ]	= 0.0f;
+				n[ 2 ]	= 0.0f;
+				*c		= 0.0f;
+
+				float z = p[ 2 ];
+				if ( !( z > 0.0f ) || z == numeric_limits<float>::infinity() ) {
+					continue;
+				}
+				int32_t r = (int32_t)( radiusScale / z + 0.5f );
+				r = max( mMinRadius, min( r, mMaxRadius ) );
+				calcBoxSums( max( x - r, 0 ), max( y - r, 0 ), min( x + r + 1, mWidth ), min( y + r + 1, mHeight ), sums );
+
+				// Windows that are mostly holes or cut off by an edge give 
+				// unreliable planes.
+				double count = sums[ Plane_Count ];
+				if ( count < 3.0 || count < (double)( ( r + 1 ) * ( r + 1 ) ) ) {
+					continue;
+				}
+
+				double inv	= 1.0 / count;
+				double mx	= sums[ Plane_X ] * inv;
+				double my	= sums[ Plane_Y ] * inv;
+				double mz	= sums[ Plane_Z ] * inv;
+				double a00	= sums[ Plane_XX ] * inv - mx * mx;
+				double a01	= sums[ Plane_XY ] * inv - mx * my;
+				double a02	= sums[ Plane_XZ ] * inv - mx * mz;
+				double a11	= sums[ Plane_YY ] * inv - my * my;
+				double a12	= sums[ Plane_YZ ] * inv - my * mz;
+				double a22	= sums[ Plane_ZZ ] * inv - mz * mz;
+
+				// Smallest eigenvalue by Newton's method on the characteristic 
+				// polynomial, starting from zero. The covariance is positive 
+				// semi-definite, so the iteration approaches the smallest root 
+				// from below without overshooting. On surfaces the first step 
+				// already lands close to it.
+				double trace	= a00 + a11 + a22;
+				double minors	= a00 * a11 - a01 * a01 + a00 * a22 - a02 * a02 + a11 * a22 - a12 * a12;
+				double det		= a00 * ( a11 * a22 - a12 * a12 ) - a01 * ( a01 * a22 - a12 * a02 ) + a02 * ( a01 * a12 - a11 * a02 );
+				if ( trace <= 0.0 ) {
+					continue;
+				}
+				double e0 = 0.0;
+				for ( size_t i = 0; i < 8; ++i ) {
+					double f		= det - e0 * ( minors - e0 * ( trace - e0 ) );
+					double slope	= -minors + e0 * ( 2.0 * trace - 3.0 * e0 );
+					if ( slope >= 0.0 ) {
+						break;
+					}
+					double step = f / slope;
+					e0 -= step;
+					if ( step > -trace * 1e-7 ) {
+						break;
+					}
+				}
+
+				// The normal is the eigenvector of the smallest eigenvalue, 
+				// taken from the best conditioned cross product of the rows 
+				// of A - e0 * I.
+				double r0[ 3 ] = { a00 - e0, a01, a02 };
+				double r1[ 3 ] = { a01, a11 - e0, a12 };
+				double r2[ 3 ] = { a02, a12, a22 - e0 };
+				double v[ 3 ][ 3 ] = {
+					{ r0[ 1 ] * r1[ 2 ] - r0[ 2 ] * r1[ 1 ], r0[ 2 ] * r1[ 0 ] - r0[ 0 ] * r1[ 2 ], r0[ 0 ] * r1[ 1 ] - r0[ 1 ] * r1[ 0 ] }, 
+					{ r0[ 1 ] * r2[ 2 ] - r0[ 2 ] * r2[ 1 ], r0[ 2 ] * r2[ 0 ] - r0[ 0 ] * r2[ 2 ], r0[ 0 ] * r2[ 1 ] - r0[ 1 ] * r2[ 0 ] }, 
+					{ r1[ 1 ] * r2[ 2 ] - r1[ 2 ] * r2[ 1 ], r1[ 2 ] * r2[ 0 ] - r1[ 0 ] * r2[ 2 ], r1[ 0 ] * r2[ 1 ] - r1[ 1 ] * r2[ 0 ] }
+				};
+				size_t best		= 0;
+				double bestLen	= 0.0;
+				for ( size_t i = 0; i < 3; ++i ) {
+					double len = v[ i ][ 0 ] * v[ i ][ 0 ] + v[ i ][ 1 ] * v[ i ][ 1 ] + v[ i ][ 2 ] * v[ i ][ 2 ];
+					if ( len > bestLen ) {
+						best	= i;
+						bestLen	= len;
+					}
+				}
+				if ( bestLen <= 0.0 ) {
+					continue;
+				}
+
+				double scale = 1.0 / sqrt( bestLen );
+				if ( v[ best ][ 0 ] * p[ 0 ] + v[ best ][ 1 ] * p[ 1 ] + v[ best ][ 2 ] * p[ 2 ] > 0.0 ) {
+					scale = -scale;
+				}
+				n[ 0 ]	= (float)( v[ best ][ 0 ] * scale );
+				n[ 1 ]	= (float)( v[ best ][ 1 ] * scale );
+				n[ 2 ]	= (float)( v[ best ][ 2 ] * scale );
+				*c		= (float)max( 0.0, e0 / trace );
+			}
+		}
+	} );
+}
+
+void DepthFeatures::buildIntegral( const Surface32f& points )
+{
+	size_t rowSize = ( mWidth + 1 ) * Plane_Total;
+
+	// Rows are summed independently, then each row adds the one above it. 
+	// The planes of a cell are interleaved so that a box lookup touches 
+	// four cells instead of forty scattered values.
+	concurrency::parallel_for( 0, mHeight, [ & ]( int32_t y )
+	{
+		double sums[ Plane_Total ] = { 0.0 };
+		const float* p	= points.getData( Vec2i( 0, y ) );
+		double* cell	= &mIntegral[ ( y + 1 ) * rowSize + Plane_Total ];
+		for ( int32_t x = 0; x < mWidth; ++x, p += points.getPixelInc(), cell += Plane_Total ) {
+			float z = p[ 2 ];
+			if ( z > 0.0f && z != numeric_limits<float>::infinity() ) {
+				double px				= p[ 0 ];
+				double py				= p[ 1 ];
+				double pz				= z;
+				sums[ Plane_Count ]		+= 1.0;
+				sums[ Plane_X ]			+= px;
+				sums[ Plane_Y ]			+= py;
+				sums[ Plane_Z ]			+= pz;
+				sums[ Plane_XX ]		+= px * px;
+				sums[ Plane_XY ]		+= px * py;
+				sums[ Plane_XZ ]		+= px * pz;
+				sums[ Plane_YY ]		+= py * py;
+				sums[ Plane_YZ ]		+= py * pz;
+				sums[ Plane_ZZ ]		+= pz * pz;
+			}
+			memcpy( cell, sums, sizeof( sums ) );
+		}
+	} );
+
+	// Rows depend on each other, so the columns are split into strips 
+	// instead.
+	static const size_t kStripSize = 256;
+	size_t stripCount = ( rowSize + kStripSize - 1 ) / kStripSize;
+	concurrency::parallel_for( (size_t)0, stripCount, [ & ]( size_t strip )
+	{
+		size_t begin	= strip * kStripSize;
+		size_t end		= min( begin + kStripSize, rowSize );
+		for ( int32_t y = 2; y <= mHeight; ++y ) {
+			const double* above	= &mIntegral[ ( y - 1 ) * rowSize ];
+			double* row			= &mIntegral[ y * rowSize ];
+			size_t i			= begin;
+			for ( ; i + 2 <= end; i += 2 ) {
+				_mm_storeu_pd( row + i, _mm_add_pd( _mm_loadu_pd( row + i ), _mm_loadu_pd( above + i ) ) );
+			}
+			for ( ; i < end; ++i ) {
+				row[ i ] += above[ i ];
+			}
+		}
+	} );
+}
+
+void DepthFeatures::calcBoxSums( int32_t x1, int32_t y1, int32_t x2, int32_t y2, double* sums ) const
+{
+	size_t rowSize		= ( mWidth + 1 ) * Plane_Total;
+	const double* a		= &mIntegral[ y1 * rowSize + x1 * Plane_Total ];
+	const double* b		= &mIntegral[ y1 * rowSize + x2 * Plane_Total ];
+	const double* c		= &mIntegral[ y2 * rowSize + x1 * Plane_Total ];
+	const double* d		= &mIntegral[ y2 * rowSize + x2 * Plane_Total ];
+	for ( size_t i = 0; i < Plane_Total; i += 2 ) {
+		__m128d v = _mm_add_pd( _mm_sub_pd( _mm_loadu_pd( d + i ), _mm_loadu_pd( b + i ) ), 
+			_mm_sub_pd( _mm_loadu_pd( a + i ), _mm_loadu_pd( c + i ) ) );
+		_mm_storeu_pd( sums + i, v );
+	}
+}
+
+uint32_t DepthFeatures::calcMean( const Area& area, Vec3f& mean ) const
+{
+	int32_t x1 = max( area.x1, 0 );
+	int32_t y1 = max( area.y1, 0 );
+	int32_t x2 = min( area.x2, mWidth );
+	int32_t y2 = min( area.y2, mHeight );
+	mean = Vec3f::zero();
+	if ( mIntegral.empty() || x2 <= x1 || y2 <= y1 ) {
+		return 0;
+	}
+
+	double sums[ Plane_Total ];
+	calcBoxSums( x1, y1, x2, y2, sums );
+	if ( sums[ Plane_Count ] > 0.0 ) {
+		double inv	= 1.0 / sums[ Plane_Count ];
+		mean		= Vec3f( (float)( sums[ Plane_X ] * inv ), (float)( sums[ Plane_Y ] * inv ), (float)( sums[ Plane_Z ] * inv ) );
+	}
+	return (uint32_t)sums[ Plane_Count ];
+}
+
+const Channel32f& DepthFeatures::getCurvature() const
+{
+	return mCurvature;
+}
+
+const Surface32f& DepthFeatures::getNormals() const
+{
+	return mNormals;
+}
+
+float DepthFeatures::getWindowSize() const
+{
+	return mWindowSize;
+}
+
+void DepthFeatures::setWindowSize( float windowSize )
+{
+	mWindowSize = windowSize;
+}
+
+}
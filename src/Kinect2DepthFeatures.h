@@ -0,0 +1,101 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2.h"
+#include "cinder/Area.h"
+
+namespace Kinect2 {
+
+class DepthFeatures;
+typedef std::shared_ptr<DepthFeatures>	DepthFeaturesRef;
+
+// Per-pixel surface normals and curvature from a camera space point map, 
+// such as the one returned by mapDepthFrameToCamera(). Integral images of 
+// the points and their products give the mean and covariance of any 
+// window with a handful of lookups, so the cost per pixel does not depend 
+// on the window size. The window covers a fixed size in meters and 
+// shrinks in pixels as the distance grows.
+class DepthFeatures
+{
+public:
+	// "windowSize" is the window's edge length in meters. Its radius in 
+	// pixels is clamped to "minRadius" and "maxRadius".
+	static DepthFeaturesRef						create( float windowSize = 0.05f, int32_t minRadius = 1, int32_t maxRadius = 12 );
+
+	// Buffers are reused while the point map size stays the same.
+	void										update( const ci::Surface32f& points );
+
+	// Surface variation, smallest covariance eigenvalue over their sum. 0 
+	// is flat, 1/3 is isotropic. Pixels without a normal are 0.
+	const ci::Channel32f&						getCurvature() const;
+	// Unit normals facing the sensor, XYZ in RGB. Pixels without depth or 
+	// with too few valid neighbours are zero.
+	const ci::Surface32f&						getNormals() const;
+
+	// Mean of the valid points in "area" from the integral images of the 
+	// last update(). Returns the number of valid points.
+	uint32_t									calcMean( const ci::Area& area, ci::Vec3f& mean ) const;
+
+	float										getWindowSize() const;
+	void										setWindowSize( float windowSize );
+protected:
+	// Count, X, Y, Z, then the products XX, XY, XZ, YY, YZ, ZZ
+	enum : size_t
+	{
+		Plane_Count, Plane_X, Plane_Y, Plane_Z, Plane_XX, Plane_XY, Plane_XZ, 
+		Plane_YY, Plane_YZ, Plane_ZZ, Plane_Total
+	};
+
+	DepthFeatures( float windowSize, int32_t minRadius, int32_t maxRadius );
+
+	void										buildIntegral( const ci::Surface32f& points );
+	void										calcBoxSums( int32_t x1, int32_t y1, int32_t x2, int32_t y2, double* sums ) const;
+
+	ci::Channel32f								mCurvature;
+	int32_t										mHeight;
+	// ( mWidth + 1 ) * ( mHeight + 1 ) cells of Plane_Total doubles
+	std::vector<double>							mIntegral;
+	int32_t										mMaxRadius;
+	int32_t										mMinRadius;
+	ci::Surface32f								mNormals;
+	int32_t										mWidth;
+	float										mWindowSize;
+};
+
+}
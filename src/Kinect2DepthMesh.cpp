@@ -0,0 +1,259 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2DepthMesh.h"
+
+#include <ppl.h>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+static const uint8_t kStateUnset = 0xff;
+
+DepthMeshRef DepthMesh::create( const CoordinateMapperRef& mapper, int32_t step )
+{
+	return DepthMeshRef( new DepthMesh( mapper, step ) );
+}
+
+DepthMesh::DepthMesh( const CoordinateMapperRef& mapper, int32_t step )
+: mDirtyBegin( 0 ), mDirtyEnd( 0 ), mInvalidated( true ), mMapper( mapper ), mMaxEdgeLength( 0.05f ), mStep( max( step, 1 ) )
+{
+	resize();
+}
+
+void DepthMesh::resize()
+{
+	mGridWidth	= ( mMapper->getDepthWidth() - 1 ) / mStep + 1;
+	mGridHeight	= ( mMapper->getDepthHeight() - 1 ) / mStep + 1;
+	size_t cellCount = ( mGridWidth - 1 ) * ( mGridHeight - 1 );
+	mIndices.assign( cellCount * 6, 0 );
+	mPositions.assign( mGridWidth * mGridHeight, Vec3f::zero() );
+	mRowChanged.assign( mGridHeight, 0 );
+	mRowDirtyBegin.assign( mGridHeight, 0 );
+	mRowDirtyEnd.assign( mGridHeight, 0 );
+	mRowTriangles.assign( mGridHeight, 0 );
+	mStates.assign( cellCount, kStateUnset );
+	mInvalidated = true;
+}
+
+size_t DepthMesh::update( const Channel16u& depth, const TileChangesRef& changes )
+{
+	int32_t width	= mMapper->getDepthWidth();
+	int32_t height	= mMapper->getDepthHeight();
+	mDirtyBegin		= 0;
+	mDirtyEnd		= 0;
+	if ( !depth || depth.getWidth() != width || depth.getHeight() != height ) {
+		return 0;
+	}
+
+	// With usable changes, clean tiles keep their vertices, and cells with 
+	// all four corners in clean tiles keep their triangles.
+	const Channel8u* tiles	= 0;
+	int32_t tileSize		= ChangeDetector::kTileSize;
+	if ( !mInvalidated && changes && changes->getTiles().getWidth() == ( width + tileSize - 1 ) / tileSize && 
+		changes->getTiles().getHeight() == ( height + tileSize - 1 ) / tileSize ) {
+		tiles = &changes->getTiles();
+	}
+	mInvalidated = false;
+
+	const float* tableX = mMapper->getDepthToCameraTableX();
+	const float* tableY = mMapper->getDepthToCameraTableY();
+	concurrency::parallel_for( 0, mGridHeight, [ & ]( int32_t gy )
+	{
+		int32_t y				= gy * mStep;
+		const uint16_t* row		= depth.getData( Vec2i( 0, y ) );
+		const uint8_t* dirty	= tiles != 0 ? tiles->getData( Vec2i( 0, y / tileSize ) ) : 0;
+		Vec3f* positions		= &mPositions[ gy * mGridWidth ];
+		for ( int32_t gx = 0; gx < mGridWidth; ++gx ) {
+			int32_t x = gx * mStep;
+			if ( dirty != 0 && dirty[ x / tileSize ] == 0 ) {
+				continue;
+			}
+			if ( row[ x ] == 0 ) {
+				positions[ gx ] = Vec3f::zero();
+			} else {
+				size_t i		= y * width + x;
+				float z			= (float)row[ x ] * 0.001f;
+				positions[ gx ]	= Vec3f( tableX[ i ] * z, tableY[ i ] * z, z );
+			}
+		}
+	} );
+
+	// Cell corners a b over c d, split into a-c-b and b-c-d. Only cells 
+	// whose triangle validity changed are written.
+	int32_t cellsX		= mGridWidth - 1;
+	float maxEdge		= mMaxEdgeLength * (float)mStep;
+	concurrency::parallel_for( 0, mGridHeight - 1, [ & ]( int32_t gy )
+	{
+		int32_t dirtyBegin		= cellsX;
+		int32_t dirtyEnd		= 0;
+		uint32_t changed		= 0;
+		uint32_t triangles		= 0;
+		const uint8_t* dirty0	= tiles != 0 ? tiles->getData( Vec2i( 0, ( gy * mStep ) / tileSize ) ) : 0;
+		const uint8_t* dirty1	= tiles != 0 ? tiles->getData( Vec2i( 0, ( ( gy + 1 ) * mStep ) / tileSize ) ) : 0;
+		for ( int32_t gx = 0; gx < cellsX; ++gx ) {
+			size_t cell = gy * cellsX + gx;
+			if ( tiles != 0 ) {
+				int32_t x0 = ( gx * mStep ) / tileSize;
+				int32_t x1 = ( ( gx + 1 ) * mStep ) / tileSize;
+				if ( ( dirty0[ x0 ] | dirty0[ x1 ] | dirty1[ x0 ] | dirty1[ x1 ] ) == 0 ) {
+					triangles += ( mStates[ cell ] & 1 ) + ( mStates[ cell ] >> 1 );
+					continue;
+				}
+			}
+
+			uint32_t a			= gy * mGridWidth + gx;
+			uint32_t b			= a + 1;
+			uint32_t c			= a + mGridWidth;
+			uint32_t d			= c + 1;
+			const Vec3f& pa		= mPositions[ a ];
+			const Vec3f& pb		= mPositions[ b ];
+			const Vec3f& pc		= mPositions[ c ];
+			const Vec3f& pd		= mPositions[ d ];
+
+			uint8_t state = 0;
+			if ( pb.z > 0.0f && pc.z > 0.0f ) {
+				float limit	= maxEdge * min( pb.z, pc.z );
+				float limit2	= limit * limit;
+				bool shared		= pb.distanceSquared( pc ) <= limit2 * 2.0f;
+				if ( shared && pa.z > 0.0f ) {
+					float l = maxEdge * min( pa.z, min( pb.z, pc.z ) );
+					if ( pa.distanceSquared( pb ) <= l * l && pa.distanceSquared( pc ) <= l * l ) {
+						state |= 1;
+					}
+				}
+				if ( shared && pd.z > 0.0f ) {
+					float l = maxEdge * min( pd.z, min( pb.z, pc.z ) );
+					if ( pd.distanceSquared( pb ) <= l * l && pd.distanceSquared( pc ) <= l * l ) {
+						state |= 2;
+					}
+				}
+			}
+			triangles += ( state & 1 ) + ( state >> 1 );
+			if ( state == mStates[ cell ] ) {
+				continue;
+			}
+			uint8_t diff		= mStates[ cell ] == kStateUnset ? 3 : state ^ mStates[ cell ];
+			changed				+= ( diff & 1 ) + ( diff >> 1 );
+			mStates[ cell ]		= state;
+			uint32_t* indices	= &mIndices[ cell * 6 ];
+			indices[ 0 ]		= a;
+			indices[ 1 ]		= ( state & 1 ) ? c : a;
+			indices[ 2 ]		= ( state & 1 ) ? b : a;
+			indices[ 3 ]		= ( state & 2 ) ? b : a;
+			indices[ 4 ]		= ( state & 2 ) ? c : a;
+			indices[ 5 ]		= ( state & 2 ) ? d : a;
+			dirtyBegin			= min( dirtyBegin, gx );
+			dirtyEnd			= gx + 1;
+		}
+		mRowDirtyBegin[ gy ]	= dirtyBegin;
+		mRowDirtyEnd[ gy ]		= dirtyEnd;
+		mRowChanged[ gy ]		= changed;
+		mRowTriangles[ gy ]		= triangles;
+	} );
+
+	size_t changed = 0;
+	for ( int32_t gy = 0; gy < mGridHeight - 1; ++gy ) {
+		if ( mRowDirtyEnd[ gy ] > mRowDirtyBegin[ gy ] ) {
+			size_t begin	= ( gy * cellsX + mRowDirtyBegin[ gy ] ) * 6;
+			size_t end		= ( gy * cellsX + mRowDirtyEnd[ gy ] ) * 6;
+			mDirtyBegin		= mDirtyEnd == 0 ? begin : mDirtyBegin;
+			mDirtyEnd		= end;
+		}
+		changed += mRowChanged[ gy ];
+	}
+	return changed;
+}
+
+const vector<Vec3f>& DepthMesh::getPositions() const
+{
+	return mPositions;
+}
+
+const vector<uint32_t>& DepthMesh::getIndices() const
+{
+	return mIndices;
+}
+
+size_t DepthMesh::getDirtyBegin() const
+{
+	return mDirtyBegin;
+}
+
+size_t DepthMesh::getDirtyEnd() const
+{
+	return mDirtyEnd;
+}
+
+int32_t DepthMesh::getGridHeight() const
+{
+	return mGridHeight;
+}
+
+int32_t DepthMesh::getGridWidth() const
+{
+	return mGridWidth;
+}
+
+size_t DepthMesh::getTriangleCount() const
+{
+	size_t count = 0;
+	for ( int32_t gy = 0; gy < mGridHeight - 1; ++gy ) {
+		count += mRowTriangles[ gy ];
+	}
+	return count;
+}
+
+void DepthMesh::setMaxEdgeLength( float length )
+{
+	mMaxEdgeLength	= length;
+	mInvalidated	= true;
+	mStates.assign( mStates.size(), kStateUnset );
+}
+
+void DepthMesh::setStep( int32_t step )
+{
+	step = max( step, 1 );
+	if ( step != mStep ) {
+		mStep = step;
+		resize();
+	}
+}
+
+}
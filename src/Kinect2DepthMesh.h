@@ -0,0 +1,111 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2ChangeDetector.h"
+#include "Kinect2CoordinateMapper.h"
+
+namespace Kinect2 {
+
+class DepthMesh;
+typedef std::shared_ptr<DepthMesh>	DepthMeshRef;
+
+// Triangulates the depth grid into buffers that persist across frames. 
+// Every grid cell owns a fixed slot of two triangles in the index buffer; 
+// a triangle that is missing depth or stretches across a depth edge is 
+// written as a degenerate one instead of being removed. The index buffer 
+// therefore only changes where a triangle's validity changed, and 
+// getDirtyBegin() and getDirtyEnd() bound what needs uploading again. 
+// Given a ChangeDetector's TileChanges for the depth, only vertices in 
+// dirty tiles and the cells touching them are updated at all.
+class DepthMesh
+{
+public:
+	// "step" is the grid decimation in depth pixels.
+	static DepthMeshRef							create( const CoordinateMapperRef& mapper, int32_t step = 1 );
+
+	// Returns the number of triangles whose validity changed. Without 
+	// "changes", or if they do not match the depth, every vertex and cell 
+	// is updated.
+	size_t										update( const ci::Channel16u& depth, const TileChangesRef& changes = TileChangesRef() );
+
+	// Grid vertices in camera space, row by row. Vertices without depth are 
+	// zero.
+	const std::vector<ci::Vec3f>&				getPositions() const;
+	// Three indices per triangle, two triangles per grid cell
+	const std::vector<uint32_t>&				getIndices() const;
+	// Index range patched by the last update(), empty if both are equal
+	size_t										getDirtyBegin() const;
+	size_t										getDirtyEnd() const;
+	int32_t										getGridHeight() const;
+	int32_t										getGridWidth() const;
+	size_t										getTriangleCount() const;
+
+	// Triangles with an edge longer than "length" times their nearest 
+	// vertex's depth and the step are culled. This removes the flying pixels along depth 
+	// edges while allowing for the grid spacing growing with distance.
+	void										setMaxEdgeLength( float length );
+	// Changes the decimation. The next update() rewrites every triangle.
+	void										setStep( int32_t step );
+protected:
+	DepthMesh( const CoordinateMapperRef& mapper, int32_t step );
+
+	void										resize();
+
+	std::vector<uint32_t>						mIndices;
+	size_t										mDirtyBegin;
+	size_t										mDirtyEnd;
+	int32_t										mGridHeight;
+	int32_t										mGridWidth;
+	bool										mInvalidated;
+	CoordinateMapperRef							mMapper;
+	float										mMaxEdgeLength;
+	std::vector<ci::Vec3f>						mPositions;
+	// Per row: changed triangles, first and last patched cell, and the 
+	// valid triangle count
+	std::vector<uint32_t>						mRowChanged;
+	std::vector<int32_t>						mRowDirtyBegin;
+	std::vector<int32_t>						mRowDirtyEnd;
+	std::vector<uint32_t>						mRowTriangles;
+	// Per cell: bit 0 and 1 for its two triangles, 0xff before the first 
+	// update()
+	std::vector<uint8_t>						mStates;
+	int32_t										mStep;
+};
+
+}
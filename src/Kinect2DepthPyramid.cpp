@@ -0,0 +1,356 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2DepthPyramid.h"
+
+#include <algorithm>
+#include <cstring>
+#include <emmintrin.h>
+#include <ppl.h>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+// Pixels are reduced in a biased signed domain, ( v - 1 ) ^ 0x8000, which 
+// maps zero (invalid) to the largest signed value. Signed minimum then 
+// skips invalid pixels and the even/odd split can use signed packing.
+static inline __m128i biasPixels( __m128i v )
+{
+	return _mm_xor_si128( _mm_sub_epi16( v, _mm_set1_epi16( 1 ) ), _mm_set1_epi16( (int16_t)0x8000 ) );
+}
+
+static inline __m128i unbiasPixels( __m128i v )
+{
+	return _mm_add_epi16( _mm_xor_si128( v, _mm_set1_epi16( (int16_t)0x8000 ) ), _mm_set1_epi16( 1 ) );
+}
+
+static inline __m128i selectPixels( __m128i mask, __m128i a, __m128i b )
+{
+	return _mm_or_si128( _mm_and_si128( mask, a ), _mm_andnot_si128( mask, b ) );
+}
+
+// Loads 16 pixels and splits them into 8 even and 8 odd biased pixels.
+static inline void loadPairs( const uint16_t* row, __m128i& even, __m128i& odd )
+{
+	__m128i a	= biasPixels( _mm_load_si128( reinterpret_cast<const __m128i*>( row ) ) );
+	__m128i b	= biasPixels( _mm_load_si128( reinterpret_cast<const __m128i*>( row + 8 ) ) );
+	even		= _mm_packs_epi32( _mm_srai_epi32( _mm_slli_epi32( a, 16 ), 16 ), _mm_srai_epi32( _mm_slli_epi32( b, 16 ), 16 ) );
+	odd			= _mm_packs_epi32( _mm_srai_epi32( a, 16 ), _mm_srai_epi32( b, 16 ) );
+}
+
+static uint16_t reducePixel( uint16_t a, uint16_t b, uint16_t c, uint16_t d, int32_t reduction )
+{
+	uint16_t v[ 4 ];
+	int32_t n = 0;
+	if ( a != 0 ) {
+		v[ n++ ] = a;
+	}
+	if ( b != 0 ) {
+		v[ n++ ] = b;
+	}
+	if ( c != 0 ) {
+		v[ n++ ] = c;
+	}
+	if ( d != 0 ) {
+		v[ n++ ] = d;
+	}
+	if ( n == 0 ) {
+		return 0;
+	}
+	sort( v, v + n );
+
+	switch ( reduction ) {
+	case DepthPyramid::Reduction_Mean:
+		return (uint16_t)( (float)( (uint32_t)a + b + c + d ) / (float)n + 0.5f );
+	case DepthPyramid::Reduction_Median:
+		return (uint16_t)( ( (uint32_t)v[ ( n - 1 ) / 2 ] + v[ n / 2 ] + 1 ) >> 1 );
+	default:
+		return v[ 0 ];
+	}
+}
+
+static void reduceRow( const uint16_t* row0, const uint16_t* row1, uint16_t* output, 
+	int32_t x1, int32_t x2, int32_t reduction )
+{
+	const __m128i zero	= _mm_setzero_si128();
+	const __m128i one	= _mm_set1_epi16( 1 );
+	const __m128i empty	= _mm_set1_epi16( 0x7fff );
+
+	int32_t x = x1;
+	for ( ; x + 8 <= x2; x += 8 ) {
+		__m128i a;
+		__m128i b;
+		__m128i c;
+		__m128i d;
+		loadPairs( row0 + x * 2, a, b );
+		loadPairs( row1 + x * 2, c, d );
+
+		__m128i result;
+		if ( reduction == DepthPyramid::Reduction_Min ) {
+			result = unbiasPixels( _mm_min_epi16( _mm_min_epi16( a, b ), _mm_min_epi16( c, d ) ) );
+		} else if ( reduction == DepthPyramid::Reduction_Median ) {
+			// Sorting network; invalid pixels sort last
+			__m128i t = _mm_min_epi16( a, b );
+			b = _mm_max_epi16( a, b );
+			a = t;
+			t = _mm_min_epi16( c, d );
+			d = _mm_max_epi16( c, d );
+			c = t;
+			t = _mm_min_epi16( a, c );
+			c = _mm_max_epi16( a, c );
+			a = t;
+			t = _mm_min_epi16( b, d );
+			d = _mm_max_epi16( b, d );
+			b = t;
+			t = _mm_min_epi16( b, c );
+			c = _mm_max_epi16( b, c );
+			b = t;
+
+			// Negative valid count
+			__m128i n	= _mm_add_epi16( _mm_add_epi16( _mm_cmplt_epi16( a, empty ), _mm_cmplt_epi16( b, empty ) ), 
+				_mm_add_epi16( _mm_cmplt_epi16( c, empty ), _mm_cmplt_epi16( d, empty ) ) );
+			__m128i lo	= selectPixels( _mm_cmplt_epi16( n, _mm_set1_epi16( -2 ) ), b, a );
+			__m128i hi	= selectPixels( _mm_cmpeq_epi16( n, _mm_set1_epi16( -4 ) ), c, 
+				selectPixels( _mm_cmplt_epi16( n, _mm_set1_epi16( -1 ) ), b, a ) );
+			result		= _mm_avg_epu16( unbiasPixels( lo ), unbiasPixels( hi ) );
+		} else {
+			a = unbiasPixels( a );
+			b = unbiasPixels( b );
+			c = unbiasPixels( c );
+			d = unbiasPixels( d );
+			__m128i n		= _mm_add_epi16( _mm_set1_epi16( 4 ), _mm_add_epi16( 
+				_mm_add_epi16( _mm_cmpeq_epi16( a, zero ), _mm_cmpeq_epi16( b, zero ) ), 
+				_mm_add_epi16( _mm_cmpeq_epi16( c, zero ), _mm_cmpeq_epi16( d, zero ) ) ) );
+			n				= _mm_max_epi16( n, one );
+			__m128i sumLo	= _mm_add_epi32( 
+				_mm_add_epi32( _mm_unpacklo_epi16( a, zero ), _mm_unpacklo_epi16( b, zero ) ), 
+				_mm_add_epi32( _mm_unpacklo_epi16( c, zero ), _mm_unpacklo_epi16( d, zero ) ) );
+			__m128i sumHi	= _mm_add_epi32( 
+				_mm_add_epi32( _mm_unpackhi_epi16( a, zero ), _mm_unpackhi_epi16( b, zero ) ), 
+				_mm_add_epi32( _mm_unpackhi_epi16( c, zero ), _mm_unpackhi_epi16( d, zero ) ) );
+			const __m128 half	= _mm_set1_ps( 0.5f );
+			__m128i meanLo		= _mm_cvttps_epi32( _mm_add_ps( _mm_div_ps( _mm_cvtepi32_ps( sumLo ), 
+				_mm_cvtepi32_ps( _mm_unpacklo_epi16( n, zero ) ) ), half ) );
+			__m128i meanHi		= _mm_cvttps_epi32( _mm_add_ps( _mm_div_ps( _mm_cvtepi32_ps( sumHi ), 
+				_mm_cvtepi32_ps( _mm_unpackhi_epi16( n, zero ) ) ), half ) );
+
+			// Unsigned 16 bit pack through the signed one
+			const __m128i bias32	= _mm_set1_epi32( 0x8000 );
+			result					= _mm_xor_si128( _mm_packs_epi32( _mm_sub_epi32( meanLo, bias32 ), 
+				_mm_sub_epi32( meanHi, bias32 ) ), _mm_set1_epi16( (int16_t)0x8000 ) );
+		}
+		_mm_store_si128( reinterpret_cast<__m128i*>( output + x ), result );
+	}
+	for ( ; x < x2; ++x ) {
+		output[ x ] = reducePixel( row0[ x * 2 ], row0[ x * 2 + 1 ], row1[ x * 2 ], row1[ x * 2 + 1 ], reduction );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+DepthPyramidRef DepthPyramid::create( int32_t levelCount, int32_t reduction )
+{
+	return DepthPyramidRef( new DepthPyramid( levelCount, reduction ) );
+}
+
+DepthPyramid::DepthPyramid( int32_t levelCount, int32_t reduction )
+: mInvalidated( true ), mLevelCount( max( levelCount, 1 ) ), mReduction( reduction )
+{
+}
+
+void DepthPyramid::resize( int32_t width, int32_t height )
+{
+	mDirtyTiles.clear();
+	mLevels.clear();
+
+	// Rows are padded to 8 pixels so every row starts 16 byte aligned.
+	vector<size_t> offsets;
+	size_t size = 0;
+	for ( int32_t level = 0; level < mLevelCount && ( width >> level ) > 0 && ( height >> level ) > 0; ++level ) {
+		int32_t stride = ( ( width >> level ) + 7 ) & ~7;
+		offsets.push_back( size );
+		size += stride * ( height >> level );
+	}
+
+	// The arena is over-allocated so its start can be aligned.
+	mArena.assign( size + 8, 0 );
+	size_t align = ( ( 16 - ( reinterpret_cast<size_t>( &mArena[ 0 ] ) & 15 ) ) & 15 ) / sizeof( uint16_t );
+
+	for ( size_t level = 0; level < offsets.size(); ++level ) {
+		int32_t w		= width >> level;
+		int32_t h		= height >> level;
+		int32_t stride	= ( w + 7 ) & ~7;
+		mLevels.push_back( Channel16u( w, h, stride * sizeof( uint16_t ), 1, 
+			&mArena[ align + offsets[ level ] ] ) );
+		mDirtyTiles.push_back( Channel8u( ( w + kTileSize - 1 ) / kTileSize, ( h + kTileSize - 1 ) / kTileSize ) );
+	}
+	mInvalidated = true;
+}
+
+size_t DepthPyramid::update( const Channel16u& channel, const TileChangesRef& changes )
+{
+	if ( !channel ) {
+		return 0;
+	}
+	if ( mLevels.empty() || mLevels[ 0 ].getSize() != channel.getSize() ) {
+		resize( channel.getWidth(), channel.getHeight() );
+	}
+
+	markTiles( channel, changes );
+	size_t count = 0;
+	for ( size_t level = 0; level < mLevels.size(); ++level ) {
+		Channel8u& dirty	= mDirtyTiles[ level ];
+		int32_t tilesX		= dirty.getWidth();
+		int32_t tilesY		= dirty.getHeight();
+
+		// A tile depends on the 2x2 tiles above it.
+		if ( level > 0 ) {
+			const Channel8u& parent = mDirtyTiles[ level - 1 ];
+			for ( int32_t y = 0; y < tilesY; ++y ) {
+				uint8_t* row = dirty.getData( Vec2i( 0, y ) );
+				for ( int32_t x = 0; x < tilesX; ++x ) {
+					int32_t px		= min( x * 2 + 1, parent.getWidth() - 1 );
+					int32_t py		= min( y * 2 + 1, parent.getHeight() - 1 );
+					row[ x ]		= parent.getValue( Vec2i( x * 2, y * 2 ) ) | parent.getValue( Vec2i( px, y * 2 ) ) | 
+						parent.getValue( Vec2i( x * 2, py ) ) | parent.getValue( Vec2i( px, py ) );
+				}
+			}
+			concurrency::parallel_for( 0, tilesY, [ & ]( int32_t y )
+			{
+				const uint8_t* row = dirty.getData( Vec2i( 0, y ) );
+				for ( int32_t x = 0; x < tilesX; ++x ) {
+					if ( row[ x ] != 0 ) {
+						reduceTile( (int32_t)level, x, y );
+					}
+				}
+			} );
+		}
+
+		for ( int32_t y = 0; y < tilesY; ++y ) {
+			const uint8_t* row = dirty.getData( Vec2i( 0, y ) );
+			count += tilesX - ( std::count( row, row + tilesX, 0 ) );
+		}
+	}
+	mInvalidated = false;
+	return count;
+}
+
+void DepthPyramid::markTiles( const Channel16u& channel, const TileChangesRef& changes )
+{
+	Channel16u& level	= mLevels[ 0 ];
+	Channel8u& dirty	= mDirtyTiles[ 0 ];
+	int32_t width		= level.getWidth();
+	int32_t height		= level.getHeight();
+	int32_t tilesX		= dirty.getWidth();
+	int32_t tilesY		= dirty.getHeight();
+
+	if ( mInvalidated || !changes || changes->getTiles().getSize() != dirty.getSize() ) {
+		concurrency::parallel_for( 0, height, [ & ]( int32_t y )
+		{
+			memcpy( level.getData( Vec2i( 0, y ) ), channel.getData( Vec2i( 0, y ) ), width * sizeof( uint16_t ) );
+		} );
+		for ( int32_t y = 0; y < tilesY; ++y ) {
+			memset( dirty.getData( Vec2i( 0, y ) ), 1, tilesX );
+		}
+		return;
+	}
+
+	const Channel8u& tiles = changes->getTiles();
+	concurrency::parallel_for( 0, tilesY, [ & ]( int32_t ty )
+	{
+		int32_t y1				= ty * kTileSize;
+		int32_t y2				= min( y1 + kTileSize, height );
+		const uint8_t* source	= tiles.getData( Vec2i( 0, ty ) );
+		uint8_t* flags			= dirty.getData( Vec2i( 0, ty ) );
+		for ( int32_t tx = 0; tx < tilesX; ++tx ) {
+			flags[ tx ] = source[ tx ] != 0 ? 1 : 0;
+			if ( flags[ tx ] != 0 ) {
+				int32_t x1 = tx * kTileSize;
+				int32_t x2 = min( x1 + kTileSize, width );
+				for ( int32_t y = y1; y < y2; ++y ) {
+					memcpy( level.getData( Vec2i( x1, y ) ), channel.getData( Vec2i( x1, y ) ), ( x2 - x1 ) * sizeof( uint16_t ) );
+				}
+			}
+		}
+	} );
+}
+
+void DepthPyramid::reduceTile( int32_t level, int32_t tileX, int32_t tileY )
+{
+	const Channel16u& input	= mLevels[ level - 1 ];
+	Channel16u& output		= mLevels[ level ];
+	int32_t x1				= tileX * kTileSize;
+	int32_t x2				= min( x1 + kTileSize, output.getWidth() );
+	int32_t y1				= tileY * kTileSize;
+	int32_t y2				= min( y1 + kTileSize, output.getHeight() );
+	for ( int32_t y = y1; y < y2; ++y ) {
+		reduceRow( input.getData( Vec2i( 0, y * 2 ) ), input.getData( Vec2i( 0, y * 2 + 1 ) ), 
+			output.getData( Vec2i( 0, y ) ), x1, x2, mReduction );
+	}
+}
+
+const Channel16u& DepthPyramid::getLevel( int32_t level ) const
+{
+	return mLevels[ level ];
+}
+
+int32_t DepthPyramid::getLevelCount() const
+{
+	return mLevels.empty() ? mLevelCount : (int32_t)mLevels.size();
+}
+
+const Channel8u& DepthPyramid::getDirtyTiles( int32_t level ) const
+{
+	return mDirtyTiles[ level ];
+}
+
+int32_t DepthPyramid::getReduction() const
+{
+	return mReduction;
+}
+
+void DepthPyramid::setReduction( int32_t reduction )
+{
+	if ( reduction != mReduction ) {
+		mReduction		= reduction;
+		mInvalidated	= true;
+	}
+}
+
+}
@@ -0,0 +1,100 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2ChangeDetector.h"
+
+namespace Kinect2 {
+
+class DepthPyramid;
+typedef std::shared_ptr<DepthPyramid>	DepthPyramidRef;
+
+// Half resolution levels of a depth or infrared channel for coarse to fine 
+// processing. Each level pixel reduces a 2x2 block of the level above, 
+// ignoring zero (invalid) pixels. All levels share one 16 byte aligned 
+// arena with 16 byte aligned rows.
+// 
+// Given the TileChanges a ChangeDetector reported for the same channel, 
+// levels are rebuilt per tile. Only dirty tiles are copied and reduced 
+// again; the rest keep last frame's values, which then match the 
+// detector's reference. Pass the changes of every channel the detector 
+// saw, or the pyramid falls behind it until the tiles change again.
+class DepthPyramid
+{
+public:
+	enum : int32_t
+	{
+		Reduction_Mean, Reduction_Median, Reduction_Min
+	};
+
+	// Tile size in pixels of each level, that of TileChanges at level zero
+	static const int32_t						kTileSize = ChangeDetector::kTileSize;
+
+	static DepthPyramidRef						create( int32_t levelCount = 4, int32_t reduction = Reduction_Median );
+
+	// Returns the number of tiles rebuilt over all levels. Without 
+	// "changes", or if they do not match the channel, every level is 
+	// rebuilt in full.
+	size_t										update( const ci::Channel16u& channel, const TileChangesRef& changes = TileChangesRef() );
+
+	// Level zero is a copy of the input.
+	const ci::Channel16u&						getLevel( int32_t level ) const;
+	// May be less than requested if the input is too small
+	int32_t										getLevelCount() const;
+	// One pixel per tile of "level", non-zero where the last update() 
+	// rebuilt it
+	const ci::Channel8u&						getDirtyTiles( int32_t level ) const;
+
+	int32_t										getReduction() const;
+	void										setReduction( int32_t reduction );
+protected:
+	DepthPyramid( int32_t levelCount, int32_t reduction );
+
+	void										markTiles( const ci::Channel16u& channel, const TileChangesRef& changes );
+	void										reduceTile( int32_t level, int32_t tileX, int32_t tileY );
+	void										resize( int32_t width, int32_t height );
+
+	std::vector<uint16_t>						mArena;
+	std::vector<ci::Channel8u>					mDirtyTiles;
+	bool										mInvalidated;
+	int32_t										mLevelCount;
+	std::vector<ci::Channel16u>					mLevels;
+	int32_t										mReduction;
+};
+
+}
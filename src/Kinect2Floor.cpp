@@ -0,0 +1,367 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2Floor.h"
+
+#include <cmath>
+#include <emmintrin.h>
+#include <limits>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+// Smallest Y component of an accepted floor normal, about 60 degrees of tilt
+static const float kMinUp				= 0.5f;
+// Sensor must be at least this high above a floor candidate
+static const float kMinHeight			= 0.1f;
+static const size_t kMinInliers			= 32;
+
+FloorEstimatorRef FloorEstimator::create( const CoordinateMapperRef& mapper, int32_t step )
+{
+	return FloorEstimatorRef( new FloorEstimator( mapper, step ) );
+}
+
+FloorEstimator::FloorEstimator( const CoordinateMapperRef& mapper, int32_t step )
+: mGridWidth( 0 ), mInlierRatio( 0.0f ), mIterations( 64 ), mMapper( mapper ), mPlane( Vec4f::zero() ), 
+mRandom( 0x9e3779b9 ), mStep( max( step, 1 ) ), mThreshold( 0.03f ), mValid( false )
+{
+}
+
+bool FloorEstimator::update( const Channel16u& depth )
+{
+	int32_t width	= mMapper->getDepthWidth();
+	int32_t height	= mMapper->getDepthHeight();
+	if ( !depth || depth.getWidth() != width || depth.getHeight() != height ) {
+		return mValid;
+	}
+
+	const float* tableX	= mMapper->getDepthToCameraTableX();
+	const float* tableY	= mMapper->getDepthToCameraTableY();
+	int32_t gridWidth	= ( width - mStep / 2 + mStep - 1 ) / mStep;
+	int32_t gridHeight	= ( height - mStep / 2 + mStep - 1 ) / mStep;
+	mGrid.assign( gridWidth * gridHeight, -1 );
+	mGridWidth			= gridWidth;
+	mPointCells.clear();
+	mPoints.clear();
+	for ( int32_t gy = 0; gy < gridHeight; ++gy ) {
+		int32_t y			= mStep / 2 + gy * mStep;
+		const uint16_t* row	= depth.getData( Vec2i( 0, y ) );
+		for ( int32_t gx = 0; gx < gridWidth; ++gx ) {
+			int32_t x = mStep / 2 + gx * mStep;
+			if ( row[ x ] != 0 ) {
+				size_t i	= y * width + x;
+				float z		= (float)row[ x ] * 0.001f;
+				mGrid[ gy * gridWidth + gx ] = (int32_t)mPoints.size();
+				mPointCells.push_back( gy * gridWidth + gx );
+				mPoints.push_back( Vec3f( tableX[ i ] * z, tableY[ i ] * z, z ) );
+			}
+		}
+	}
+
+	bool tracked = false;
+	if ( mValid && !mPoints.empty() ) {
+		Vec4f plane		= mPlane;
+		size_t below	= 0;
+		size_t inliers	= refine( plane, below );
+		float ratio		= (float)inliers / (float)mPoints.size();
+		if ( inliers >= kMinInliers && below < inliers && ratio >= mInlierRatio * 0.5f ) {
+			mInlierRatio	= ratio;
+			mPlane			= plane;
+			tracked			= true;
+		}
+	}
+	if ( !tracked ) {
+		mValid = runRansac();
+	}
+
+	if ( mValid ) {
+		updateHeight( depth );
+	}
+	return mValid;
+}
+
+size_t FloorEstimator::refine( Vec4f& plane, size_t& below ) const
+{
+	// Least squares fit of y = a * x + b * z + c, which suits planes whose 
+	// normal is mostly vertical.
+	double sxx = 0.0, sxz = 0.0, sx = 0.0, szz = 0.0, sz = 0.0, sn = 0.0;
+	double sxy = 0.0, szy = 0.0, sy = 0.0;
+	Vec3f n( plane.x, plane.y, plane.z );
+	size_t inliers	= 0;
+	below			= 0;
+	for ( vector<Vec3f>::const_iterator iter = mPoints.begin(); iter != mPoints.end(); ++iter ) {
+		float h = n.dot( *iter ) + plane.w;
+		if ( h < -mThreshold * 3.0f ) {
+			++below;
+		}
+		if ( fabs( h ) > mThreshold ) {
+			continue;
+		}
+		double x = iter->x;
+		double y = iter->y;
+		double z = iter->z;
+		sxx += x * x;
+		sxz += x * z;
+		sx	+= x;
+		szz += z * z;
+		sz	+= z;
+		sn	+= 1.0;
+		sxy += x * y;
+		szy += z * y;
+		sy	+= y;
+		++inliers;
+	}
+	if ( inliers < 3 ) {
+		return inliers;
+	}
+
+	// Cramer's rule on the 3x3 normal equations
+	double det = sxx * ( szz * sn - sz * sz ) - sxz * ( sxz * sn - sz * sx ) + sx * ( sxz * sz - szz * sx );
+	if ( fabs( det ) < 1e-12 ) {
+		return inliers;
+	}
+	double a	= ( sxy * ( szz * sn - sz * sz ) - sxz * ( szy * sn - sz * sy ) + sx * ( szy * sz - szz * sy ) ) / det;
+	double b	= ( sxx * ( szy * sn - sy * sz ) - sxy * ( sxz * sn - sz * sx ) + sx * ( sxz * sy - szy * sx ) ) / det;
+	double c	= ( sxx * ( szz * sy - sz * szy ) - sxz * ( sxz * sy - szy * sx ) + sxy * ( sxz * sz - szz * sx ) ) / det;
+	double len	= sqrt( a * a + 1.0 + b * b );
+	Vec4f refined( (float)( -a / len ), (float)( 1.0 / len ), (float)( -b / len ), (float)( -c / len ) );
+	if ( refined.y >= kMinUp && refined.w >= kMinHeight ) {
+		plane = refined;
+	}
+	return inliers;
+}
+
+bool FloorEstimator::runRansac()
+{
+	size_t count = mPoints.size();
+	if ( count < kMinInliers ) {
+		return false;
+	}
+
+	// Tables and other raised surfaces have floor points under them, so 
+	// candidates lose score for every point clearly below.
+	Vec4f best			= Vec4f::zero();
+	int32_t gridHeight	= (int32_t)mGrid.size() / mGridWidth;
+	int64_t score		= 0;
+	for ( uint32_t i = 0; i < mIterations; ++i ) {
+		// The floor often covers only a small part of the view, so three 
+		// random points rarely all land on it. Hypotheses are built from a 
+		// random point and two grid neighbours instead, which usually share 
+		// its surface.
+		int32_t s[ 3 ];
+		s[ 0 ]			= (int32_t)( nextRandom() % count );
+		int32_t gx		= (int32_t)mPointCells[ s[ 0 ] ] % mGridWidth;
+		int32_t gy		= (int32_t)mPointCells[ s[ 0 ] ] / mGridWidth;
+		int32_t dx		= (int32_t)( nextRandom() % 3 ) + 2;
+		int32_t dy		= (int32_t)( nextRandom() % 3 ) + 2;
+		int32_t x		= gx + dx < mGridWidth ? gx + dx : gx - dx;
+		int32_t y		= gy + dy < gridHeight ? gy + dy : gy - dy;
+		if ( x < 0 || y < 0 ) {
+			continue;
+		}
+		s[ 1 ] = mGrid[ gy * mGridWidth + x ];
+		s[ 2 ] = mGrid[ y * mGridWidth + gx ];
+		if ( s[ 1 ] < 0 || s[ 2 ] < 0 ) {
+			continue;
+		}
+		Vec3f n = ( mPoints[ s[ 1 ] ] - mPoints[ s[ 0 ] ] ).cross( mPoints[ s[ 2 ] ] - mPoints[ s[ 0 ] ] );
+		float len = n.length();
+		if ( len < 1e-6f ) {
+			continue;
+		}
+		n /= len;
+		if ( n.y < 0.0f ) {
+			n = -n;
+		}
+		float w = -n.dot( mPoints[ s[ 0 ] ] );
+		if ( n.y < kMinUp || w < kMinHeight ) {
+			continue;
+		}
+
+		int64_t inliers	= 0;
+		int64_t below	= 0;
+		for ( size_t j = 0; j < count; ++j ) {
+			float h = n.dot( mPoints[ j ] ) + w;
+			if ( h < -mThreshold * 3.0f ) {
+				++below;
+			} else if ( h <= mThreshold ) {
+				++inliers;
+			}
+		}
+		if ( inliers - below * 2 > score ) {
+			best	= Vec4f( n.x, n.y, n.z, w );
+			score	= inliers - below * 2;
+		}
+	}
+	if ( score < (int64_t)kMinInliers ) {
+		return false;
+	}
+
+	// The refit plane gathers inliers the sampled one missed, so fit a 
+	// second time to those.
+	size_t below	= 0;
+	size_t inliers	= 0;
+	for ( size_t i = 0; i < 2; ++i ) {
+		inliers = refine( best, below );
+	}
+	mInlierRatio	= (float)inliers / (float)count;
+	mPlane			= best;
+	return inliers >= kMinInliers;
+}
+
+void FloorEstimator::updateHeight( const Channel16u& depth )
+{
+	int32_t width	= depth.getWidth();
+	int32_t height	= depth.getHeight();
+	if ( !mHeight || mHeight.getWidth() != width || mHeight.getHeight() != height ) {
+		mHeight = Channel32f( width, height );
+	}
+
+	// h = z * ( nx * tx + ny * ty + nz ) + w, with tx and ty from the 
+	// camera table
+	const float negInf		= -numeric_limits<float>::infinity();
+	const float* tableX		= mMapper->getDepthToCameraTableX();
+	const float* tableY		= mMapper->getDepthToCameraTableY();
+	const __m128 nx			= _mm_set1_ps( mPlane.x );
+	const __m128 ny			= _mm_set1_ps( mPlane.y );
+	const __m128 nz			= _mm_set1_ps( mPlane.z );
+	const __m128 w			= _mm_set1_ps( mPlane.w );
+	const __m128 scale		= _mm_set1_ps( 0.001f );
+	const __m128 inf		= _mm_set1_ps( negInf );
+	const __m128 zero		= _mm_setzero_ps();
+	const __m128i zeroi		= _mm_setzero_si128();
+	for ( int32_t y = 0; y < height; ++y ) {
+		const uint16_t* d	= depth.getData( Vec2i( 0, y ) );
+		float* output		= mHeight.getData( Vec2i( 0, y ) );
+		size_t offset		= y * width;
+		int32_t x			= 0;
+		for ( ; x + 4 <= width; x += 4 ) {
+			__m128i d16		= _mm_loadl_epi64( reinterpret_cast<const __m128i*>( d + x ) );
+			__m128 z		= _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi16( d16, zeroi ) ), scale );
+			__m128 invalid	= _mm_cmpeq_ps( z, zero );
+			__m128 k		= _mm_add_ps( _mm_add_ps( _mm_mul_ps( nx, _mm_loadu_ps( tableX + offset + x ) ), 
+				_mm_mul_ps( ny, _mm_loadu_ps( tableY + offset + x ) ) ), nz );
+			__m128 h		= _mm_add_ps( _mm_mul_ps( z, k ), w );
+			_mm_storeu_ps( output + x, _mm_or_ps( _mm_andnot_ps( invalid, h ), _mm_and_ps( invalid, inf ) ) );
+		}
+		for ( ; x < width; ++x ) {
+			if ( d[ x ] == 0 ) {
+				output[ x ] = negInf;
+			} else {
+				float z		= (float)d[ x ] * 0.001f;
+				output[ x ]	= z * ( mPlane.x * tableX[ offset + x ] + mPlane.y * tableY[ offset + x ] + mPlane.z ) + mPlane.w;
+			}
+		}
+	}
+}
+
+Matrix44f FloorEstimator::calcTransform( const Vec4f& plane )
+{
+	// Rows are the floor axes in camera space. Projecting the camera origin 
+	// onto the plane gives -w * n, which the W column moves to the origin.
+	Vec3f up( plane.x, plane.y, plane.z );
+	Vec3f forward = Vec3f::zAxis() - up * up.z;
+	if ( forward.lengthSquared() < 1e-6f ) {
+		forward = up.cross( Vec3f::xAxis() );
+	}
+	forward.normalize();
+	Vec3f right = up.cross( forward );
+	Vec3f axes[ 3 ] = { right, up, forward };
+	Matrix44f m;
+	for ( int32_t r = 0; r < 3; ++r ) {
+		m.at( r, 0 ) = axes[ r ].x;
+		m.at( r, 1 ) = axes[ r ].y;
+		m.at( r, 2 ) = axes[ r ].z;
+		m.at( r, 3 ) = 0.0f;
+	}
+	m.at( 1, 3 ) = plane.w;
+	return m;
+}
+
+uint32_t FloorEstimator::nextRandom()
+{
+	mRandom ^= mRandom << 13;
+	mRandom ^= mRandom >> 17;
+	mRandom ^= mRandom << 5;
+	return mRandom;
+}
+
+const Channel32f& FloorEstimator::getHeight() const
+{
+	return mHeight;
+}
+
+float FloorEstimator::getInlierRatio() const
+{
+	return mInlierRatio;
+}
+
+const Vec4f& FloorEstimator::getPlane() const
+{
+	return mPlane;
+}
+
+Matrix44f FloorEstimator::getTransform() const
+{
+	return mValid ? calcTransform( mPlane ) : Matrix44f();
+}
+
+bool FloorEstimator::isValid() const
+{
+	return mValid;
+}
+
+void FloorEstimator::setIterations( uint32_t iterations )
+{
+	mIterations = iterations;
+}
+
+void FloorEstimator::setPlane( const Vec4f& plane )
+{
+	mPlane			= plane;
+	mValid			= plane != Vec4f::zero();
+	mInlierRatio	= 0.0f;
+}
+
+void FloorEstimator::setThreshold( float threshold )
+{
+	mThreshold = threshold;
+}
+
+}
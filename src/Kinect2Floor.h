@@ -0,0 +1,112 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2.h"
+#include "Kinect2CoordinateMapper.h"
+
+namespace Kinect2 {
+
+class FloorEstimator;
+typedef std::shared_ptr<FloorEstimator>	FloorEstimatorRef;
+
+// Finds the floor in depth alone, so a floor plane is available without 
+// body tracking. Uses RANSAC over a sparse grid of depth points, then a 
+// least squares refit on the inliers. Once a floor is known, each frame 
+// starts with a refit around the previous plane; RANSAC only runs again 
+// when too few points still support it.
+// 
+// Planes follow IBodyFrame::get_FloorClipPlane(): XYZ is the unit normal 
+// pointing up and W the sensor's height, so dot( n, p ) + w is the height 
+// of "p" above the floor.
+class FloorEstimator
+{
+public:
+	// "step" is the grid spacing in depth pixels used for fitting.
+	static FloorEstimatorRef					create( const CoordinateMapperRef& mapper, int32_t step = 8 );
+
+	// Returns true if a floor is known after this frame.
+	bool										update( const ci::Channel16u& depth );
+	// Starts from "plane", e.g. the body stream's floor plane. Zero forgets 
+	// the current floor.
+	void										setPlane( const ci::Vec4f& plane );
+
+	// Height above the floor in meters per depth pixel. Pixels without 
+	// depth are negative infinity. Empty until a floor is found.
+	const ci::Channel32f&						getHeight() const;
+	// Fraction of fitted points within the threshold of the plane
+	float										getInlierRatio() const;
+	const ci::Vec4f&							getPlane() const;
+	// Camera space to floor space: Y is height above the floor, the origin 
+	// is under the sensor and Z follows the sensor's view direction.
+	ci::Matrix44f								getTransform() const;
+	bool										isValid() const;
+
+	// Inliers lie within "threshold" meters of the plane.
+	void										setThreshold( float threshold );
+	void										setIterations( uint32_t iterations );
+
+	// Transform of getTransform() for any plane
+	static ci::Matrix44f						calcTransform( const ci::Vec4f& plane );
+protected:
+	FloorEstimator( const CoordinateMapperRef& mapper, int32_t step );
+
+	uint32_t									nextRandom();
+	// Returns the number of inliers of "plane" and refits it to them. 
+	// "below" receives the count of points clearly under the plane.
+	size_t										refine( ci::Vec4f& plane, size_t& below ) const;
+	bool										runRansac();
+	void										updateHeight( const ci::Channel16u& depth );
+
+	// Index into mPoints per grid cell, -1 without depth
+	std::vector<int32_t>						mGrid;
+	int32_t										mGridWidth;
+	ci::Channel32f								mHeight;
+	float										mInlierRatio;
+	uint32_t									mIterations;
+	CoordinateMapperRef							mMapper;
+	ci::Vec4f									mPlane;
+	std::vector<uint32_t>						mPointCells;
+	std::vector<ci::Vec3f>						mPoints;
+	uint32_t									mRandom;
+	int32_t										mStep;
+	float										mThreshold;
+	bool										mValid;
+};
+
+}
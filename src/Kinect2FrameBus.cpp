@@ -0,0 +1,595 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2FrameBus.h"
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+static const uint32_t kFrameBusMagic	= 0x4246324b;
+static const uint32_t kFrameBusVersion	= 2;
+
+static uint32_t alignFrameBus( size_t v )
+{
+	return (uint32_t)( ( v + 63 ) & ~(size_t)63 );
+}
+
+static string toMappingName( const string& name )
+{
+	return "Local\\Kinect2FrameBus_" + name;
+}
+
+static string toEventName( const string& name, size_t index )
+{
+	char suffix[ 16 ];
+	sprintf( suffix, "_wake%u", (uint32_t)index );
+	return "Local\\Kinect2FrameBus_" + name + suffix;
+}
+
+static FrameBus::SlotHeader* getSlot( uint8_t* buffer, const FrameBus::Header* header, uint64_t frameIndex )
+{
+	size_t index = (size_t)( ( frameIndex - 1 ) % header->mSlotCount );
+	return (FrameBus::SlotHeader*)( buffer + alignFrameBus( sizeof( FrameBus::Header ) ) + index * header->mSlotSize );
+}
+
+static void copyRows( uint8_t* dst, size_t dstRowBytes, const uint8_t* src, size_t srcRowBytes, int32_t height )
+{
+	size_t rowBytes = min( dstRowBytes, srcRowBytes );
+	if ( rowBytes == dstRowBytes && rowBytes == srcRowBytes ) {
+		memcpy( dst, src, rowBytes * height );
+		return;
+	}
+	for ( int32_t y = 0; y < height; ++y, dst += dstRowBytes, src += srcRowBytes ) {
+		memcpy( dst, src, rowBytes );
+	}
+}
+
+static uint64_t getProcessOwner( HANDLE process, uint32_t processId )
+{
+	FILETIME creation;
+	FILETIME exit;
+	FILETIME kernel;
+	FILETIME user;
+	if ( !GetProcessTimes( process, &creation, &exit, &kernel, &user ) ) {
+		creation.dwLowDateTime = 0;
+	}
+	return ( (uint64_t)processId << 32 ) | creation.dwLowDateTime;
+}
+
+// False only if the owning process has exited or its id was reused.
+static bool isOwnerAlive( uint64_t owner )
+{
+	uint32_t processId	= (uint32_t)( owner >> 32 );
+	HANDLE process		= OpenProcess( PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, FALSE, processId );
+	if ( process == 0 ) {
+		// Exists, but belongs to someone we may not inspect
+		return GetLastError() == ERROR_ACCESS_DENIED;
+	}
+	bool alive = WaitForSingleObject( process, 0 ) == WAIT_TIMEOUT && getProcessOwner( process, processId ) == owner;
+	CloseHandle( process );
+	return alive;
+}
+
+FrameBus::ReaderStats::ReaderStats()
+: mActive( false ), mDropped( 0 ), mLag( 0 ), mOverruns( 0 ), mPosition( 0 )
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameBusPublisherRef FrameBusPublisher::create( const string& name, const DeviceOptions& options, 
+											   size_t slotCount, bool wakeReaders )
+{
+	return FrameBusPublisherRef( new FrameBusPublisher( name, options, slotCount, wakeReaders ) );
+}
+
+FrameBusPublisher::FrameBusPublisher( const string& name, const DeviceOptions& options, size_t slotCount, bool wakeReaders )
+: mBuffer( 0 ), mHeader( 0 ), mMapping( 0 ), mName( name ), mWakeReaders( wakeReaders )
+{
+	for ( size_t i = 0; i < FrameBus::kMaxReaders; ++i ) {
+		mReaderEvents[ i ] = 0;
+	}
+
+	FrameBus::StreamDesc streams[ FrameBus::Stream_Count ];
+	memset( streams, 0, sizeof( streams ) );
+	uint32_t mask = 0;
+	if ( options.isColorEnabled() ) {
+		mask |= 1 << FrameBus::Stream_Color;
+		streams[ FrameBus::Stream_Color ].mWidth			= 1920;
+		streams[ FrameBus::Stream_Color ].mHeight			= 1080;
+		streams[ FrameBus::Stream_Color ].mBytesPerPixel	= 4;
+	}
+	if ( options.isDepthEnabled() ) {
+		mask |= 1 << FrameBus::Stream_Depth;
+	}
+	if ( options.isInfraredEnabled() ) {
+		mask |= 1 << FrameBus::Stream_Infrared;
+	}
+	if ( options.isInfraredLongExposureEnabled() ) {
+		mask |= 1 << FrameBus::Stream_InfraredLongExposure;
+	}
+	if ( options.isBodyIndexEnabled() ) {
+		mask |= 1 << FrameBus::Stream_BodyIndex;
+	}
+	for ( uint32_t i = FrameBus::Stream_Depth; i < FrameBus::Stream_Count; ++i ) {
+		if ( ( mask & ( 1 << i ) ) != 0 ) {
+			streams[ i ].mWidth			= 512;
+			streams[ i ].mHeight		= 424;
+			streams[ i ].mBytesPerPixel	= i == FrameBus::Stream_BodyIndex ? 1 : 2;
+		}
+	}
+
+	uint32_t slotSize = alignFrameBus( sizeof( FrameBus::SlotHeader ) );
+	for ( uint32_t i = 0; i < FrameBus::Stream_Count; ++i ) {
+		streams[ i ].mOffset	= slotSize;
+		slotSize				+= alignFrameBus( streams[ i ].mWidth * streams[ i ].mHeight * streams[ i ].mBytesPerPixel );
+	}
+	slotCount = max<size_t>( slotCount, 2 );
+	uint64_t size = alignFrameBus( sizeof( FrameBus::Header ) ) + (uint64_t)slotSize * slotCount;
+
+	mMapping = CreateFileMappingA( INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, (DWORD)( size >> 32 ), 
+		(DWORD)( size & 0xffffffff ), toMappingName( name ).c_str() );
+	if ( mMapping == 0 ) {
+		throw ExcCreateFailed( name, (long)GetLastError() );
+	}
+	if ( GetLastError() == ERROR_ALREADY_EXISTS ) {
+		CloseHandle( mMapping );
+		throw ExcCreateFailed( name, ERROR_ALREADY_EXISTS );
+	}
+	mBuffer = (uint8_t*)MapViewOfFile( mMapping, FILE_MAP_ALL_ACCESS, 0, 0, (size_t)size );
+	if ( mBuffer == 0 ) {
+		long error = (long)GetLastError();
+		CloseHandle( mMapping );
+		throw ExcCreateFailed( name, error );
+	}
+
+	// New mappings are zero-filled, so slot sequences and reader entries 
+	// start out cleared. The magic number is written last; readers refuse 
+	// to attach until it is there.
+	mHeader					= (FrameBus::Header*)mBuffer;
+	mHeader->mVersion		= kFrameBusVersion;
+	mHeader->mSlotCount		= (uint32_t)slotCount;
+	mHeader->mSlotSize		= slotSize;
+	mHeader->mStreamMask	= mask;
+	memcpy( mHeader->mStreams, streams, sizeof( streams ) );
+	mHeader->mPublished.store( 0 );
+	atomic_thread_fence( memory_order_release );
+	mHeader->mMagic			= kFrameBusMagic;
+}
+
+FrameBusPublisher::~FrameBusPublisher()
+{
+	for ( size_t i = 0; i < FrameBus::kMaxReaders; ++i ) {
+		if ( mReaderEvents[ i ] != 0 ) {
+			CloseHandle( mReaderEvents[ i ] );
+		}
+	}
+	if ( mBuffer != 0 ) {
+		UnmapViewOfFile( mBuffer );
+	}
+	if ( mMapping != 0 ) {
+		CloseHandle( mMapping );
+	}
+}
+
+void FrameBusPublisher::publish( const Frame& frame )
+{
+	uint64_t frameIndex			= mHeader->mPublished.load( memory_order_relaxed ) + 1;
+	FrameBus::SlotHeader* slot	= getSlot( mBuffer, mHeader, frameIndex );
+	uint8_t* data				= (uint8_t*)slot;
+
+	// Odd while writing. The fence keeps the payload writes below from 
+	// becoming visible before the sequence does.
+	slot->mSequence.store( frameIndex * 2 - 1, memory_order_relaxed );
+	atomic_thread_fence( memory_order_release );
+
+	slot->mTimeStamp		= frame.getTimeStamp();
+	slot->mBodyTimeStamp	= frame.getBodyTimeStamp();
+	slot->mStreamMask		= 0;
+
+	const FrameBus::StreamDesc* streams = mHeader->mStreams;
+	const Surface8u& color = frame.getColor();
+	if ( color && streams[ FrameBus::Stream_Color ].mWidth == color.getWidth() && 
+		streams[ FrameBus::Stream_Color ].mHeight == color.getHeight() && color.getPixelInc() == 4 ) {
+		const FrameBus::StreamDesc& desc = streams[ FrameBus::Stream_Color ];
+		copyRows( data + desc.mOffset, desc.mWidth * desc.mBytesPerPixel, color.getData(), color.getRowBytes(), desc.mHeight );
+		slot->mStreamMask |= 1 << FrameBus::Stream_Color;
+	}
+
+	const Channel16u* channels[] = { &frame.getDepth(), &frame.getInfrared(), &frame.getInfraredLongExposure() };
+	for ( uint32_t i = 0; i < 3; ++i ) {
+		const Channel16u& channel			= *channels[ i ];
+		const FrameBus::StreamDesc& desc	= streams[ FrameBus::Stream_Depth + i ];
+		if ( channel && channel.getIncrement() == 1 && desc.mWidth == channel.getWidth() && desc.mHeight == channel.getHeight() ) {
+			copyRows( data + desc.mOffset, desc.mWidth * desc.mBytesPerPixel, (const uint8_t*)channel.getData(), channel.getRowBytes(), desc.mHeight );
+			slot->mStreamMask |= 1 << ( FrameBus::Stream_Depth + i );
+		}
+	}
+
+	const Channel8u& bodyIndex			= frame.getBodyIndex();
+	const FrameBus::StreamDesc& desc	= streams[ FrameBus::Stream_BodyIndex ];
+	if ( bodyIndex && bodyIndex.getIncrement() == 1 && desc.mWidth == bodyIndex.getWidth() && desc.mHeight == bodyIndex.getHeight() ) {
+		copyRows( data + desc.mOffset, desc.mWidth, bodyIndex.getData(), bodyIndex.getRowBytes(), desc.mHeight );
+		slot->mStreamMask |= 1 << FrameBus::Stream_BodyIndex;
+	}
+
+	const vector<Body>& bodies	= frame.getBodies();
+	slot->mBodyCount			= (uint32_t)min<size_t>( bodies.size(), BODY_COUNT );
+	for ( uint32_t i = 0; i < slot->mBodyCount; ++i ) {
+		const Body& body				= bodies[ i ];
+		FrameBus::BodyRecord& record	= slot->mBodies[ i ];
+		record.mId						= body.getId();
+		record.mIndex					= body.getIndex();
+		record.mLeftHandState			= (uint8_t)body.getLeftHandState();
+		record.mRightHandState			= (uint8_t)body.getRightHandState();
+		for ( int32_t j = 0; j < JointType_Count; ++j ) {
+			record.mTrackingStates[ j ] = (uint8_t)TrackingState_NotTracked;
+		}
+		for ( map<JointType, Body::Joint>::const_iterator iter = body.getJointMap().begin(); iter != body.getJointMap().end(); ++iter ) {
+			int32_t j							= (int32_t)iter->first;
+			const Vec3f& p						= iter->second.getPosition();
+			const Quatf& q						= iter->second.getOrientation();
+			record.mTrackingStates[ j ]			= (uint8_t)iter->second.getTrackingState();
+			record.mPositions[ j ][ 0 ]			= p.x;
+			record.mPositions[ j ][ 1 ]			= p.y;
+			record.mPositions[ j ][ 2 ]			= p.z;
+			record.mOrientations[ j ][ 0 ]		= q.v.x;
+			record.mOrientations[ j ][ 1 ]		= q.v.y;
+			record.mOrientations[ j ][ 2 ]		= q.v.z;
+			record.mOrientations[ j ][ 3 ]		= q.w;
+		}
+	}
+
+	slot->mSequence.store( frameIndex * 2, memory_order_release );
+	mHeader->mPublished.store( frameIndex, memory_order_release );
+
+	if ( mWakeReaders ) {
+		for ( size_t i = 0; i < FrameBus::kMaxReaders; ++i ) {
+			bool active = mHeader->mReaders[ i ].mOwner.load( memory_order_acquire ) != 0;
+			if ( active && mReaderEvents[ i ] == 0 ) {
+				mReaderEvents[ i ] = OpenEventA( EVENT_MODIFY_STATE, FALSE, toEventName( mName, i ).c_str() );
+			} else if ( !active && mReaderEvents[ i ] != 0 ) {
+				CloseHandle( mReaderEvents[ i ] );
+				mReaderEvents[ i ] = 0;
+			}
+			if ( mReaderEvents[ i ] != 0 ) {
+				SetEvent( mReaderEvents[ i ] );
+			}
+		}
+	}
+}
+
+uint64_t FrameBusPublisher::getPublishedCount() const
+{
+	return mHeader->mPublished.load( memory_order_acquire );
+}
+
+FrameBus::ReaderStats FrameBusPublisher::getReaderStats( size_t index ) const
+{
+	FrameBus::ReaderStats stats;
+	if ( index < FrameBus::kMaxReaders ) {
+		const FrameBus::ReaderEntry& entry	= mHeader->mReaders[ index ];
+		stats.mActive						= entry.mOwner.load( memory_order_acquire ) != 0;
+		stats.mDropped						= entry.mDropped.load( memory_order_relaxed );
+		stats.mOverruns						= entry.mOverruns.load( memory_order_relaxed );
+		stats.mPosition						= entry.mPosition.load( memory_order_relaxed );
+		uint64_t published					= getPublishedCount();
+		stats.mLag							= stats.mActive && published > stats.mPosition ? published - stats.mPosition : 0;
+	}
+	return stats;
+}
+
+size_t FrameBusPublisher::getReaderCount() const
+{
+	size_t count = 0;
+	for ( size_t i = 0; i < FrameBus::kMaxReaders; ++i ) {
+		if ( mHeader->mReaders[ i ].mOwner.load( memory_order_relaxed ) != 0 ) {
+			++count;
+		}
+	}
+	return count;
+}
+
+const char* FrameBusPublisher::Exception::what() const throw()
+{
+	return mMessage;
+}
+
+FrameBusPublisher::ExcCreateFailed::ExcCreateFailed( const string& name, long error ) throw()
+{
+	sprintf( mMessage, "Unable to create frame bus \"%s\". Error: %i", name.c_str(), error );
+}
+
+FrameBusPublisher::ExcOpenFailed::ExcOpenFailed( const string& name, long error ) throw()
+{
+	sprintf( mMessage, "Unable to open frame bus \"%s\". Error: %i", name.c_str(), error );
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameBusReader::View::View()
+: mFrameIndex( 0 ), mSlot( 0 )
+{
+}
+
+const Channel8u& FrameBusReader::View::getBodyIndex() const
+{
+	return mChannelBodyIndex;
+}
+
+const Surface8u& FrameBusReader::View::getColor() const
+{
+	return mSurfaceColor;
+}
+
+const Channel16u& FrameBusReader::View::getDepth() const
+{
+	return mChannelDepth;
+}
+
+const Channel16u& FrameBusReader::View::getInfrared() const
+{
+	return mChannelInfrared;
+}
+
+const Channel16u& FrameBusReader::View::getInfraredLongExposure() const
+{
+	return mChannelInfraredLongExposure;
+}
+
+long long FrameBusReader::View::getBodyTimeStamp() const
+{
+	return mSlot != 0 ? mSlot->mBodyTimeStamp : 0L;
+}
+
+uint64_t FrameBusReader::View::getFrameIndex() const
+{
+	return mFrameIndex;
+}
+
+long long FrameBusReader::View::getTimeStamp() const
+{
+	return mSlot != 0 ? mSlot->mTimeStamp : 0L;
+}
+
+void FrameBusReader::View::getBodies( vector<Body>& bodies ) const
+{
+	size_t count = mSlot != 0 ? mSlot->mBodyCount : 0;
+	bodies.resize( count );
+	for ( size_t i = 0; i < count; ++i ) {
+		const FrameBus::BodyRecord& record	= mSlot->mBodies[ i ];
+		Body& body							= bodies[ i ];
+		body.mId							= record.mId;
+		body.mIndex							= record.mIndex;
+		body.mLeftHandState					= (HandState)record.mLeftHandState;
+		body.mRightHandState				= (HandState)record.mRightHandState;
+		body.mTracked						= true;
+		for ( int32_t j = 0; j < JointType_Count; ++j ) {
+			Body::Joint& joint		= body.mJointMap[ (JointType)j ];
+			joint.mTrackingState	= (TrackingState)record.mTrackingStates[ j ];
+			joint.mPosition			= Vec3f( record.mPositions[ j ][ 0 ], record.mPositions[ j ][ 1 ], record.mPositions[ j ][ 2 ] );
+			joint.mOrientation		= Quatf( record.mOrientations[ j ][ 3 ], record.mOrientations[ j ][ 0 ], 
+				record.mOrientations[ j ][ 1 ], record.mOrientations[ j ][ 2 ] );
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+FrameBusReaderRef FrameBusReader::create( const string& name )
+{
+	return FrameBusReaderRef( new FrameBusReader( name ) );
+}
+
+FrameBusReader::FrameBusReader( const string& name )
+: mBuffer( 0 ), mEvent( 0 ), mEntry( 0 ), mHeader( 0 ), mMapping( 0 ), mPosition( 0 )
+{
+	mMapping = OpenFileMappingA( FILE_MAP_ALL_ACCESS, FALSE, toMappingName( name ).c_str() );
+	if ( mMapping == 0 ) {
+		throw FrameBusPublisher::ExcOpenFailed( name, (long)GetLastError() );
+	}
+	mBuffer = (uint8_t*)MapViewOfFile( mMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0 );
+	if ( mBuffer == 0 ) {
+		long error = (long)GetLastError();
+		CloseHandle( mMapping );
+		throw FrameBusPublisher::ExcOpenFailed( name, error );
+	}
+	mHeader = (FrameBus::Header*)mBuffer;
+	atomic_thread_fence( memory_order_acquire );
+	if ( mHeader->mMagic != kFrameBusMagic || mHeader->mVersion != kFrameBusVersion ) {
+		UnmapViewOfFile( mBuffer );
+		CloseHandle( mMapping );
+		throw FrameBusPublisher::ExcOpenFailed( name, ERROR_INVALID_DATA );
+	}
+
+	// Free entries held by processes that died without detaching. Entries 
+	// of this process are in use by other readers here.
+	uint32_t processId	= GetCurrentProcessId();
+	uint64_t owner		= getProcessOwner( GetCurrentProcess(), processId );
+	for ( size_t i = 0; i < FrameBus::kMaxReaders; ++i ) {
+		uint64_t current = mHeader->mReaders[ i ].mOwner.load( memory_order_acquire );
+		if ( current != 0 && (uint32_t)( current >> 32 ) != processId && !isOwnerAlive( current ) ) {
+			mHeader->mReaders[ i ].mOwner.compare_exchange_strong( current, 0 );
+		}
+	}
+
+	for ( size_t i = 0; i < FrameBus::kMaxReaders && mEntry == 0; ++i ) {
+		uint64_t expected = 0;
+		if ( mHeader->mReaders[ i ].mOwner.compare_exchange_strong( expected, owner ) ) {
+			mEntry = &mHeader->mReaders[ i ];
+			mEntry->mDropped.store( 0 );
+			mEntry->mOverruns.store( 0 );
+			mEvent = CreateEventA( 0, FALSE, FALSE, toEventName( name, i ).c_str() );
+		}
+	}
+	
+	// Start at the newest frame. Readers past kMaxReaders still work, but 
+	// are neither woken nor visible to the publisher's statistics.
+	mPosition = mHeader->mPublished.load( memory_order_acquire );
+	if ( mEntry != 0 ) {
+		mEntry->mPosition.store( mPosition );
+	}
+}
+
+FrameBusReader::~FrameBusReader()
+{
+	if ( mEntry != 0 ) {
+		mEntry->mOwner.store( 0, memory_order_release );
+	}
+	if ( mEvent != 0 ) {
+		CloseHandle( mEvent );
+	}
+	UnmapViewOfFile( mBuffer );
+	CloseHandle( mMapping );
+}
+
+bool FrameBusReader::acquire( uint64_t frameIndex, View& view )
+{
+	const FrameBus::SlotHeader* slot = getSlot( mBuffer, mHeader, frameIndex );
+	if ( slot->mSequence.load( memory_order_acquire ) != frameIndex * 2 ) {
+		return false;
+	}
+
+	view.mFrameIndex	= frameIndex;
+	view.mSlot			= slot;
+
+	// Views wrap the slot's memory directly.
+	uint8_t* data						= (uint8_t*)slot;
+	uint32_t mask						= slot->mStreamMask;
+	const FrameBus::StreamDesc* streams = mHeader->mStreams;
+	const FrameBus::StreamDesc& color	= streams[ FrameBus::Stream_Color ];
+	view.mSurfaceColor = ( mask & ( 1 << FrameBus::Stream_Color ) ) != 0 ? 
+		Surface8u( data + color.mOffset, color.mWidth, color.mHeight, color.mWidth * 4, SurfaceChannelOrder::RGBA ) : Surface8u();
+	
+	Channel16u* channels[] = { &view.mChannelDepth, &view.mChannelInfrared, &view.mChannelInfraredLongExposure };
+	for ( uint32_t i = 0; i < 3; ++i ) {
+		const FrameBus::StreamDesc& desc = streams[ FrameBus::Stream_Depth + i ];
+		*channels[ i ] = ( mask & ( 1 << ( FrameBus::Stream_Depth + i ) ) ) != 0 ? 
+			Channel16u( desc.mWidth, desc.mHeight, desc.mWidth * 2, 1, (uint16_t*)( data + desc.mOffset ) ) : Channel16u();
+	}
+
+	const FrameBus::StreamDesc& bodyIndex = streams[ FrameBus::Stream_BodyIndex ];
+	view.mChannelBodyIndex = ( mask & ( 1 << FrameBus::Stream_BodyIndex ) ) != 0 ? 
+		Channel8u( bodyIndex.mWidth, bodyIndex.mHeight, bodyIndex.mWidth, 1, data + bodyIndex.mOffset ) : Channel8u();
+
+	if ( frameIndex > mPosition + 1 && mEntry != 0 ) {
+		mEntry->mDropped.fetch_add( frameIndex - mPosition - 1, memory_order_relaxed );
+	}
+	mPosition = frameIndex;
+	if ( mEntry != 0 ) {
+		mEntry->mPosition.store( mPosition, memory_order_relaxed );
+	}
+	return true;
+}
+
+bool FrameBusReader::acquireLatest( View& view )
+{
+	// A miss means the publisher is already rewriting the newest slot, 
+	// so fall back to the one before it.
+	uint64_t published = mHeader->mPublished.load( memory_order_acquire );
+	for ( uint64_t frameIndex = published; frameIndex > mPosition && frameIndex + 1 >= published; --frameIndex ) {
+		if ( acquire( frameIndex, view ) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FrameBusReader::acquireNext( View& view )
+{
+	uint64_t published = mHeader->mPublished.load( memory_order_acquire );
+	if ( published <= mPosition ) {
+		return false;
+	}
+
+	// Skip what the publisher has lapped, keeping one slot of slack for 
+	// the frame being written.
+	uint64_t frameIndex = mPosition + 1;
+	uint64_t slotCount	= mHeader->mSlotCount;
+	if ( published - frameIndex >= slotCount - 1 ) {
+		frameIndex = published - slotCount + 2;
+	}
+	for ( ; frameIndex <= published; ++frameIndex ) {
+		if ( acquire( frameIndex, view ) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FrameBusReader::release( const View& view )
+{
+	if ( view.mSlot == 0 ) {
+		return false;
+	}
+	atomic_thread_fence( memory_order_acquire );
+	bool valid = view.mSlot->mSequence.load( memory_order_relaxed ) == view.mFrameIndex * 2;
+	if ( !valid && mEntry != 0 ) {
+		mEntry->mOverruns.fetch_add( 1, memory_order_relaxed );
+	}
+	return valid;
+}
+
+bool FrameBusReader::waitForFrame( uint32_t timeoutMs )
+{
+	if ( mHeader->mPublished.load( memory_order_acquire ) > mPosition ) {
+		return true;
+	}
+	if ( mEvent == 0 ) {
+		return false;
+	}
+	WaitForSingleObject( mEvent, timeoutMs );
+	return mHeader->mPublished.load( memory_order_acquire ) > mPosition;
+}
+
+FrameBus::ReaderStats FrameBusReader::getStats() const
+{
+	FrameBus::ReaderStats stats;
+	stats.mPosition = mPosition;
+	uint64_t published = mHeader->mPublished.load( memory_order_acquire );
+	stats.mLag = published > mPosition ? published - mPosition : 0;
+	if ( mEntry != 0 ) {
+		stats.mActive	= true;
+		stats.mDropped	= mEntry->mDropped.load( memory_order_relaxed );
+		stats.mOverruns	= mEntry->mOverruns.load( memory_order_relaxed );
+	}
+	return stats;
+}
+
+}
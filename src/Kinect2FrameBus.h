@@ -0,0 +1,242 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2.h"
+
+namespace Kinect2 {
+
+class FrameBusPublisher;
+class FrameBusReader;
+typedef std::shared_ptr<FrameBusPublisher>	FrameBusPublisherRef;
+typedef std::shared_ptr<FrameBusReader>		FrameBusReaderRef;
+
+// Shared memory layout common to publisher and readers. Every slot holds 
+// one complete frame. Slot sequence numbers are odd while the publisher 
+// writes and even once the frame is complete, so readers can validate 
+// what they read without locking (seqlock).
+namespace FrameBus
+{
+	enum : uint32_t
+	{
+		Stream_Color, Stream_Depth, Stream_Infrared, Stream_InfraredLongExposure, 
+		Stream_BodyIndex, Stream_Count
+	};
+
+	static const uint32_t kMaxReaders = 16;
+
+	struct StreamDesc
+	{
+		int32_t									mWidth;
+		int32_t									mHeight;
+		uint32_t								mBytesPerPixel;
+		uint32_t								mOffset;
+	};
+
+	struct BodyRecord
+	{
+		uint64_t								mId;
+		uint8_t									mIndex;
+		uint8_t									mLeftHandState;
+		uint8_t									mRightHandState;
+		uint8_t									mTrackingStates[ JointType_Count ];
+		float									mOrientations[ JointType_Count ][ 4 ];
+		float									mPositions[ JointType_Count ][ 3 ];
+	};
+
+	// A reader's entry is owned by its process: the process id in the high 
+	// 32 bits and the low 32 bits of its creation time, which tells a dead 
+	// owner apart from a new process that reuses the id. Zero while free.
+	struct ReaderEntry
+	{
+		std::atomic<uint64_t>					mOwner;
+		std::atomic<uint64_t>					mDropped;
+		std::atomic<uint64_t>					mOverruns;
+		std::atomic<uint64_t>					mPosition;
+	};
+
+	struct Header
+	{
+		uint32_t								mMagic;
+		uint32_t								mVersion;
+		uint32_t								mSlotCount;
+		uint32_t								mSlotSize;
+		uint32_t								mStreamMask;
+		StreamDesc								mStreams[ Stream_Count ];
+		std::atomic<uint64_t>					mPublished;
+		ReaderEntry								mReaders[ kMaxReaders ];
+	};
+
+	struct SlotHeader
+	{
+		std::atomic<uint64_t>					mSequence;
+		long long								mTimeStamp;
+		long long								mBodyTimeStamp;
+		uint32_t								mStreamMask;
+		uint32_t								mBodyCount;
+		BodyRecord								mBodies[ BODY_COUNT ];
+	};
+
+	// Lag and loss figures for one reader, as seen by either side.
+	struct ReaderStats
+	{
+		ReaderStats();
+
+		bool									mActive;
+		uint64_t								mDropped;
+		uint64_t								mLag;
+		uint64_t								mOverruns;
+		uint64_t								mPosition;
+	};
+}
+
+// Writes each Frame into the next slot of a named shared memory ring. 
+// Besides copying the frame, the only per-frame system calls are the 
+// optional wake-ups of waiting readers.
+class FrameBusPublisher
+{
+public:
+	// Streams enabled in "options" get space in every slot. 
+	static FrameBusPublisherRef					create( const std::string& name, const DeviceOptions& options, 
+												size_t slotCount = 4, bool wakeReaders = true );
+	~FrameBusPublisher();
+
+	void										publish( const Frame& frame );
+
+	uint64_t									getPublishedCount() const;
+	FrameBus::ReaderStats						getReaderStats( size_t index ) const;
+	size_t										getReaderCount() const;
+protected:
+	FrameBusPublisher( const std::string& name, const DeviceOptions& options, size_t slotCount, bool wakeReaders );
+
+	uint8_t*									mBuffer;
+	FrameBus::Header*							mHeader;
+	HANDLE										mMapping;
+	std::string									mName;
+	HANDLE										mReaderEvents[ FrameBus::kMaxReaders ];
+	bool										mWakeReaders;
+public:
+
+	//////////////////////////////////////////////////////////////////////////////////////////////
+
+	class Exception : public ci::Exception
+	{
+	public:
+		const char* what() const throw();
+	protected:
+		char									mMessage[ 2048 ];
+		friend class							FrameBusPublisher;
+		friend class							FrameBusReader;
+	};
+
+	class ExcCreateFailed : public Exception 
+	{
+	public:
+		ExcCreateFailed( const std::string& name, long error ) throw();
+	};
+
+	class ExcOpenFailed : public Exception 
+	{
+	public:
+		ExcOpenFailed( const std::string& name, long error ) throw();
+	};
+};
+
+// Reads frames published by another process without copying. Channels and 
+// surfaces in a View point straight into shared memory; call release() 
+// when done to find out whether the publisher overwrote them in the meantime. 
+// Entries left behind by reader processes that exited without cleaning up 
+// are reclaimed when the next reader attaches.
+class FrameBusReader
+{
+public:
+	static FrameBusReaderRef					create( const std::string& name );
+	~FrameBusReader();
+
+	class View
+	{
+	public:
+		View();
+
+		const ci::Channel8u&					getBodyIndex() const;
+		const ci::Surface8u&					getColor() const;
+		const ci::Channel16u&					getDepth() const;
+		const ci::Channel16u&					getInfrared() const;
+		const ci::Channel16u&					getInfraredLongExposure() const;
+		long long								getBodyTimeStamp() const;
+		uint64_t								getFrameIndex() const;
+		long long								getTimeStamp() const;
+
+		// Rebuilds bodies into "bodies", reusing existing entries.
+		void									getBodies( std::vector<Body>& bodies ) const;
+	protected:
+		ci::Channel8u							mChannelBodyIndex;
+		ci::Channel16u							mChannelDepth;
+		ci::Channel16u							mChannelInfrared;
+		ci::Channel16u							mChannelInfraredLongExposure;
+		uint64_t								mFrameIndex;
+		const FrameBus::SlotHeader*				mSlot;
+		ci::Surface8u							mSurfaceColor;
+
+		friend class							FrameBusReader;
+	};
+
+	// Newest complete frame not seen yet. Older unread frames are dropped.
+	bool										acquireLatest( View& view );
+	// Next frame in order. Frames already overwritten are counted as dropped.
+	bool										acquireNext( View& view );
+	// True if the frame stayed intact while the view was in use.
+	bool										release( const View& view );
+	// Blocks until a frame newer than the last acquired one is published.
+	bool										waitForFrame( uint32_t timeoutMs );
+
+	FrameBus::ReaderStats						getStats() const;
+protected:
+	FrameBusReader( const std::string& name );
+
+	bool										acquire( uint64_t frameIndex, View& view );
+
+	uint8_t*									mBuffer;
+	HANDLE										mEvent;
+	FrameBus::ReaderEntry*						mEntry;
+	FrameBus::Header*							mHeader;
+	HANDLE										mMapping;
+	uint64_t									mPosition;
+};
+
+}
@@ -0,0 +1,193 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2FrameHistory.h"
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+FrameHistoryRef FrameHistory::create( size_t capacity, size_t memoryBudget )
+{
+	return FrameHistoryRef( new FrameHistory( capacity, memoryBudget ) );
+}
+
+FrameHistory::FrameHistory( size_t capacity, size_t memoryBudget )
+: mHead( 0 ), mMemoryBudget( memoryBudget ), mMemoryUsage( 0 ), mSize( 0 )
+{
+	capacity = max<size_t>( capacity, 1 );
+	mFrames.resize( capacity );
+	mMemoryUsages.resize( capacity, 0 );
+}
+
+size_t FrameHistory::calcMemoryUsage( const Frame& frame )
+{
+	size_t bytes = frame.getBodies().size() * ( sizeof( Body ) + JointType_Count * ( sizeof( Body::Joint ) + 4 * sizeof( void* ) ) );
+	if ( frame.getBodyIndex() ) {
+		bytes += frame.getBodyIndex().getRowBytes() * frame.getBodyIndex().getHeight();
+	}
+	if ( frame.getColor() ) {
+		bytes += frame.getColor().getRowBytes() * frame.getColor().getHeight();
+	}
+	const Channel16u* channels[] = { &frame.getDepth(), &frame.getInfrared(), &frame.getInfraredLongExposure() };
+	for ( size_t i = 0; i < 3; ++i ) {
+		if ( *channels[ i ] ) {
+			bytes += channels[ i ]->getRowBytes() * channels[ i ]->getHeight();
+		}
+	}
+	return bytes;
+}
+
+bool FrameHistory::push( const Frame& frame )
+{
+	if ( mSize > 0 && frame.getTimeStamp() <= mFrames[ mHead ]->getTimeStamp() ) {
+		return false;
+	}
+
+	// Overwriting the oldest slot only drops this history's reference; 
+	// snapshots handed out earlier stay alive.
+	size_t capacity = mFrames.size();
+	mHead			= ( mHead + 1 ) % capacity;
+	if ( mSize == capacity ) {
+		mMemoryUsage -= mMemoryUsages[ mHead ];
+	} else {
+		++mSize;
+	}
+	mFrames[ mHead ]		= FrameSnapshotRef( new Frame( frame ) );
+	mMemoryUsages[ mHead ]	= calcMemoryUsage( frame );
+	mMemoryUsage			+= mMemoryUsages[ mHead ];
+	evict();
+	return true;
+}
+
+void FrameHistory::clear()
+{
+	for ( size_t i = 0; i < mFrames.size(); ++i ) {
+		mFrames[ i ].reset();
+		mMemoryUsages[ i ] = 0;
+	}
+	mHead			= 0;
+	mMemoryUsage	= 0;
+	mSize			= 0;
+}
+
+void FrameHistory::evict()
+{
+	while ( mMemoryBudget > 0 && mMemoryUsage > mMemoryBudget && mSize > 1 ) {
+		size_t i			= slot( mSize - 1 );
+		mMemoryUsage		-= mMemoryUsages[ i ];
+		mMemoryUsages[ i ]	= 0;
+		mFrames[ i ].reset();
+		--mSize;
+	}
+}
+
+size_t FrameHistory::slot( size_t age ) const
+{
+	size_t capacity = mFrames.size();
+	return ( mHead + capacity - age ) % capacity;
+}
+
+FrameSnapshotRef FrameHistory::get( size_t age ) const
+{
+	return age < mSize ? mFrames[ slot( age ) ] : FrameSnapshotRef();
+}
+
+FrameSnapshotRef FrameHistory::find( long long timeStamp ) const
+{
+	if ( mSize == 0 ) {
+		return FrameSnapshotRef();
+	}
+
+	long long newest	= mFrames[ slot( 0 ) ]->getTimeStamp();
+	long long oldest	= mFrames[ slot( mSize - 1 ) ]->getTimeStamp();
+	if ( timeStamp >= newest || mSize == 1 ) {
+		return mFrames[ slot( 0 ) ];
+	} else if ( timeStamp <= oldest ) {
+		return mFrames[ slot( mSize - 1 ) ];
+	}
+
+	// Time stamps decrease with age. Guess from the mean interval, then 
+	// step until "timeStamp" lies between two neighbours.
+	double interval	= (double)( newest - oldest ) / (double)( mSize - 1 );
+	size_t age		= min( (size_t)( (double)( newest - timeStamp ) / interval + 0.5 ), mSize - 1 );
+	while ( age > 0 && mFrames[ slot( age ) ]->getTimeStamp() < timeStamp ) {
+		--age;
+	}
+	while ( age + 1 < mSize && mFrames[ slot( age + 1 ) ]->getTimeStamp() >= timeStamp ) {
+		++age;
+	}
+
+	// "age" is now the oldest frame at or after "timeStamp".
+	if ( age + 1 < mSize ) {
+		long long after		= mFrames[ slot( age ) ]->getTimeStamp();
+		long long before	= mFrames[ slot( age + 1 ) ]->getTimeStamp();
+		if ( timeStamp - before < after - timeStamp ) {
+			++age;
+		}
+	}
+	return mFrames[ slot( age ) ];
+}
+
+size_t FrameHistory::getCapacity() const
+{
+	return mFrames.size();
+}
+
+size_t FrameHistory::getMemoryBudget() const
+{
+	return mMemoryBudget;
+}
+
+size_t FrameHistory::getMemoryUsage() const
+{
+	return mMemoryUsage;
+}
+
+size_t FrameHistory::getSize() const
+{
+	return mSize;
+}
+
+void FrameHistory::setMemoryBudget( size_t memoryBudget )
+{
+	mMemoryBudget = memoryBudget;
+	evict();
+}
+
+}
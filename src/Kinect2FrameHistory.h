@@ -0,0 +1,92 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2.h"
+
+namespace Kinect2 {
+
+class FrameHistory;
+typedef std::shared_ptr<FrameHistory>	FrameHistoryRef;
+typedef std::shared_ptr<const Frame>	FrameSnapshotRef;
+
+// Ring of the most recent frames as immutable, shared snapshots. Device 
+// allocates new channels for every frame and never writes into old ones, 
+// so a snapshot shares its pixel buffers instead of copying them and stays 
+// valid for as long as anyone holds it.
+class FrameHistory
+{
+public:
+	// "memoryBudget" caps the bytes of pixel and body data held, evicting 
+	// the oldest frames first. 0 means only "capacity" applies.
+	static FrameHistoryRef						create( size_t capacity = 30, size_t memoryBudget = 0 );
+
+	// Appends "frame" if its time stamp is newer than the last one.
+	bool										push( const Frame& frame );
+	void										clear();
+
+	// "age" is the number of frames before the most recent one. Returns 
+	// null past the oldest frame held.
+	FrameSnapshotRef							get( size_t age = 0 ) const;
+	// Frame closest in time to "timeStamp". The index is estimated from the 
+	// mean frame interval and corrected locally, so lookups take constant 
+	// time while the frame rate is steady.
+	FrameSnapshotRef							find( long long timeStamp ) const;
+
+	size_t										getCapacity() const;
+	size_t										getMemoryBudget() const;
+	size_t										getMemoryUsage() const;
+	size_t										getSize() const;
+	void										setMemoryBudget( size_t memoryBudget );
+
+	static size_t								calcMemoryUsage( const Frame& frame );
+protected:
+	FrameHistory( size_t capacity, size_t memoryBudget );
+
+	void										evict();
+	size_t										slot( size_t age ) const;
+
+	std::vector<FrameSnapshotRef>				mFrames;
+	size_t										mHead;
+	size_t										mMemoryBudget;
+	size_t										mMemoryUsage;
+	std::vector<size_t>							mMemoryUsages;
+	size_t										mSize;
+};
+
+}
@@ -0,0 +1,478 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2Gesture.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <ppl.h>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+GestureRecognizer::Match::Match()
+: mBodyId( 0 ), mDistance( FLT_MAX ), mTemplate( 0 )
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+GestureRecognizerRef GestureRecognizer::create()
+{
+	vector<JointType> joints;
+	joints.push_back( JointType_Head );
+	joints.push_back( JointType_ElbowLeft );
+	joints.push_back( JointType_WristLeft );
+	joints.push_back( JointType_HandLeft );
+	joints.push_back( JointType_ElbowRight );
+	joints.push_back( JointType_WristRight );
+	joints.push_back( JointType_HandRight );
+	return create( joints );
+}
+
+GestureRecognizerRef GestureRecognizer::create( const vector<JointType>& joints, size_t length, float bandRatio, size_t maxDuration )
+{
+	return GestureRecognizerRef( new GestureRecognizer( joints, length, bandRatio, maxDuration ) );
+}
+
+GestureRecognizer::GestureRecognizer( const vector<JointType>& joints, size_t length, float bandRatio, size_t maxDuration )
+: mJoints( joints ), mLength( max<size_t>( length, 2 ) ), mMaxDuration( max<size_t>( maxDuration, 2 ) ), 
+mTimeStamp( 0L ), mAbandonedCount( 0 ), mComparedCount( 0 ), mPrunedCount( 0 )
+{
+	mBandRadius	= max<size_t>( (size_t)( bandRatio * (float)mLength + 0.5f ), 1 );
+	mDimensions	= mJoints.size() * 3;
+
+	mTracks.resize( BODY_COUNT );
+	for ( vector<Track>::iterator iter = mTracks.begin(); iter != mTracks.end(); ++iter ) {
+		iter->mActive	= false;
+		iter->mId		= 0;
+		iter->mSequence	= 0;
+		iter->mSize		= 0;
+		iter->mFrames.resize( mMaxDuration * mDimensions );
+	}
+	mMatches.reserve( BODY_COUNT );
+}
+
+size_t GestureRecognizer::addTemplate( const string& name, const vector<Body>& frames, float threshold )
+{
+	vector<float> data( frames.size() * mDimensions );
+	size_t count = 0;
+	for ( vector<Body>::const_iterator iter = frames.begin(); iter != frames.end(); ++iter ) {
+		if ( normalize( *iter, &data[ count * mDimensions ] ) ) {
+			++count;
+		}
+	}
+	addTemplate( name, data, count, threshold );
+	return mTemplates.size() - 1;
+}
+
+size_t GestureRecognizer::addTemplate( const string& name, const vector<Vec3f>& positions, size_t frameCount, float threshold )
+{
+	size_t count = min( frameCount, positions.size() / max<size_t>( mJoints.size(), 1 ) );
+	vector<float> data( count * mDimensions );
+	for ( size_t i = 0; i < count * mJoints.size(); ++i ) {
+		data[ i * 3 + 0 ] = positions[ i ].x;
+		data[ i * 3 + 1 ] = positions[ i ].y;
+		data[ i * 3 + 2 ] = positions[ i ].z;
+	}
+	addTemplate( name, data, count, threshold );
+	return mTemplates.size() - 1;
+}
+
+void GestureRecognizer::addTemplate( const string& name, const vector<float>& frames, size_t frameCount, float threshold )
+{
+	Template t;
+	t.mName			= name;
+	t.mDuration		= min( max<size_t>( frameCount, 2 ), mMaxDuration );
+	t.mThreshold	= threshold;
+	t.mData.resize( mLength * mDimensions, 0.0f );
+	t.mLower.resize( mLength * mDimensions );
+	t.mUpper.resize( mLength * mDimensions );
+	if ( frameCount > 0 ) {
+		resample( &frames[ 0 ], frameCount, &t.mData[ 0 ] );
+	}
+
+	// LB_Keogh envelope over the same band the warping path is held to
+	for ( size_t i = 0; i < mLength; ++i ) {
+		size_t lo = i > mBandRadius ? i - mBandRadius : 0;
+		size_t hi = min( i + mBandRadius, mLength - 1 );
+		for ( size_t d = 0; d < mDimensions; ++d ) {
+			float lower = FLT_MAX;
+			float upper = -FLT_MAX;
+			for ( size_t j = lo; j <= hi; ++j ) {
+				float v	= t.mData[ j * mDimensions + d ];
+				lower	= min( lower, v );
+				upper	= max( upper, v );
+			}
+			t.mLower[ i * mDimensions + d ] = lower;
+			t.mUpper[ i * mDimensions + d ] = upper;
+		}
+	}
+
+	mTemplates.push_back( t );
+	allocateScratch();
+}
+
+void GestureRecognizer::clearTemplates()
+{
+	mTemplates.clear();
+	mMatches.clear();
+	allocateScratch();
+}
+
+void GestureRecognizer::allocateScratch()
+{
+	size_t pairCount = mTemplates.size() * BODY_COUNT;
+	mPairDistances.resize( pairCount );
+	mPairResults.resize( pairCount );
+	mScratch.resize( pairCount * ( mLength * mDimensions + ( mLength + 1 ) * 2 ) );
+}
+
+void GestureRecognizer::reset()
+{
+	for ( vector<Track>::iterator iter = mTracks.begin(); iter != mTracks.end(); ++iter ) {
+		iter->mActive	= false;
+		iter->mId		= 0;
+		iter->mSequence	= 0;
+		iter->mSize		= 0;
+	}
+	mMatches.clear();
+	mTimeStamp = 0L;
+}
+
+bool GestureRecognizer::normalize( const Body& body, float* output ) const
+{
+	const map<JointType, Body::Joint>& jointMap = body.getJointMap();
+	map<JointType, Body::Joint>::const_iterator spine			= jointMap.find( JointType_SpineMid );
+	map<JointType, Body::Joint>::const_iterator shoulderLeft	= jointMap.find( JointType_ShoulderLeft );
+	map<JointType, Body::Joint>::const_iterator shoulderRight	= jointMap.find( JointType_ShoulderRight );
+	if ( spine == jointMap.end() || shoulderLeft == jointMap.end() || shoulderRight == jointMap.end() ) {
+		return false;
+	}
+
+	float width = shoulderLeft->second.getPosition().distance( shoulderRight->second.getPosition() );
+	if ( width < 0.01f ) {
+		return false;
+	}
+	float scale		= 1.0f / width;
+	Vec3f origin	= spine->second.getPosition();
+	for ( size_t i = 0; i < mJoints.size(); ++i ) {
+		map<JointType, Body::Joint>::const_iterator iter = jointMap.find( mJoints[ i ] );
+		Vec3f v = iter != jointMap.end() ? ( iter->second.getPosition() - origin ) * scale : Vec3f::zero();
+		output[ i * 3 + 0 ] = v.x;
+		output[ i * 3 + 1 ] = v.y;
+		output[ i * 3 + 2 ] = v.z;
+	}
+	return true;
+}
+
+void GestureRecognizer::resample( const float* input, size_t inputCount, float* output ) const
+{
+	if ( inputCount == 1 ) {
+		for ( size_t i = 0; i < mLength; ++i ) {
+			memcpy( output + i * mDimensions, input, mDimensions * sizeof( float ) );
+		}
+		return;
+	}
+	float step = (float)( inputCount - 1 ) / (float)( mLength - 1 );
+	for ( size_t i = 0; i < mLength; ++i ) {
+		float t			= (float)i * step;
+		size_t a		= min( (size_t)t, inputCount - 2 );
+		float f			= t - (float)a;
+		const float* pa	= input + a * mDimensions;
+		const float* pb	= pa + mDimensions;
+		float* po		= output + i * mDimensions;
+		for ( size_t d = 0; d < mDimensions; ++d ) {
+			po[ d ] = pa[ d ] + ( pb[ d ] - pa[ d ] ) * f;
+		}
+	}
+}
+
+void GestureRecognizer::resampleTrack( const Track& track, size_t duration, float* output ) const
+{
+	uint64_t first	= track.mSequence - duration;
+	float step		= (float)( duration - 1 ) / (float)( mLength - 1 );
+	for ( size_t i = 0; i < mLength; ++i ) {
+		float t			= (float)i * step;
+		size_t a		= min( (size_t)t, duration - 2 );
+		float f			= t - (float)a;
+		const float* pa	= &track.mFrames[ (size_t)( ( first + a ) % mMaxDuration ) * mDimensions ];
+		const float* pb	= &track.mFrames[ (size_t)( ( first + a + 1 ) % mMaxDuration ) * mDimensions ];
+		float* po		= output + i * mDimensions;
+		for ( size_t d = 0; d < mDimensions; ++d ) {
+			po[ d ] = pa[ d ] + ( pb[ d ] - pa[ d ] ) * f;
+		}
+	}
+}
+
+int32_t GestureRecognizer::compare( size_t templateIndex, size_t trackIndex, float* scratch, float& distance ) const
+{
+	const Template& t	= mTemplates[ templateIndex ];
+	const Track& track	= mTracks[ trackIndex ];
+	if ( track.mSize < t.mDuration ) {
+		return Result_Skipped;
+	}
+
+	float* query	= scratch;
+	float* prev		= query + mLength * mDimensions;
+	float* cur		= prev + mLength + 1;
+	float limit		= t.mThreshold * (float)mLength;
+	resampleTrack( track, t.mDuration, query );
+
+	// Lower bound first; most pairs never reach the full warp
+	float bound = 0.0f;
+	for ( size_t i = 0; i < mLength; ++i ) {
+		const float* q		= query + i * mDimensions;
+		const float* lower	= &t.mLower[ i * mDimensions ];
+		const float* upper	= &t.mUpper[ i * mDimensions ];
+		for ( size_t d = 0; d < mDimensions; ++d ) {
+			float v = q[ d ];
+			if ( v > upper[ d ] ) {
+				bound += ( v - upper[ d ] ) * ( v - upper[ d ] );
+			} else if ( v < lower[ d ] ) {
+				bound += ( lower[ d ] - v ) * ( lower[ d ] - v );
+			}
+		}
+		if ( bound > limit ) {
+			return Result_Pruned;
+		}
+	}
+
+	prev[ 0 ] = 0.0f;
+	for ( size_t j = 1; j <= mLength; ++j ) {
+		prev[ j ] = FLT_MAX;
+	}
+	for ( size_t i = 1; i <= mLength; ++i ) {
+		size_t lo		= i > mBandRadius ? i - mBandRadius : 1;
+		size_t hi		= min( i + mBandRadius, mLength );
+		const float* q	= query + ( i - 1 ) * mDimensions;
+		float rowMin	= FLT_MAX;
+		for ( size_t j = 0; j <= mLength; ++j ) {
+			cur[ j ] = FLT_MAX;
+		}
+		for ( size_t j = lo; j <= hi; ++j ) {
+			const float* c	= &t.mData[ ( j - 1 ) * mDimensions ];
+			float cost		= 0.0f;
+			for ( size_t d = 0; d < mDimensions; ++d ) {
+				float delta	= q[ d ] - c[ d ];
+				cost		+= delta * delta;
+			}
+			float best = min( prev[ j - 1 ], min( prev[ j ], cur[ j - 1 ] ) );
+			cur[ j ] = best == FLT_MAX ? FLT_MAX : best + cost;
+			rowMin = min( rowMin, cur[ j ] );
+		}
+		if ( rowMin > limit ) {
+			return Result_Abandoned;
+		}
+		swap( prev, cur );
+	}
+
+	distance = prev[ mLength ] / (float)mLength;
+	return distance <= t.mThreshold ? Result_Matched : Result_Rejected;
+}
+
+void GestureRecognizer::update( const Frame& frame )
+{
+	update( frame.getBodies(), frame.getTimeStamp() );
+}
+
+void GestureRecognizer::update( const vector<Body>& bodies, long long timeStamp )
+{
+	if ( timeStamp <= mTimeStamp ) {
+		return;
+	}
+	mTimeStamp = timeStamp;
+
+	bool seen[ BODY_COUNT ] = { false };
+	for ( vector<Body>::const_iterator body = bodies.begin(); body != bodies.end(); ++body ) {
+		if ( !body->isTracked() ) {
+			continue;
+		}
+		int32_t index		= -1;
+		int32_t available	= -1;
+		for ( int32_t i = 0; i < BODY_COUNT; ++i ) {
+			if ( mTracks[ i ].mActive ) {
+				if ( mTracks[ i ].mId == body->getId() ) {
+					index = i;
+					break;
+				}
+			} else if ( available < 0 ) {
+				available = i;
+			}
+		}
+		if ( index < 0 ) {
+			if ( available < 0 ) {
+				continue;
+			}
+			index						= available;
+			mTracks[ index ].mActive	= true;
+			mTracks[ index ].mId		= body->getId();
+			mTracks[ index ].mSequence	= 0;
+			mTracks[ index ].mSize		= 0;
+		}
+		
+		Track& track	= mTracks[ index ];
+		seen[ index ]	= true;
+		float* slot		= &track.mFrames[ (size_t)( track.mSequence % mMaxDuration ) * mDimensions ];
+		if ( normalize( *body, slot ) ) {
+			++track.mSequence;
+			track.mSize = min( track.mSize + 1, mMaxDuration );
+		}
+	}
+
+	size_t trackIndices[ BODY_COUNT ];
+	size_t trackCount = 0;
+	for ( size_t i = 0; i < BODY_COUNT; ++i ) {
+		if ( !seen[ i ] ) {
+			mTracks[ i ].mActive	= false;
+			mTracks[ i ].mId		= 0;
+		} else {
+			trackIndices[ trackCount++ ] = i;
+		}
+	}
+
+	mMatches.clear();
+	mAbandonedCount	= 0;
+	mComparedCount	= 0;
+	mPrunedCount	= 0;
+	if ( mTemplates.empty() || trackCount == 0 ) {
+		return;
+	}
+
+	size_t pairCount	= mTemplates.size() * trackCount;
+	size_t scratchSize	= mLength * mDimensions + ( mLength + 1 ) * 2;
+	concurrency::parallel_for( (size_t)0, pairCount, [ & ]( size_t pair )
+	{
+		size_t templateIndex	= pair / trackCount;
+		size_t trackIndex		= trackIndices[ pair % trackCount ];
+		mPairDistances[ pair ]	= FLT_MAX;
+		mPairResults[ pair ]	= compare( templateIndex, trackIndex, &mScratch[ pair * scratchSize ], mPairDistances[ pair ] );
+	} );
+
+	for ( size_t k = 0; k < trackCount; ++k ) {
+		Match match;
+		for ( size_t t = 0; t < mTemplates.size(); ++t ) {
+			size_t pair = t * trackCount + k;
+			switch ( mPairResults[ pair ] ) {
+			case Result_Matched:
+				if ( mPairDistances[ pair ] < match.mDistance ) {
+					match.mDistance = mPairDistances[ pair ];
+					match.mTemplate = t;
+				}
+				++mComparedCount;
+				break;
+			case Result_Rejected:
+				++mComparedCount;
+				break;
+			case Result_Abandoned:
+				++mAbandonedCount;
+				break;
+			case Result_Pruned:
+				++mPrunedCount;
+				break;
+			}
+		}
+		if ( match.mDistance < FLT_MAX ) {
+			match.mBodyId = mTracks[ trackIndices[ k ] ].mId;
+			mMatches.push_back( match );
+		}
+	}
+}
+
+const vector<GestureRecognizer::Match>& GestureRecognizer::getMatches() const
+{
+	return mMatches;
+}
+
+size_t GestureRecognizer::getBandRadius() const
+{
+	return mBandRadius;
+}
+
+const vector<JointType>& GestureRecognizer::getJoints() const
+{
+	return mJoints;
+}
+
+size_t GestureRecognizer::getLength() const
+{
+	return mLength;
+}
+
+size_t GestureRecognizer::getMaxDuration() const
+{
+	return mMaxDuration;
+}
+
+size_t GestureRecognizer::getTemplateCount() const
+{
+	return mTemplates.size();
+}
+
+size_t GestureRecognizer::getTemplateDuration( size_t index ) const
+{
+	return mTemplates.at( index ).mDuration;
+}
+
+const string& GestureRecognizer::getTemplateName( size_t index ) const
+{
+	return mTemplates.at( index ).mName;
+}
+
+float GestureRecognizer::getTemplateThreshold( size_t index ) const
+{
+	return mTemplates.at( index ).mThreshold;
+}
+
+size_t GestureRecognizer::getAbandonedCount() const
+{
+	return mAbandonedCount;
+}
+
+size_t GestureRecognizer::getComparedCount() const
+{
+	return mComparedCount;
+}
+
+size_t GestureRecognizer::getPrunedCount() const
+{
+	return mPrunedCount;
+}
+
+}
@@ -0,0 +1,153 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2.h"
+
+namespace Kinect2 {
+
+class GestureRecognizer;
+typedef std::shared_ptr<GestureRecognizer> GestureRecognizerRef;
+
+// Matches live joint trajectories against recorded templates using 
+// banded dynamic time warping. Every trajectory is expressed relative to 
+// the mid spine and scaled by shoulder width, then resampled to a fixed 
+// length. Candidates are pruned with an LB_Keogh lower bound and abandoned 
+// early once their running cost exceeds the template's threshold. All 
+// template/body pairs are evaluated in parallel.
+class GestureRecognizer
+{
+public:
+	static GestureRecognizerRef					create();
+	static GestureRecognizerRef					create( const std::vector<JointType>& joints, size_t length = 32, 
+												float bandRatio = 0.1f, size_t maxDuration = 90 );
+
+	struct Match
+	{
+		Match();
+
+		uint64_t								mBodyId;
+		float									mDistance;
+		size_t									mTemplate;
+	};
+
+	// Records a template from consecutive frames of one body. Matches are 
+	// reported when the mean per-sample distance falls below "threshold".
+	size_t										addTemplate( const std::string& name, const std::vector<Body>& frames, float threshold );
+	// Records a template from already-normalized positions, laid out 
+	// frame by frame in the order returned by getJoints().
+	size_t										addTemplate( const std::string& name, const std::vector<ci::Vec3f>& positions, 
+												size_t frameCount, float threshold );
+	void										clearTemplates();
+
+	void										update( const Frame& frame );
+	void										update( const std::vector<Body>& bodies, long long timeStamp );
+	void										reset();
+
+	// Best template per body for the latest update.
+	const std::vector<Match>&					getMatches() const;
+
+	size_t										getBandRadius() const;
+	const std::vector<JointType>&				getJoints() const;
+	size_t										getLength() const;
+	size_t										getMaxDuration() const;
+	size_t										getTemplateCount() const;
+	size_t										getTemplateDuration( size_t index ) const;
+	const std::string&							getTemplateName( size_t index ) const;
+	float										getTemplateThreshold( size_t index ) const;
+
+	// Pair counts from the last update, useful for tuning thresholds.
+	size_t										getAbandonedCount() const;
+	size_t										getComparedCount() const;
+	size_t										getPrunedCount() const;
+
+	// Normalizes one body pose into "output" (getJoints().size() * 3 floats).
+	bool										normalize( const Body& body, float* output ) const;
+protected:
+	GestureRecognizer( const std::vector<JointType>& joints, size_t length, float bandRatio, size_t maxDuration );
+
+	struct Template
+	{
+		std::string								mName;
+		size_t									mDuration;
+		float									mThreshold;
+		std::vector<float>						mData;
+		std::vector<float>						mLower;
+		std::vector<float>						mUpper;
+	};
+
+	struct Track
+	{
+		bool									mActive;
+		uint64_t								mId;
+		size_t									mSize;
+		uint64_t								mSequence;
+		std::vector<float>						mFrames;
+	};
+
+	enum
+	{
+		Result_Matched, Result_Pruned, Result_Abandoned, Result_Rejected, Result_Skipped
+	};
+
+	void										addTemplate( const std::string& name, const std::vector<float>& frames, size_t frameCount, float threshold );
+	void										allocateScratch();
+	int32_t										compare( size_t templateIndex, size_t trackIndex, float* scratch, float& distance ) const;
+	void										resample( const float* input, size_t inputCount, float* output ) const;
+	void										resampleTrack( const Track& track, size_t duration, float* output ) const;
+
+	size_t										mBandRadius;
+	size_t										mDimensions;
+	std::vector<JointType>						mJoints;
+	size_t										mLength;
+	size_t										mMaxDuration;
+	long long									mTimeStamp;
+
+	size_t										mAbandonedCount;
+	size_t										mComparedCount;
+	size_t										mPrunedCount;
+
+	std::vector<Match>							mMatches;
+	std::vector<float>							mPairDistances;
+	std::vector<int32_t>						mPairResults;
+	std::vector<float>							mScratch;
+	std::vector<Template>						mTemplates;
+	std::vector<Track>							mTracks;
+};
+
+}
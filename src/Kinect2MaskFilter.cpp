@@ -0,0 +1,388 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2MaskFilter.h"
+
+#include <cfloat>
+#include <cmath>
+#include <emmintrin.h>
+#include <ppl.h>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+static const int16_t	kDistanceInfinite	= 0x7fff;
+static const float		kEnvelopeInfinite	= 1.0e20f;
+
+static inline void resizeChannel( Channel8u& channel, const Vec2i& size )
+{
+	if ( !channel || channel.getSize() != size ) {
+		channel = Channel8u( size.x, size.y );
+	}
+}
+
+MaskFilterRef MaskFilter::create()
+{
+	return MaskFilterRef( new MaskFilter() );
+}
+
+MaskFilter::MaskFilter()
+{
+}
+
+void MaskFilter::selectMask( const Channel8u& labels, int32_t mask )
+{
+	int32_t width = labels.getWidth();
+	resizeChannel( mMask, labels.getSize() );
+	concurrency::parallel_for( 0, labels.getHeight(), [ & ]( int32_t y )
+	{
+		const uint8_t* input	= labels.getData( Vec2i( 0, y ) );
+		uint8_t* output			= mMask.getData( Vec2i( 0, y ) );
+		const __m128i zero		= _mm_setzero_si128();
+		const __m128i users		= _mm_set1_epi8( BODY_COUNT - 1 );
+		const __m128i label		= _mm_set1_epi8( (char)mask );
+		int32_t x = 0;
+		for ( ; x + 16 <= width; x += 16 ) {
+			__m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( input + x ) );
+			if ( mask == Mask_Users ) {
+				v = _mm_cmpeq_epi8( _mm_subs_epu8( v, users ), zero );
+			} else if ( mask == Mask_NonZero ) {
+				v = _mm_andnot_si128( _mm_cmpeq_epi8( v, zero ), _mm_set1_epi8( -1 ) );
+			} else {
+				v = _mm_cmpeq_epi8( v, label );
+			}
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( output + x ), v );
+		}
+		for ( ; x < width; ++x ) {
+			bool inside = mask == Mask_Users ? input[ x ] < BODY_COUNT : ( mask == Mask_NonZero ? input[ x ] != 0 : input[ x ] == (uint8_t)mask );
+			output[ x ] = inside ? 255 : 0;
+		}
+	} );
+}
+
+template<bool dilation>
+static inline uint8_t combine( uint8_t a, uint8_t b )
+{
+	return dilation ? max( a, b ) : min( a, b );
+}
+
+template<bool dilation>
+static inline __m128i combine( __m128i a, __m128i b )
+{
+	return dilation ? _mm_max_epu8( a, b ) : _mm_min_epu8( a, b );
+}
+
+// van Herk/Gil-Werman: the padded line is cut into blocks of the window 
+// size, each with a running maximum (minimum) from its start and from its 
+// end. Any window spans at most two blocks, so its result is the suffix 
+// value at its start combined with the prefix value at its end. "T" is a 
+// pixel, or 16 pixels of a column strip.
+template<bool dilation, typename T>
+static void filterLine( const T* line, T* prefix, T* suffix, int32_t length, int32_t window )
+{
+	for ( int32_t start = 0; start < length; start += window ) {
+		int32_t end		= min( start + window, length );
+		prefix[ start ]	= line[ start ];
+		for ( int32_t i = start + 1; i < end; ++i ) {
+			prefix[ i ] = combine<dilation>( prefix[ i - 1 ], line[ i ] );
+		}
+		suffix[ end - 1 ] = line[ end - 1 ];
+		for ( int32_t i = end - 2; i >= start; --i ) {
+			suffix[ i ] = combine<dilation>( suffix[ i + 1 ], line[ i ] );
+		}
+	}
+}
+
+// Returns "count" 16 byte aligned elements of "scratch".
+template<typename T>
+static T* alignScratch( vector<uint8_t>& scratch, size_t count )
+{
+	scratch.resize( count * sizeof( T ) + 16 );
+	uint8_t* data = &scratch[ 0 ];
+	return reinterpret_cast<T*>( data + ( ( 16 - ( reinterpret_cast<size_t>( data ) & 15 ) ) & 15 ) );
+}
+
+template<bool dilation>
+static void filterRows( const Channel8u& input, Channel8u& output, int32_t radius, vector<uint8_t>* lines, size_t bandCount )
+{
+	int32_t width	= input.getWidth();
+	int32_t height	= input.getHeight();
+	int32_t length	= width + radius * 2;
+	uint8_t pad		= dilation ? 0 : 255;
+	concurrency::parallel_for( (size_t)0, bandCount, [ & ]( size_t band )
+	{
+		uint8_t* line	= alignScratch<uint8_t>( lines[ band ], length * 3 );
+		uint8_t* prefix	= line + length;
+		uint8_t* suffix	= prefix + length;
+		memset( line, pad, radius );
+		memset( line + radius + width, pad, radius );
+
+		int32_t y0 = (int32_t)( band * height / bandCount );
+		int32_t y1 = (int32_t)( ( band + 1 ) * height / bandCount );
+		for ( int32_t y = y0; y < y1; ++y ) {
+			memcpy( line + radius, input.getData( Vec2i( 0, y ) ), width );
+			filterLine<dilation>( line, prefix, suffix, length, radius * 2 + 1 );
+			uint8_t* result = output.getData( Vec2i( 0, y ) );
+			for ( int32_t x = 0; x < width; ++x ) {
+				result[ x ] = combine<dilation>( suffix[ x ], prefix[ x + radius * 2 ] );
+			}
+		}
+	} );
+}
+
+// Columns 16 at a time. Strips overlap at the right edge if the width is 
+// not a multiple of 16.
+template<bool dilation>
+static void filterColumns( const Channel8u& input, Channel8u& output, int32_t radius, vector<uint8_t>* lines, size_t bandCount )
+{
+	int32_t width	= input.getWidth();
+	int32_t height	= input.getHeight();
+	int32_t length	= height + radius * 2;
+	int32_t strips	= ( width + 15 ) / 16;
+	concurrency::parallel_for( (size_t)0, bandCount, [ & ]( size_t band )
+	{
+		__m128i* line	= alignScratch<__m128i>( lines[ band ], length * 3 );
+		__m128i* prefix	= line + length;
+		__m128i* suffix	= prefix + length;
+		for ( int32_t i = 0; i < radius; ++i ) {
+			line[ i ]						= _mm_set1_epi8( dilation ? 0 : -1 );
+			line[ radius + height + i ]		= line[ i ];
+		}
+
+		int32_t s0 = (int32_t)( band * strips / bandCount );
+		int32_t s1 = (int32_t)( ( band + 1 ) * strips / bandCount );
+		for ( int32_t s = s0; s < s1; ++s ) {
+			int32_t x = min( s * 16, width - 16 );
+			for ( int32_t y = 0; y < height; ++y ) {
+				line[ radius + y ] = _mm_loadu_si128( reinterpret_cast<const __m128i*>( input.getData( Vec2i( x, y ) ) ) );
+			}
+			filterLine<dilation>( line, prefix, suffix, length, radius * 2 + 1 );
+			for ( int32_t y = 0; y < height; ++y ) {
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( output.getData( Vec2i( x, y ) ) ), 
+					combine<dilation>( suffix[ y ], prefix[ y + radius * 2 ] ) );
+			}
+		}
+	} );
+}
+
+void MaskFilter::filter( const Channel8u& input, Channel8u& output, int32_t radius, bool dilation )
+{
+	int32_t width	= input.getWidth();
+	int32_t height	= input.getHeight();
+	resizeChannel( output, input.getSize() );
+	if ( radius <= 0 ) {
+		for ( int32_t y = 0; y < height; ++y ) {
+			memcpy( output.getData( Vec2i( 0, y ) ), input.getData( Vec2i( 0, y ) ), width );
+		}
+		return;
+	}
+
+	resizeChannel( mPass, input.getSize() );
+	if ( dilation ) {
+		filterRows<true>( input, mPass, radius, mLines, kBandCount );
+	} else {
+		filterRows<false>( input, mPass, radius, mLines, kBandCount );
+	}
+	if ( width >= 16 ) {
+		if ( dilation ) {
+			filterColumns<true>( mPass, output, radius, mLines, kBandCount );
+		} else {
+			filterColumns<false>( mPass, output, radius, mLines, kBandCount );
+		}
+	} else {
+
+		// Frames narrower than a strip run the columns through the row 
+		// pass on a transposed copy.
+		Channel8u transposed( height, width );
+		Channel8u filtered( height, width );
+		for ( int32_t y = 0; y < height; ++y ) {
+			for ( int32_t x = 0; x < width; ++x ) {
+				transposed.setValue( Vec2i( y, x ), mPass.getValue( Vec2i( x, y ) ) );
+			}
+		}
+		if ( dilation ) {
+			filterRows<true>( transposed, filtered, radius, mLines, kBandCount );
+		} else {
+			filterRows<false>( transposed, filtered, radius, mLines, kBandCount );
+		}
+		for ( int32_t y = 0; y < height; ++y ) {
+			for ( int32_t x = 0; x < width; ++x ) {
+				output.setValue( Vec2i( x, y ), filtered.getValue( Vec2i( y, x ) ) );
+			}
+		}
+	}
+}
+
+void MaskFilter::dilate( const Channel8u& labels, Channel8u& output, int32_t radius, int32_t mask )
+{
+	if ( labels ) {
+		selectMask( labels, mask );
+		filter( mMask, output, radius, true );
+	}
+}
+
+void MaskFilter::erode( const Channel8u& labels, Channel8u& output, int32_t radius, int32_t mask )
+{
+	if ( labels ) {
+		selectMask( labels, mask );
+		filter( mMask, output, radius, false );
+	}
+}
+
+void MaskFilter::close( const Channel8u& labels, Channel8u& output, int32_t radius, int32_t mask )
+{
+	if ( labels ) {
+		selectMask( labels, mask );
+		filter( mMask, mStage, radius, true );
+		filter( mStage, output, radius, false );
+	}
+}
+
+void MaskFilter::open( const Channel8u& labels, Channel8u& output, int32_t radius, int32_t mask )
+{
+	if ( labels ) {
+		selectMask( labels, mask );
+		filter( mMask, mStage, radius, false );
+		filter( mStage, output, radius, true );
+	}
+}
+
+// Felzenszwalb and Huttenlocher: the vertical distance to the nearest 
+// feature per column, eight columns at a time, then per row the lower 
+// envelope of the parabolas those distances define.
+void MaskFilter::calcDistance( const Channel8u& labels, Channel32f& output, bool inside, int32_t mask )
+{
+	if ( !labels ) {
+		return;
+	}
+	selectMask( labels, mask );
+
+	int32_t width	= labels.getWidth();
+	int32_t height	= labels.getHeight();
+	if ( !output || output.getSize() != labels.getSize() ) {
+		output = Channel32f( width, height );
+	}
+	mColumnDistances.resize( width * height );
+
+	// Features are the pixels distances are measured to.
+	uint8_t feature = inside ? 0 : 255;
+	if ( width < 8 ) {
+		for ( int32_t x = 0; x < width; ++x ) {
+			int16_t d = kDistanceInfinite;
+			for ( int32_t y = 0; y < height; ++y ) {
+				d = mMask.getValue( Vec2i( x, y ) ) == feature ? 0 : min<int16_t>( d, kDistanceInfinite - 1 ) + 1;
+				mColumnDistances[ y * width + x ] = d;
+			}
+			for ( int32_t y = height - 2; y >= 0; --y ) {
+				uint16_t& v = mColumnDistances[ y * width + x ];
+				v = min<uint16_t>( v, mColumnDistances[ ( y + 1 ) * width + x ] + 1 );
+			}
+		}
+	} else {
+		int32_t strips = ( width + 7 ) / 8;
+		concurrency::parallel_for( (size_t)0, kBandCount, [ & ]( size_t band )
+		{
+			const __m128i zero		= _mm_setzero_si128();
+			const __m128i one		= _mm_set1_epi16( 1 );
+			const __m128i features	= _mm_set1_epi16( feature );
+			int32_t s0 = (int32_t)( band * strips / kBandCount );
+			int32_t s1 = (int32_t)( ( band + 1 ) * strips / kBandCount );
+			for ( int32_t s = s0; s < s1; ++s ) {
+				int32_t x = min( s * 8, width - 8 );
+				__m128i d = _mm_set1_epi16( kDistanceInfinite );
+				for ( int32_t y = 0; y < height; ++y ) {
+					__m128i m = _mm_unpacklo_epi8( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( mMask.getData( Vec2i( x, y ) ) ) ), zero );
+					d = _mm_andnot_si128( _mm_cmpeq_epi16( m, features ), _mm_adds_epi16( d, one ) );
+					_mm_storeu_si128( reinterpret_cast<__m128i*>( &mColumnDistances[ y * width + x ] ), d );
+				}
+				for ( int32_t y = height - 2; y >= 0; --y ) {
+					__m128i* v	= reinterpret_cast<__m128i*>( &mColumnDistances[ y * width + x ] );
+					d			= _mm_min_epi16( _mm_loadu_si128( v ), _mm_adds_epi16( d, one ) );
+					_mm_storeu_si128( v, d );
+				}
+			}
+		} );
+	}
+
+	concurrency::parallel_for( (size_t)0, kBandCount, [ & ]( size_t band )
+	{
+		vector<int32_t>& sites	= mEnvelopeSites[ band ];
+		vector<float>& bounds	= mEnvelopeBounds[ band ];
+		sites.resize( width );
+		bounds.resize( width + 1 );
+
+		int32_t y0 = (int32_t)( band * height / kBandCount );
+		int32_t y1 = (int32_t)( ( band + 1 ) * height / kBandCount );
+		for ( int32_t y = y0; y < y1; ++y ) {
+			const uint16_t* column	= &mColumnDistances[ y * width ];
+			float* result			= output.getData( Vec2i( 0, y ) );
+
+			int32_t k	= 0;
+			sites[ 0 ]	= 0;
+			bounds[ 0 ]	= -kEnvelopeInfinite;
+			bounds[ 1 ]	= kEnvelopeInfinite;
+			for ( int32_t q = 1; q < width; ++q ) {
+				float fq = column[ q ] == kDistanceInfinite ? kEnvelopeInfinite : (float)column[ q ] * (float)column[ q ];
+				float s = 0.0f;
+				do {
+					int32_t v	= sites[ k ];
+					float fv	= column[ v ] == kDistanceInfinite ? kEnvelopeInfinite : (float)column[ v ] * (float)column[ v ];
+					s			= ( ( fq + (float)( q * q ) ) - ( fv + (float)( v * v ) ) ) / (float)( 2 * ( q - v ) );
+				} while ( s <= bounds[ k ] && --k >= 0 );
+				++k;
+				sites[ k ]		= q;
+				bounds[ k ]		= s;
+				bounds[ k + 1 ]	= kEnvelopeInfinite;
+			}
+
+			k = 0;
+			for ( int32_t q = 0; q < width; ++q ) {
+				while ( bounds[ k + 1 ] < (float)q ) {
+					++k;
+				}
+				int32_t v	= sites[ k ];
+				float fv	= column[ v ] == kDistanceInfinite ? kEnvelopeInfinite : (float)column[ v ] * (float)column[ v ];
+				float d		= (float)( ( q - v ) * ( q - v ) ) + fv;
+				result[ q ]	= d >= kEnvelopeInfinite * 0.5f ? FLT_MAX : sqrt( d );
+			}
+		}
+	} );
+}
+
+}
@@ -0,0 +1,106 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2.h"
+
+namespace Kinect2 {
+
+class MaskFilter;
+typedef std::shared_ptr<MaskFilter>	MaskFilterRef;
+
+// Morphology and distance transforms over label masks such as 
+// Frame::getBodyIndex(). Every kernel first selects a binary mask, either 
+// one label, all users or all non-zero pixels. Results go into the 
+// caller's channels, which are only reallocated if their size is wrong, 
+// and scratch space is kept across calls.
+// 
+// Morphology uses square windows with the van Herk/Gil-Werman algorithm, 
+// so its cost does not depend on the radius. Output masks are 255 inside 
+// and 0 outside. Pixels beyond the frame don't affect the result.
+class MaskFilter
+{
+public:
+	enum : int32_t
+	{
+		// Pixels below BODY_COUNT, i.e. any user in a body index frame
+		Mask_Users		= -1, 
+		Mask_NonZero	= -2
+	};
+
+	static MaskFilterRef						create();
+
+	// "mask" is a label value, Mask_Users or Mask_NonZero.
+	void										dilate( const ci::Channel8u& labels, ci::Channel8u& output, int32_t radius, int32_t mask = Mask_Users );
+	void										erode( const ci::Channel8u& labels, ci::Channel8u& output, int32_t radius, int32_t mask = Mask_Users );
+	// Dilation then erosion, which fills holes and gaps up to twice 
+	// "radius" wide
+	void										close( const ci::Channel8u& labels, ci::Channel8u& output, int32_t radius, int32_t mask = Mask_Users );
+	// Erosion then dilation, which removes specks up to twice "radius" wide
+	void										open( const ci::Channel8u& labels, ci::Channel8u& output, int32_t radius, int32_t mask = Mask_Users );
+
+	// Exact Euclidean distance in pixels from each pixel inside the mask to 
+	// the nearest pixel outside, or with "inside" false, from each pixel 
+	// outside to the nearest one inside. Other pixels are zero. If there 
+	// is nothing to measure to, distances are FLT_MAX.
+	void										calcDistance( const ci::Channel8u& labels, ci::Channel32f& output, bool inside = true, int32_t mask = Mask_Users );
+protected:
+	static const size_t							kBandCount = 8;
+
+	MaskFilter();
+
+	void										filter( const ci::Channel8u& input, ci::Channel8u& output, int32_t radius, bool dilation );
+	void										selectMask( const ci::Channel8u& labels, int32_t mask );
+
+	// The selected mask, the row pass of filter(), and the first filter() 
+	// of close() and open()
+	ci::Channel8u								mMask;
+	ci::Channel8u								mPass;
+	ci::Channel8u								mStage;
+
+	// Per band scratch
+	std::vector<float>							mEnvelopeBounds[ kBandCount ];
+	std::vector<int32_t>						mEnvelopeSites[ kBandCount ];
+	// Padded line, prefix and suffix values of filter()
+	std::vector<uint8_t>						mLines[ kBandCount ];
+
+	// Vertical distances of the first distance pass
+	std::vector<uint16_t>						mColumnDistances;
+};
+
+}
@@ -0,0 +1,312 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2Occupancy.h"
+
+#include <cmath>
+#include <emmintrin.h>
+#include <ppl.h>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+OccupancyMapRef OccupancyMap::create( const Vec2f& size, const Vec2f& origin, float cellSize )
+{
+	return OccupancyMapRef( new OccupancyMap( size, origin, cellSize ) );
+}
+
+OccupancyMap::OccupancyMap( const Vec2f& size, const Vec2f& origin, float cellSize )
+: mCellSize( max( cellSize, 0.001f ) ), mDecay( 0.98f ), mMaxHeight( 2.4f ), mMinHeight( 0.1f ), 
+mMinPoints( 4 ), mOrigin( origin ), mPersonMaxHeight( 2.3f ), mPersonMinHeight( 0.9f ), 
+mPersonRadius( 0.3f )
+{
+	mGridWidth	= max( (int32_t)ceil( size.x / mCellSize ), 1 );
+	mGridHeight	= max( (int32_t)ceil( size.y / mCellSize ), 1 );
+	mCounts		= Channel32f( mGridWidth, mGridHeight );
+	mHeatmap	= Channel32f( mGridWidth, mGridHeight );
+	mHeights	= Channel32f( mGridWidth, mGridHeight );
+	size_t cellCount = mGridWidth * mGridHeight;
+	for ( size_t i = 0; i < cellCount; ++i ) {
+		mCounts.getData()[ i ]	= 0.0f;
+		mHeatmap.getData()[ i ]	= 0.0f;
+		mHeights.getData()[ i ]	= 0.0f;
+	}
+	for ( size_t b = 0; b < kBandCount; ++b ) {
+		mPendingCounts[ b ].resize( cellCount, 0.0f );
+		mPendingHeights[ b ].resize( cellCount, 0.0f );
+	}
+	mPeople.reserve( 64 );
+}
+
+void OccupancyMap::add( const CoordinateMapperRef& mapper, const Channel16u& depth, const Vec4f& floorPlane, 
+	const Vec2f& position, float yaw, const Channel8u& mask )
+{
+	int32_t width	= mapper->getDepthWidth();
+	int32_t height	= mapper->getDepthHeight();
+	if ( !depth || depth.getWidth() != width || depth.getHeight() != height || floorPlane == Vec4f::zero() ) {
+		return;
+	}
+	bool masked = mask && mask.getWidth() == width && mask.getHeight() == height;
+
+	// Map X, height and map Z are each linear in the camera space point, so 
+	// fold the floor transform, sensor placement and cell scale into one 
+	// row per output: v = z * ( r.x * tx + r.y * ty + r.z ) + r.w
+	Matrix44f floor	= FloorEstimator::calcTransform( floorPlane );
+	float c			= cos( yaw );
+	float s			= sin( yaw );
+	float scale		= 1.0f / mCellSize;
+	float rows[ 3 ][ 4 ];
+	for ( int32_t i = 0; i < 3; ++i ) {
+		rows[ 0 ][ i ] = ( c * floor.at( 0, i ) - s * floor.at( 2, i ) ) * scale;
+		rows[ 1 ][ i ] = floor.at( 1, i );
+		rows[ 2 ][ i ] = ( s * floor.at( 0, i ) + c * floor.at( 2, i ) ) * scale;
+	}
+	rows[ 0 ][ 3 ] = ( position.x - mOrigin.x ) * scale;
+	rows[ 1 ][ 3 ] = floor.at( 1, 3 );
+	rows[ 2 ][ 3 ] = ( position.y - mOrigin.y ) * scale;
+
+	const float* tableX	= mapper->getDepthToCameraTableX();
+	const float* tableY	= mapper->getDepthToCameraTableY();
+	concurrency::parallel_for( (size_t)0, kBandCount, [ & ]( size_t band )
+	{
+		float* counts		= &mPendingCounts[ band ][ 0 ];
+		float* heights		= &mPendingHeights[ band ][ 0 ];
+		int32_t y0			= (int32_t)( band * height / kBandCount );
+		int32_t y1			= (int32_t)( ( band + 1 ) * height / kBandCount );
+		const __m128 scaleZ	= _mm_set1_ps( 0.001f );
+		const __m128 zero	= _mm_setzero_ps();
+		const __m128i zeroi	= _mm_setzero_si128();
+		const __m128 minH	= _mm_set1_ps( mMinHeight );
+		const __m128 maxH	= _mm_set1_ps( mMaxHeight );
+		const __m128 gridW	= _mm_set1_ps( (float)mGridWidth );
+		const __m128 gridH	= _mm_set1_ps( (float)mGridHeight );
+		__m128 r[ 3 ][ 4 ];
+		for ( int32_t i = 0; i < 3; ++i ) {
+			for ( int32_t j = 0; j < 4; ++j ) {
+				r[ i ][ j ] = _mm_set1_ps( rows[ i ][ j ] );
+			}
+		}
+
+		int32_t gx[ 4 ];
+		int32_t gz[ 4 ];
+		float h[ 4 ];
+		for ( int32_t y = y0; y < y1; ++y ) {
+			const uint16_t* d	= depth.getData( Vec2i( 0, y ) );
+			const uint8_t* m	= masked ? mask.getData( Vec2i( 0, y ) ) : 0;
+			size_t offset		= y * width;
+			for ( int32_t x = 0; x + 4 <= width; x += 4 ) {
+				__m128i d16	= _mm_loadl_epi64( reinterpret_cast<const __m128i*>( d + x ) );
+				__m128 z	= _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi16( d16, zeroi ) ), scaleZ );
+				__m128 tx	= _mm_loadu_ps( tableX + offset + x );
+				__m128 ty	= _mm_loadu_ps( tableY + offset + x );
+				__m128 v[ 3 ];
+				for ( int32_t i = 0; i < 3; ++i ) {
+					__m128 k	= _mm_add_ps( _mm_add_ps( _mm_mul_ps( r[ i ][ 0 ], tx ), _mm_mul_ps( r[ i ][ 1 ], ty ) ), r[ i ][ 2 ] );
+					v[ i ]		= _mm_add_ps( _mm_mul_ps( z, k ), r[ i ][ 3 ] );
+				}
+				__m128 valid = _mm_and_ps( _mm_cmpgt_ps( z, zero ), _mm_and_ps( _mm_cmpge_ps( v[ 1 ], minH ), _mm_cmple_ps( v[ 1 ], maxH ) ) );
+				valid = _mm_and_ps( valid, _mm_and_ps( _mm_cmpge_ps( v[ 0 ], zero ), _mm_cmplt_ps( v[ 0 ], gridW ) ) );
+				valid = _mm_and_ps( valid, _mm_and_ps( _mm_cmpge_ps( v[ 2 ], zero ), _mm_cmplt_ps( v[ 2 ], gridH ) ) );
+				int32_t lanes = _mm_movemask_ps( valid );
+				if ( lanes == 0 ) {
+					continue;
+				}
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( gx ), _mm_cvttps_epi32( v[ 0 ] ) );
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( gz ), _mm_cvttps_epi32( v[ 2 ] ) );
+				_mm_storeu_ps( h, v[ 1 ] );
+				for ( int32_t i = 0; i < 4; ++i ) {
+					if ( ( lanes & ( 1 << i ) ) != 0 && ( m == 0 || m[ x + i ] != 0 ) ) {
+						size_t cell			= gz[ i ] * mGridWidth + gx[ i ];
+						counts[ cell ]		+= 1.0f;
+						heights[ cell ]		= max( heights[ cell ], h[ i ] );
+					}
+				}
+			}
+		}
+	} );
+}
+
+void OccupancyMap::merge( const OccupancyMap& map )
+{
+	if ( map.mGridWidth != mGridWidth || map.mGridHeight != mGridHeight ) {
+		return;
+	}
+	size_t cellCount		= mGridWidth * mGridHeight;
+	const float* counts		= map.mCounts.getData();
+	const float* heights	= map.mHeights.getData();
+	for ( size_t i = 0; i < cellCount; ++i ) {
+		mPendingCounts[ 0 ][ i ]	+= counts[ i ];
+		mPendingHeights[ 0 ][ i ]	= max( mPendingHeights[ 0 ][ i ], heights[ i ] );
+	}
+}
+
+void OccupancyMap::update()
+{
+	size_t cellCount	= mGridWidth * mGridHeight;
+	float* counts		= mCounts.getData();
+	float* heatmap		= mHeatmap.getData();
+	float* heights		= mHeights.getData();
+
+	// Reduce the bands, then fold the frame into the heatmap.
+	const __m128 decay		= _mm_set1_ps( mDecay );
+	const __m128 one		= _mm_set1_ps( 1.0f );
+	const __m128 minPoints	= _mm_set1_ps( (float)mMinPoints );
+	size_t i = 0;
+	for ( ; i + 4 <= cellCount; i += 4 ) {
+		__m128 c = _mm_loadu_ps( &mPendingCounts[ 0 ][ i ] );
+		__m128 h = _mm_loadu_ps( &mPendingHeights[ 0 ][ i ] );
+		for ( size_t b = 1; b < kBandCount; ++b ) {
+			c = _mm_add_ps( c, _mm_loadu_ps( &mPendingCounts[ b ][ i ] ) );
+			h = _mm_max_ps( h, _mm_loadu_ps( &mPendingHeights[ b ][ i ] ) );
+		}
+		__m128 occupied = _mm_and_ps( _mm_cmpge_ps( c, minPoints ), one );
+		_mm_storeu_ps( counts + i, c );
+		_mm_storeu_ps( heights + i, h );
+		_mm_storeu_ps( heatmap + i, _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( heatmap + i ), decay ), occupied ) );
+	}
+	for ( ; i < cellCount; ++i ) {
+		float c = mPendingCounts[ 0 ][ i ];
+		float h = mPendingHeights[ 0 ][ i ];
+		for ( size_t b = 1; b < kBandCount; ++b ) {
+			c += mPendingCounts[ b ][ i ];
+			h = max( h, mPendingHeights[ b ][ i ] );
+		}
+		counts[ i ]		= c;
+		heights[ i ]	= h;
+		heatmap[ i ]	= heatmap[ i ] * mDecay + ( c >= (float)mMinPoints ? 1.0f : 0.0f );
+	}
+	clearPending();
+
+	// A candidate is the highest cell within the radius. Equal heights are 
+	// resolved by cell order so a flat top yields one candidate.
+	mPeople.clear();
+	int32_t radius = max( (int32_t)( mPersonRadius / mCellSize + 0.5f ), 1 );
+	for ( int32_t y = 0; y < mGridHeight; ++y ) {
+		for ( int32_t x = 0; x < mGridWidth; ++x ) {
+			int32_t cell	= y * mGridWidth + x;
+			float h			= heights[ cell ];
+			if ( h < mPersonMinHeight || h > mPersonMaxHeight || counts[ cell ] < (float)mMinPoints ) {
+				continue;
+			}
+			bool peak = true;
+			for ( int32_t ny = max( y - radius, 0 ); ny <= min( y + radius, mGridHeight - 1 ) && peak; ++ny ) {
+				for ( int32_t nx = max( x - radius, 0 ); nx <= min( x + radius, mGridWidth - 1 ); ++nx ) {
+					int32_t neighbor	= ny * mGridWidth + nx;
+					float nh			= heights[ neighbor ];
+					if ( nh > h || ( nh == h && neighbor < cell ) ) {
+						peak = false;
+						break;
+					}
+				}
+			}
+			if ( peak ) {
+				Vec2f center = getCellCenter( Vec2i( x, y ) );
+				mPeople.push_back( Vec3f( center.x, h, center.y ) );
+			}
+		}
+	}
+}
+
+void OccupancyMap::clearPending()
+{
+	for ( size_t b = 0; b < kBandCount; ++b ) {
+		memset( &mPendingCounts[ b ][ 0 ], 0, mPendingCounts[ b ].size() * sizeof( float ) );
+		memset( &mPendingHeights[ b ][ 0 ], 0, mPendingHeights[ b ].size() * sizeof( float ) );
+	}
+}
+
+Vec2i OccupancyMap::getCell( const Vec2f& v ) const
+{
+	return Vec2i( (int32_t)floor( ( v.x - mOrigin.x ) / mCellSize ), (int32_t)floor( ( v.y - mOrigin.y ) / mCellSize ) );
+}
+
+Vec2f OccupancyMap::getCellCenter( const Vec2i& cell ) const
+{
+	return mOrigin + Vec2f( ( (float)cell.x + 0.5f ) * mCellSize, ( (float)cell.y + 0.5f ) * mCellSize );
+}
+
+float OccupancyMap::getCellSize() const
+{
+	return mCellSize;
+}
+
+const Channel32f& OccupancyMap::getCounts() const
+{
+	return mCounts;
+}
+
+const Channel32f& OccupancyMap::getHeatmap() const
+{
+	return mHeatmap;
+}
+
+const Channel32f& OccupancyMap::getHeights() const
+{
+	return mHeights;
+}
+
+const vector<Vec3f>& OccupancyMap::getPeople() const
+{
+	return mPeople;
+}
+
+void OccupancyMap::setDecay( float decay )
+{
+	mDecay = max( 0.0f, min( decay, 1.0f ) );
+}
+
+void OccupancyMap::setHeightBand( float minHeight, float maxHeight )
+{
+	mMinHeight = minHeight;
+	mMaxHeight = maxHeight;
+}
+
+void OccupancyMap::setMinPoints( uint32_t minPoints )
+{
+	mMinPoints = minPoints;
+}
+
+void OccupancyMap::setPersonBand( float minHeight, float maxHeight, float radius )
+{
+	mPersonMinHeight	= minHeight;
+	mPersonMaxHeight	= maxHeight;
+	mPersonRadius		= radius;
+}
+
+}
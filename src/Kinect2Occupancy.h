@@ -0,0 +1,125 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2Floor.h"
+
+namespace Kinect2 {
+
+class OccupancyMap;
+typedef std::shared_ptr<OccupancyMap>	OccupancyMapRef;
+
+// Top-down grid over the floor. Depth points between the floor and head 
+// height are binned by their position on the floor, giving per-cell point 
+// counts and the highest point per cell. The counts feed a decaying 
+// heatmap; height peaks in the person band become people candidates.
+// 
+// Several sensors can feed one map: add() takes each sensor's floor plane 
+// and its placement in the shared floor space. Maps filled elsewhere are 
+// combined with merge(). update() closes the frame. Everything is 
+// allocated at creation.
+class OccupancyMap
+{
+public:
+	// The grid spans "size" meters from "origin" on the floor, in floor 
+	// space X and Z (see FloorEstimator::getTransform()).
+	static OccupancyMapRef						create( const ci::Vec2f& size = ci::Vec2f( 8.0f, 8.0f ), 
+												const ci::Vec2f& origin = ci::Vec2f( -4.0f, 0.0f ), float cellSize = 0.05f );
+
+	// Bins one sensor's depth into the current frame. "position" and "yaw" 
+	// (radians) place the sensor's floor space in the map; use zero for a 
+	// single sensor. Pixels where "mask" is zero are skipped.
+	void										add( const CoordinateMapperRef& mapper, const ci::Channel16u& depth, 
+												const ci::Vec4f& floorPlane, const ci::Vec2f& position = ci::Vec2f::zero(), 
+												float yaw = 0.0f, const ci::Channel8u& mask = ci::Channel8u() );
+	// Adds the last frame of "map" to the current frame. Grids must match.
+	void										merge( const OccupancyMap& map );
+	// Decays the heatmap, adds the current frame to it, finds people and 
+	// starts a new frame.
+	void										update();
+
+	// Points per cell in the last frame
+	const ci::Channel32f&						getCounts() const;
+	// Decaying occupancy, cells count as occupied with at least 
+	// getMinPoints() points
+	const ci::Channel32f&						getHeatmap() const;
+	// Highest point per cell in the last frame, zero if empty
+	const ci::Channel32f&						getHeights() const;
+	// Floor space X, height and Z of each candidate's highest point
+	const std::vector<ci::Vec3f>&				getPeople() const;
+
+	ci::Vec2i									getCell( const ci::Vec2f& v ) const;
+	ci::Vec2f									getCellCenter( const ci::Vec2i& cell ) const;
+	float										getCellSize() const;
+
+	// Heatmap decay per update(), 0 to 1
+	void										setDecay( float decay );
+	// Only points between "minHeight" and "maxHeight" above the floor count.
+	void										setHeightBand( float minHeight, float maxHeight );
+	void										setMinPoints( uint32_t minPoints );
+	// A candidate's peak must lie in this band and be the highest cell 
+	// within "radius" meters.
+	void										setPersonBand( float minHeight, float maxHeight, float radius = 0.3f );
+protected:
+	static const size_t							kBandCount = 8;
+
+	OccupancyMap( const ci::Vec2f& size, const ci::Vec2f& origin, float cellSize );
+
+	void										clearPending();
+
+	float										mCellSize;
+	ci::Channel32f								mCounts;
+	float										mDecay;
+	int32_t										mGridHeight;
+	int32_t										mGridWidth;
+	ci::Channel32f								mHeatmap;
+	ci::Channel32f								mHeights;
+	float										mMaxHeight;
+	float										mMinHeight;
+	uint32_t									mMinPoints;
+	ci::Vec2f									mOrigin;
+	// Partial grids, one per band of depth rows, so rows bin in parallel
+	std::vector<float>							mPendingCounts[ kBandCount ];
+	std::vector<float>							mPendingHeights[ kBandCount ];
+	std::vector<ci::Vec3f>						mPeople;
+	float										mPersonMaxHeight;
+	float										mPersonMinHeight;
+	float										mPersonRadius;
+};
+
+}
@@ -0,0 +1,234 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2PointCloud.h"
+
+#include <cfloat>
+#include <ppl.h>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+UserPointCloudRef UserPointCloud::create( const CoordinateMapperRef& mapper, bool color )
+{
+	return UserPointCloudRef( new UserPointCloud( mapper, color ) );
+}
+
+UserPointCloud::UserPointCloud( const CoordinateMapperRef& mapper, bool color )
+: mColorEnabled( color ), mMapper( mapper )
+{
+	size_t width	= (size_t)mMapper->getDepthWidth();
+	size_t height	= (size_t)mMapper->getDepthHeight();
+	mPoints.resize( width * height );
+	if ( mColorEnabled ) {
+		mColors.resize( width * height );
+	}
+	mRowCounts.resize( height * BODY_COUNT, 0 );
+	mRowMax.resize( height * BODY_COUNT );
+	mRowMin.resize( height * BODY_COUNT );
+	mRowOffsets.resize( height * BODY_COUNT, 0 );
+	mRowSums.resize( height * BODY_COUNT );
+	for ( size_t i = 0; i < BODY_COUNT; ++i ) {
+		mCounts[ i ]	= 0;
+		mOffsets[ i ]	= 0;
+	}
+}
+
+void UserPointCloud::update( const Channel16u& depth, const Channel8u& bodyIndex, const Surface8u& color )
+{
+	int32_t width	= mMapper->getDepthWidth();
+	int32_t height	= mMapper->getDepthHeight();
+	for ( size_t i = 0; i < BODY_COUNT; ++i ) {
+		mBounds[ i ]	= AxisAlignedBox3f( Vec3f::zero(), Vec3f::zero() );
+		mCentroids[ i ]	= Vec3f::zero();
+		mCounts[ i ]	= 0;
+		mOffsets[ i ]	= 0;
+	}
+	if ( !depth || !bodyIndex || depth.getWidth() != width || depth.getHeight() != height || 
+		bodyIndex.getWidth() != width || bodyIndex.getHeight() != height ) {
+		return;
+	}
+
+	concurrency::parallel_for( 0, height, [ & ]( int32_t y )
+	{
+		const uint16_t* d	= depth.getData( Vec2i( 0, y ) );
+		const uint8_t* b	= bodyIndex.getData( Vec2i( 0, y ) );
+		uint32_t* counts	= &mRowCounts[ y * BODY_COUNT ];
+		for ( size_t i = 0; i < BODY_COUNT; ++i ) {
+			counts[ i ] = 0;
+		}
+		for ( int32_t x = 0; x < width; ++x ) {
+			if ( b[ x ] < BODY_COUNT && d[ x ] != 0 ) {
+				++counts[ b[ x ] ];
+			}
+		}
+	} );
+
+	// Users are laid out one after another, each user's rows in order.
+	size_t offset = 0;
+	for ( size_t i = 0; i < BODY_COUNT; ++i ) {
+		mOffsets[ i ] = offset;
+		for ( int32_t y = 0; y < height; ++y ) {
+			mRowOffsets[ y * BODY_COUNT + i ]	= (uint32_t)offset;
+			offset								+= mRowCounts[ y * BODY_COUNT + i ];
+		}
+		mCounts[ i ] = offset - mOffsets[ i ];
+	}
+
+	bool sampleColor				= mColorEnabled && color;
+	int32_t colorWidth				= sampleColor ? color.getWidth() : 0;
+	int32_t colorHeight				= sampleColor ? color.getHeight() : 0;
+	const CoordinateMapper* mapper	= mMapper.get();
+	const float* tableX				= mapper->getDepthToCameraTableX();
+	const float* tableY				= mapper->getDepthToCameraTableY();
+	concurrency::parallel_for( 0, height, [ & ]( int32_t y )
+	{
+		const uint16_t* d	= depth.getData( Vec2i( 0, y ) );
+		const uint8_t* b	= bodyIndex.getData( Vec2i( 0, y ) );
+		size_t row			= y * BODY_COUNT;
+		uint32_t cursors[ BODY_COUNT ];
+		for ( size_t i = 0; i < BODY_COUNT; ++i ) {
+			cursors[ i ]			= mRowOffsets[ row + i ];
+			mRowMax[ row + i ]		= Vec3f( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+			mRowMin[ row + i ]		= Vec3f( FLT_MAX, FLT_MAX, FLT_MAX );
+			mRowSums[ row + i ]		= Vec3f::zero();
+		}
+
+		size_t index = y * width;
+		for ( int32_t x = 0; x < width; ++x, ++index ) {
+			uint8_t user = b[ x ];
+			if ( user >= BODY_COUNT || d[ x ] == 0 ) {
+				continue;
+			}
+			float z		= (float)d[ x ] * 0.001f;
+			Vec3f p( tableX[ index ] * z, tableY[ index ] * z, z );
+			size_t i	= row + user;
+			mPoints[ cursors[ user ] ] = p;
+			mRowSums[ i ] += p;
+			mRowMin[ i ].x = min( mRowMin[ i ].x, p.x );
+			mRowMin[ i ].y = min( mRowMin[ i ].y, p.y );
+			mRowMin[ i ].z = min( mRowMin[ i ].z, p.z );
+			mRowMax[ i ].x = max( mRowMax[ i ].x, p.x );
+			mRowMax[ i ].y = max( mRowMax[ i ].y, p.y );
+			mRowMax[ i ].z = max( mRowMax[ i ].z, p.z );
+
+			if ( sampleColor ) {
+				Vec2f uv		= mapper->mapDepthPointToColor( Vec2i( x, y ), d[ x ] );
+				int32_t u		= (int32_t)( uv.x + 0.5f );
+				int32_t v		= (int32_t)( uv.y + 0.5f );
+				Color8u& c		= mColors[ cursors[ user ] ];
+				if ( uv.x >= 0.0f && uv.y >= 0.0f && u < colorWidth && v < colorHeight ) {
+					const uint8_t* pixel = color.getData( Vec2i( u, v ) );
+					c = Color8u( pixel[ color.getRedOffset() ], pixel[ color.getGreenOffset() ], pixel[ color.getBlueOffset() ] );
+				} else {
+					c = Color8u( 0, 0, 0 );
+				}
+			}
+			++cursors[ user ];
+		}
+	} );
+
+	for ( size_t i = 0; i < BODY_COUNT; ++i ) {
+		if ( mCounts[ i ] == 0 ) {
+			continue;
+		}
+		Vec3f sum	= Vec3f::zero();
+		Vec3f lo( FLT_MAX, FLT_MAX, FLT_MAX );
+		Vec3f hi( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+		for ( int32_t y = 0; y < height; ++y ) {
+			size_t r = y * BODY_COUNT + i;
+			if ( mRowCounts[ r ] == 0 ) {
+				continue;
+			}
+			sum		+= mRowSums[ r ];
+			lo.x	= min( lo.x, mRowMin[ r ].x );
+			lo.y	= min( lo.y, mRowMin[ r ].y );
+			lo.z	= min( lo.z, mRowMin[ r ].z );
+			hi.x	= max( hi.x, mRowMax[ r ].x );
+			hi.y	= max( hi.y, mRowMax[ r ].y );
+			hi.z	= max( hi.z, mRowMax[ r ].z );
+		}
+		mBounds[ i ]	= AxisAlignedBox3f( lo, hi );
+		mCentroids[ i ]	= sum / (float)mCounts[ i ];
+	}
+}
+
+const AxisAlignedBox3f& UserPointCloud::getBounds( uint8_t user ) const
+{
+	return mBounds[ min<uint8_t>( user, BODY_COUNT - 1 ) ];
+}
+
+const Vec3f& UserPointCloud::getCentroid( uint8_t user ) const
+{
+	return mCentroids[ min<uint8_t>( user, BODY_COUNT - 1 ) ];
+}
+
+const Color8u* UserPointCloud::getColors( uint8_t user ) const
+{
+	if ( !mColorEnabled || user >= BODY_COUNT || mCounts[ user ] == 0 ) {
+		return 0;
+	}
+	return &mColors[ mOffsets[ user ] ];
+}
+
+size_t UserPointCloud::getPointCount( uint8_t user ) const
+{
+	return user < BODY_COUNT ? mCounts[ user ] : 0;
+}
+
+const Vec3f* UserPointCloud::getPoints( uint8_t user ) const
+{
+	if ( user >= BODY_COUNT || mCounts[ user ] == 0 ) {
+		return 0;
+	}
+	return &mPoints[ mOffsets[ user ] ];
+}
+
+uint32_t UserPointCloud::getUserMask() const
+{
+	uint32_t mask = 0;
+	for ( size_t i = 0; i < BODY_COUNT; ++i ) {
+		if ( mCounts[ i ] > 0 ) {
+			mask |= 1 << i;
+		}
+	}
+	return mask;
+}
+
+}
@@ -0,0 +1,96 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2.h"
+#include "Kinect2CoordinateMapper.h"
+#include "cinder/AxisAlignedBox.h"
+
+namespace Kinect2 {
+
+class UserPointCloud;
+typedef std::shared_ptr<UserPointCloud>	UserPointCloudRef;
+
+// Extracts the camera space points of every user in one pass over depth, 
+// body index and the mapper's camera table, without mapping the whole 
+// frame first. Each user's points are packed contiguously into buffers 
+// allocated once at creation. Rows are processed in parallel: the first 
+// pass counts points per row and user, the second writes them at their 
+// final offsets.
+class UserPointCloud
+{
+public:
+	// With "color", update() also samples a registered color per point.
+	static UserPointCloudRef					create( const CoordinateMapperRef& mapper, bool color = false );
+
+	// "color" is only read if color was enabled at creation. Frames that 
+	// don't match the mapper's depth size clear all users.
+	void										update( const ci::Channel16u& depth, const ci::Channel8u& bodyIndex, 
+												const ci::Surface8u& color = ci::Surface8u() );
+
+	// "user" is a body index value, 0 to BODY_COUNT - 1.
+	const ci::AxisAlignedBox3f&					getBounds( uint8_t user ) const;
+	const ci::Vec3f&							getCentroid( uint8_t user ) const;
+	// Null if color is disabled. Points that fall outside the color frame 
+	// are black.
+	const ci::Color8u*							getColors( uint8_t user ) const;
+	size_t										getPointCount( uint8_t user ) const;
+	const ci::Vec3f*							getPoints( uint8_t user ) const;
+	// Bit "i" is set if user "i" has at least one point.
+	uint32_t									getUserMask() const;
+protected:
+	UserPointCloud( const CoordinateMapperRef& mapper, bool color );
+
+	ci::AxisAlignedBox3f						mBounds[ BODY_COUNT ];
+	ci::Vec3f									mCentroids[ BODY_COUNT ];
+	std::vector<ci::Color8u>					mColors;
+	bool										mColorEnabled;
+	size_t										mCounts[ BODY_COUNT ];
+	CoordinateMapperRef							mMapper;
+	size_t										mOffsets[ BODY_COUNT ];
+	std::vector<ci::Vec3f>						mPoints;
+
+	// Per row and user, indexed y * BODY_COUNT + user
+	std::vector<uint32_t>						mRowCounts;
+	std::vector<ci::Vec3f>						mRowMax;
+	std::vector<ci::Vec3f>						mRowMin;
+	std::vector<uint32_t>						mRowOffsets;
+	std::vector<ci::Vec3f>						mRowSums;
+};
+
+}
@@ -0,0 +1,203 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2Projection.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <emmintrin.h>
+#include <limits>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+CameraProjection::CameraProjection()
+: mFocalLength( Vec2f::zero() ), mOffset( Vec2f::zero() ), mPrincipalPoint( Vec2f::zero() )
+{
+	mRadialDistortion[ 0 ] = 0.0f;
+	mRadialDistortion[ 1 ] = 0.0f;
+	mRadialDistortion[ 2 ] = 0.0f;
+}
+
+Vec2f CameraProjection::project( const Vec3f& v ) const
+{
+	if ( v.z <= 0.0f ) {
+		return Vec2f( -numeric_limits<float>::infinity(), -numeric_limits<float>::infinity() );
+	}
+	float invZ	= 1.0f / v.z;
+	float x		= v.x * invZ;
+	float y		= v.y * invZ;
+	float r2	= x * x + y * y;
+	float d		= 1.0f + r2 * ( mRadialDistortion[ 0 ] + r2 * ( mRadialDistortion[ 1 ] + r2 * mRadialDistortion[ 2 ] ) );
+	return Vec2f( 
+		mPrincipalPoint.x + mFocalLength.x * x * d + mOffset.x * invZ, 
+		mPrincipalPoint.y + mFocalLength.y * y * d + mOffset.y * invZ 
+		);
+}
+
+void CameraProjection::project( const Vec3f* points, size_t count, Vec2f* output ) const
+{
+	const __m128 one	= _mm_set1_ps( 1.0f );
+	const __m128 zero	= _mm_setzero_ps();
+	const __m128 inf	= _mm_set1_ps( -numeric_limits<float>::infinity() );
+	const __m128 cx		= _mm_set1_ps( mPrincipalPoint.x );
+	const __m128 cy		= _mm_set1_ps( mPrincipalPoint.y );
+	const __m128 fx		= _mm_set1_ps( mFocalLength.x );
+	const __m128 fy		= _mm_set1_ps( mFocalLength.y );
+	const __m128 ox		= _mm_set1_ps( mOffset.x );
+	const __m128 oy		= _mm_set1_ps( mOffset.y );
+	const __m128 k0		= _mm_set1_ps( mRadialDistortion[ 0 ] );
+	const __m128 k1		= _mm_set1_ps( mRadialDistortion[ 1 ] );
+	const __m128 k2		= _mm_set1_ps( mRadialDistortion[ 2 ] );
+	const float* input	= reinterpret_cast<const float*>( points );
+	float* out			= reinterpret_cast<float*>( output );
+
+	// Same operation order as project( v ), so results match it exactly
+	size_t i = 0;
+	for ( ; i + 4 <= count; i += 4, input += 12, out += 8 ) {
+		// Interleaved XYZ to SoA
+		__m128 a		= _mm_loadu_ps( input + 0 );
+		__m128 b		= _mm_loadu_ps( input + 4 );
+		__m128 c		= _mm_loadu_ps( input + 8 );
+		__m128 x		= _mm_shuffle_ps( _mm_shuffle_ps( a, a, _MM_SHUFFLE( 3, 3, 0, 0 ) ), _mm_shuffle_ps( b, c, _MM_SHUFFLE( 1, 1, 2, 2 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+		__m128 y		= _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 0, 0, 1, 1 ) ), _mm_shuffle_ps( b, c, _MM_SHUFFLE( 2, 2, 3, 3 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+		__m128 z		= _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 1, 1, 2, 2 ) ), _mm_shuffle_ps( c, c, _MM_SHUFFLE( 3, 3, 0, 0 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+
+		__m128 invalid	= _mm_cmple_ps( z, zero );
+		__m128 invZ		= _mm_div_ps( one, _mm_or_ps( _mm_andnot_ps( invalid, z ), _mm_and_ps( invalid, one ) ) );
+		x				= _mm_mul_ps( x, invZ );
+		y				= _mm_mul_ps( y, invZ );
+		__m128 r2		= _mm_add_ps( _mm_mul_ps( x, x ), _mm_mul_ps( y, y ) );
+		__m128 d		= _mm_add_ps( one, _mm_mul_ps( r2, _mm_add_ps( k0, _mm_mul_ps( r2, _mm_add_ps( k1, _mm_mul_ps( r2, k2 ) ) ) ) ) );
+		__m128 u		= _mm_add_ps( _mm_add_ps( cx, _mm_mul_ps( _mm_mul_ps( fx, x ), d ) ), _mm_mul_ps( ox, invZ ) );
+		__m128 v		= _mm_add_ps( _mm_add_ps( cy, _mm_mul_ps( _mm_mul_ps( fy, y ), d ) ), _mm_mul_ps( oy, invZ ) );
+		u				= _mm_or_ps( _mm_andnot_ps( invalid, u ), _mm_and_ps( invalid, inf ) );
+		v				= _mm_or_ps( _mm_andnot_ps( invalid, v ), _mm_and_ps( invalid, inf ) );
+		_mm_storeu_ps( out + 0, _mm_unpacklo_ps( u, v ) );
+		_mm_storeu_ps( out + 4, _mm_unpackhi_ps( u, v ) );
+	}
+	for ( ; i < count; ++i ) {
+		output[ i ] = project( points[ i ] );
+	}
+}
+
+bool CameraProjection::isValid() const
+{
+	return mFocalLength.x != 0.0f && mFocalLength.y != 0.0f;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+// Solves a 3x3 linear system in place with partial pivoting
+static bool solve3( double a[ 3 ][ 3 ], double b[ 3 ], double x[ 3 ] )
+{
+	for ( int32_t c = 0; c < 3; ++c ) {
+		int32_t pivot = c;
+		for ( int32_t r = c + 1; r < 3; ++r ) {
+			if ( abs( a[ r ][ c ] ) > abs( a[ pivot ][ c ] ) ) {
+				pivot = r;
+			}
+		}
+		if ( abs( a[ pivot ][ c ] ) < 1.0e-12 ) {
+			return false;
+		}
+		if ( pivot != c ) {
+			for ( int32_t k = 0; k < 3; ++k ) {
+				swap( a[ c ][ k ], a[ pivot ][ k ] );
+			}
+			swap( b[ c ], b[ pivot ] );
+		}
+		for ( int32_t r = c + 1; r < 3; ++r ) {
+			double f = a[ r ][ c ] / a[ c ][ c ];
+			for ( int32_t k = c; k < 3; ++k ) {
+				a[ r ][ k ] -= f * a[ c ][ k ];
+			}
+			b[ r ] -= f * b[ c ];
+		}
+	}
+	for ( int32_t r = 2; r >= 0; --r ) {
+		double sum = b[ r ];
+		for ( int32_t k = r + 1; k < 3; ++k ) {
+			sum -= a[ r ][ k ] * x[ k ];
+		}
+		x[ r ] = sum / a[ r ][ r ];
+	}
+	return true;
+}
+
+CameraProjection fitProjection( const Vec3f* points, const Vec2f* positions, size_t count )
+{
+	// u = cx + fx * X / Z + ox / Z is linear in ( cx, fx, ox ); same for v
+	CameraProjection projection;
+	double au[ 3 ][ 3 ]	= { 0.0 };
+	double av[ 3 ][ 3 ]	= { 0.0 };
+	double bu[ 3 ]		= { 0.0 };
+	double bv[ 3 ]		= { 0.0 };
+	size_t valid		= 0;
+	for ( size_t i = 0; i < count; ++i ) {
+		const Vec2f& c = positions[ i ];
+		if ( points[ i ].z <= 0.0f || !( c.x > -FLT_MAX && c.x < FLT_MAX && c.y > -FLT_MAX && c.y < FLT_MAX ) ) {
+			continue;
+		}
+		double invZ		= 1.0 / points[ i ].z;
+		double fu[ 3 ]	= { 1.0, points[ i ].x * invZ, invZ };
+		double fv[ 3 ]	= { 1.0, points[ i ].y * invZ, invZ };
+		for ( size_t r = 0; r < 3; ++r ) {
+			for ( size_t k = 0; k < 3; ++k ) {
+				au[ r ][ k ] += fu[ r ] * fu[ k ];
+				av[ r ][ k ] += fv[ r ] * fv[ k ];
+			}
+			bu[ r ] += fu[ r ] * c.x;
+			bv[ r ] += fv[ r ] * c.y;
+		}
+		++valid;
+	}
+
+	double xu[ 3 ] = { 0.0 };
+	double xv[ 3 ] = { 0.0 };
+	if ( valid >= 3 && solve3( au, bu, xu ) && solve3( av, bv, xv ) ) {
+		projection.mPrincipalPoint	= Vec2f( (float)xu[ 0 ], (float)xv[ 0 ] );
+		projection.mFocalLength		= Vec2f( (float)xu[ 1 ], (float)xv[ 1 ] );
+		projection.mOffset			= Vec2f( (float)xu[ 2 ], (float)xv[ 2 ] );
+	}
+	return projection;
+}
+
+}
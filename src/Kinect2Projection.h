@@ -0,0 +1,73 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "cinder/Vector.h"
+
+// Camera models shared by the SDK wrapper and the CPU mapping code. 
+// Depends on nothing but Cinder's vector types, so projection math can 
+// be built, tested and benchmarked away from the Kinect SDK.
+
+namespace Kinect2 {
+
+// Projection from camera space to image coordinates. Normalized 
+// coordinates are radially distorted, then "mOffset" / Z is added to 
+// absorb the baseline of a camera that is not at the camera space origin.
+struct CameraProjection
+{
+	CameraProjection();
+
+	ci::Vec2f									project( const ci::Vec3f& v ) const;
+	// Projects "count" points into "output". Points at or behind the 
+	// camera map to negative infinity.
+	void										project( const ci::Vec3f* points, size_t count, ci::Vec2f* output ) const;
+	bool										isValid() const;
+
+	ci::Vec2f									mFocalLength;
+	ci::Vec2f									mOffset;
+	ci::Vec2f									mPrincipalPoint;
+	float										mRadialDistortion[ 3 ];
+};
+
+// Least squares fit of principal point, focal length and offset to 
+// "count" camera space points and the image positions they map to. 
+// Distortion is left at zero. Non-finite positions are skipped. Returns 
+// an invalid projection if fewer than three points are usable.
+CameraProjection								fitProjection( const ci::Vec3f* points, const ci::Vec2f* positions, size_t count );
+
+}
@@ -0,0 +1,380 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2ReplayBuffer.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+static const uint32_t kReplayMagic		= 0x5242324b;
+static const uint32_t kReplayVersion	= 2;
+
+// Frame time stamps are in 100ns ticks
+static const double kTicksPerSecond		= 10000000.0;
+
+ReplayBuffer::Stats::Stats()
+: mBytes( 0 ), mDropped( 0 ), mEncodeTime( 0.0 ), mFlushes( 0 ), mFlushFailures( 0 ), 
+mFrames( 0 )
+{
+}
+
+ReplayBufferRef ReplayBuffer::create( double duration, size_t memoryBudget )
+{
+	return ReplayBufferRef( new ReplayBuffer( duration, memoryBudget ) );
+}
+
+ReplayBuffer::ReplayBuffer( double duration, size_t memoryBudget )
+: mDuration( (long long)( duration * kTicksPerSecond ) ), mFlushing( false ), 
+mLastBodyTimeStamp( 0 ), mLastTimeStamp( 0 ), mMemoryBudget( memoryBudget ), 
+mPendingValid( false ), mRunning( true ), mSequence( 0 )
+{
+	mEncodeThread	= shared_ptr<thread>( new thread( bind( &ReplayBuffer::encode, this ) ) );
+	mFlushThread	= shared_ptr<thread>( new thread( bind( &ReplayBuffer::flush, this ) ) );
+}
+
+ReplayBuffer::~ReplayBuffer()
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		mRunning = false;
+	}
+	mCondition.notify_all();
+	mEncodeThread->join();
+	mFlushThread->join();
+}
+
+void ReplayBuffer::push( const Frame& frame )
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		if ( frame.getTimeStamp() == mLastTimeStamp ) {
+			return;
+		}
+		mLastTimeStamp = frame.getTimeStamp();
+		if ( mPendingValid ) {
+			++mStats.mDropped;
+		}
+		mPending		= frame;
+		mPendingValid	= true;
+	}
+	mCondition.notify_all();
+}
+
+bool ReplayBuffer::trigger( const fs::path& path )
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		if ( mFlushing ) {
+			return false;
+		}
+
+		// Only the packet references are copied; the flush thread writes 
+		// from buffers the encoder never touches again.
+		mFlushEntries	= mEntries;
+		mFlushPath		= path;
+		mFlushing		= true;
+	}
+	mCondition.notify_all();
+	return true;
+}
+
+void ReplayBuffer::encode()
+{
+	while ( true ) {
+		Frame frame;
+		{
+			unique_lock<mutex> lock( mMutex );
+			while ( mRunning && !mPendingValid ) {
+				mCondition.wait( lock );
+			}
+			if ( !mRunning ) {
+				break;
+			}
+			frame			= mPending;
+			mPending		= Frame();
+			mPendingValid	= false;
+		}
+
+		double start = getHostTime();
+		StreamCodec::PacketHeader header;
+		memset( &header, 0, sizeof( header ) );
+		header.mMagic		= StreamCodec::kStreamMagic;
+		header.mSequence	= mSequence++;
+		header.mTimeStamp	= frame.getTimeStamp();
+
+		// One entry holds every packet of a frame, so eviction and flushing 
+		// never split a frame.
+		shared_ptr<vector<uint8_t> > packet( new vector<uint8_t>() );
+		for ( uint8_t type = 0; type < StreamCodec::Packet_Count; ++type ) {
+			size_t offset	= packet->size();
+			header.mType	= type;
+			header.mWidth	= 0;
+			header.mHeight	= 0;
+			packet->resize( offset + sizeof( header ) );
+			if ( type == StreamCodec::Packet_Bodies ) {
+				if ( frame.getBodyTimeStamp() == mLastBodyTimeStamp ) {
+					packet->resize( offset );
+					continue;
+				}
+				mLastBodyTimeStamp	= frame.getBodyTimeStamp();
+				header.mTimeStamp	= frame.getBodyTimeStamp();
+				StreamCodec::encodeBodies( frame.getBodies(), *packet );
+			} else if ( type == StreamCodec::Packet_BodyIndex && frame.getBodyIndex() ) {
+				header.mTimeStamp	= frame.getTimeStamp();
+				header.mWidth		= frame.getBodyIndex().getWidth();
+				header.mHeight		= frame.getBodyIndex().getHeight();
+				StreamCodec::encodeRunLength( frame.getBodyIndex(), *packet );
+			} else if ( type == StreamCodec::Packet_Depth && frame.getDepth() ) {
+				header.mTimeStamp	= frame.getTimeStamp();
+				header.mWidth		= frame.getDepth().getWidth();
+				header.mHeight		= frame.getDepth().getHeight();
+				StreamCodec::encodeChannel16u( frame.getDepth(), *packet );
+			} else {
+				packet->resize( offset );
+				continue;
+			}
+			header.mSize = (uint32_t)( packet->size() - offset - sizeof( header ) );
+			memcpy( &( *packet )[ offset ], &header, sizeof( header ) );
+		}
+		if ( packet->empty() ) {
+			continue;
+		}
+
+		Entry entry;
+		entry.mPacket		= packet;
+		entry.mTimeStamp	= frame.getTimeStamp();
+		double elapsed		= getHostTime() - start;
+		{
+			lock_guard<mutex> lock( mMutex );
+			mEntries.push_back( entry );
+			mStats.mBytes		+= packet->size();
+			mStats.mEncodeTime	= mStats.mEncodeTime == 0.0 ? elapsed : mStats.mEncodeTime * 0.95 + elapsed * 0.05;
+			while ( mEntries.size() > 1 && 
+				( mEntries.back().mTimeStamp - mEntries.front().mTimeStamp > mDuration || 
+				( mMemoryBudget > 0 && mStats.mBytes > mMemoryBudget ) ) ) {
+				mStats.mBytes -= mEntries.front().mPacket->size();
+				mEntries.pop_front();
+			}
+			mStats.mFrames = mEntries.size();
+		}
+	}
+}
+
+void ReplayBuffer::flush()
+{
+	while ( true ) {
+		deque<Entry> entries;
+		string path;
+		{
+			unique_lock<mutex> lock( mMutex );
+			while ( mRunning && !mFlushing ) {
+				mCondition.wait( lock );
+			}
+			if ( !mRunning ) {
+				break;
+			}
+			entries.swap( mFlushEntries );
+			path = mFlushPath.string();
+		}
+
+		FileHeader header;
+		memset( &header, 0, sizeof( header ) );
+		header.mMagic	= kReplayMagic;
+		header.mVersion	= kReplayVersion;
+		for ( deque<Entry>::const_iterator iter = entries.begin(); iter != entries.end(); ++iter ) {
+			const vector<uint8_t>& packet = *iter->mPacket;
+			for ( size_t offset = 0; offset < packet.size(); ) {
+				const StreamCodec::PacketHeader* h = (const StreamCodec::PacketHeader*)&packet[ offset ];
+				offset += sizeof( StreamCodec::PacketHeader ) + h->mSize;
+				++header.mPacketCount;
+			}
+		}
+		if ( !entries.empty() ) {
+			header.mFirstTimeStamp	= entries.front().mTimeStamp;
+			header.mLastTimeStamp	= entries.back().mTimeStamp;
+		}
+
+		ofstream stream( path.c_str(), ios::binary );
+		if ( stream ) {
+			stream.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+			for ( deque<Entry>::const_iterator iter = entries.begin(); iter != entries.end() && stream; ++iter ) {
+				stream.write( reinterpret_cast<const char*>( &( *iter->mPacket )[ 0 ] ), iter->mPacket->size() );
+			}
+			stream.close();
+		}
+
+		lock_guard<mutex> lock( mMutex );
+		if ( stream ) {
+			++mStats.mFlushes;
+		} else {
+			++mStats.mFlushFailures;
+		}
+		mFlushing = false;
+	}
+}
+
+double ReplayBuffer::getDuration() const
+{
+	lock_guard<mutex> lock( mMutex );
+	if ( mEntries.empty() ) {
+		return 0.0;
+	}
+	return (double)( mEntries.back().mTimeStamp - mEntries.front().mTimeStamp ) / kTicksPerSecond;
+}
+
+ReplayBuffer::Stats ReplayBuffer::getStats() const
+{
+	lock_guard<mutex> lock( mMutex );
+	return mStats;
+}
+
+bool ReplayBuffer::isFlushing() const
+{
+	lock_guard<mutex> lock( mMutex );
+	return mFlushing;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+ReplayReaderRef ReplayReader::create( const fs::path& path )
+{
+	return ReplayReaderRef( new ReplayReader( path ) );
+}
+
+ReplayReader::ReplayReader( const fs::path& path )
+: mBodyTimeStamp( 0L ), mHeaderValid( false ), mPacketCount( 0 )
+{
+	memset( &mFileHeader, 0, sizeof( mFileHeader ) );
+	memset( &mHeader, 0, sizeof( mHeader ) );
+	mStream.open( path.string().c_str(), ios::binary );
+	mStream.read( reinterpret_cast<char*>( &mFileHeader ), sizeof( mFileHeader ) );
+	if ( !mStream || mFileHeader.mMagic != kReplayMagic || mFileHeader.mVersion != kReplayVersion ) {
+		throw ExcFileInvalid( path.string() );
+	}
+	mHeaderValid = readHeader();
+}
+
+// Leaves the stream at the payload of the packet in "mHeader".
+bool ReplayReader::readHeader()
+{
+	if ( mPacketCount >= mFileHeader.mPacketCount ) {
+		return false;
+	}
+	mStream.read( reinterpret_cast<char*>( &mHeader ), sizeof( mHeader ) );
+	if ( !mStream ) {
+		return false;
+	}
+	return StreamCodec::checkHeader( mHeader );
+}
+
+bool ReplayReader::read( Frame& frame )
+{
+	if ( !mHeaderValid ) {
+		return false;
+	}
+
+	uint32_t sequence	= mHeader.mSequence;
+	long long timeStamp	= 0L;
+	Channel8u bodyIndex;
+	Channel16u depth;
+	while ( mHeaderValid && mHeader.mSequence == sequence ) {
+		mPayload.resize( mHeader.mSize );
+		if ( mHeader.mSize > 0 ) {
+			mStream.read( reinterpret_cast<char*>( &mPayload[ 0 ] ), mHeader.mSize );
+		}
+		const uint8_t* data = mPayload.empty() ? 0 : &mPayload[ 0 ];
+
+		bool decoded = (bool)mStream;
+		switch ( mHeader.mType ) {
+		case StreamCodec::Packet_Bodies:
+			decoded			= decoded && StreamCodec::decodeBodies( data, mPayload.size(), mBodies );
+			mBodyTimeStamp	= mHeader.mTimeStamp;
+			break;
+		case StreamCodec::Packet_BodyIndex:
+			bodyIndex		= Channel8u( mHeader.mWidth, mHeader.mHeight );
+			decoded			= decoded && StreamCodec::decodeRunLength( data, mPayload.size(), bodyIndex );
+			timeStamp		= mHeader.mTimeStamp;
+			break;
+		case StreamCodec::Packet_Depth:
+			depth			= Channel16u( mHeader.mWidth, mHeader.mHeight );
+			decoded			= decoded && StreamCodec::decodeChannel16u( data, mPayload.size(), depth );
+			timeStamp		= mHeader.mTimeStamp;
+			break;
+		}
+		if ( !decoded ) {
+			mHeaderValid = false;
+			return false;
+		}
+		++mPacketCount;
+		mHeaderValid = readHeader();
+	}
+
+	// Frames with unchanged bodies and no images are never written, so 
+	// a frame without images is a body-only capture.
+	if ( !bodyIndex && !depth ) {
+		timeStamp = mBodyTimeStamp;
+	}
+	frame = Frame( timeStamp, "", Surface8u(), depth, Channel16u(), Channel16u(), mBodies, mBodyTimeStamp, bodyIndex );
+	return true;
+}
+
+const ReplayBuffer::FileHeader& ReplayReader::getFileHeader() const
+{
+	return mFileHeader;
+}
+
+uint32_t ReplayReader::getPacketCount() const
+{
+	return mPacketCount;
+}
+
+const char* ReplayReader::Exception::what() const throw()
+{
+	return mMessage;
+}
+
+ReplayReader::ExcFileInvalid::ExcFileInvalid( const string& path ) throw()
+{
+	sprintf( mMessage, "Unable to read replay file: %s", path.c_str() );
+}
+
+}
@@ -0,0 +1,194 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2.h"
+#include "Kinect2StreamCodec.h"
+#include "cinder/Filesystem.h"
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+
+namespace Kinect2 {
+
+class ReplayBuffer;
+class ReplayReader;
+typedef std::shared_ptr<ReplayBuffer>	ReplayBufferRef;
+typedef std::shared_ptr<ReplayReader>	ReplayReaderRef;
+
+// Keeps the last few seconds of depth, body index and bodies in memory, 
+// compressed with the StreamCodec encoders, and writes them to disk when 
+// trigger() is called. Encoding and writing run on their own threads; 
+// push() only hands the frame over, so capture never waits on either.
+// 
+// The file starts with a FileHeader followed by "mPacketCount" packets, 
+// each a StreamCodec::PacketHeader and its payload, oldest frame first. 
+// Packets of one frame share a sequence number. Packet headers carry the 
+// stream magic, so StreamCodec::checkHeader() applies to them.
+class ReplayBuffer
+{
+public:
+	// "memoryBudget" caps the compressed bytes held. The oldest frames are 
+	// dropped first when either limit is reached.
+	static ReplayBufferRef						create( double duration = 10.0, size_t memoryBudget = 256 * 1024 * 1024 );
+	~ReplayBuffer();
+
+	// Frames already seen (same time stamp) are ignored. If the encoder 
+	// is still busy with the previous frame, that one is replaced.
+	void										push( const Frame& frame );
+	// Writes everything buffered so far to "path" in the background. 
+	// Returns false if a previous flush is still running.
+	bool										trigger( const ci::fs::path& path );
+
+	// Seconds of data currently buffered
+	double										getDuration() const;
+	bool										isFlushing() const;
+
+	struct FileHeader
+	{
+		uint32_t								mMagic;
+		uint32_t								mVersion;
+		uint32_t								mPacketCount;
+		uint32_t								mReserved;
+		long long								mFirstTimeStamp;
+		long long								mLastTimeStamp;
+	};
+
+	struct Stats
+	{
+		Stats();
+
+		// Compressed bytes and frames currently buffered
+		uint64_t								mBytes;
+		// Frames replaced before the encoder got to them
+		uint64_t								mDropped;
+		// Smoothed seconds spent encoding one frame
+		double									mEncodeTime;
+		uint64_t								mFlushes;
+		uint64_t								mFlushFailures;
+		uint64_t								mFrames;
+	};
+
+	Stats										getStats() const;
+protected:
+	typedef std::shared_ptr<const std::vector<uint8_t> >	PacketRef;
+
+	struct Entry
+	{
+		PacketRef								mPacket;
+		long long								mTimeStamp;
+	};
+
+	ReplayBuffer( double duration, size_t memoryBudget );
+
+	void										encode();
+	void										flush();
+
+	std::deque<Entry>							mEntries;
+	std::condition_variable						mCondition;
+	long long									mDuration;
+	std::deque<Entry>							mFlushEntries;
+	std::shared_ptr<std::thread>				mEncodeThread;
+	std::shared_ptr<std::thread>				mFlushThread;
+	ci::fs::path								mFlushPath;
+	bool										mFlushing;
+	long long									mLastBodyTimeStamp;
+	long long									mLastTimeStamp;
+	size_t										mMemoryBudget;
+	mutable std::mutex							mMutex;
+	Frame										mPending;
+	bool										mPendingValid;
+	bool										mRunning;
+	uint32_t									mSequence;
+	Stats										mStats;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+// Reads a file written by ReplayBuffer back one frame at a time. Bodies 
+// are only stored when they change, so every frame carries the latest 
+// bodies read so far.
+class ReplayReader
+{
+public:
+	// Throws ExcFileInvalid if "path" cannot be opened or is not a replay 
+	// of the current version.
+	static ReplayReaderRef						create( const ci::fs::path& path );
+
+	// Decodes the next frame into "frame". Returns false at the end of the 
+	// file or at the first corrupt packet.
+	bool										read( Frame& frame );
+
+	const ReplayBuffer::FileHeader&				getFileHeader() const;
+	// Packets read so far
+	uint32_t									getPacketCount() const;
+protected:
+	ReplayReader( const ci::fs::path& path );
+
+	bool										readHeader();
+
+	std::vector<Body>							mBodies;
+	long long									mBodyTimeStamp;
+	ReplayBuffer::FileHeader					mFileHeader;
+	StreamCodec::PacketHeader					mHeader;
+	bool										mHeaderValid;
+	uint32_t									mPacketCount;
+	std::vector<uint8_t>						mPayload;
+	std::ifstream								mStream;
+public:
+
+	//////////////////////////////////////////////////////////////////////////////////////////////
+
+	class Exception : public ci::Exception
+	{
+	public:
+		const char* what() const throw();
+	protected:
+		char									mMessage[ 2048 ];
+		friend class							ReplayReader;
+	};
+
+	class ExcFileInvalid : public Exception 
+	{
+	public:
+		ExcFileInvalid( const std::string& path ) throw();
+	};
+};
+
+}
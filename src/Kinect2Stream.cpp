@@ -0,0 +1,564 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2Stream.h"
+
+#include <ws2tcpip.h>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+StreamStats::StreamStats()
+: mBandwidth( 0.0 ), mBytes( 0 ), mEncodeTime( 0.0 ), mLatency( 0.0 )
+{
+	for ( size_t i = 0; i < StreamCodec::Packet_Count; ++i ) {
+		mDropped[ i ] = 0;
+		mPackets[ i ] = 0;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+StreamServer::Client::Client()
+: mRunning( true ), mSocket( INVALID_SOCKET )
+{
+}
+
+StreamServerRef StreamServer::create( uint16_t port, int32_t colorScale )
+{
+	return StreamServerRef( new StreamServer( port, colorScale ) );
+}
+
+StreamServer::StreamServer( uint16_t port, int32_t colorScale )
+: mColorScale( colorScale ), mListenSocket( INVALID_SOCKET ), mLastTimeStamp( 0L ), mRunning( true ), 
+mSequence( 0 ), mStatsTime( getHostTime() ), mStatsBytes( 0 )
+{
+	for ( size_t i = 0; i < StreamCodec::Packet_Count; ++i ) {
+		mPendingSequence[ i ]	= 0;
+		mPendingTime[ i ]		= 0.0;
+		mPendingValid[ i ]		= false;
+	}
+
+	WSADATA data;
+	int32_t error = WSAStartup( MAKEWORD( 2, 2 ), &data );
+	if ( error != 0 ) {
+		throw ExcSocketFailed( "WSAStartup", error );
+	}
+
+	mListenSocket = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+	if ( mListenSocket == INVALID_SOCKET ) {
+		error = WSAGetLastError();
+		WSACleanup();
+		throw ExcSocketFailed( "socket", error );
+	}
+	int32_t reuse = 1;
+	setsockopt( mListenSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof( reuse ) );
+
+	sockaddr_in address;
+	memset( &address, 0, sizeof( address ) );
+	address.sin_family		= AF_INET;
+	address.sin_addr.s_addr	= htonl( INADDR_ANY );
+	address.sin_port		= htons( port );
+	if ( ::bind( mListenSocket, (const sockaddr*)&address, sizeof( address ) ) == SOCKET_ERROR || 
+		listen( mListenSocket, SOMAXCONN ) == SOCKET_ERROR ) {
+		error = WSAGetLastError();
+		closesocket( mListenSocket );
+		WSACleanup();
+		throw ExcSocketFailed( "listen", error );
+	}
+
+	mAcceptThread = shared_ptr<thread>( new thread( bind( &StreamServer::accept, this ) ) );
+	for ( uint8_t i = 0; i < StreamCodec::Packet_Count; ++i ) {
+		if ( i != StreamCodec::Packet_Color || mColorScale > 0 ) {
+			mEncodeThreads.push_back( shared_ptr<thread>( new thread( bind( &StreamServer::encode, this, i ) ) ) );
+		}
+	}
+}
+
+StreamServer::~StreamServer()
+{
+	{
+		lock_guard<mutex> lock( mMutex );
+		mRunning = false;
+	}
+	mCondition.notify_all();
+	for ( vector<shared_ptr<thread> >::iterator iter = mEncodeThreads.begin(); iter != mEncodeThreads.end(); ++iter ) {
+		( *iter )->join();
+	}
+
+	// Shutting the socket down releases the blocking accept().
+	shutdown( mListenSocket, SD_BOTH );
+	closesocket( mListenSocket );
+	mAcceptThread->join();
+
+	for ( vector<ClientRef>::iterator iter = mClients.begin(); iter != mClients.end(); ++iter ) {
+		Client* client = iter->get();
+		{
+			lock_guard<mutex> lock( client->mMutex );
+			client->mRunning = false;
+		}
+		client->mCondition.notify_all();
+		shutdown( client->mSocket, SD_BOTH );
+		client->mThread->join();
+		closesocket( client->mSocket );
+	}
+	WSACleanup();
+}
+
+void StreamServer::send( const Frame& frame )
+{
+	if ( frame.getTimeStamp() == mLastTimeStamp ) {
+		return;
+	}
+	mLastTimeStamp = frame.getTimeStamp();
+
+	bool available[ StreamCodec::Packet_Count ];
+	available[ StreamCodec::Packet_Bodies ]						= frame.getBodyTimeStamp() != 0L;
+	available[ StreamCodec::Packet_BodyIndex ]					= frame.getBodyIndex();
+	available[ StreamCodec::Packet_Color ]						= frame.getColor() && mColorScale > 0;
+	available[ StreamCodec::Packet_Depth ]						= frame.getDepth();
+	available[ StreamCodec::Packet_Infrared ]					= frame.getInfrared();
+	available[ StreamCodec::Packet_InfraredLongExposure ]		= frame.getInfraredLongExposure();
+
+	double hostTime = getHostTime();
+	{
+		lock_guard<mutex> lock( mMutex );
+		for ( size_t i = 0; i < StreamCodec::Packet_Count; ++i ) {
+			if ( available[ i ] ) {
+				if ( mPendingValid[ i ] ) {
+					++mStats.mDropped[ i ];
+				}
+				mPending[ i ]			= frame;
+				mPendingSequence[ i ]	= mSequence;
+				mPendingTime[ i ]		= hostTime;
+				mPendingValid[ i ]		= true;
+			}
+		}
+		++mSequence;
+	}
+	mCondition.notify_all();
+}
+
+size_t StreamServer::getClientCount() const
+{
+	lock_guard<mutex> lock( mClientMutex );
+	size_t count = 0;
+	for ( vector<ClientRef>::const_iterator iter = mClients.begin(); iter != mClients.end(); ++iter ) {
+		if ( ( *iter )->mRunning ) {
+			++count;
+		}
+	}
+	return count;
+}
+
+StreamStats StreamServer::getStats() const
+{
+	lock_guard<mutex> lock( mMutex );
+	return mStats;
+}
+
+void StreamServer::accept()
+{
+	while ( mRunning ) {
+		SOCKET socket = ::accept( mListenSocket, 0, 0 );
+		if ( socket == INVALID_SOCKET ) {
+			continue;
+		}
+		int32_t noDelay = 1;
+		setsockopt( socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof( noDelay ) );
+
+		ClientRef client( new Client() );
+		client->mSocket = socket;
+		client->mThread = shared_ptr<thread>( new thread( bind( &StreamServer::write, this, client.get() ) ) );
+
+		lock_guard<mutex> lock( mClientMutex );
+		for ( vector<ClientRef>::iterator iter = mClients.begin(); iter != mClients.end(); ) {
+			if ( !( *iter )->mRunning ) {
+				( *iter )->mThread->join();
+				closesocket( ( *iter )->mSocket );
+				iter = mClients.erase( iter );
+			} else {
+				++iter;
+			}
+		}
+		mClients.push_back( client );
+	}
+}
+
+void StreamServer::encode( uint8_t type )
+{
+	while ( true ) {
+		Frame frame;
+		StreamCodec::PacketHeader header;
+		memset( &header, 0, sizeof( header ) );
+		{
+			unique_lock<mutex> lock( mMutex );
+			while ( mRunning && !mPendingValid[ type ] ) {
+				mCondition.wait( lock );
+			}
+			if ( !mRunning ) {
+				break;
+			}
+			frame					= mPending[ type ];
+			header.mHostTime		= mPendingTime[ type ];
+			header.mSequence		= mPendingSequence[ type ];
+			mPending[ type ]		= Frame();
+			mPendingValid[ type ]	= false;
+		}
+
+		double start = getHostTime();
+		shared_ptr<vector<uint8_t> > packet( new vector<uint8_t>( sizeof( header ) ) );
+		header.mMagic		= StreamCodec::kStreamMagic;
+		header.mType		= type;
+		header.mTimeStamp	= frame.getTimeStamp();
+		switch ( type ) {
+		case StreamCodec::Packet_Bodies:
+			header.mTimeStamp = frame.getBodyTimeStamp();
+			StreamCodec::encodeBodies( frame.getBodies(), *packet );
+			break;
+		case StreamCodec::Packet_BodyIndex:
+			header.mWidth	= frame.getBodyIndex().getWidth();
+			header.mHeight	= frame.getBodyIndex().getHeight();
+			StreamCodec::encodeRunLength( frame.getBodyIndex(), *packet );
+			break;
+		case StreamCodec::Packet_Color:
+			header.mWidth	= frame.getColor().getWidth() / mColorScale;
+			header.mHeight	= frame.getColor().getHeight() / mColorScale;
+			StreamCodec::encodeColor( frame.getColor(), mColorScale, *packet );
+			break;
+		case StreamCodec::Packet_Depth:
+			header.mWidth	= frame.getDepth().getWidth();
+			header.mHeight	= frame.getDepth().getHeight();
+			StreamCodec::encodeChannel16u( frame.getDepth(), *packet );
+			break;
+		case StreamCodec::Packet_Infrared:
+			header.mWidth	= frame.getInfrared().getWidth();
+			header.mHeight	= frame.getInfrared().getHeight();
+			StreamCodec::encodeChannel16u( frame.getInfrared(), *packet );
+			break;
+		case StreamCodec::Packet_InfraredLongExposure:
+			header.mWidth	= frame.getInfraredLongExposure().getWidth();
+			header.mHeight	= frame.getInfraredLongExposure().getHeight();
+			StreamCodec::encodeChannel16u( frame.getInfraredLongExposure(), *packet );
+			break;
+		}
+		header.mSize = (uint32_t)( packet->size() - sizeof( header ) );
+		memcpy( &( *packet )[ 0 ], &header, sizeof( header ) );
+
+		double elapsed = getHostTime() - start;
+		{
+			lock_guard<mutex> lock( mMutex );
+			mStats.mEncodeTime = mStats.mEncodeTime == 0.0 ? elapsed : mStats.mEncodeTime * 0.95 + elapsed * 0.05;
+		}
+		post( packet, type );
+	}
+}
+
+void StreamServer::post( const PacketRef& packet, uint8_t type )
+{
+	uint64_t dropped = 0;
+	{
+		lock_guard<mutex> lock( mClientMutex );
+		for ( vector<ClientRef>::iterator iter = mClients.begin(); iter != mClients.end(); ++iter ) {
+			Client* client = iter->get();
+			if ( client->mRunning ) {
+				{
+					lock_guard<mutex> clientLock( client->mMutex );
+					if ( client->mPackets[ type ] ) {
+						++dropped;
+					}
+					client->mPackets[ type ] = packet;
+				}
+				client->mCondition.notify_one();
+			}
+		}
+	}
+	if ( dropped > 0 ) {
+		lock_guard<mutex> lock( mMutex );
+		mStats.mDropped[ type ] += dropped;
+	}
+}
+
+void StreamServer::write( Client* client )
+{
+	while ( true ) {
+		PacketRef packet;
+		uint8_t type = 0;
+		{
+			unique_lock<mutex> lock( client->mMutex );
+			while ( client->mRunning && packet == 0 ) {
+				
+				// Oldest frame first, so streams stay interleaved.
+				uint32_t sequence = 0;
+				for ( uint8_t i = 0; i < StreamCodec::Packet_Count; ++i ) {
+					const PacketRef& p = client->mPackets[ i ];
+					if ( p ) {
+						uint32_t s = ( (const StreamCodec::PacketHeader*)&( *p )[ 0 ] )->mSequence;
+						if ( packet == 0 || (int32_t)( s - sequence ) < 0 ) {
+							packet		= p;
+							sequence	= s;
+							type		= i;
+						}
+					}
+				}
+				if ( packet ) {
+					client->mPackets[ type ].reset();
+				} else {
+					client->mCondition.wait( lock );
+				}
+			}
+			if ( !client->mRunning ) {
+				break;
+			}
+		}
+
+		const char* data	= (const char*)&( *packet )[ 0 ];
+		int32_t remaining	= (int32_t)packet->size();
+		while ( remaining > 0 ) {
+			int32_t count = ::send( client->mSocket, data, remaining, 0 );
+			if ( count <= 0 ) {
+				break;
+			}
+			data		+= count;
+			remaining	-= count;
+		}
+		if ( remaining > 0 ) {
+			client->mRunning = false;
+			break;
+		}
+
+		lock_guard<mutex> lock( mMutex );
+		mStats.mBytes += packet->size();
+		++mStats.mPackets[ type ];
+		double now = getHostTime();
+		if ( now - mStatsTime >= 1.0 ) {
+			mStats.mBandwidth	= (double)( mStats.mBytes - mStatsBytes ) / ( now - mStatsTime );
+			mStatsBytes			= mStats.mBytes;
+			mStatsTime			= now;
+		}
+	}
+}
+
+const char* StreamServer::Exception::what() const throw()
+{
+	return mMessage;
+}
+
+StreamServer::ExcSocketFailed::ExcSocketFailed( const string& operation, int32_t error ) throw()
+{
+	sprintf( mMessage, "Socket operation \"%s\" failed. Error: %i", operation.c_str(), error );
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+StreamClientRef StreamClient::create( const string& host, uint16_t port )
+{
+	return StreamClientRef( new StreamClient( host, port ) );
+}
+
+StreamClient::StreamClient( const string& host, uint16_t port )
+: mConnected( false ), mFrameNew( false ), mRunning( true ), mSocket( INVALID_SOCKET ), 
+mStatsTime( getHostTime() ), mStatsBytes( 0 )
+{
+	WSADATA data;
+	int32_t error = WSAStartup( MAKEWORD( 2, 2 ), &data );
+	if ( error != 0 ) {
+		throw StreamServer::ExcSocketFailed( "WSAStartup", error );
+	}
+
+	addrinfo hints;
+	memset( &hints, 0, sizeof( hints ) );
+	hints.ai_family		= AF_INET;
+	hints.ai_socktype	= SOCK_STREAM;
+	hints.ai_protocol	= IPPROTO_TCP;
+	addrinfo* result	= 0;
+	char service[ 8 ];
+	sprintf( service, "%u", (uint32_t)port );
+	error = getaddrinfo( host.c_str(), service, &hints, &result );
+	if ( error != 0 ) {
+		WSACleanup();
+		throw StreamServer::ExcSocketFailed( "getaddrinfo", error );
+	}
+	for ( addrinfo* iter = result; iter != 0 && mSocket == INVALID_SOCKET; iter = iter->ai_next ) {
+		mSocket = socket( iter->ai_family, iter->ai_socktype, iter->ai_protocol );
+		if ( mSocket != INVALID_SOCKET && connect( mSocket, iter->ai_addr, (int32_t)iter->ai_addrlen ) == SOCKET_ERROR ) {
+			error = WSAGetLastError();
+			closesocket( mSocket );
+			mSocket = INVALID_SOCKET;
+		}
+	}
+	freeaddrinfo( result );
+	if ( mSocket == INVALID_SOCKET ) {
+		WSACleanup();
+		throw StreamServer::ExcSocketFailed( "connect", error );
+	}
+	int32_t noDelay = 1;
+	setsockopt( mSocket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof( noDelay ) );
+
+	mConnected	= true;
+	mThread		= shared_ptr<thread>( new thread( bind( &StreamClient::receive, this ) ) );
+}
+
+StreamClient::~StreamClient()
+{
+	mRunning = false;
+	shutdown( mSocket, SD_BOTH );
+	mThread->join();
+	closesocket( mSocket );
+	WSACleanup();
+}
+
+bool StreamClient::getFrame( Frame& frame )
+{
+	lock_guard<mutex> lock( mMutex );
+	if ( !mFrameNew ) {
+		return false;
+	}
+	frame		= mFrame;
+	mFrameNew	= false;
+	return true;
+}
+
+StreamStats StreamClient::getStats() const
+{
+	lock_guard<mutex> lock( mMutex );
+	return mStats;
+}
+
+bool StreamClient::isConnected() const
+{
+	return mConnected;
+}
+
+static bool receiveAll( SOCKET socket, uint8_t* data, size_t size )
+{
+	while ( size > 0 ) {
+		int32_t count = recv( socket, (char*)data, (int32_t)size, 0 );
+		if ( count <= 0 ) {
+			return false;
+		}
+		data += count;
+		size -= count;
+	}
+	return true;
+}
+
+void StreamClient::receive()
+{
+	vector<uint8_t> payload;
+	while ( mRunning ) {
+		StreamCodec::PacketHeader header;
+		if ( !receiveAll( mSocket, (uint8_t*)&header, sizeof( header ) ) || !StreamCodec::checkHeader( header ) ) {
+			break;
+		}
+		payload.resize( header.mSize );
+		if ( header.mSize > 0 && !receiveAll( mSocket, &payload[ 0 ], header.mSize ) ) {
+			break;
+		}
+		const uint8_t* data = payload.empty() ? 0 : &payload[ 0 ];
+
+		// Decode into fresh buffers, so frames already handed out stay intact.
+		bool decoded = false;
+		vector<Body> bodies;
+		Channel8u channel8;
+		Channel16u channel16;
+		Surface8u surface;
+		switch ( header.mType ) {
+		case StreamCodec::Packet_Bodies:
+			decoded = StreamCodec::decodeBodies( data, payload.size(), bodies );
+			break;
+		case StreamCodec::Packet_BodyIndex:
+			channel8 = Channel8u( header.mWidth, header.mHeight );
+			decoded = StreamCodec::decodeRunLength( data, payload.size(), channel8 );
+			break;
+		case StreamCodec::Packet_Color:
+			surface = Surface8u( header.mWidth, header.mHeight, false, SurfaceChannelOrder::RGBA );
+			decoded = StreamCodec::decodeColor( data, payload.size(), surface );
+			break;
+		default:
+			channel16 = Channel16u( header.mWidth, header.mHeight );
+			decoded = StreamCodec::decodeChannel16u( data, payload.size(), channel16 );
+			break;
+		}
+		if ( !decoded ) {
+			continue;
+		}
+
+		double now = getHostTime();
+		lock_guard<mutex> lock( mMutex );
+		switch ( header.mType ) {
+		case StreamCodec::Packet_Bodies:
+			mFrame.mBodies.swap( bodies );
+			mFrame.mBodyTimeStamp = header.mTimeStamp;
+			break;
+		case StreamCodec::Packet_BodyIndex:
+			mFrame.mChannelBodyIndex = channel8;
+			break;
+		case StreamCodec::Packet_Color:
+			mFrame.mSurfaceColor = surface;
+			break;
+		case StreamCodec::Packet_Depth:
+			mFrame.mChannelDepth = channel16;
+			break;
+		case StreamCodec::Packet_Infrared:
+			mFrame.mChannelInfrared = channel16;
+			break;
+		case StreamCodec::Packet_InfraredLongExposure:
+			mFrame.mChannelInfraredLongExposure = channel16;
+			break;
+		}
+		if ( header.mType != StreamCodec::Packet_Bodies ) {
+			mFrame.mTimeStamp = header.mTimeStamp;
+		}
+		mFrameNew = true;
+
+		double latency	= now - header.mHostTime;
+		mStats.mLatency	= mStats.mLatency == 0.0 ? latency : mStats.mLatency * 0.95 + latency * 0.05;
+		mStats.mBytes	+= sizeof( header ) + header.mSize;
+		++mStats.mPackets[ header.mType ];
+		if ( now - mStatsTime >= 1.0 ) {
+			mStats.mBandwidth	= (double)( mStats.mBytes - mStatsBytes ) / ( now - mStatsTime );
+			mStatsBytes			= mStats.mBytes;
+			mStatsTime			= now;
+		}
+	}
+	mConnected = false;
+}
+
+}
@@ -0,0 +1,182 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+// Winsock must come before anything that pulls in windows.h.
+#include <winsock2.h>
+#include "Kinect2.h"
+#include "Kinect2StreamCodec.h"
+#include <condition_variable>
+#include <mutex>
+
+#pragma comment( lib, "ws2_32.lib" )
+
+namespace Kinect2 {
+
+class StreamClient;
+class StreamServer;
+typedef std::shared_ptr<StreamClient>	StreamClientRef;
+typedef std::shared_ptr<StreamServer>	StreamServerRef;
+
+struct StreamStats
+{
+	StreamStats();
+
+	// Bytes per second over the last second
+	double										mBandwidth;
+	uint64_t									mBytes;
+	uint64_t									mDropped[ StreamCodec::Packet_Count ];
+	// Mean seconds spent encoding (server) or from send() to decoded (client)
+	double										mEncodeTime;
+	double										mLatency;
+	uint64_t									mPackets[ StreamCodec::Packet_Count ];
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+// Serves frames to any number of TCP clients. send() never blocks: each 
+// stream keeps only its latest frame, both while waiting for an encoder 
+// and while waiting for a client's socket, so slow links drop frames 
+// instead of building up latency.
+class StreamServer
+{
+public:
+	// A "colorScale" of 0 disables color.
+	static StreamServerRef						create( uint16_t port, int32_t colorScale = 4 );
+	~StreamServer();
+
+	void										send( const Frame& frame );
+
+	size_t										getClientCount() const;
+	StreamStats									getStats() const;
+protected:
+	typedef std::shared_ptr<const std::vector<uint8_t> >	PacketRef;
+
+	struct Client
+	{
+		Client();
+
+		std::condition_variable					mCondition;
+		std::mutex								mMutex;
+		PacketRef								mPackets[ StreamCodec::Packet_Count ];
+		std::atomic<bool>						mRunning;
+		SOCKET									mSocket;
+		std::shared_ptr<std::thread>			mThread;
+	};
+	typedef std::shared_ptr<Client>	ClientRef;
+
+	StreamServer( uint16_t port, int32_t colorScale );
+
+	void										accept();
+	void										encode( uint8_t type );
+	void										post( const PacketRef& packet, uint8_t type );
+	void										write( Client* client );
+
+	std::vector<ClientRef>						mClients;
+	mutable std::mutex							mClientMutex;
+	int32_t										mColorScale;
+	std::condition_variable						mCondition;
+	std::vector<std::shared_ptr<std::thread> >	mEncodeThreads;
+	std::shared_ptr<std::thread>				mAcceptThread;
+	SOCKET										mListenSocket;
+	mutable std::mutex							mMutex;
+	Frame										mPending[ StreamCodec::Packet_Count ];
+	double										mPendingTime[ StreamCodec::Packet_Count ];
+	uint32_t									mPendingSequence[ StreamCodec::Packet_Count ];
+	bool										mPendingValid[ StreamCodec::Packet_Count ];
+	long long									mLastTimeStamp;
+	std::atomic<bool>							mRunning;
+	uint32_t									mSequence;
+	StreamStats									mStats;
+	double										mStatsTime;
+	uint64_t									mStatsBytes;
+public:
+
+	//////////////////////////////////////////////////////////////////////////////////////////////
+
+	class Exception : public ci::Exception
+	{
+	public:
+		const char* what() const throw();
+	protected:
+		char									mMessage[ 2048 ];
+		friend class							StreamServer;
+		friend class							StreamClient;
+	};
+
+	class ExcSocketFailed : public Exception 
+	{
+	public:
+		ExcSocketFailed( const std::string& operation, int32_t error ) throw();
+	};
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+// Receives from a StreamServer on a background thread and assembles the 
+// latest packet of every stream into a Frame. Latency is only meaningful 
+// when both ends share a clock, e.g. over loopback.
+class StreamClient
+{
+public:
+	static StreamClientRef						create( const std::string& host, uint16_t port );
+	~StreamClient();
+
+	// Copies the latest frame into "frame". Returns false if nothing 
+	// arrived since the last call.
+	bool										getFrame( Frame& frame );
+	StreamStats									getStats() const;
+	bool										isConnected() const;
+protected:
+	StreamClient( const std::string& host, uint16_t port );
+
+	void										receive();
+
+	std::atomic<bool>							mConnected;
+	Frame										mFrame;
+	bool										mFrameNew;
+	mutable std::mutex							mMutex;
+	std::atomic<bool>							mRunning;
+	SOCKET										mSocket;
+	StreamStats									mStats;
+	double										mStatsTime;
+	uint64_t									mStatsBytes;
+	std::shared_ptr<std::thread>				mThread;
+};
+
+}
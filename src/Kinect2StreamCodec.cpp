@@ -0,0 +1,468 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2StreamCodec.h"
+#if defined( CINDER_MSW )
+#include "Kinect2.h"
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+static const uint32_t kRiceLimit		= 24;
+
+StreamCodec::BitWriter::BitWriter( vector<uint8_t>& buffer )
+: mBits( 0 ), mBuffer( buffer ), mCount( 0 )
+{
+}
+
+void StreamCodec::BitWriter::write( uint32_t v, uint32_t count )
+{
+	mBits	= ( mBits << count ) | ( v & ( ( (uint64_t)1 << count ) - 1 ) );
+	mCount	+= count;
+	while ( mCount >= 8 ) {
+		mCount -= 8;
+		mBuffer.push_back( (uint8_t)( mBits >> mCount ) );
+	}
+}
+
+void StreamCodec::BitWriter::flush()
+{
+	if ( mCount > 0 ) {
+		mBuffer.push_back( (uint8_t)( mBits << ( 8 - mCount ) ) );
+		mCount = 0;
+	}
+}
+
+StreamCodec::BitReader::BitReader( const uint8_t* data, size_t size )
+: mBits( 0 ), mCount( 0 ), mData( data ), mEnd( data + size ), mOverrun( false )
+{
+}
+
+uint32_t StreamCodec::BitReader::read( uint32_t count )
+{
+	while ( mCount < count ) {
+		mBits = mBits << 8;
+		if ( mData < mEnd ) {
+			mBits |= *mData++;
+		} else {
+			mOverrun = true;
+		}
+		mCount += 8;
+	}
+	mCount -= count;
+	return (uint32_t)( mBits >> mCount ) & (uint32_t)( ( (uint64_t)1 << count ) - 1 );
+}
+
+bool StreamCodec::BitReader::isOverrun() const
+{
+	return mOverrun;
+}
+
+// Running mean of the residuals picks the Rice parameter, as in JPEG-LS.
+class RiceContext
+{
+public:
+	RiceContext()
+	: mCount( 1 ), mSum( 8 )
+	{
+	}
+
+	uint32_t getParameter() const
+	{
+		uint32_t k = 0;
+		while ( ( mCount << k ) < mSum && k < 16 ) {
+			++k;
+		}
+		return k;
+	}
+
+	void update( uint32_t u )
+	{
+		mSum += u;
+		if ( ++mCount == 256 ) {
+			mCount	>>= 1;
+			mSum	>>= 1;
+		}
+	}
+protected:
+	uint32_t	mCount;
+	uint32_t	mSum;
+};
+
+static inline int32_t predictMedian( int32_t a, int32_t b, int32_t c )
+{
+	int32_t lo = min( a, b );
+	int32_t hi = max( a, b );
+	if ( c >= hi ) {
+		return lo;
+	} else if ( c <= lo ) {
+		return hi;
+	}
+	return a + b - c;
+}
+
+static inline void predictNeighbors( const uint16_t* row, const uint16_t* up, int32_t x, int32_t increment, 
+									int32_t& a, int32_t& b, int32_t& c )
+{
+	if ( up == 0 ) {
+		a = x > 0 ? row[ ( x - 1 ) * increment ] : 0;
+		b = a;
+		c = a;
+	} else if ( x == 0 ) {
+		b = up[ 0 ];
+		a = b;
+		c = b;
+	} else {
+		a = row[ ( x - 1 ) * increment ];
+		b = up[ x * increment ];
+		c = up[ ( x - 1 ) * increment ];
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t StreamCodec::getMaxPayloadSize( uint8_t type, int32_t width, int32_t height )
+{
+	size_t area = (size_t)max( width, 0 ) * (size_t)max( height, 0 );
+	switch ( type ) {
+	case Packet_Bodies:
+		// Count, then per body its ID, index, hand states and joint count, 
+		// then per joint its type, state, position and orientation.
+		return 1 + kMaxBodies * ( 12 + kMaxJoints * ( 2 + 7 * sizeof( float ) ) );
+	case Packet_BodyIndex:
+		// Every pixel its own run: value plus a one byte length
+		return area * 2;
+	case Packet_Color:
+		return area * 3;
+	case Packet_Depth:
+	case Packet_Infrared:
+	case Packet_InfraredLongExposure:
+		// The escape code is the longest Rice code.
+		return ( area * ( kRiceLimit + 17 ) + 7 ) / 8;
+	}
+	return 0;
+}
+
+bool StreamCodec::checkHeader( const PacketHeader& header )
+{
+	return header.mMagic == kStreamMagic && header.mType < Packet_Count && 
+		header.mWidth >= 0 && header.mHeight >= 0 && 
+		header.mWidth <= kMaxDimension && header.mHeight <= kMaxDimension && 
+		header.mSize <= getMaxPayloadSize( header.mType, header.mWidth, header.mHeight );
+}
+
+void StreamCodec::encodeChannel16u( const Channel16u& channel, vector<uint8_t>& buffer )
+{
+	int32_t width		= channel.getWidth();
+	int32_t height		= channel.getHeight();
+	int32_t increment	= channel.getIncrement();
+	buffer.reserve( buffer.size() + width * height );
+
+	StreamCodec::BitWriter writer( buffer );
+	RiceContext context;
+	const uint16_t* up = 0;
+	for ( int32_t y = 0; y < height; ++y ) {
+		const uint16_t* row = channel.getData( Vec2i( 0, y ) );
+		for ( int32_t x = 0; x < width; ++x ) {
+			int32_t a, b, c;
+			predictNeighbors( row, up, x, increment, a, b, c );
+			int32_t e	= (int32_t)row[ x * increment ] - predictMedian( a, b, c );
+			uint32_t u	= (uint32_t)( ( e << 1 ) ^ ( e >> 31 ) );
+			uint32_t k	= context.getParameter();
+			uint32_t q	= u >> k;
+			if ( q < kRiceLimit ) {
+				writer.write( ( 1u << ( q + 1 ) ) - 2, q + 1 );
+				writer.write( u, k );
+			} else {
+				writer.write( ( 1u << kRiceLimit ) - 1, kRiceLimit );
+				writer.write( u, 17 );
+			}
+			context.update( u );
+		}
+		up = row;
+	}
+	writer.flush();
+}
+
+bool StreamCodec::decodeChannel16u( const uint8_t* data, size_t size, Channel16u& channel )
+{
+	int32_t width		= channel.getWidth();
+	int32_t height		= channel.getHeight();
+	int32_t increment	= channel.getIncrement();
+
+	StreamCodec::BitReader reader( data, size );
+	RiceContext context;
+	const uint16_t* up = 0;
+	for ( int32_t y = 0; y < height; ++y ) {
+		uint16_t* row = channel.getData( Vec2i( 0, y ) );
+		for ( int32_t x = 0; x < width; ++x ) {
+			uint32_t q = 0;
+			while ( q < kRiceLimit && reader.read( 1 ) != 0 ) {
+				++q;
+			}
+			uint32_t u = 0;
+			if ( q < kRiceLimit ) {
+				uint32_t k	= context.getParameter();
+				u			= ( q << k ) | reader.read( k );
+			} else {
+				u = reader.read( 17 );
+			}
+			if ( reader.isOverrun() ) {
+				return false;
+			}
+			context.update( u );
+
+			int32_t a, b, c;
+			predictNeighbors( row, up, x, increment, a, b, c );
+			int32_t e				= (int32_t)( u >> 1 ) ^ -(int32_t)( u & 1 );
+			row[ x * increment ]	= (uint16_t)( predictMedian( a, b, c ) + e );
+		}
+		up = row;
+	}
+	return true;
+}
+
+void StreamCodec::encodeRunLength( const Channel8u& channel, vector<uint8_t>& buffer )
+{
+	int32_t width		= channel.getWidth();
+	int32_t height		= channel.getHeight();
+	int32_t increment	= channel.getIncrement();
+
+	uint8_t value	= 0;
+	uint32_t run	= 0;
+	for ( int32_t y = 0; y < height; ++y ) {
+		const uint8_t* row = channel.getData( Vec2i( 0, y ) );
+		for ( int32_t x = 0; x < width; ++x ) {
+			uint8_t v = row[ x * increment ];
+			if ( run > 0 && v != value ) {
+				buffer.push_back( value );
+				for ( ; run >= 0x80; run >>= 7 ) {
+					buffer.push_back( (uint8_t)( run | 0x80 ) );
+				}
+				buffer.push_back( (uint8_t)run );
+				run = 0;
+			}
+			value = v;
+			++run;
+		}
+	}
+	if ( run > 0 ) {
+		buffer.push_back( value );
+		for ( ; run >= 0x80; run >>= 7 ) {
+			buffer.push_back( (uint8_t)( run | 0x80 ) );
+		}
+		buffer.push_back( (uint8_t)run );
+	}
+}
+
+bool StreamCodec::decodeRunLength( const uint8_t* data, size_t size, Channel8u& channel )
+{
+	int32_t width		= channel.getWidth();
+	int32_t height		= channel.getHeight();
+	int32_t increment	= channel.getIncrement();
+
+	const uint8_t* end	= data + size;
+	uint8_t value		= 0;
+	uint32_t run		= 0;
+	for ( int32_t y = 0; y < height; ++y ) {
+		uint8_t* row = channel.getData( Vec2i( 0, y ) );
+		for ( int32_t x = 0; x < width; ++x, --run ) {
+			if ( run == 0 ) {
+				if ( data == end ) {
+					return false;
+				}
+				value = *data++;
+				for ( uint32_t shift = 0; ; shift += 7 ) {
+					if ( data == end || shift > 28 ) {
+						return false;
+					}
+					uint8_t byte	= *data++;
+					run				|= (uint32_t)( byte & 0x7f ) << shift;
+					if ( ( byte & 0x80 ) == 0 ) {
+						break;
+					}
+				}
+				if ( run == 0 ) {
+					return false;
+				}
+			}
+			row[ x * increment ] = value;
+		}
+	}
+	return run == 0 && data == end;
+}
+
+void StreamCodec::encodeColor( const Surface8u& surface, int32_t scale, vector<uint8_t>& buffer )
+{
+	scale				= max( scale, 1 );
+	int32_t width		= surface.getWidth() / scale;
+	int32_t height		= surface.getHeight() / scale;
+	int32_t inc			= surface.getPixelInc();
+	int32_t area		= scale * scale;
+	uint8_t offsets[]	= { surface.getRedOffset(), surface.getGreenOffset(), surface.getBlueOffset() };
+
+	size_t i = buffer.size();
+	buffer.resize( i + width * height * 3 );
+	for ( int32_t y = 0; y < height; ++y ) {
+		for ( int32_t x = 0; x < width; ++x ) {
+			uint32_t sum[ 3 ] = { 0, 0, 0 };
+			for ( int32_t v = 0; v < scale; ++v ) {
+				const uint8_t* p = surface.getData( Vec2i( x * scale, y * scale + v ) );
+				for ( int32_t u = 0; u < scale; ++u, p += inc ) {
+					sum[ 0 ] += p[ offsets[ 0 ] ];
+					sum[ 1 ] += p[ offsets[ 1 ] ];
+					sum[ 2 ] += p[ offsets[ 2 ] ];
+				}
+			}
+			buffer[ i++ ] = (uint8_t)( sum[ 0 ] / area );
+			buffer[ i++ ] = (uint8_t)( sum[ 1 ] / area );
+			buffer[ i++ ] = (uint8_t)( sum[ 2 ] / area );
+		}
+	}
+}
+
+bool StreamCodec::decodeColor( const uint8_t* data, size_t size, Surface8u& surface )
+{
+	int32_t width	= surface.getWidth();
+	int32_t height	= surface.getHeight();
+	if ( size != (size_t)( width * height * 3 ) ) {
+		return false;
+	}
+	int32_t inc			= surface.getPixelInc();
+	int8_t alpha		= surface.hasAlpha() ? surface.getAlphaOffset() : -1;
+	uint8_t offsets[]	= { surface.getRedOffset(), surface.getGreenOffset(), surface.getBlueOffset() };
+	for ( int32_t y = 0; y < height; ++y ) {
+		uint8_t* p = surface.getData( Vec2i( 0, y ) );
+		for ( int32_t x = 0; x < width; ++x, p += inc, data += 3 ) {
+			p[ offsets[ 0 ] ] = data[ 0 ];
+			p[ offsets[ 1 ] ] = data[ 1 ];
+			p[ offsets[ 2 ] ] = data[ 2 ];
+			if ( alpha >= 0 ) {
+				p[ alpha ] = 0xff;
+			}
+		}
+	}
+	return true;
+}
+
+#if defined( CINDER_MSW )
+static_assert( StreamCodec::kMaxBodies == BODY_COUNT && StreamCodec::kMaxJoints == JointType_Count, "Body bounds do not match the SDK" );
+
+template<typename T> 
+static void appendValue( vector<uint8_t>& buffer, const T& v )
+{
+	size_t size = buffer.size();
+	buffer.resize( size + sizeof( T ) );
+	memcpy( &buffer[ size ], &v, sizeof( T ) );
+}
+
+template<typename T> 
+static bool readValue( const uint8_t*& data, const uint8_t* end, T& v )
+{
+	if ( end - data < (ptrdiff_t)sizeof( T ) ) {
+		return false;
+	}
+	memcpy( &v, data, sizeof( T ) );
+	data += sizeof( T );
+	return true;
+}
+
+void StreamCodec::encodeBodies( const vector<Body>& bodies, vector<uint8_t>& buffer )
+{
+	// Synthetic sources may hold more bodies than the sensor tracks.
+	size_t count = min<size_t>( bodies.size(), kMaxBodies );
+	appendValue( buffer, (uint8_t)count );
+	for ( vector<Body>::const_iterator iter = bodies.begin(); iter != bodies.begin() + count; ++iter ) {
+		appendValue( buffer, iter->getId() );
+		appendValue( buffer, iter->getIndex() );
+		appendValue( buffer, (uint8_t)iter->getLeftHandState() );
+		appendValue( buffer, (uint8_t)iter->getRightHandState() );
+		appendValue( buffer, (uint8_t)iter->getJointMap().size() );
+		for ( map<JointType, Body::Joint>::const_iterator jointIter = iter->getJointMap().begin(); jointIter != iter->getJointMap().end(); ++jointIter ) {
+			const Vec3f& p = jointIter->second.getPosition();
+			const Quatf& q = jointIter->second.getOrientation();
+			float v[] = { p.x, p.y, p.z, q.w, q.v.x, q.v.y, q.v.z };
+			appendValue( buffer, (uint8_t)jointIter->first );
+			appendValue( buffer, (uint8_t)jointIter->second.getTrackingState() );
+			appendValue( buffer, v );
+		}
+	}
+}
+
+bool StreamCodec::decodeBodies( const uint8_t* data, size_t size, vector<Body>& bodies )
+{
+	const uint8_t* end	= data + size;
+	uint8_t count		= 0;
+	if ( !readValue( data, end, count ) || count > kMaxBodies ) {
+		return false;
+	}
+	bodies.clear();
+	for ( uint8_t b = 0; b < count; ++b ) {
+		uint64_t id				= 0;
+		uint8_t index			= 0;
+		uint8_t leftHandState	= 0;
+		uint8_t rightHandState	= 0;
+		uint8_t jointCount		= 0;
+		if ( !readValue( data, end, id ) || !readValue( data, end, index ) || 
+			!readValue( data, end, leftHandState ) || !readValue( data, end, rightHandState ) || 
+			!readValue( data, end, jointCount ) ) {
+			return false;
+		}
+		map<JointType, Body::Joint> jointMap;
+		for ( uint8_t i = 0; i < jointCount; ++i ) {
+			uint8_t jointType		= 0;
+			uint8_t trackingState	= 0;
+			float v[ 7 ];
+			if ( !readValue( data, end, jointType ) || !readValue( data, end, trackingState ) || !readValue( data, end, v ) || 
+				jointType >= JointType_Count ) {
+				return false;
+			}
+			jointMap[ (JointType)jointType ] = Body::Joint( Vec3f( v[ 0 ], v[ 1 ], v[ 2 ] ), Quatf( v[ 3 ], v[ 4 ], v[ 5 ], v[ 6 ] ), (TrackingState)trackingState );
+		}
+		bodies.push_back( Body( id, index, jointMap, (HandState)leftHandState, (HandState)rightHandState ) );
+	}
+	return data == end;
+}
+#endif
+
+}
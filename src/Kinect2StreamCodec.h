@@ -0,0 +1,145 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "cinder/Channel.h"
+#include "cinder/Cinder.h"
+#include "cinder/Surface.h"
+#include <cstdint>
+#include <vector>
+
+namespace Kinect2 {
+
+class Body;
+
+// Codecs and wire format shared by StreamServer, StreamClient and 
+// ReplayBuffer. Each 
+// stream of a Frame travels as its own packet so that a slow stream never 
+// holds up a fast one. Only the body codec needs the Kinect SDK, so a 
+// client on another platform needs nothing but its own socket code around 
+// checkHeader() and the decoders.
+namespace StreamCodec
+{
+	static const uint32_t						kStreamMagic	= 0x5332324b;
+
+	// Bounds on what a sensor frame can hold, used to reject corrupt or 
+	// hostile packet headers before allocating their payload.
+	static const int32_t						kMaxDimension	= 4096;
+	static const uint32_t						kMaxBodies		= 6;
+	static const uint32_t						kMaxJoints		= 25;
+
+	enum : uint8_t
+	{
+		Packet_Bodies, Packet_BodyIndex, Packet_Color, Packet_Depth, Packet_Infrared, 
+		Packet_InfraredLongExposure, Packet_Count
+	};
+
+	// MSB-first bit packing
+	class BitWriter
+	{
+	public:
+		BitWriter( std::vector<uint8_t>& buffer );
+
+		// "count" may be up to 32.
+		void									write( uint32_t v, uint32_t count );
+		void									flush();
+	protected:
+		uint64_t								mBits;
+		std::vector<uint8_t>&					mBuffer;
+		uint32_t								mCount;
+	};
+
+	class BitReader
+	{
+	public:
+		BitReader( const uint8_t* data, size_t size );
+
+		// Reads past the end return zeros and set the overrun flag.
+		uint32_t								read( uint32_t count );
+		bool									isOverrun() const;
+	protected:
+		uint64_t								mBits;
+		uint32_t								mCount;
+		const uint8_t*							mData;
+		const uint8_t*							mEnd;
+		bool									mOverrun;
+	};
+
+	struct PacketHeader
+	{
+		uint32_t								mMagic;
+		uint8_t									mType;
+		uint8_t									mReserved[ 3 ];
+		int32_t									mWidth;
+		int32_t									mHeight;
+		uint32_t								mSize;
+		uint32_t								mSequence;
+		long long								mTimeStamp;
+		// getHostTime() on the server when the frame was handed to send()
+		double									mHostTime;
+	};
+
+	// Largest payload the encoders produce for a "type" packet of 
+	// "width" by "height" pixels.
+	size_t										getMaxPayloadSize( uint8_t type, int32_t width, int32_t height );
+	// Returns false unless "header" could have come from a StreamServer. 
+	// Check this before trusting its size.
+	bool										checkHeader( const PacketHeader& header );
+
+	// Encoders append to "buffer". Decoders expect the destination to be 
+	// allocated at the size given in the packet header.
+
+	// Lossless. Pixels are predicted from their neighbours (LOCO-I median 
+	// predictor) and residuals are Rice coded with an adaptive parameter.
+	void										encodeChannel16u( const ci::Channel16u& channel, std::vector<uint8_t>& buffer );
+	bool										decodeChannel16u( const uint8_t* data, size_t size, ci::Channel16u& channel );
+	// Run-length coding for body index maps, which are mostly 0xff.
+	void										encodeRunLength( const ci::Channel8u& channel, std::vector<uint8_t>& buffer );
+	bool										decodeRunLength( const uint8_t* data, size_t size, ci::Channel8u& channel );
+	// Box-filtered, 24-bit. "scale" is the integer reduction factor.
+	void										encodeColor( const ci::Surface8u& surface, int32_t scale, std::vector<uint8_t>& buffer );
+	bool										decodeColor( const uint8_t* data, size_t size, ci::Surface8u& surface );
+#if defined( CINDER_MSW )
+	// Raw joint positions, orientations and states. Needs the Kinect SDK's 
+	// joint and hand types.
+	void										encodeBodies( const std::vector<Body>& bodies, std::vector<uint8_t>& buffer );
+	bool										decodeBodies( const uint8_t* data, size_t size, std::vector<Body>& bodies );
+#endif
+}
+
+}
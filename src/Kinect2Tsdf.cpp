@@ -0,0 +1,517 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2Tsdf.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <ppl.h>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+// Depth pixels sampled per row and column when looking for visible blocks. 
+// A block is much wider than four pixels' footprint at any working range.
+static const int32_t kSampleStep = 4;
+
+// Mesh vertices closer to a cube corner than this fraction of the edge 
+// are snapped onto it
+static const float kVertexSnap = 0.001f;
+
+// Marching cubes corner and edge numbering
+static const int32_t kCubeCorners[ 8 ][ 3 ]	= { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 } };
+static const int32_t kCubeEdges[ 12 ][ 2 ]	= { { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 }, { 4, 5 }, { 5, 6 }, { 6, 7 }, { 7, 4 }, { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 } };
+// Corners of each face, counter-clockwise seen from outside the cube
+static const int32_t kCubeFaces[ 6 ][ 4 ]	= { { 0, 3, 2, 1 }, { 4, 5, 6, 7 }, { 0, 1, 5, 4 }, { 3, 7, 6, 2 }, { 0, 4, 7, 3 }, { 1, 2, 6, 5 } };
+
+// Triangles per corner configuration as edge triples, -1 terminated
+static int8_t		sCubeTriangles[ 256 ][ 32 ];
+static once_flag	sCubeTrianglesOnce;
+
+static int32_t findCubeEdge( int32_t a, int32_t b )
+{
+	for ( int32_t e = 0; e < 12; ++e ) {
+		if ( ( kCubeEdges[ e ][ 0 ] == a && kCubeEdges[ e ][ 1 ] == b ) || ( kCubeEdges[ e ][ 0 ] == b && kCubeEdges[ e ][ 1 ] == a ) ) {
+			return e;
+		}
+	}
+	return -1;
+}
+
+// Builds the triangle table from the faces instead of storing the usual 
+// 256-entry literal. On every face each run of inside corners is cut off 
+// by its own segment, which also settles ambiguous faces, so neighbouring 
+// cubes always agree on the shared face and the mesh has no cracks. The 
+// segments of all six faces join into closed loops that are fanned into 
+// triangles.
+static void buildCubeTriangles()
+{
+	for ( int32_t config = 0; config < 256; ++config ) {
+		int32_t next[ 12 ];
+		for ( int32_t e = 0; e < 12; ++e ) {
+			next[ e ] = -1;
+		}
+		for ( int32_t f = 0; f < 6; ++f ) {
+			const int32_t* q = kCubeFaces[ f ];
+			for ( int32_t k = 0; k < 4; ++k ) {
+				int32_t previous = ( k + 3 ) % 4;
+				if ( ( config & ( 1 << q[ k ] ) ) == 0 || ( config & ( 1 << q[ previous ] ) ) != 0 ) {
+					continue;
+				}
+				int32_t j = k;
+				while ( ( config & ( 1 << q[ ( j + 1 ) % 4 ] ) ) != 0 ) {
+					j = ( j + 1 ) % 4;
+				}
+				next[ findCubeEdge( q[ previous ], q[ k ] ) ] = findCubeEdge( q[ j ], q[ ( j + 1 ) % 4 ] );
+			}
+		}
+
+		int32_t count = 0;
+		bool visited[ 12 ] = { false };
+		for ( int32_t e = 0; e < 12; ++e ) {
+			if ( next[ e ] < 0 || visited[ e ] ) {
+				continue;
+			}
+			int32_t loop[ 12 ];
+			int32_t length = 0;
+			for ( int32_t i = e; !visited[ i ]; i = next[ i ] ) {
+				visited[ i ]		= true;
+				loop[ length++ ]	= i;
+			}
+			for ( int32_t i = 1; i + 1 < length; ++i ) {
+				sCubeTriangles[ config ][ count++ ] = (int8_t)loop[ 0 ];
+				sCubeTriangles[ config ][ count++ ] = (int8_t)loop[ i ];
+				sCubeTriangles[ config ][ count++ ] = (int8_t)loop[ i + 1 ];
+			}
+		}
+		sCubeTriangles[ config ][ count ] = -1;
+	}
+}
+
+TsdfVolumeRef TsdfVolume::create( const CoordinateMapperRef& mapper, float voxelSize, float truncation, size_t memoryBudget )
+{
+	return TsdfVolumeRef( new TsdfVolume( mapper, voxelSize, truncation, memoryBudget ) );
+}
+
+TsdfVolume::TsdfVolume( const CoordinateMapperRef& mapper, float voxelSize, float truncation, size_t memoryBudget )
+: mBlockCount( 0 ), mEvictedCount( 0 ), mFrame( 0 ), mMapper( mapper ), mMaxWeight( 64 ), 
+mTruncation( max( truncation, voxelSize ) ), mVoxelSize( voxelSize )
+{
+	call_once( sCubeTrianglesOnce, buildCubeTriangles );
+	mMaxBlockCount = max<size_t>( memoryBudget / sizeof( Block ), 1 );
+	mVisibleBlocks.reserve( mVisibleHash.getCapacity() );
+}
+
+uint64_t TsdfVolume::getKey( const Vec3i& coord )
+{
+	return ( (uint64_t)( coord.x & 0x1fffff ) << 42 ) | ( (uint64_t)( coord.y & 0x1fffff ) << 21 ) | (uint64_t)( coord.z & 0x1fffff );
+}
+
+const TsdfVolume::Block* TsdfVolume::findBlock( const Vec3i& coord ) const
+{
+	unordered_map<uint64_t, uint32_t>::const_iterator iter = mBlockMap.find( getKey( coord ) );
+	return iter == mBlockMap.end() ? 0 : mBlocks[ iter->second ].get();
+}
+
+void TsdfVolume::clear()
+{
+	mBlockMap.clear();
+	mBlocks.clear();
+	mFreeBlocks.clear();
+	mBlockCount = 0;
+}
+
+void TsdfVolume::integrate( const Channel16u& depth, const Matrix44f& pose )
+{
+	int32_t width	= mMapper->getDepthWidth();
+	int32_t height	= mMapper->getDepthHeight();
+	if ( !depth || depth.getWidth() != width || depth.getHeight() != height ) {
+		return;
+	}
+	++mFrame;
+
+	// Blocks hit by the truncation band around the sampled surface points
+	const float* tableX	= mMapper->getDepthToCameraTableX();
+	const float* tableY	= mMapper->getDepthToCameraTableY();
+	float blockScale	= 1.0f / ( mVoxelSize * (float)kBlockSize );
+	mVisibleHash.clear();
+	for ( int32_t y = kSampleStep / 2; y < height; y += kSampleStep ) {
+		const uint16_t* row = depth.getData( Vec2i( 0, y ) );
+		for ( int32_t x = kSampleStep / 2; x < width; x += kSampleStep ) {
+			if ( row[ x ] == 0 ) {
+				continue;
+			}
+			size_t i	= y * width + x;
+			float z		= (float)row[ x ] * 0.001f;
+			for ( int32_t s = -1; s <= 1; ++s ) {
+				float zs = z + (float)s * mTruncation;
+				Vec3f c( tableX[ i ] * zs, tableY[ i ] * zs, zs );
+				Vec3f w(
+					pose.at( 0, 0 ) * c.x + pose.at( 0, 1 ) * c.y + pose.at( 0, 2 ) * c.z + pose.at( 0, 3 ), 
+					pose.at( 1, 0 ) * c.x + pose.at( 1, 1 ) * c.y + pose.at( 1, 2 ) * c.z + pose.at( 1, 3 ), 
+					pose.at( 2, 0 ) * c.x + pose.at( 2, 1 ) * c.y + pose.at( 2, 2 ) * c.z + pose.at( 2, 3 ) 
+					);
+				mVisibleHash.insert( Vec3i( (int32_t)floor( w.x * blockScale ), (int32_t)floor( w.y * blockScale ), (int32_t)floor( w.z * blockScale ) ) );
+			}
+		}
+	}
+
+	size_t visibleCount = mVisibleHash.getSize();
+	size_t missing		= 0;
+	for ( size_t i = 0; i < visibleCount; ++i ) {
+		unordered_map<uint64_t, uint32_t>::iterator iter = mBlockMap.find( getKey( mVisibleHash.getCell( i ) ) );
+		if ( iter == mBlockMap.end() ) {
+			++missing;
+		} else {
+			mBlocks[ iter->second ]->mFrame = mFrame;
+		}
+	}
+	if ( mBlockCount + missing > mMaxBlockCount ) {
+		evict();
+	}
+
+	mVisibleBlocks.clear();
+	for ( size_t i = 0; i < visibleCount; ++i ) {
+		const Vec3i& coord	= mVisibleHash.getCell( i );
+		uint64_t key		= getKey( coord );
+		unordered_map<uint64_t, uint32_t>::iterator iter = mBlockMap.find( key );
+		if ( iter != mBlockMap.end() ) {
+			mVisibleBlocks.push_back( iter->second );
+			continue;
+		}
+
+		uint32_t index = 0;
+		if ( !mFreeBlocks.empty() ) {
+			index = mFreeBlocks.back();
+			mFreeBlocks.pop_back();
+		} else if ( mBlocks.size() < mMaxBlockCount ) {
+			index = (uint32_t)mBlocks.size();
+			mBlocks.push_back( BlockRef( new Block() ) );
+		} else {
+			continue;
+		}
+		Block& block	= *mBlocks[ index ];
+		block.mCoord	= coord;
+		block.mChanged	= false;
+		block.mFrame	= mFrame;
+		block.mMesh.clear();
+		memset( block.mVoxels, 0, sizeof( block.mVoxels ) );
+		mBlockMap[ key ] = index;
+		mVisibleBlocks.push_back( index );
+		++mBlockCount;
+	}
+
+	// Inverse of the rigid pose, volume space to camera space
+	float rotation[ 9 ];
+	for ( int32_t r = 0; r < 3; ++r ) {
+		for ( int32_t c = 0; c < 3; ++c ) {
+			rotation[ r * 3 + c ] = pose.at( c, r );
+		}
+	}
+	Vec3f t( pose.at( 0, 3 ), pose.at( 1, 3 ), pose.at( 2, 3 ) );
+	Vec3f translation(
+		-( rotation[ 0 ] * t.x + rotation[ 1 ] * t.y + rotation[ 2 ] * t.z ), 
+		-( rotation[ 3 ] * t.x + rotation[ 4 ] * t.y + rotation[ 5 ] * t.z ), 
+		-( rotation[ 6 ] * t.x + rotation[ 7 ] * t.y + rotation[ 8 ] * t.z ) 
+		);
+	concurrency::parallel_for( (size_t)0, mVisibleBlocks.size(), [ & ]( size_t i )
+	{
+		Block& block = *mBlocks[ mVisibleBlocks[ i ] ];
+		if ( integrateBlock( block, depth, rotation, translation ) ) {
+			block.mChanged = true;
+		}
+	} );
+}
+
+bool TsdfVolume::integrateBlock( Block& block, const Channel16u& depth, const float* rotation, const Vec3f& translation )
+{
+	const CameraProjection& projection = mMapper->getDepthProjection();
+	int32_t width		= depth.getWidth();
+	int32_t height		= depth.getHeight();
+	float invTruncation	= 1.0f / mTruncation;
+	Vec3f origin		= Vec3f( (float)block.mCoord.x, (float)block.mCoord.y, (float)block.mCoord.z ) * ( (float)kBlockSize * mVoxelSize );
+	bool changed		= false;
+	Voxel* voxel		= block.mVoxels;
+	for ( int32_t z = 0; z < kBlockSize; ++z ) {
+		for ( int32_t y = 0; y < kBlockSize; ++y ) {
+			for ( int32_t x = 0; x < kBlockSize; ++x, ++voxel ) {
+				Vec3f v = origin + Vec3f( (float)x + 0.5f, (float)y + 0.5f, (float)z + 0.5f ) * mVoxelSize;
+				Vec3f c(
+					rotation[ 0 ] * v.x + rotation[ 1 ] * v.y + rotation[ 2 ] * v.z + translation.x, 
+					rotation[ 3 ] * v.x + rotation[ 4 ] * v.y + rotation[ 5 ] * v.z + translation.y, 
+					rotation[ 6 ] * v.x + rotation[ 7 ] * v.y + rotation[ 8 ] * v.z + translation.z 
+					);
+				if ( c.z <= 0.0f ) {
+					continue;
+				}
+				Vec2f uv	= projection.project( c );
+				int32_t u	= (int32_t)( uv.x + 0.5f );
+				int32_t w	= (int32_t)( uv.y + 0.5f );
+				if ( uv.x < 0.0f || uv.y < 0.0f || u >= width || w >= height ) {
+					continue;
+				}
+				uint16_t d = *depth.getData( Vec2i( u, w ) );
+				if ( d == 0 ) {
+					continue;
+				}
+
+				// Projective distance along the view axis. Voxels far behind 
+				// the surface are occluded and left alone.
+				float distance = ( (float)d * 0.001f - c.z ) * invTruncation;
+				if ( distance < -1.0f ) {
+					continue;
+				}
+				distance = min( distance, 1.0f );
+
+				float weight		= (float)voxel->mWeight;
+				float current		= (float)voxel->mDistance / 32767.0f;
+				float blended		= ( current * weight + distance ) / ( weight + 1.0f );
+				voxel->mDistance	= (int16_t)( blended * 32767.0f );
+				voxel->mWeight		= (uint16_t)min<uint32_t>( voxel->mWeight + 1, mMaxWeight );
+				changed				= true;
+			}
+		}
+	}
+	return changed;
+}
+
+void TsdfVolume::evict()
+{
+	// Oldest blocks not seen this frame go first, down to 90% of the 
+	// budget so eviction doesn't run every frame.
+	size_t target = mMaxBlockCount - mMaxBlockCount / 10;
+	if ( mBlockCount <= target ) {
+		return;
+	}
+	vector<pair<uint32_t, uint32_t> > ages;
+	ages.reserve( mBlockCount );
+	for ( unordered_map<uint64_t, uint32_t>::const_iterator iter = mBlockMap.begin(); iter != mBlockMap.end(); ++iter ) {
+		const Block& block = *mBlocks[ iter->second ];
+		if ( block.mFrame != mFrame ) {
+			ages.push_back( make_pair( block.mFrame, iter->second ) );
+		}
+	}
+	size_t count = min( mBlockCount - target, ages.size() );
+	if ( count == 0 ) {
+		return;
+	}
+	nth_element( ages.begin(), ages.begin() + ( count - 1 ), ages.end() );
+	for ( size_t i = 0; i < count; ++i ) {
+		Block& block = *mBlocks[ ages[ i ].second ];
+		mBlockMap.erase( getKey( block.mCoord ) );
+		block.mMesh.clear();
+		mFreeBlocks.push_back( ages[ i ].second );
+
+		// Neighbours below lose the cells they shared with this block.
+		for ( int32_t n = 1; n < 8; ++n ) {
+			Vec3i coord = block.mCoord - Vec3i( n & 1, ( n >> 1 ) & 1, ( n >> 2 ) & 1 );
+			unordered_map<uint64_t, uint32_t>::iterator iter = mBlockMap.find( getKey( coord ) );
+			if ( iter != mBlockMap.end() ) {
+				mBlocks[ iter->second ]->mChanged = true;
+			}
+		}
+	}
+	mBlockCount		-= count;
+	mEvictedCount	+= count;
+}
+
+size_t TsdfVolume::updateMesh()
+{
+	// Cells on a block's upper faces read the neighbouring blocks, so a 
+	// change also dirties the neighbours below it.
+	vector<uint32_t> changed;
+	for ( unordered_map<uint64_t, uint32_t>::const_iterator iter = mBlockMap.begin(); iter != mBlockMap.end(); ++iter ) {
+		if ( mBlocks[ iter->second ]->mChanged ) {
+			changed.push_back( iter->second );
+		}
+	}
+	size_t count = changed.size();
+	for ( size_t i = 0; i < count; ++i ) {
+		const Vec3i& coord = mBlocks[ changed[ i ] ]->mCoord;
+		for ( int32_t n = 1; n < 8; ++n ) {
+			unordered_map<uint64_t, uint32_t>::const_iterator iter = mBlockMap.find( getKey( coord - Vec3i( n & 1, ( n >> 1 ) & 1, ( n >> 2 ) & 1 ) ) );
+			if ( iter != mBlockMap.end() && !mBlocks[ iter->second ]->mChanged ) {
+				mBlocks[ iter->second ]->mChanged = true;
+				changed.push_back( iter->second );
+			}
+		}
+	}
+
+	concurrency::parallel_for( (size_t)0, changed.size(), [ & ]( size_t i )
+	{
+		meshBlock( *mBlocks[ changed[ i ] ] );
+	} );
+	for ( size_t i = 0; i < changed.size(); ++i ) {
+		mBlocks[ changed[ i ] ]->mChanged = false;
+	}
+	return changed.size();
+}
+
+void TsdfVolume::meshBlock( Block& block ) const
+{
+	static const int32_t kSize = kBlockSize + 1;
+
+	// Gather the block plus one layer of its upper neighbours
+	const Block* neighbors[ 8 ];
+	for ( int32_t n = 0; n < 8; ++n ) {
+		neighbors[ n ] = n == 0 ? &block : findBlock( block.mCoord + Vec3i( n & 1, ( n >> 1 ) & 1, ( n >> 2 ) & 1 ) );
+	}
+	float distances[ kSize * kSize * kSize ];
+	bool observed[ kSize * kSize * kSize ];
+	for ( int32_t z = 0; z < kSize; ++z ) {
+		for ( int32_t y = 0; y < kSize; ++y ) {
+			for ( int32_t x = 0; x < kSize; ++x ) {
+				int32_t n			= ( x / kBlockSize ) | ( ( y / kBlockSize ) << 1 ) | ( ( z / kBlockSize ) << 2 );
+				int32_t i			= ( z * kSize + y ) * kSize + x;
+				const Block* source	= neighbors[ n ];
+				if ( source == 0 ) {
+					observed[ i ] = false;
+					continue;
+				}
+				const Voxel& voxel	= source->mVoxels[ ( ( z % kBlockSize ) * kBlockSize + ( y % kBlockSize ) ) * kBlockSize + ( x % kBlockSize ) ];
+				observed[ i ]		= voxel.mWeight > 0;
+				distances[ i ]		= (float)voxel.mDistance;
+			}
+		}
+	}
+
+	block.mMesh.clear();
+	Vec3f origin = ( Vec3f( (float)block.mCoord.x, (float)block.mCoord.y, (float)block.mCoord.z ) * (float)kBlockSize + Vec3f( 0.5f, 0.5f, 0.5f ) ) * mVoxelSize;
+	for ( int32_t z = 0; z < kBlockSize; ++z ) {
+		for ( int32_t y = 0; y < kBlockSize; ++y ) {
+			for ( int32_t x = 0; x < kBlockSize; ++x ) {
+				int32_t config = 0;
+				float d[ 8 ];
+				bool complete = true;
+				for ( int32_t k = 0; k < 8 && complete; ++k ) {
+					int32_t i	= ( ( z + kCubeCorners[ k ][ 2 ] ) * kSize + ( y + kCubeCorners[ k ][ 1 ] ) ) * kSize + x + kCubeCorners[ k ][ 0 ];
+					complete	= observed[ i ];
+					d[ k ]		= distances[ i ];
+					if ( d[ k ] < 0.0f ) {
+						config |= 1 << k;
+					}
+				}
+				if ( !complete || config == 0 || config == 255 ) {
+					continue;
+				}
+
+				Vec3f corner = origin + Vec3f( (float)x, (float)y, (float)z ) * mVoxelSize;
+				for ( const int8_t* e = sCubeTriangles[ config ]; *e >= 0; e += 3 ) {
+					Vec3f triangle[ 3 ];
+					for ( int32_t k = 0; k < 3; ++k ) {
+						int32_t a	= kCubeEdges[ e[ k ] ][ 0 ];
+						int32_t b	= kCubeEdges[ e[ k ] ][ 1 ];
+						float t		= d[ a ] / ( d[ a ] - d[ b ] );
+						t			= t < kVertexSnap ? 0.0f : t > 1.0f - kVertexSnap ? 1.0f : t;
+						Vec3f pa( (float)kCubeCorners[ a ][ 0 ], (float)kCubeCorners[ a ][ 1 ], (float)kCubeCorners[ a ][ 2 ] );
+						Vec3f pb( (float)kCubeCorners[ b ][ 0 ], (float)kCubeCorners[ b ][ 1 ], (float)kCubeCorners[ b ][ 2 ] );
+						triangle[ k ] = corner + ( pa + ( pb - pa ) * t ) * mVoxelSize;
+					}
+
+					// A corner at or next to the surface puts the vertices of 
+					// all its edges on the corner. The collapsed triangles 
+					// add no area and would share edges with their 
+					// neighbours more than twice.
+					if ( triangle[ 0 ] == triangle[ 1 ] || triangle[ 1 ] == triangle[ 2 ] || triangle[ 2 ] == triangle[ 0 ] ) {
+						continue;
+					}
+					block.mMesh.insert( block.mMesh.end(), triangle, triangle + 3 );
+				}
+			}
+		}
+	}
+}
+
+void TsdfVolume::getMesh( vector<Vec3f>& positions ) const
+{
+	for ( unordered_map<uint64_t, uint32_t>::const_iterator iter = mBlockMap.begin(); iter != mBlockMap.end(); ++iter ) {
+		const vector<Vec3f>& mesh = mBlocks[ iter->second ]->mMesh;
+		positions.insert( positions.end(), mesh.begin(), mesh.end() );
+	}
+}
+
+bool TsdfVolume::getDistance( const Vec3i& voxel, float& distance ) const
+{
+	Vec3i coord(
+		(int32_t)floor( (float)voxel.x / (float)kBlockSize ), 
+		(int32_t)floor( (float)voxel.y / (float)kBlockSize ), 
+		(int32_t)floor( (float)voxel.z / (float)kBlockSize ) 
+		);
+	const Block* block = findBlock( coord );
+	if ( block == 0 ) {
+		return false;
+	}
+	Vec3i local		= voxel - coord * kBlockSize;
+	const Voxel& v	= block->mVoxels[ ( local.z * kBlockSize + local.y ) * kBlockSize + local.x ];
+	distance		= (float)v.mDistance / 32767.0f * mTruncation;
+	return v.mWeight > 0;
+}
+
+size_t TsdfVolume::getBlockCount() const
+{
+	return mBlockCount;
+}
+
+size_t TsdfVolume::getEvictedCount() const
+{
+	return mEvictedCount;
+}
+
+size_t TsdfVolume::getMaxBlockCount() const
+{
+	return mMaxBlockCount;
+}
+
+float TsdfVolume::getTruncation() const
+{
+	return mTruncation;
+}
+
+float TsdfVolume::getVoxelSize() const
+{
+	return mVoxelSize;
+}
+
+void TsdfVolume::setMaxWeight( uint16_t maxWeight )
+{
+	mMaxWeight = max<uint16_t>( maxWeight, 1 );
+}
+
+}
@@ -0,0 +1,132 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2.h"
+#include "Kinect2CoordinateMapper.h"
+#include "Kinect2VoxelGrid.h"
+#include <unordered_map>
+
+namespace Kinect2 {
+
+class TsdfVolume;
+typedef std::shared_ptr<TsdfVolume>	TsdfVolumeRef;
+
+// Truncated signed distance volume for reconstruction from depth alone. 
+// Voxels live in 8x8x8 blocks that are allocated where depth lands and 
+// looked up by a hash of their block coordinates, so only the observed 
+// surface costs memory. Blocks that fall outside the memory budget are 
+// evicted, least recently observed first.
+// 
+// integrate() fuses one depth frame: visible blocks are found from a 
+// sparse sample of the depth pixels, then updated in parallel. 
+// updateMesh() reruns marching cubes only for blocks changed since the 
+// last call.
+class TsdfVolume
+{
+public:
+	static const int32_t						kBlockSize = 8;
+
+	// "truncation" is the distance in meters around the surface that is 
+	// tracked. "memoryBudget" is in bytes.
+	static TsdfVolumeRef						create( const CoordinateMapperRef& mapper, float voxelSize = 0.01f, 
+												float truncation = 0.04f, size_t memoryBudget = 512 * 1024 * 1024 );
+
+	// "pose" maps camera space to volume space.
+	void										integrate( const ci::Channel16u& depth, const ci::Matrix44f& pose );
+	// Remeshes changed blocks. Returns how many were remeshed.
+	size_t										updateMesh();
+	void										clear();
+
+	// Appends the triangles of every block, three positions per triangle, 
+	// wound counter-clockwise seen from outside the surface.
+	void										getMesh( std::vector<ci::Vec3f>& positions ) const;
+	// Signed distance in meters and whether the voxel has been observed
+	bool										getDistance( const ci::Vec3i& voxel, float& distance ) const;
+
+	size_t										getBlockCount() const;
+	size_t										getEvictedCount() const;
+	size_t										getMaxBlockCount() const;
+	float										getTruncation() const;
+	float										getVoxelSize() const;
+	void										setMaxWeight( uint16_t maxWeight );
+protected:
+	static const int32_t						kVoxelCount = kBlockSize * kBlockSize * kBlockSize;
+
+	struct Voxel
+	{
+		// Signed distance over truncation, scaled to +-32767
+		int16_t									mDistance;
+		uint16_t								mWeight;
+	};
+
+	struct Block
+	{
+		ci::Vec3i								mCoord;
+		bool									mChanged;
+		uint32_t								mFrame;
+		std::vector<ci::Vec3f>					mMesh;
+		Voxel									mVoxels[ kVoxelCount ];
+	};
+	typedef std::shared_ptr<Block>	BlockRef;
+
+	TsdfVolume( const CoordinateMapperRef& mapper, float voxelSize, float truncation, size_t memoryBudget );
+
+	const Block*								findBlock( const ci::Vec3i& coord ) const;
+	static uint64_t								getKey( const ci::Vec3i& coord );
+	bool										integrateBlock( Block& block, const ci::Channel16u& depth, const float* rotation, 
+												const ci::Vec3f& translation );
+	void										meshBlock( Block& block ) const;
+	void										evict();
+
+	std::vector<BlockRef>						mBlocks;
+	std::vector<uint32_t>						mFreeBlocks;
+	size_t										mBlockCount;
+	std::unordered_map<uint64_t, uint32_t>		mBlockMap;
+	size_t										mEvictedCount;
+	uint32_t									mFrame;
+	CoordinateMapperRef							mMapper;
+	size_t										mMaxBlockCount;
+	uint16_t									mMaxWeight;
+	float										mTruncation;
+	std::vector<uint32_t>						mVisibleBlocks;
+	SpatialHash									mVisibleHash;
+	float										mVoxelSize;
+};
+
+}
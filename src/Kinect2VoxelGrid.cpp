@@ -0,0 +1,365 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#include "Kinect2VoxelGrid.h"
+
+#include <cmath>
+#include <limits>
+#include <ppl.h>
+
+namespace Kinect2
+{
+using namespace ci;
+using namespace std;
+
+SpatialHash::SpatialHash( size_t capacity )
+: mEpoch( 1 ), mSize( 0 )
+{
+	size_t size = 16;
+	while ( size < capacity ) {
+		size <<= 1;
+	}
+	mMask = size - 1;
+	Slot slot;
+	slot.mCell	= Vec3i::zero();
+	slot.mEpoch	= 0;
+	slot.mIndex	= -1;
+	mSlots.resize( size, slot );
+	mCells.reserve( size / 2 );
+}
+
+void SpatialHash::clear()
+{
+	mCells.clear();
+	mSize = 0;
+	++mEpoch;
+
+	// Only reached after four billion clears
+	if ( mEpoch == 0 ) {
+		for ( vector<Slot>::iterator iter = mSlots.begin(); iter != mSlots.end(); ++iter ) {
+			iter->mEpoch = 0;
+		}
+		mEpoch = 1;
+	}
+}
+
+size_t SpatialHash::hash( const Vec3i& cell ) const
+{
+	uint32_t h = (uint32_t)cell.x * 73856093u ^ (uint32_t)cell.y * 19349663u ^ (uint32_t)cell.z * 83492791u;
+	return (size_t)( h ^ ( h >> 16 ) ) & mMask;
+}
+
+int32_t SpatialHash::insert( const Vec3i& cell )
+{
+	for ( size_t i = hash( cell ); ; i = ( i + 1 ) & mMask ) {
+		Slot& slot = mSlots[ i ];
+		if ( slot.mEpoch != mEpoch ) {
+			if ( mSize * 2 >= mSlots.size() ) {
+				return -1;
+			}
+			slot.mCell	= cell;
+			slot.mEpoch	= mEpoch;
+			slot.mIndex	= (int32_t)mSize++;
+			mCells.push_back( cell );
+			return slot.mIndex;
+		} else if ( slot.mCell == cell ) {
+			return slot.mIndex;
+		}
+	}
+}
+
+int32_t SpatialHash::find( const Vec3i& cell ) const
+{
+	for ( size_t i = hash( cell ); ; i = ( i + 1 ) & mMask ) {
+		const Slot& slot = mSlots[ i ];
+		if ( slot.mEpoch != mEpoch ) {
+			return -1;
+		} else if ( slot.mCell == cell ) {
+			return slot.mIndex;
+		}
+	}
+}
+
+size_t SpatialHash::getCapacity() const
+{
+	return mSlots.size() / 2;
+}
+
+const Vec3i& SpatialHash::getCell( size_t index ) const
+{
+	return mCells[ index ];
+}
+
+size_t SpatialHash::getSize() const
+{
+	return mSize;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+VoxelGrid::Band::Band( size_t capacity )
+: mHash( capacity * 2 ), mOverflow( 0 )
+{
+	mCounts.resize( mHash.getCapacity(), 0 );
+	mNormals.resize( mHash.getCapacity() );
+	mSums.resize( mHash.getCapacity() );
+}
+
+VoxelGridRef VoxelGrid::create( float leafSize, size_t maxVoxels )
+{
+	return VoxelGridRef( new VoxelGrid( leafSize, maxVoxels ) );
+}
+
+VoxelGrid::VoxelGrid( float leafSize, size_t maxVoxels )
+: mHash( maxVoxels * 2 ), mLeafSize( max( leafSize, 0.001f ) ), mOverflow( 0 )
+{
+	for ( size_t i = 0; i < kBandCount; ++i ) {
+		mBands.push_back( shared_ptr<Band>( new Band( maxVoxels ) ) );
+	}
+	mCentroids.reserve( mHash.getCapacity() );
+	mCounts.reserve( mHash.getCapacity() );
+	mNormals.reserve( mHash.getCapacity() );
+}
+
+Vec3i VoxelGrid::getCell( const Vec3f& v ) const
+{
+	float scale = 1.0f / mLeafSize;
+	return Vec3i( (int32_t)floor( v.x * scale ), (int32_t)floor( v.y * scale ), (int32_t)floor( v.z * scale ) );
+}
+
+bool VoxelGrid::getCellRange( const Vec3f& v, float radius, Vec3i& lo, Vec3i& hi ) const
+{
+	// Keeps the float to int conversion defined. NaN fails too.
+	static const float kLimit = 1.0e9f;
+	float scale	= 1.0f / mLeafSize;
+	Vec3f a		= ( v - Vec3f( radius, radius, radius ) ) * scale;
+	Vec3f b		= ( v + Vec3f( radius, radius, radius ) ) * scale;
+	if ( !( a.x > -kLimit && a.y > -kLimit && a.z > -kLimit && b.x < kLimit && b.y < kLimit && b.z < kLimit ) ) {
+		return false;
+	}
+	lo = Vec3i( (int32_t)floor( a.x ), (int32_t)floor( a.y ), (int32_t)floor( a.z ) );
+	hi = Vec3i( (int32_t)floor( b.x ), (int32_t)floor( b.y ), (int32_t)floor( b.z ) );
+
+	double cells = (double)( hi.x - lo.x + 1 ) * (double)( hi.y - lo.y + 1 ) * (double)( hi.z - lo.z + 1 );
+	return cells <= (double)mCentroids.size();
+}
+
+void VoxelGrid::update( const Surface32f& points, const Surface32f& normals )
+{
+	mCentroids.clear();
+	mCounts.clear();
+	mNormals.clear();
+	mHash.clear();
+	mOverflow = 0;
+	if ( !points ) {
+		return;
+	}
+	bool hasNormals = normals && normals.getWidth() == points.getWidth() && normals.getHeight() == points.getHeight();
+	int32_t width	= points.getWidth();
+	int32_t height	= points.getHeight();
+
+	concurrency::parallel_for( (size_t)0, kBandCount, [ & ]( size_t index )
+	{
+		Band& band		= *mBands[ index ];
+		int32_t y0		= (int32_t)( index * height / kBandCount );
+		int32_t y1		= (int32_t)( ( index + 1 ) * height / kBandCount );
+		band.mHash.clear();
+		band.mOverflow	= 0;
+		for ( int32_t y = y0; y < y1; ++y ) {
+			const float* p = points.getData( Vec2i( 0, y ) );
+			const float* n = hasNormals ? normals.getData( Vec2i( 0, y ) ) : 0;
+			for ( int32_t x = 0; x < width; ++x, p += points.getPixelInc() ) {
+				Vec3f v( p[ 0 ], p[ 1 ], p[ 2 ] );
+				if ( !( v.z > 0.0f ) || v.z == numeric_limits<float>::infinity() ) {
+					continue;
+				}
+				size_t previous	= band.mHash.getSize();
+				int32_t i		= band.mHash.insert( getCell( v ) );
+				if ( i < 0 ) {
+					++band.mOverflow;
+					continue;
+				}
+				if ( (size_t)i == previous ) {
+					band.mCounts[ i ]	= 0;
+					band.mNormals[ i ]	= Vec3f::zero();
+					band.mSums[ i ]		= Vec3f::zero();
+				}
+				++band.mCounts[ i ];
+				band.mSums[ i ] += v;
+				if ( n != 0 ) {
+					const float* normal = n + x * normals.getPixelInc();
+					band.mNormals[ i ] += Vec3f( normal[ 0 ], normal[ 1 ], normal[ 2 ] );
+				}
+			}
+		}
+	} );
+
+	// Voxels that straddle two bands appear in both and are combined here.
+	for ( size_t b = 0; b < kBandCount; ++b ) {
+		const Band& band	= *mBands[ b ];
+		size_t count		= band.mHash.getSize();
+		mOverflow			+= band.mOverflow;
+		for ( size_t j = 0; j < count; ++j ) {
+			size_t previous	= mHash.getSize();
+			int32_t i		= mHash.insert( band.mHash.getCell( j ) );
+			if ( i < 0 ) {
+				mOverflow += band.mCounts[ j ];
+				continue;
+			}
+			if ( (size_t)i == previous ) {
+				mCentroids.push_back( Vec3f::zero() );
+				mCounts.push_back( 0 );
+				if ( hasNormals ) {
+					mNormals.push_back( Vec3f::zero() );
+				}
+			}
+			mCentroids[ i ]	+= band.mSums[ j ];
+			mCounts[ i ]	+= band.mCounts[ j ];
+			if ( hasNormals ) {
+				mNormals[ i ] += band.mNormals[ j ];
+			}
+		}
+	}
+
+	for ( size_t i = 0; i < mCentroids.size(); ++i ) {
+		mCentroids[ i ] /= (float)mCounts[ i ];
+		if ( hasNormals && mNormals[ i ].lengthSquared() > 0.0f ) {
+			mNormals[ i ].normalize();
+		}
+	}
+}
+
+int32_t VoxelGrid::findNearest( const Vec3f& v, float maxDistance ) const
+{
+	maxDistance		= maxDistance > 0.0f ? maxDistance : 0.0f;
+	int32_t nearest	= -1;
+	float best		= maxDistance * maxDistance;
+	Vec3i lo;
+	Vec3i hi;
+	if ( !getCellRange( v, maxDistance, lo, hi ) ) {
+		for ( size_t i = 0; i < mCentroids.size(); ++i ) {
+			float d = mCentroids[ i ].distanceSquared( v );
+			if ( d <= best ) {
+				best	= d;
+				nearest	= (int32_t)i;
+			}
+		}
+		return nearest;
+	}
+
+	for ( int32_t z = lo.z; z <= hi.z; ++z ) {
+		for ( int32_t y = lo.y; y <= hi.y; ++y ) {
+			for ( int32_t x = lo.x; x <= hi.x; ++x ) {
+				int32_t i = mHash.find( Vec3i( x, y, z ) );
+				if ( i >= 0 ) {
+					float d = mCentroids[ i ].distanceSquared( v );
+					if ( d <= best ) {
+						best	= d;
+						nearest	= i;
+					}
+				}
+			}
+		}
+	}
+	return nearest;
+}
+
+size_t VoxelGrid::findInRadius( const Vec3f& v, float radius, vector<uint32_t>& indices ) const
+{
+	indices.clear();
+	radius		= radius > 0.0f ? radius : 0.0f;
+	float r2	= radius * radius;
+	Vec3i lo;
+	Vec3i hi;
+	if ( !getCellRange( v, radius, lo, hi ) ) {
+		for ( size_t i = 0; i < mCentroids.size(); ++i ) {
+			if ( mCentroids[ i ].distanceSquared( v ) <= r2 ) {
+				indices.push_back( (uint32_t)i );
+			}
+		}
+		return indices.size();
+	}
+
+	for ( int32_t z = lo.z; z <= hi.z; ++z ) {
+		for ( int32_t y = lo.y; y <= hi.y; ++y ) {
+			for ( int32_t x = lo.x; x <= hi.x; ++x ) {
+				int32_t i = mHash.find( Vec3i( x, y, z ) );
+				if ( i >= 0 && mCentroids[ i ].distanceSquared( v ) <= r2 ) {
+					indices.push_back( (uint32_t)i );
+				}
+			}
+		}
+	}
+	return indices.size();
+}
+
+const vector<Vec3f>& VoxelGrid::getCentroids() const
+{
+	return mCentroids;
+}
+
+const vector<uint32_t>& VoxelGrid::getCounts() const
+{
+	return mCounts;
+}
+
+const SpatialHash& VoxelGrid::getHash() const
+{
+	return mHash;
+}
+
+float VoxelGrid::getLeafSize() const
+{
+	return mLeafSize;
+}
+
+const vector<Vec3f>& VoxelGrid::getNormals() const
+{
+	return mNormals;
+}
+
+size_t VoxelGrid::getOverflowCount() const
+{
+	return mOverflow;
+}
+
+size_t VoxelGrid::getVoxelCount() const
+{
+	return mCentroids.size();
+}
+
+}
@@ -0,0 +1,144 @@
+/*
+* 
+* Copyright (c) 2013, Wieden+Kennedy
+* Stephen Schieberl, Michael Latzoni
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#include "Kinect2.h"
+
+namespace Kinect2 {
+
+class VoxelGrid;
+typedef std::shared_ptr<VoxelGrid>	VoxelGridRef;
+
+// Open-addressing hash from integer cells to dense indices 0 to getSize() - 1. 
+// Slots carry the epoch they were written in, so clear() only advances the 
+// epoch instead of touching the table.
+class SpatialHash
+{
+public:
+	// "capacity" is rounded up to a power of two. Inserts fail once half of 
+	// it is in use.
+	SpatialHash( size_t capacity = 1 << 16 );
+
+	void										clear();
+	// Returns the cell's index, adding it if needed, or -1 if full.
+	int32_t										insert( const ci::Vec3i& cell );
+	// Returns -1 if "cell" is absent.
+	int32_t										find( const ci::Vec3i& cell ) const;
+
+	size_t										getCapacity() const;
+	const ci::Vec3i&							getCell( size_t index ) const;
+	size_t										getSize() const;
+protected:
+	struct Slot
+	{
+		ci::Vec3i								mCell;
+		uint32_t								mEpoch;
+		int32_t									mIndex;
+	};
+
+	size_t										hash( const ci::Vec3i& cell ) const;
+
+	std::vector<ci::Vec3i>						mCells;
+	uint32_t									mEpoch;
+	size_t										mMask;
+	size_t										mSize;
+	std::vector<Slot>							mSlots;
+};
+
+// Downsamples a camera space point map, such as mapDepthFrameToCamera() 
+// output, to one point per occupied voxel. Each voxel keeps the centroid 
+// and count of its points and, if normals are supplied, their mean normal. 
+// Row bands are binned in parallel into their own hashes and merged.
+class VoxelGrid
+{
+public:
+	static VoxelGridRef							create( float leafSize = 0.02f, size_t maxVoxels = 1 << 16 );
+
+	// "normals" is optional and must match "points" in size, e.g. 
+	// DepthFeatures::getNormals(). Zero normals are ignored.
+	void										update( const ci::Surface32f& points, const ci::Surface32f& normals = ci::Surface32f() );
+
+	const std::vector<ci::Vec3f>&				getCentroids() const;
+	const std::vector<uint32_t>&				getCounts() const;
+	const SpatialHash&							getHash() const;
+	float										getLeafSize() const;
+	// Unit normals per voxel, empty if update() had no normals
+	const std::vector<ci::Vec3f>&				getNormals() const;
+	// Points left out because the voxel limit was reached
+	size_t										getOverflowCount() const;
+	size_t										getVoxelCount() const;
+
+	// Both queries look up every cell within reach of "v", or scan all 
+	// voxels when that is fewer, so large distances are safe but slow.
+
+	// Voxel with the centroid closest to "v" within "maxDistance", or -1
+	int32_t										findNearest( const ci::Vec3f& v, float maxDistance ) const;
+	// Replaces "indices" with the voxels whose centroids lie within "radius" 
+	// and returns their count.
+	size_t										findInRadius( const ci::Vec3f& v, float radius, std::vector<uint32_t>& indices ) const;
+protected:
+	static const size_t							kBandCount = 8;
+
+	struct Band
+	{
+		Band( size_t capacity );
+
+		std::vector<uint32_t>					mCounts;
+		SpatialHash								mHash;
+		std::vector<ci::Vec3f>					mNormals;
+		size_t									mOverflow;
+		std::vector<ci::Vec3f>					mSums;
+	};
+
+	VoxelGrid( float leafSize, size_t maxVoxels );
+
+	ci::Vec3i									getCell( const ci::Vec3f& v ) const;
+	// Cells within "radius" of "v". Returns false if there are more of 
+	// them than voxels, or too many to count.
+	bool										getCellRange( const ci::Vec3f& v, float radius, ci::Vec3i& lo, ci::Vec3i& hi ) const;
+
+	std::vector<std::shared_ptr<Band> >			mBands;
+	std::vector<ci::Vec3f>						mCentroids;
+	std::vector<uint32_t>						mCounts;
+	SpatialHash									mHash;
+	float										mLeafSize;
+	std::vector<ci::Vec3f>						mNormals;
+	size_t										mOverflow;
+};
+
+}